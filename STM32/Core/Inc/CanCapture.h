@@ -0,0 +1,127 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    CanCapture.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+#ifndef CAN_CAPTURE_H
+#define CAN_CAPTURE_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+#include "CanFrameBuffer.h"
+#include "CanFilter.h"
+
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+#include "Timestamp.h"
+
+/*-- Exported macro ---------------------------------------------------------*/
+//Captured buses, bus n is bxCAN n + 1
+#define CAN_CAPTURE_NUM_BUSES			2
+
+//First of the 28 shared filter banks owned by CAN2, banks below it belong
+//to CAN1. Each side needs at least 4 banks for the accept-all setup.
+#ifndef CAN_CAPTURE_SLAVE_START_BANK
+#define CAN_CAPTURE_SLAVE_START_BANK	14
+#endif
+
+//Frames between Rx ISR and main loop, per bus, power of two.
+//256 frames hold 30 ms of 1 Mbit/s bus at full load.
+#ifndef CAN_CAPTURE_QUEUE_SIZE
+#define CAN_CAPTURE_QUEUE_SIZE			256
+#endif
+
+//Frames forwarded to USB per bus and CanCapture_Run call
+#ifndef CAN_CAPTURE_RUN_BUDGET
+#define CAN_CAPTURE_RUN_BUDGET			64
+#endif
+
+//Frame timestamp, 64 bit microseconds. Taken once per Rx ISR entry, one
+//time base for all buses, so merged streams keep bus order.
+#ifndef CAN_CAPTURE_TIMESTAMP
+#define CAN_CAPTURE_TIMESTAMP()			Timestamp_Get()
+#endif
+
+//bxCAN time triggered mode: 1 - frames drained by one Rx ISR are placed back
+//from the newest one by their mailbox SOF stamps instead of sharing the ISR
+//entry time, 0 - disabled
+#ifndef CAN_CAPTURE_TTCM
+#define CAN_CAPTURE_TTCM				0
+#endif
+
+//Rx ISR profiling with DWT cycle counter: 1 - enabled, 0 - disabled
+#ifndef CAN_CAPTURE_PROFILE
+#define CAN_CAPTURE_PROFILE				0
+#endif
+
+//Write to Rx FIFO register RF0R/RF1R: flags are cleared by writing 1 and
+//RFOM releases the output mailbox. Host tests route it to the model of the
+//controller behind a mocked register block.
+#ifndef CAN_CAPTURE_RFR_WRITE
+#define CAN_CAPTURE_RFR_WRITE(rfr, value)	(*(rfr) = (value))
+#endif
+
+//Write to Tx status register TSR: RQCPx written 1 clears the completion
+//status of mailbox x, routed like CAN_CAPTURE_RFR_WRITE in host tests
+#ifndef CAN_CAPTURE_TSR_WRITE
+#define CAN_CAPTURE_TSR_WRITE(tsr, value)	(*(tsr) = (value))
+#endif
+
+//CanCapture_GetStatus flags, SJA1000 status layout of SLCAN F command
+#define CAN_CAPTURE_STATUS_QUEUE_FULL	0x01	//Frame queue dropped frames
+#define CAN_CAPTURE_STATUS_ERROR_WARNING	0x04
+#define CAN_CAPTURE_STATUS_OVERRUN		0x08	//Hardware Rx FIFO overrun
+#define CAN_CAPTURE_STATUS_ERROR_PASSIVE	0x20
+#define CAN_CAPTURE_STATUS_BUS_OFF		0x80
+
+/*-- Typedefs ---------------------------------------------------------------*/
+typedef enum
+{
+	CAN_CAPTURE_MODE_NORMAL = 0,			//Receive, acknowledge and transmit
+	CAN_CAPTURE_MODE_SILENT,				//Listen only, bus is never disturbed
+	CAN_CAPTURE_MODE_LOOPBACK,				//Own frames are received, bus sees them too
+	CAN_CAPTURE_MODE_SILENT_LOOPBACK,		//Own frames are received, self-test without a bus
+}CanCapture_Mode_t;
+
+typedef struct
+{
+	uint32_t RxFrames;						//Frames read from hardware FIFOs
+	uint32_t FifoOverruns;					//Hardware FIFO overrun events
+	uint32_t QueueDropped;					//Frames lost because frame queue was full
+	uint32_t QueueHighWater;				//Maximum frame queue load, frames
+	uint32_t BusOff;						//Bus-off entries
+	uint32_t ErrorPassive;					//Error-passive entries
+	uint32_t RxIrqCyclesMax;				//Rx ISR, CPU cycles, CAN_CAPTURE_PROFILE only
+	uint32_t FilterDropped;					//Frames rejected by software filter, see CanFilter_Compile
+	uint32_t FilterBanks;					//Filter banks in use
+	uint32_t LoadTestFrames;				//Frames queued by loopback load test, compare with RxFrames
+	uint32_t TxFrames;						//Tx mailboxes completed with success
+	uint32_t TxErrors;						//Tx mailboxes completed without success: arbitration lost, error, abort
+}CanCapture_Stats_t;
+
+/*-- Exported functions -----------------------------------------------------*/
+void CanCapture_Init(void);
+void CanCapture_Run(void);
+bool CanCapture_Open(uint8_t bus, CanCapture_Mode_t mode);
+bool CanCapture_Close(uint8_t bus);
+bool CanCapture_SetMode(uint8_t bus, CanCapture_Mode_t mode);
+bool CanCapture_SetLoadTest(uint8_t bus, bool enable);
+bool CanCapture_SetBitrate(uint8_t bus, uint32_t bitrate);
+bool CanCapture_SetBitTiming(uint8_t bus, uint32_t prescaler, uint32_t timeSeg1, uint32_t timeSeg2, uint32_t syncJumpWidth);
+bool CanCapture_ClearFilter(uint8_t bus);
+bool CanCapture_AddFilterRange(uint8_t bus, uint32_t first, uint32_t last, uint8_t flags);
+bool CanCapture_AddFilterMask(uint8_t bus, uint32_t id, uint32_t mask, uint8_t flags);
+bool CanCapture_Transmit(uint8_t bus, const CanFrame_t *frame);
+uint8_t CanCapture_GetStatus(uint8_t bus);
+void CanCapture_GetStats(uint8_t bus, CanCapture_Stats_t *stats);
+void CanCapture_RxIrqHandler(uint8_t bus, uint32_t fifo);
+void CanCapture_TxIrqHandler(uint8_t bus);
+void CanCapture_ErrorIrqHandler(uint8_t bus);
+
+#endif // CAN_CAPTURE_H
+/*-- EOF --------------------------------------------------------------------*/
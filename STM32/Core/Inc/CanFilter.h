@@ -0,0 +1,88 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    CanFilter.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+#ifndef CAN_FILTER_H
+#define CAN_FILTER_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Exported macro ---------------------------------------------------------*/
+//Acceptance rules of one bus, after ranges are split into masks
+#ifndef CAN_FILTER_MAX_RULES
+#define CAN_FILTER_MAX_RULES		32
+#endif
+
+//Filter banks shared by CAN1 and CAN2
+#define CAN_FILTER_MAX_BANKS		28
+
+//Rule flags of CanFilter_AddRange and CanFilter_AddMask
+#define CAN_FILTER_FLAG_EXT			0x01	//29 bit identifiers
+#define CAN_FILTER_FLAG_DATA_ONLY	0x02	//Remote frames are rejected
+#define CAN_FILTER_FLAG_REMOTE_ONLY	0x04	//Data frames are rejected
+
+//bxCAN 32 bit filter and RIR register layout: STID[31:21], EXID[20:3], IDE, RTR
+#define CAN_FILTER_STID_POS			21
+#define CAN_FILTER_EXID_POS			3
+#define CAN_FILTER_IDE				0x00000004U
+#define CAN_FILTER_RTR				0x00000002U
+
+/*-- Typedefs ---------------------------------------------------------------*/
+//One rule in 32 bit register layout: frame passes if (RIR ^ Id) & Mask == 0
+typedef struct
+{
+	uint32_t Id;
+	uint32_t Mask;
+}CanFilter_Rule_t;
+
+//Rule list of one bus. Empty list accepts every frame.
+typedef struct
+{
+	CanFilter_Rule_t Rules[CAN_FILTER_MAX_RULES];
+	uint32_t Count;
+}CanFilter_t;
+
+typedef enum
+{
+	CAN_FILTER_BANK_MASK_32 = 0,			//FR1 - identifier, FR2 - mask
+	CAN_FILTER_BANK_LIST_32,				//FR1, FR2 - identifiers
+	CAN_FILTER_BANK_MASK_16,				//FRx[15:0] - identifier, FRx[31:16] - mask
+	CAN_FILTER_BANK_LIST_16,				//FRx[15:0], FRx[31:16] - identifiers
+}CanFilter_BankMode_t;
+
+//One filter bank, register values
+typedef struct
+{
+	CanFilter_BankMode_t Mode;
+	uint32_t Fr1;
+	uint32_t Fr2;
+}CanFilter_Bank_t;
+
+//Compiled rule list
+typedef struct
+{
+	CanFilter_Bank_t Banks[CAN_FILTER_MAX_BANKS];
+	uint32_t Count;							//Banks used
+	uint32_t HardwareRules;					//Leading rules matched exactly by hardware
+	bool Software;							//Last bank passes a superset, see CanFilter_Match
+	uint32_t SoftwareId;					//Superset bank in 32 bit register layout
+	uint32_t SoftwareMask;
+}CanFilter_Plan_t;
+
+/*-- Exported functions -----------------------------------------------------*/
+void CanFilter_Init(CanFilter_t *filter);
+bool CanFilter_AddRange(CanFilter_t *filter, uint32_t first, uint32_t last, uint8_t flags);
+bool CanFilter_AddMask(CanFilter_t *filter, uint32_t id, uint32_t mask, uint8_t flags);
+uint32_t CanFilter_Compile(const CanFilter_t *filter, uint32_t maxBanks, CanFilter_Plan_t *plan);
+bool CanFilter_Match(const CanFilter_t *filter, uint32_t rir);
+
+#endif // CAN_FILTER_H
+/*-- EOF --------------------------------------------------------------------*/
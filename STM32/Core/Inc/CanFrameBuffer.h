@@ -0,0 +1,69 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    CanFrameBuffer.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+#ifndef CAN_FRAME_BUFFER_H
+#define CAN_FRAME_BUFFER_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Exported macro ---------------------------------------------------------*/
+#define CAN_FRAME_MAX_DATA			8
+
+//CanFrame_t Flags
+#define CAN_FRAME_FLAG_EXT			0x01	//29 bit identifier
+#define CAN_FRAME_FLAG_RTR			0x02	//Remote transmission request
+#define CAN_FRAME_FLAG_ERR			0x04	//Error frame
+
+//Static initializer of CanFrameBuffer_t over a CanFrame_t array: empty
+#define CAN_FRAME_BUFFER_INIT(slots)	{ .Slots = (slots), .Size = sizeof(slots) / sizeof((slots)[0]) }
+
+/*-- Typedefs ---------------------------------------------------------------*/
+//One received or transmitted CAN frame, fixed size slot
+typedef struct
+{
+	uint64_t Timestamp;						//Microseconds, see Timestamp_Get
+	uint32_t Id;
+	uint8_t Flags;
+	uint8_t Dlc;
+	uint8_t Data[CAN_FRAME_MAX_DATA];
+	uint8_t Bus;							//Capturing controller, tags frames of a merged stream
+}CanFrame_t;
+
+/*
+ * Single producer / single consumer ring of frame slots.
+ * Size is count of slots and must be a power of two.
+ * A slot becomes visible to the consumer only when it is completely written,
+ * so a frame is never torn.
+ */
+typedef struct
+{
+	CanFrame_t *Slots;
+	uint32_t Size;
+	volatile uint32_t Tail;
+	volatile uint32_t Head;
+	uint32_t Dropped;						//Frames lost because ring was full
+	uint32_t HighWater;						//Maximum load seen by producer, frames
+}CanFrameBuffer_t;
+
+/*-- Exported functions -----------------------------------------------------*/
+CanFrame_t *CanFrameBuffer_GetWriteSlot(CanFrameBuffer_t *buffer, uint32_t pending);
+void CanFrameBuffer_Commit(CanFrameBuffer_t *buffer, uint32_t count);
+bool CanFrameBuffer_Push(CanFrameBuffer_t *buffer, const CanFrame_t *frame);
+uint32_t CanFrameBuffer_PopArray(CanFrameBuffer_t *buffer, CanFrame_t *frames, uint32_t count);
+CanFrame_t *CanFrameBuffer_PeekContiguous(CanFrameBuffer_t *buffer, uint32_t *count);
+void CanFrameBuffer_Consume(CanFrameBuffer_t *buffer, uint32_t count);
+void CanFrameBuffer_Clear(CanFrameBuffer_t *buffer);
+uint32_t CanFrameBuffer_GetLoad(CanFrameBuffer_t *buffer);
+uint32_t CanFrameBuffer_GetFree(CanFrameBuffer_t *buffer);
+
+#endif // CAN_FRAME_BUFFER_H
+/*-- EOF --------------------------------------------------------------------*/
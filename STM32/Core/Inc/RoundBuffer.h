@@ -9,29 +9,73 @@
 #ifndef ROUND_BUFFER_H
 #define ROUND_BUFFER_H
 /*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
 #include <stdint.h>
 
 /*-- Other libraries --------------------------------------------------------*/
 /*-- Hardware specific libraries --------------------------------------------*/
 /*-- Project specific includes ----------------------------------------------*/
 /*-- Exported macro ---------------------------------------------------------*/
+//Buffer size must be a power of two: indices are free running and masked
+#define ROUND_BUFFER_IS_POW2(size)		(((size) != 0) && (((size) & ((size) - 1)) == 0))
+
+//Static initializer of RoundBuffer_t over an array: empty, REJECT policy
+#define ROUND_BUFFER_INIT(array)		{ .Buff = (array), .Size = sizeof(array) }
+
 /*-- Typedefs ---------------------------------------------------------------*/
+//What a producer does when a record does not fit
+typedef enum
+{
+	ROUND_BUFFER_OVERFLOW_REJECT = 0,		//New record is dropped (default)
+	ROUND_BUFFER_OVERFLOW_DROP_OLDEST,		//Oldest unclaimed records are dropped
+	ROUND_BUFFER_OVERFLOW_BLOCK,			//Wait for consumer up to Timeout ms, then reject
+}RoundBuffer_OverflowPolicy_t;
+
+typedef struct
+{
+	uint32_t DroppedBytes;
+	uint32_t DroppedRecords;				//Records for RecordSize > 1, else drop events
+	uint32_t HighWater;						//Maximum load seen by producer, bytes
+}RoundBuffer_Stats_t;
+
+/*
+ * Single producer / single consumer ring.
+ * Head is written only by the producer, Tail only by the consumer,
+ * so one side may live in an ISR and the other in the main loop.
+ * The only exception is DROP_OLDEST: producer moves Tail while the consumer
+ * has no Claimed data, else it drops records behind the claimed region and
+ * moves Head back. BLOCK must not be used by a producer which runs at
+ * higher priority than the consumer.
+ */
 typedef struct
 {
 	uint8_t *Buff;
 	uint32_t Size;
-    uint32_t Tail;
-    uint32_t Head;
+    volatile uint32_t Tail;
+    volatile uint32_t Head;
+	RoundBuffer_OverflowPolicy_t Policy;
+	uint32_t RecordSize;
+	uint32_t Timeout;
+	volatile uint32_t Claimed;				//Bytes from Tail consumer reads in place
+	RoundBuffer_Stats_t Stats;
 }RoundBuffer_t;
 
 /*-- Exported functions -----------------------------------------------------*/
-void RoundBuffer_AddByte(RoundBuffer_t *buffer, uint8_t byte);
-void RoundBuffer_AddArray(RoundBuffer_t *buffer, uint8_t *inArray, uint32_t length);
+void RoundBuffer_SetOverflowPolicy(RoundBuffer_t *buffer, RoundBuffer_OverflowPolicy_t policy, uint32_t recordSize, uint32_t timeout);
+void RoundBuffer_GetStats(RoundBuffer_t *buffer, RoundBuffer_Stats_t *stats);
+void RoundBuffer_ResetStats(RoundBuffer_t *buffer);
+bool RoundBuffer_AddByte(RoundBuffer_t *buffer, uint8_t byte);
+uint32_t RoundBuffer_AddArray(RoundBuffer_t *buffer, uint8_t *inArray, uint32_t length);
+uint8_t *RoundBuffer_GetWriteContiguous(RoundBuffer_t *buffer, uint32_t *length);
+void RoundBuffer_Commit(RoundBuffer_t *buffer, uint32_t length);
 void RoundBuffer_Clear(RoundBuffer_t *buffer);
 uint32_t RoundBuffer_GetSize(RoundBuffer_t *buffer);
 uint32_t RoundBuffer_GetLoad(RoundBuffer_t *buffer);
+uint32_t RoundBuffer_GetFree(RoundBuffer_t *buffer);
 uint32_t RoundBuffer_GetArray(RoundBuffer_t *buffer, uint8_t *outArray, uint32_t length);
 uint8_t RoundBuffer_GetByte(RoundBuffer_t *buffer);
+uint8_t *RoundBuffer_PeekContiguous(RoundBuffer_t *buffer, uint32_t *length);
+void RoundBuffer_Consume(RoundBuffer_t *buffer, uint32_t length);
 
 #endif // ROUND_BUFFER_H
 /*-- EOF --------------------------------------------------------------------*/
@@ -0,0 +1,48 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    RoundBufferPort.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+#ifndef ROUND_BUFFER_PORT_H
+#define ROUND_BUFFER_PORT_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Exported macro ---------------------------------------------------------*/
+/*
+ * Target services of RoundBuffer.c, Cortex-M4 with HAL tick.
+ * Another target (host build of Tests) provides its own RoundBufferPort.h
+ * earlier on the include path.
+ */
+
+//Data must be visible before the index that publishes it
+#define ROUND_BUFFER_BARRIER()			__DMB()
+
+//Critical section against the other side of the ring: returns previous
+//state, which is given back to ROUND_BUFFER_UNLOCK
+#define ROUND_BUFFER_LOCK()				RoundBufferPort_Lock()
+#define ROUND_BUFFER_UNLOCK(state)		__set_PRIMASK(state)
+
+//Millisecond tick for BLOCK overflow policy
+#define ROUND_BUFFER_GET_TICK()			HAL_GetTick()
+
+/*-- Exported functions -----------------------------------------------------*/
+static inline uint32_t RoundBufferPort_Lock(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	return primask;
+}
+
+#endif // ROUND_BUFFER_PORT_H
+/*-- EOF --------------------------------------------------------------------*/
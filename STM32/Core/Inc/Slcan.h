@@ -0,0 +1,99 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    Slcan.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+#ifndef SLCAN_H
+#define SLCAN_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+#include "RoundBuffer.h"
+#include "CanFrameBuffer.h"
+#include "CanFilter.h"
+
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Exported macro ---------------------------------------------------------*/
+//Longest command line without CR: T + 8 id + dlc + 16 data
+#define SLCAN_MAX_LINE				26
+
+//Longest frame line: T + 8 id + dlc + 16 data + 4 timestamp + CR
+#define SLCAN_MAX_FRAME_LINE		31
+
+//Longest reply to one command: Fxx, Vxxxx, Nxxxx with CR
+#define SLCAN_MAX_REPLY				6
+
+//Version reported by V command: hardware, software
+#define SLCAN_HW_VERSION			0x10
+#define SLCAN_SW_VERSION			0x13
+
+/*-- Typedefs ---------------------------------------------------------------*/
+//Bus modes of O, L and Yn commands, n is the mode number
+typedef enum
+{
+	SLCAN_MODE_NORMAL = 0,
+	SLCAN_MODE_LISTEN_ONLY,
+	SLCAN_MODE_LOOPBACK,					//Own frames only, bus sees them too
+	SLCAN_MODE_SILENT_LOOPBACK,				//Own frames only, bus is never disturbed
+}Slcan_Mode_t;
+
+//k/K command, closed channel only. k/K alone accepts every frame, otherwise
+//the rule is added to the list: kIII id, kIII-JJJ range, kIII/MMM id and
+//mask, K with 8 digit identifiers. Suffix t accepts data frames only, r
+//remote frames only.
+typedef enum
+{
+	SLCAN_FILTER_RANGE = 0,					//Id..Value
+	SLCAN_FILTER_MASK,						//Id compared in bits set in Value
+}Slcan_FilterType_t;
+
+typedef struct
+{
+	Slcan_FilterType_t Type;
+	uint32_t Id;
+	uint32_t Value;
+	uint8_t Flags;							//CAN_FILTER_FLAG_xxx
+}Slcan_Filter_t;
+
+//CAN controller side. Called from the main loop. NULL members are skipped
+//and the command is acknowledged.
+typedef struct
+{
+	bool (*Open)(uint8_t channel, Slcan_Mode_t mode);
+	bool (*Close)(uint8_t channel);
+	bool (*SetBitrate)(uint8_t channel, uint32_t bitrate);				//S command, bit/s
+	bool (*SetBtr)(uint8_t channel, uint8_t btr0, uint8_t btr1);		//s command, SJA1000 BTR0/BTR1
+	bool (*Transmit)(uint8_t channel, const CanFrame_t *frame);		//false - no free mailbox
+	uint8_t (*GetStatus)(uint8_t channel);								//F command, SJA1000 style flags
+	bool (*SetFilter)(uint8_t channel, const Slcan_Filter_t *filter);	//k/K command, NULL - accept all
+	bool (*SetMode)(uint8_t channel, Slcan_Mode_t mode);				//Yn command on open channel
+	bool (*SetLoadTest)(uint8_t channel, bool enable);					//y1/y0 command, silent loopback mode
+}Slcan_Backend_t;
+
+//Protocol state of one channel
+typedef struct
+{
+	const Slcan_Backend_t *Backend;
+	uint8_t Channel;						//Passed to backend
+	uint16_t Serial;						//Reported by N command
+	bool Open;
+	bool Timestamp;							//Z1: frames carry ms timestamp
+	bool LineOverflow;						//Line longer than SLCAN_MAX_LINE, dropped at CR
+	uint8_t LineLength;						//Bytes of a line split by ring wrap
+	char Line[SLCAN_MAX_LINE];
+}Slcan_t;
+
+/*-- Exported functions -----------------------------------------------------*/
+void Slcan_Init(Slcan_t *slcan, uint8_t channel, uint16_t serial);
+void Slcan_SetBackend(Slcan_t *slcan, const Slcan_Backend_t *backend);
+uint32_t Slcan_Process(Slcan_t *slcan, RoundBuffer_t *rxBuffer, RoundBuffer_t *txBuffer, uint32_t budget);
+bool Slcan_EncodeFrame(Slcan_t *slcan, RoundBuffer_t *txBuffer, const CanFrame_t *frame);
+
+#endif // SLCAN_H
+/*-- EOF --------------------------------------------------------------------*/
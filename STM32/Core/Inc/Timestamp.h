@@ -0,0 +1,25 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    Timestamp.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Exported macro ---------------------------------------------------------*/
+/*-- Typedefs ---------------------------------------------------------------*/
+/*-- Exported functions -----------------------------------------------------*/
+void Timestamp_Init(void);
+uint64_t Timestamp_Get(void);
+void Timestamp_IrqHandler(void);
+
+#endif // TIMESTAMP_H
+/*-- EOF --------------------------------------------------------------------*/
@@ -12,19 +12,165 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "usbd_conf.h"
+#include "usbd_cdc.h"
 /*-- Other libraries --------------------------------------------------------*/
+#include "RoundBuffer.h"
+#include "Slcan.h"
 /*-- Hardware specific libraries --------------------------------------------*/
 /*-- Project specific includes ----------------------------------------------*/
 /*-- Exported macro ---------------------------------------------------------*/
+//Data path profiling with DWT cycle counter: 1 - enabled, 0 - disabled.
+//Byte and transfer counters of USB_VCP_Stats_t are kept either way.
+#ifndef USB_VCP_PROFILE
+#define USB_VCP_PROFILE						0
+#endif
+
+//Largest single CDC_Transmit, bytes. One transfer spans many max-size packets
+//and ends with a short packet or ZLP. Must be a multiple of max packet size.
+#ifndef USB_VCP_TX_TRANSFER_SIZE
+#define USB_VCP_TX_TRANSFER_SIZE			4096
+#endif
+
+//Per channel ring sizes, bytes, power of two. Tx ring holds two transfers:
+//one in flight and one being refilled by the main loop.
+#ifndef USB_VCP_TX_BUFFER_SIZE
+#define USB_VCP_TX_BUFFER_SIZE				(2 * USB_VCP_TX_TRANSFER_SIZE)
+#endif
+
+//Rx ring must hold at least one max packet: OUT endpoint is armed only while
+//a whole packet fits, otherwise the host is NAKed until the ring drains
+#ifndef USB_VCP_RX_BUFFER_SIZE
+#define USB_VCP_RX_BUFFER_SIZE				2048
+#endif
+
+//Transmit coalescing: while less than one max packet is pending, data waits
+//for more until this many SOFs (1 ms FS, 125 us HS) passed since the last
+//transfer, then is flushed. 0 - send immediately.
+#ifndef USB_VCP_COALESCE_SOF
+#define USB_VCP_COALESCE_SOF				1
+#endif
+
+//Defaults for every channel, override per channel with
+//USB_VCP_CDCn_TX_BUFFER_SIZE, USB_VCP_CDCn_RX_BUFFER_SIZE, USB_VCP_CDCn_WEIGHT
+//or USB_VCP_VENDOR_TX_BUFFER_SIZE, USB_VCP_VENDOR_RX_BUFFER_SIZE, USB_VCP_VENDOR_WEIGHT
+
+//Channel count: CDC channels and vendor bulk interface
+#define USB_VCP_NUM_CHANNELS				(NUM_OF_CDC_UARTS + USBD_VENDOR_ENABLE)
+
+//Scheduler weight: share of USB_VCP_Run work, in quanta per round
+#ifndef USB_VCP_WEIGHT
+#define USB_VCP_WEIGHT						1
+#endif
+
+//CDC channel protocol: 1 - SLCAN (Lawicel) command set, 0 - echo Rx to Tx
+#ifndef USB_VCP_SLCAN
+#define USB_VCP_SLCAN						1
+#endif
+
+//CDC channel streaming gated by host DTR: 1 - data produced while the port is
+//closed is only counted and Tx backlog is flushed on open, 0 - always stream
+#ifndef USB_VCP_DTR_GATING
+#define USB_VCP_DTR_GATING					1
+#endif
+
+//Gated channel opened by host OUT data as well, for terminals which never set
+//DTR: 1 - enabled, 0 - DTR only
+#ifndef USB_VCP_DATA_OPENS_PORT
+#define USB_VCP_DATA_OPENS_PORT				0
+#endif
+
+//Bytes of received data a channel may process per weight unit and round
+#ifndef USB_VCP_QUANTUM
+#define USB_VCP_QUANTUM						512
+#endif
+
+//Channel events reported to the host by CDC SERIAL_STATE notification on the
+//command endpoint: lost data only, the host counts the one-shot overrun bit.
+//CAN controller state is read with the SLCAN F command.
+#define USB_VCP_EVENT_RX_OVERRUN			CDC_SERIAL_STATE_OVERRUN		//Receive FIFO of CAN controller overrun
+#define USB_VCP_EVENT_BUFFER_OVERFLOW		CDC_SERIAL_STATE_OVERRUN		//Frame queue or Tx round buffer dropped data
+
+//Vendor bulk interface streams captured CAN frames as fixed size binary
+//records, little-endian, host OUT data is discarded. Record layout:
+//  0 Timestamp u64 (us), 8 Id u32, 12 Flags (CAN_FRAME_FLAG_x), 13 Dlc,
+//  14 Bus, 15 reserved 0, 16 Data[8] (bytes past Dlc are 0)
+#define USB_VCP_VENDOR_RECORD_SIZE			24
+
 /*-- Typedefs ---------------------------------------------------------------*/
+//Data path counters, read with debugger or USB_VCP_GetStats
+typedef struct
+{
+	uint32_t RxBytes;						//Bytes received from host
+	uint32_t TxBytes;						//Bytes sent to host
+	uint32_t TxTransfers;					//Started IN transfers
+	uint32_t TxBytesPerSecond;				//Average since last reset, filled by USB_VCP_GetStats
+	uint32_t RunCalls;
+	uint32_t RunCyclesLast;					//USB_VCP_Run, CPU cycles, USB_VCP_PROFILE only
+	uint32_t RunCyclesMax;
+	uint64_t RunCyclesTotal;
+	uint32_t RxCyclesMax;					//USB_VCP_DataReceivedCallback (USB ISR), CPU cycles
+	uint32_t TxCpltCyclesMax;				//USB_VCP_TransmitCompleteCallback (USB ISR), CPU cycles
+	uint32_t GatedBytes;					//USB_VCP_SendData bytes dropped, port closed
+	uint32_t GatedFrames;					//CAN frames not encoded, port closed
+	uint32_t StartTick;						//HAL tick of last reset
+}USB_VCP_Stats_t;
+
+//Channel data handler: process up to budget bytes from rxBuffer, put replies
+//to txBuffer. Returns count of consumed rxBuffer bytes.
+typedef uint32_t (*USB_VCP_Process_t)(void *context, RoundBuffer_t *rxBuffer, RoundBuffer_t *txBuffer, uint32_t budget);
+
+//Endpoint driver of a channel: CDC or vendor bulk interface
+typedef struct
+{
+	uint8_t (*Transmit)(uint8_t *buffer, uint16_t length, uint8_t interfaceNumber);
+	bool (*TransmitAvailable)(uint8_t interfaceNumber);
+	void (*ReceiveResume)(uint8_t interfaceNumber);
+	uint8_t (*Notify)(uint16_t serialState, uint8_t interfaceNumber);		//NULL - no command endpoint
+}USB_VCP_Port_t;
+
+//One channel of VCP engine
+typedef struct
+{
+	uint8_t InterfaceNumber;				//CDC_ITF_NUMBER_n or VENDOR_ITF_NUMBER
+	const USB_VCP_Port_t *Port;
+	RoundBuffer_t *RxBuffer;				//Host to device
+	RoundBuffer_t *TxBuffer;				//Device to host
+	uint32_t Weight;						//Scheduler weight, quanta per round
+	USB_VCP_Process_t Process;
+	void *Context;							//Protocol state passed to Process
+	uint32_t Deficit;						//Unused budget carried to the next round, bytes
+	volatile uint32_t SofAge;				//SOFs since last transfer start
+	volatile bool RxPaused;					//OUT endpoint not armed, Rx ring is short of space
+	volatile uint16_t Events;				//USB_VCP_EVENT_xxx not sent to host yet
+	uint32_t TxDropped;						//Tx ring drop count already reported
+	volatile bool HostOpen;					//DTR set by host, stream data to channel
+	volatile bool TxFlush;					//Port opened during a transfer, drop backlog on its completion
+}USB_VCP_Channel_t;
+
 /*-- Exported variables -----------------------------------------------------*/
 /*-- Exported functions -----------------------------------------------------*/
+void USB_VCP_Init(void);
+void USB_VCP_GetStats(USB_VCP_Stats_t *stats);
+void USB_VCP_ResetStats(void);
 int8_t USB_VCP_ConfigCallback(uint8_t cmd, uint8_t* pbuf, uint16_t length, uint8_t interfaceNumber);
+void USB_VCP_InitCallback(void);
+bool USB_VCP_ReceiveCredit(uint8_t interfaceNumber, uint32_t pending);
 void USB_VCP_DataReceivedCallback(uint8_t* buffer, uint16_t length, uint8_t interfaceNumber);
+void USB_VCP_TransmitCompleteCallback(uint8_t* buffer, uint32_t length, uint8_t interfaceNumber);
+void USB_VCP_SOFCallback(void);
 void USB_VCP_SendData(uint8_t* buffer, uint16_t length, uint8_t interfaceNumber);
 void USB_VCP_CableConnected(PCD_HandleTypeDef *hpcd);
 void USB_VCP_CableDisconnected(PCD_HandleTypeDef *hpcd);
 void USB_VCP_Run(void);
+void USB_VCP_NotifyEvent(uint8_t interfaceNumber, uint16_t events);
+bool USB_VCP_IsHostOpen(uint8_t interfaceNumber);
+#if (USB_VCP_SLCAN == 1)
+void USB_VCP_SlcanSetBackend(const Slcan_Backend_t *backend);
+bool USB_VCP_SlcanSendFrame(uint8_t interfaceNumber, const CanFrame_t *frame);
+#endif
+#if (USBD_VENDOR_ENABLE == 1)
+bool USB_VCP_VendorSendFrame(const CanFrame_t *frame);
+#endif
 
 #endif // _USB_VCP_H
 /*-- EOF --------------------------------------------------------------------*/
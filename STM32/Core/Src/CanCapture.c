@@ -0,0 +1,1353 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    CanCapture.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+#include "CanCapture.h"
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+#include "CanFrameBuffer.h"
+#include "CanFilter.h"
+
+/*-- Hardware specific libraries --------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+/*-- Project specific includes ----------------------------------------------*/
+#include "can.h"
+#include "usbd_vcp.h"
+#include "usbd_gsusb.h"
+
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+#if !ROUND_BUFFER_IS_POW2(CAN_CAPTURE_QUEUE_SIZE)
+#error "CAN_CAPTURE_QUEUE_SIZE must be a power of two"
+#endif
+
+#if (CAN_CAPTURE_SLAVE_START_BANK < 4) || (CAN_CAPTURE_SLAVE_START_BANK > 24)
+#error "CAN_CAPTURE_SLAVE_START_BANK must leave 4 filter banks to each bus"
+#endif
+
+//CDC channel of bus 2 SLCAN stream, 0 - only the tagged gs_usb stream
+#if (NUM_OF_CDC_UARTS > 1)
+#define CAN_CAPTURE_BUS2_INTERFACE		CDC_ITF_NUMBER_2
+#else
+#define CAN_CAPTURE_BUS2_INTERFACE		0
+#endif
+
+#if (CAN_CAPTURE_PROFILE == 1)
+#define CAN_CAPTURE_PROFILE_START()		uint32_t profileStart = DWT->CYCCNT
+#define CAN_CAPTURE_PROFILE_STOP(max)	do { uint32_t cycles = DWT->CYCCNT - profileStart; if(cycles > (max)) { (max) = cycles; } } while(0)
+#else
+#define CAN_CAPTURE_PROFILE_START()
+#define CAN_CAPTURE_PROFILE_STOP(max)
+#endif
+
+//Interrupts of an open bus. Last error code interrupt is left off: a broken
+//bus would raise it for every erroneous frame.
+#define CAN_CAPTURE_IT					(CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO0_OVERRUN | \
+										 CAN_IT_RX_FIFO1_MSG_PENDING | CAN_IT_RX_FIFO1_OVERRUN | CAN_IT_TX_MAILBOX_EMPTY | \
+										 CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE | CAN_IT_BUSOFF | CAN_IT_ERROR)
+
+//Bit timing limits of bxCAN, time quanta
+#define CAN_CAPTURE_PRESCALER_MAX		1024
+#define CAN_CAPTURE_TSEG1_MAX			16
+#define CAN_CAPTURE_TSEG2_MAX			8
+#define CAN_CAPTURE_SJW_MAX				4
+#define CAN_CAPTURE_TQ_MIN				8
+#define CAN_CAPTURE_TQ_MAX				25
+
+//Lowest identifier bits in 32 bit filter register layout
+#define CAN_CAPTURE_FILTER_STD_LSB		(1U << CAN_FILTER_STID_POS)
+#define CAN_CAPTURE_FILTER_EXT_LSB		(1U << CAN_FILTER_EXID_POS)
+
+//Loopback load test frames: identifier walks all standard identifiers, so
+//both FIFOs of the accept-all filters share the load
+#define CAN_CAPTURE_LOAD_TEST_ID_MASK	0x7FFU
+
+//Tx mailboxes of bxCAN, TSR holds one status byte per mailbox
+#define CAN_CAPTURE_TX_MAILBOXES		3
+#define CAN_CAPTURE_TSR_SHIFT(mailbox)	(8U * (mailbox))
+
+
+//Bus state change requested from USB ISR, applied by CanCapture_Run
+#define CAN_CAPTURE_REQUEST_NONE		0
+#define CAN_CAPTURE_REQUEST_OPEN		1
+#define CAN_CAPTURE_REQUEST_CLOSE		2
+
+/*-- Local typedefs ---------------------------------------------------------*/
+typedef struct
+{
+	CAN_HandleTypeDef *Handle;
+	CanFrameBuffer_t Frames;				//Rx ISR to main loop
+	uint8_t InterfaceNumber;				//CDC channel of SLCAN stream and events
+	bool Open;
+	CanCapture_Mode_t Mode;
+	volatile uint8_t Status;				//Latched CAN_CAPTURE_STATUS_xxx, cleared by CanCapture_GetStatus
+	volatile uint8_t Request;				//CAN_CAPTURE_REQUEST_xxx
+	CanCapture_Mode_t RequestMode;
+	bool RequestOneShot;
+	bool OneShot;							//No automatic retransmission, gs_usb ONE_SHOT
+	CanCapture_Stats_t Stats;
+	bool LoadTest;							//Silent loopback mode, Tx mailboxes are kept full
+#if (CAN_CAPTURE_TTCM == 1)
+	uint32_t BitTime;						//Microseconds per bit, 16.16 fixed point
+#endif
+	CanFilter_t Filter;						//Host acceptance rules
+	bool FilterPending;						//Rules changed, compiled by CanCapture_Open
+	bool SoftwareFilter;					//Frames passed by superset bank are checked by CanFilter_Match
+	uint32_t SoftwareId;
+	uint32_t SoftwareMask;
+}CanCapture_Bus_t;
+
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+static CanFrame_t canCapture1Slots[CAN_CAPTURE_QUEUE_SIZE];
+static CanFrame_t canCapture2Slots[CAN_CAPTURE_QUEUE_SIZE];
+
+static CanCapture_Bus_t canCaptureBuses[CAN_CAPTURE_NUM_BUSES] =
+{
+	{ .Handle = &hcan1, .Frames = CAN_FRAME_BUFFER_INIT(canCapture1Slots), .InterfaceNumber = CDC_ITF_NUMBER_1 },
+	{ .Handle = &hcan2, .Frames = CAN_FRAME_BUFFER_INIT(canCapture2Slots), .InterfaceNumber = CAN_CAPTURE_BUS2_INTERFACE },
+};
+
+//CanCapture_Mode_t to bxCAN test mode bits
+static const uint32_t canCaptureModes[] = { CAN_MODE_NORMAL, CAN_MODE_SILENT, CAN_MODE_LOOPBACK, CAN_MODE_SILENT_LOOPBACK };
+
+/*-- Local functions --------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Get bus descriptor by index.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval pointer to bus, NULL if index is out of range.
+ *****************************************************************************/
+static CanCapture_Bus_t *CanCapture_GetBus(uint8_t bus)
+{
+	return (bus < CAN_CAPTURE_NUM_BUSES) ? &canCaptureBuses[bus] : NULL;
+}
+
+/******************************************************************************
+ *  @brief  Get filter banks of a bus: CAN1 below slave start bank, CAN2
+ *          from it up.
+ *
+ *  @param  bus - bus index.
+ *  @param  count - pointer to count of banks.
+ *
+ *  @retval first filter bank.
+ *****************************************************************************/
+static uint32_t CanCapture_GetFilterBanks(uint8_t bus, uint32_t *count)
+{
+	if(bus == 0)
+	{
+		*count = CAN_CAPTURE_SLAVE_START_BANK;
+		return 0;
+	}
+
+	*count = CAN_FILTER_MAX_BANKS - CAN_CAPTURE_SLAVE_START_BANK;
+
+	return CAN_CAPTURE_SLAVE_START_BANK;
+}
+
+/******************************************************************************
+ *  @brief  Configure one filter bank.
+ *
+ *  @param  handle - CAN handle, CAN1 owns the filter banks of both buses.
+ *  @param  bank - filter bank number.
+ *  @param  config - register values, NULL deactivates the bank.
+ *  @param  fifo - CAN_FILTER_FIFO0 or CAN_FILTER_FIFO1.
+ *
+ *  @retval true if bank is configured.
+ *****************************************************************************/
+static bool CanCapture_ConfigFilter(CAN_HandleTypeDef *handle, uint32_t bank, const CanFilter_Bank_t *config, uint32_t fifo)
+{
+	CAN_FilterTypeDef filter;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.FilterMode = CAN_FILTERMODE_IDMASK;
+	filter.FilterScale = CAN_FILTERSCALE_32BIT;
+	filter.FilterActivation = DISABLE;
+
+	if(config)
+	{
+		filter.FilterActivation = ENABLE;
+
+		if((config->Mode == CAN_FILTER_BANK_MASK_16) || (config->Mode == CAN_FILTER_BANK_LIST_16))
+		{
+			//HAL packs FR1 from the Low halves and FR2 from the High halves
+			filter.FilterScale = CAN_FILTERSCALE_16BIT;
+			filter.FilterIdLow = config->Fr1 & 0xFFFF;
+			filter.FilterMaskIdLow = config->Fr1 >> 16;
+			filter.FilterIdHigh = config->Fr2 & 0xFFFF;
+			filter.FilterMaskIdHigh = config->Fr2 >> 16;
+		}
+		else
+		{
+			filter.FilterIdHigh = config->Fr1 >> 16;
+			filter.FilterIdLow = config->Fr1 & 0xFFFF;
+			filter.FilterMaskIdHigh = config->Fr2 >> 16;
+			filter.FilterMaskIdLow = config->Fr2 & 0xFFFF;
+		}
+
+		if((config->Mode == CAN_FILTER_BANK_LIST_32) || (config->Mode == CAN_FILTER_BANK_LIST_16))
+		{
+			filter.FilterMode = CAN_FILTERMODE_IDLIST;
+		}
+	}
+
+	filter.FilterFIFOAssignment = fifo;
+	filter.FilterBank = bank;
+	filter.SlaveStartFilterBank = CAN_CAPTURE_SLAVE_START_BANK;
+
+	return (HAL_CAN_ConfigFilter(handle, &filter) == HAL_OK);
+}
+
+/******************************************************************************
+ *  @brief  Accept every frame. Even and odd identifiers go to different
+ *          FIFOs, so a burst has six hardware mailboxes instead of three.
+ *
+ *  @param  handle - CAN handle.
+ *  @param  firstBank - first of four filter banks to use.
+ *
+ *  @retval true if filters are configured.
+ *****************************************************************************/
+static bool CanCapture_ConfigAcceptAll(CAN_HandleTypeDef *handle, uint32_t firstBank)
+{
+	uint32_t stdMask = CAN_FILTER_IDE | CAN_CAPTURE_FILTER_STD_LSB;
+	uint32_t extMask = CAN_FILTER_IDE | CAN_CAPTURE_FILTER_EXT_LSB;
+	const CanFilter_Bank_t banks[4] =
+	{
+		{ CAN_FILTER_BANK_MASK_32, 0, stdMask },
+		{ CAN_FILTER_BANK_MASK_32, CAN_CAPTURE_FILTER_STD_LSB, stdMask },
+		{ CAN_FILTER_BANK_MASK_32, CAN_FILTER_IDE, extMask },
+		{ CAN_FILTER_BANK_MASK_32, CAN_FILTER_IDE | CAN_CAPTURE_FILTER_EXT_LSB, extMask },
+	};
+	bool result = true;
+	uint32_t index;
+
+	for(index = 0; index < 4; index++)
+	{
+		result &= CanCapture_ConfigFilter(handle, firstBank + index, &banks[index], (index & 1) ? CAN_FILTER_FIFO1 : CAN_FILTER_FIFO0);
+	}
+
+	return result;
+}
+
+/******************************************************************************
+ *  @brief  Load host rules of a bus into its filter banks. Banks alternate
+ *          between the FIFOs, unused banks are deactivated.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval true if filters are configured.
+ *****************************************************************************/
+static bool CanCapture_ApplyFilter(uint8_t bus)
+{
+	static CanFilter_Plan_t plan;
+	CanCapture_Bus_t *captureBus = &canCaptureBuses[bus];
+	CAN_HandleTypeDef *handle = captureBus->Handle;
+	uint32_t count;
+	uint32_t first = CanCapture_GetFilterBanks(bus, &count);
+	uint32_t used;
+	uint32_t index;
+	bool result = true;
+
+	if(captureBus->Filter.Count == 0)
+	{
+		result = CanCapture_ConfigAcceptAll(handle, first);
+		used = 4;
+		plan.Software = false;
+	}
+	else
+	{
+		used = CanFilter_Compile(&captureBus->Filter, count, &plan);
+
+		for(index = 0; index < used; index++)
+		{
+			result &= CanCapture_ConfigFilter(handle, first + index, &plan.Banks[index], (index & 1) ? CAN_FILTER_FIFO1 : CAN_FILTER_FIFO0);
+		}
+	}
+
+	for(index = used; index < count; index++)
+	{
+		result &= CanCapture_ConfigFilter(handle, first + index, NULL, CAN_FILTER_FIFO0);
+	}
+
+	captureBus->SoftwareFilter = plan.Software;
+	captureBus->SoftwareId = plan.SoftwareId;
+	captureBus->SoftwareMask = plan.SoftwareMask;
+	captureBus->Stats.FilterBanks = used;
+	captureBus->FilterPending = false;
+
+	return result;
+}
+
+/******************************************************************************
+ *  @brief  Apply bus state change requested from USB ISR.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void CanCapture_ServiceRequest(uint8_t bus)
+{
+	CanCapture_Bus_t *captureBus = &canCaptureBuses[bus];
+	uint32_t primask = __get_PRIMASK();
+	uint8_t request;
+
+	__disable_irq();
+	request = captureBus->Request;
+	captureBus->Request = CAN_CAPTURE_REQUEST_NONE;
+	__set_PRIMASK(primask);
+
+	if(request != CAN_CAPTURE_REQUEST_NONE)
+	{
+		//Restart applies new mode and bit timing
+		CanCapture_Close(bus);
+
+		//One shot lasts until the next gs_usb mode request
+		captureBus->OneShot = ((request == CAN_CAPTURE_REQUEST_OPEN) && (captureBus->RequestOneShot));
+
+		if(request == CAN_CAPTURE_REQUEST_OPEN)
+		{
+			CanCapture_Open(bus, captureBus->RequestMode);
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  Loopback load test: refill free Tx mailboxes, so the controller
+ *          sends back to back and receives every frame itself. Frames carry
+ *          a sequence number and its complement. Called from the Tx mailbox
+ *          empty interrupt and from the main loop, which starts the test.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void CanCapture_RunLoadTest(uint8_t bus)
+{
+	CanCapture_Bus_t *captureBus = &canCaptureBuses[bus];
+	CAN_TxHeaderTypeDef header;
+	uint32_t data[2];
+	uint32_t mailbox;
+	uint32_t primask;
+
+	if(!captureBus->LoadTest)
+	{
+		return;
+	}
+
+	header.ExtId = 0;
+	header.IDE = CAN_ID_STD;
+	header.RTR = CAN_RTR_DATA;
+	header.DLC = CAN_FRAME_MAX_DATA;
+	header.TransmitGlobalTime = DISABLE;
+
+	//Tx ISR refills as well, sequence numbers must not repeat
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	while(HAL_CAN_GetTxMailboxesFreeLevel(captureBus->Handle) > 0)
+	{
+		uint32_t sequence = captureBus->Stats.LoadTestFrames;
+
+		header.StdId = sequence & CAN_CAPTURE_LOAD_TEST_ID_MASK;
+		data[0] = sequence;
+		data[1] = ~sequence;
+
+		if(HAL_CAN_AddTxMessage(captureBus->Handle, &header, (uint8_t *)data, &mailbox) != HAL_OK)
+		{
+			break;
+		}
+
+		captureBus->Stats.LoadTestFrames++;
+	}
+
+	__set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ *  @brief  Check that the bus may transmit.
+ *
+ *  @param  captureBus - bus.
+ *
+ *  @retval true if bus is open and not silent.
+ *****************************************************************************/
+static bool CanCapture_CanSend(const CanCapture_Bus_t *captureBus)
+{
+	//Silent loopback keeps Tx internal, only plain silent mode cannot send
+	return ((captureBus->Open) && (captureBus->Mode != CAN_CAPTURE_MODE_SILENT));
+}
+
+/******************************************************************************
+ *  @brief  Put frame into a free Tx mailbox.
+ *
+ *  @param  captureBus - bus, open.
+ *  @param  frame - frame to send.
+ *  @param  mailbox - pointer to CAN_TX_MAILBOXx used.
+ *
+ *  @retval false if no mailbox is free.
+ *****************************************************************************/
+static bool CanCapture_AddTx(CanCapture_Bus_t *captureBus, const CanFrame_t *frame, uint32_t *mailbox)
+{
+	CAN_TxHeaderTypeDef header;
+
+	header.StdId = frame->Id;
+	header.ExtId = frame->Id;
+	header.IDE = (frame->Flags & CAN_FRAME_FLAG_EXT) ? CAN_ID_EXT : CAN_ID_STD;
+	header.RTR = (frame->Flags & CAN_FRAME_FLAG_RTR) ? CAN_RTR_REMOTE : CAN_RTR_DATA;
+	header.DLC = (frame->Dlc > CAN_FRAME_MAX_DATA) ? CAN_FRAME_MAX_DATA : frame->Dlc;
+	header.TransmitGlobalTime = DISABLE;
+
+	return (HAL_CAN_AddTxMessage(captureBus->Handle, &header, (uint8_t *)frame->Data, mailbox) == HAL_OK);
+}
+
+/******************************************************************************
+ *  @brief  Forward one captured frame to USB streams: SLCAN channel of its
+ *          bus, binary record stream of the vendor interface and gs_usb
+ *          stream, both tagged with bus. Streams which are closed or full
+ *          skip it.
+ *
+ *  @param  frame - captured frame.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void CanCapture_Forward(const CanFrame_t *frame)
+{
+#if (USB_VCP_SLCAN == 1)
+	(void)USB_VCP_SlcanSendFrame(canCaptureBuses[frame->Bus].InterfaceNumber, frame);
+#endif
+#if (USBD_VENDOR_ENABLE == 1)
+	(void)USB_VCP_VendorSendFrame(frame);
+#endif
+#if (USBD_GSUSB_ENABLE == 1)
+	if(frame->Bus < GSUSB_NUM_CHANNELS)
+	{
+		(void)USBD_GS_ReceiveFrame(frame->Bus, frame);
+	}
+#endif
+}
+
+#if (USB_VCP_SLCAN == 1)
+/******************************************************************************
+ *  @brief  Convert SLCAN bus mode.
+ *
+ *  @param  mode - SLCAN mode.
+ *
+ *  @retval capture mode.
+ *****************************************************************************/
+static CanCapture_Mode_t CanCapture_SlcanMode(Slcan_Mode_t mode)
+{
+	switch(mode)
+	{
+		case SLCAN_MODE_LISTEN_ONLY:
+		{
+			return CAN_CAPTURE_MODE_SILENT;
+		}
+
+		case SLCAN_MODE_LOOPBACK:
+		{
+			return CAN_CAPTURE_MODE_LOOPBACK;
+		}
+
+		case SLCAN_MODE_SILENT_LOOPBACK:
+		{
+			return CAN_CAPTURE_MODE_SILENT_LOOPBACK;
+		}
+
+		default:
+		{
+			return CAN_CAPTURE_MODE_NORMAL;
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  SLCAN backend: O, L and Yn commands on a closed channel.
+ *
+ *  @param  channel - SLCAN channel, equals bus index.
+ *  @param  mode - bus mode.
+ *
+ *  @retval true if bus is open.
+ *****************************************************************************/
+static bool CanCapture_SlcanOpen(uint8_t channel, Slcan_Mode_t mode)
+{
+	return CanCapture_Open(channel, CanCapture_SlcanMode(mode));
+}
+
+/******************************************************************************
+ *  @brief  SLCAN backend: Yn command on an open channel.
+ *
+ *  @param  channel - SLCAN channel, equals bus index.
+ *  @param  mode - bus mode.
+ *
+ *  @retval true if bus runs in the new mode.
+ *****************************************************************************/
+static bool CanCapture_SlcanSetMode(uint8_t channel, Slcan_Mode_t mode)
+{
+	return CanCapture_SetMode(channel, CanCapture_SlcanMode(mode));
+}
+
+/******************************************************************************
+ *  @brief  SLCAN backend: s command. SJA1000 registers at 16 MHz clock are
+ *          converted to bitrate, bxCAN timing is calculated from it.
+ *
+ *  @param  channel - SLCAN channel, equals bus index.
+ *  @param  btr0 - SJA1000 BTR0: SJW and prescaler.
+ *  @param  btr1 - SJA1000 BTR1: TSEG2 and TSEG1.
+ *
+ *  @retval true if bitrate is reachable.
+ *****************************************************************************/
+static bool CanCapture_SlcanSetBtr(uint8_t channel, uint8_t btr0, uint8_t btr1)
+{
+	uint32_t prescaler = (btr0 & 0x3F) + 1;
+	uint32_t timeQuanta = 1 + ((btr1 & 0x0F) + 1) + (((btr1 >> 4) & 0x07) + 1);
+
+	return CanCapture_SetBitrate(channel, 8000000U / (prescaler * timeQuanta));
+}
+
+/******************************************************************************
+ *  @brief  SLCAN backend: k and K commands.
+ *
+ *  @param  channel - SLCAN channel, equals bus index.
+ *  @param  filter - rule to add, NULL clears the rule list.
+ *
+ *  @retval true if rule is added and bus is closed.
+ *****************************************************************************/
+static bool CanCapture_SlcanSetFilter(uint8_t channel, const Slcan_Filter_t *filter)
+{
+	if(!filter)
+	{
+		return CanCapture_ClearFilter(channel);
+	}
+
+	if(filter->Type == SLCAN_FILTER_MASK)
+	{
+		return CanCapture_AddFilterMask(channel, filter->Id, filter->Value, filter->Flags);
+	}
+
+	return CanCapture_AddFilterRange(channel, filter->Id, filter->Value, filter->Flags);
+}
+
+static const Slcan_Backend_t canCaptureSlcanBackend =
+{
+	CanCapture_SlcanOpen,
+	CanCapture_Close,
+	CanCapture_SetBitrate,
+	CanCapture_SlcanSetBtr,
+	CanCapture_Transmit,
+	CanCapture_GetStatus,
+	CanCapture_SlcanSetFilter,
+	CanCapture_SlcanSetMode,
+	CanCapture_SetLoadTest,
+};
+#endif
+
+#if (USBD_GSUSB_ENABLE == 1)
+/******************************************************************************
+ *  @brief  gs_usb backend: bit timing request (USB ISR).
+ *
+ *  @param  channel - gs_usb channel, equals bus index.
+ *  @param  timing - host bit timing, time quanta.
+ *
+ *  @retval true if timing is valid and bus is closed.
+ *****************************************************************************/
+static bool CanCapture_GsSetBitTiming(uint8_t channel, const USBD_GS_BitTimingTypeDef *timing)
+{
+	return CanCapture_SetBitTiming(channel, timing->brp, timing->prop_seg + timing->phase_seg1, timing->phase_seg2, timing->sjw);
+}
+
+/******************************************************************************
+ *  @brief  gs_usb backend: mode request (USB ISR). HAL_CAN_Init waits on
+ *          HAL_GetTick, so the request is applied by CanCapture_Run.
+ *          ONE_SHOT turns automatic retransmission off.
+ *
+ *  @param  channel - gs_usb channel, equals bus index.
+ *  @param  mode - GSUSB_MODE_START or GSUSB_MODE_RESET.
+ *  @param  flags - GSUSB_FEATURE_xxx.
+ *
+ *  @retval true if request is accepted.
+ *****************************************************************************/
+static bool CanCapture_GsSetMode(uint8_t channel, uint32_t mode, uint32_t flags)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(channel);
+
+	if(!captureBus)
+	{
+		return false;
+	}
+
+	if(flags & GSUSB_FEATURE_LOOP_BACK)
+	{
+		captureBus->RequestMode = (flags & GSUSB_FEATURE_LISTEN_ONLY) ? CAN_CAPTURE_MODE_SILENT_LOOPBACK : CAN_CAPTURE_MODE_LOOPBACK;
+	}
+	else
+	{
+		captureBus->RequestMode = (flags & GSUSB_FEATURE_LISTEN_ONLY) ? CAN_CAPTURE_MODE_SILENT : CAN_CAPTURE_MODE_NORMAL;
+	}
+	captureBus->RequestOneShot = ((flags & GSUSB_FEATURE_ONE_SHOT) != 0);
+	captureBus->Request = (mode == GSUSB_MODE_START) ? CAN_CAPTURE_REQUEST_OPEN : CAN_CAPTURE_REQUEST_CLOSE;
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  gs_usb backend: host frame to a Tx mailbox. The echo follows
+ *          from CanCapture_TxIrqHandler once the mailbox completes.
+ *
+ *  @param  channel - gs_usb channel, equals bus index.
+ *  @param  frame - frame to send.
+ *
+ *  @retval mailbox 0..2, GSUSB_TX_BUSY while mailboxes are full or start
+ *          request is pending, GSUSB_TX_REJECTED if bus cannot send.
+ *****************************************************************************/
+static uint8_t CanCapture_GsTransmit(uint8_t channel, const CanFrame_t *frame)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(channel);
+	uint32_t mailbox;
+
+	if(!captureBus)
+	{
+		return GSUSB_TX_REJECTED;
+	}
+
+	if(captureBus->Request == CAN_CAPTURE_REQUEST_OPEN)
+	{
+		return GSUSB_TX_BUSY;
+	}
+
+	if(!CanCapture_CanSend(captureBus))
+	{
+		return GSUSB_TX_REJECTED;
+	}
+
+	//Interrupts are masked: a mailbox which completed meanwhile is reported
+	//first, TXRQ would clear its status
+	if(captureBus->Handle->Instance->TSR & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2))
+	{
+		CanCapture_TxIrqHandler(channel);
+	}
+
+	if(!CanCapture_AddTx(captureBus, frame, &mailbox))
+	{
+		return GSUSB_TX_BUSY;
+	}
+
+	//CAN_TX_MAILBOX0..2 are bits 0..2
+	return (uint8_t)(mailbox >> 1);
+}
+
+/******************************************************************************
+ *  @brief  gs_usb backend: timestamp of frames, microseconds.
+ *
+ *  @param  None.
+ *
+ *  @retval timestamp.
+ *****************************************************************************/
+static uint32_t CanCapture_GsGetTimestamp(void)
+{
+	return (uint32_t)CAN_CAPTURE_TIMESTAMP();
+}
+
+/******************************************************************************
+ *  @brief  gs_usb backend: bxCAN kernel clock.
+ *
+ *  @param  None.
+ *
+ *  @retval clock, Hz.
+ *****************************************************************************/
+static uint32_t CanCapture_GsGetClock(void)
+{
+	return HAL_RCC_GetPCLK1Freq();
+}
+
+static const USBD_GS_BackendTypeDef canCaptureGsBackend =
+{
+	CanCapture_GsSetBitTiming,
+	CanCapture_GsSetMode,
+	CanCapture_GsTransmit,
+	CanCapture_GsGetTimestamp,
+	CanCapture_GsGetClock,
+};
+#endif
+
+/*-- Exported functions -----------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Init capture engine. Call once after MX_CANx_Init and
+ *          USB_VCP_Init. Buses stay closed until host opens them.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void CanCapture_Init(void)
+{
+	uint8_t bus;
+
+	for(bus = 0; bus < CAN_CAPTURE_NUM_BUSES; bus++)
+	{
+		if(!CanCapture_ApplyFilter(bus))
+		{
+			Error_Handler();
+		}
+	}
+
+#if (CAN_CAPTURE_PROFILE == 1)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+#if (USB_VCP_SLCAN == 1)
+	USB_VCP_SlcanSetBackend(&canCaptureSlcanBackend);
+#endif
+#if (USBD_GSUSB_ENABLE == 1)
+	USBD_GS_RegisterBackend(&canCaptureGsBackend);
+#endif
+}
+
+/******************************************************************************
+ *  @brief  Forward captured frames to USB streams. Main loop. Frame queues
+ *          of all buses are merged oldest first, so a tagged stream keeps
+ *          one timeline.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void CanCapture_Run(void)
+{
+	uint32_t budget = CAN_CAPTURE_RUN_BUDGET * CAN_CAPTURE_NUM_BUSES;
+	uint8_t bus;
+
+	for(bus = 0; bus < CAN_CAPTURE_NUM_BUSES; bus++)
+	{
+		CanCapture_ServiceRequest(bus);
+		CanCapture_RunLoadTest(bus);
+	}
+
+	while(budget-- > 0)
+	{
+		CanFrameBuffer_t *oldest = NULL;
+		CanFrame_t *frame = NULL;
+
+		for(bus = 0; bus < CAN_CAPTURE_NUM_BUSES; bus++)
+		{
+			uint32_t count;
+			CanFrame_t *head = CanFrameBuffer_PeekContiguous(&canCaptureBuses[bus].Frames, &count);
+
+			//Equal stamps keep bus order
+			if((count > 0) && ((!frame) || (head->Timestamp < frame->Timestamp)))
+			{
+				frame = head;
+				oldest = &canCaptureBuses[bus].Frames;
+			}
+		}
+
+		if(!frame)
+		{
+			break;
+		}
+
+		CanCapture_Forward(frame);
+		CanFrameBuffer_Consume(oldest, 1);
+	}
+}
+
+/******************************************************************************
+ *  @brief  Join the bus. Frames left in the frame queue are kept.
+ *
+ *  @param  bus - bus index.
+ *  @param  mode - bus mode.
+ *
+ *  @retval true if controller is started.
+ *****************************************************************************/
+bool CanCapture_Open(uint8_t bus, CanCapture_Mode_t mode)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+	CAN_HandleTypeDef *handle;
+
+	if((!captureBus) || (captureBus->Open) || (mode > CAN_CAPTURE_MODE_SILENT_LOOPBACK))
+	{
+		return false;
+	}
+
+	handle = captureBus->Handle;
+	handle->Init.Mode = canCaptureModes[mode];
+	handle->Init.AutoRetransmission = (captureBus->OneShot) ? DISABLE : ENABLE;
+#if (CAN_CAPTURE_TTCM == 1)
+	handle->Init.TimeTriggeredMode = ENABLE;
+	captureBus->BitTime = (uint32_t)((((uint64_t)handle->Init.Prescaler *
+									   (1 + ((handle->Init.TimeSeg1 >> CAN_BTR_TS1_Pos) + 1) + ((handle->Init.TimeSeg2 >> CAN_BTR_TS2_Pos) + 1))) *
+									  (1000000ULL << 16)) / HAL_RCC_GetPCLK1Freq());
+#endif
+
+	//Filter banks are shared: reloading them pauses reception of both buses,
+	//so it is done only when rules changed
+	if((HAL_CAN_Init(handle) != HAL_OK) ||
+	   ((captureBus->FilterPending) && (!CanCapture_ApplyFilter(bus))) ||
+	   (HAL_CAN_ActivateNotification(handle, CAN_CAPTURE_IT) != HAL_OK) ||
+	   (HAL_CAN_Start(handle) != HAL_OK))
+	{
+		return false;
+	}
+
+	captureBus->Status = 0;
+	captureBus->Mode = mode;
+	captureBus->Open = true;
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Leave the bus.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval true if bus is closed.
+ *****************************************************************************/
+bool CanCapture_Close(uint8_t bus)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+
+	if(!captureBus)
+	{
+		return false;
+	}
+
+	if(captureBus->Open)
+	{
+		HAL_CAN_DeactivateNotification(captureBus->Handle, CAN_CAPTURE_IT);
+		HAL_CAN_Stop(captureBus->Handle);
+		captureBus->Open = false;
+		captureBus->LoadTest = false;
+	}
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Switch mode of an open bus: controller is stopped, initialized
+ *          with the new mode and started again. Frame queue and a running
+ *          load test (if the new mode is silent loopback) are kept.
+ *
+ *  @param  bus - bus index.
+ *  @param  mode - bus mode.
+ *
+ *  @retval true if bus runs in the new mode.
+ *****************************************************************************/
+bool CanCapture_SetMode(uint8_t bus, CanCapture_Mode_t mode)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+	CanCapture_Mode_t previousMode;
+	bool loadTest;
+
+	if((!captureBus) || (!captureBus->Open) || (mode > CAN_CAPTURE_MODE_SILENT_LOOPBACK))
+	{
+		return false;
+	}
+
+	if(mode == captureBus->Mode)
+	{
+		return true;
+	}
+
+	previousMode = captureBus->Mode;
+	loadTest = captureBus->LoadTest;
+	CanCapture_Close(bus);
+
+	if(!CanCapture_Open(bus, mode))
+	{
+		//Host still sees an open channel, keep it on the bus
+		CanCapture_Open(bus, previousMode);
+		return false;
+	}
+
+	captureBus->LoadTest = (loadTest && (mode == CAN_CAPTURE_MODE_SILENT_LOOPBACK));
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Start or stop loopback load test. Received test frames are
+ *          captured and streamed like bus traffic, so the test covers the
+ *          whole path to the host. LoadTestFrames against RxFrames shows
+ *          frames lost on the way. Silent loopback only: back to back
+ *          frames must not reach a real bus.
+ *
+ *  @param  bus - bus index.
+ *  @param  enable - true to start.
+ *
+ *  @retval false if start is requested and bus is not open in silent
+ *          loopback mode.
+ *****************************************************************************/
+bool CanCapture_SetLoadTest(uint8_t bus, bool enable)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+
+	if(!captureBus)
+	{
+		return false;
+	}
+
+	if((enable) && ((!captureBus->Open) || (captureBus->Mode != CAN_CAPTURE_MODE_SILENT_LOOPBACK)))
+	{
+		return false;
+	}
+
+	captureBus->LoadTest = enable;
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Set bit timing of a closed bus, applied by CanCapture_Open.
+ *
+ *  @param  bus - bus index.
+ *  @param  prescaler - time quantum, kernel clocks, 1..1024.
+ *  @param  timeSeg1 - propagation and phase segment 1, time quanta, 1..16.
+ *  @param  timeSeg2 - phase segment 2, time quanta, 1..8.
+ *  @param  syncJumpWidth - time quanta, 1..4.
+ *
+ *  @retval true if timing is valid and bus is closed.
+ *****************************************************************************/
+bool CanCapture_SetBitTiming(uint8_t bus, uint32_t prescaler, uint32_t timeSeg1, uint32_t timeSeg2, uint32_t syncJumpWidth)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+	CAN_InitTypeDef *init;
+
+	if((!captureBus) || (captureBus->Open) ||
+	   (prescaler == 0) || (prescaler > CAN_CAPTURE_PRESCALER_MAX) ||
+	   (timeSeg1 == 0) || (timeSeg1 > CAN_CAPTURE_TSEG1_MAX) ||
+	   (timeSeg2 == 0) || (timeSeg2 > CAN_CAPTURE_TSEG2_MAX) ||
+	   (syncJumpWidth == 0) || (syncJumpWidth > CAN_CAPTURE_SJW_MAX))
+	{
+		return false;
+	}
+
+	init = &captureBus->Handle->Init;
+	init->Prescaler = prescaler;
+	init->TimeSeg1 = (timeSeg1 - 1) << CAN_BTR_TS1_Pos;
+	init->TimeSeg2 = (timeSeg2 - 1) << CAN_BTR_TS2_Pos;
+	init->SyncJumpWidth = (syncJumpWidth - 1) << CAN_BTR_SJW_Pos;
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Set bitrate of a closed bus. The longest bit of 8..25 time quanta
+ *          which divides kernel clock exactly is used, sample point is
+ *          about 80 %.
+ *
+ *  @param  bus - bus index.
+ *  @param  bitrate - bit/s.
+ *
+ *  @retval true if bitrate is reachable without error and bus is closed.
+ *****************************************************************************/
+bool CanCapture_SetBitrate(uint8_t bus, uint32_t bitrate)
+{
+	uint32_t clock = HAL_RCC_GetPCLK1Freq();
+	uint32_t timeQuanta;
+
+	if(bitrate == 0)
+	{
+		return false;
+	}
+
+	for(timeQuanta = CAN_CAPTURE_TQ_MAX; timeQuanta >= CAN_CAPTURE_TQ_MIN; timeQuanta--)
+	{
+		uint32_t timeSeg2 = timeQuanta / 5;
+		uint32_t timeSeg1 = timeQuanta - 1 - timeSeg2;
+
+		if(((clock % (bitrate * timeQuanta)) == 0) && (timeSeg1 <= CAN_CAPTURE_TSEG1_MAX))
+		{
+			return CanCapture_SetBitTiming(bus, clock / (bitrate * timeQuanta), timeSeg1, timeSeg2, 1);
+		}
+	}
+
+	return false;
+}
+
+/******************************************************************************
+ *  @brief  Accept every frame on a closed bus, applied by CanCapture_Open.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval true if bus is closed.
+ *****************************************************************************/
+bool CanCapture_ClearFilter(uint8_t bus)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+
+	if((!captureBus) || (captureBus->Open))
+	{
+		return false;
+	}
+
+	CanFilter_Init(&captureBus->Filter);
+	captureBus->FilterPending = true;
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Add identifier range to acceptance rules of a closed bus,
+ *          applied by CanCapture_Open.
+ *
+ *  @param  bus - bus index.
+ *  @param  first - first identifier.
+ *  @param  last - last identifier.
+ *  @param  flags - CAN_FILTER_FLAG_xxx.
+ *
+ *  @retval true if rule is added and bus is closed.
+ *****************************************************************************/
+bool CanCapture_AddFilterRange(uint8_t bus, uint32_t first, uint32_t last, uint8_t flags)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+
+	if((!captureBus) || (captureBus->Open))
+	{
+		return false;
+	}
+
+	captureBus->FilterPending = true;
+
+	return CanFilter_AddRange(&captureBus->Filter, first, last, flags);
+}
+
+/******************************************************************************
+ *  @brief  Add identifier and mask to acceptance rules of a closed bus,
+ *          applied by CanCapture_Open.
+ *
+ *  @param  bus - bus index.
+ *  @param  id - identifier.
+ *  @param  mask - compared identifier bits.
+ *  @param  flags - CAN_FILTER_FLAG_xxx.
+ *
+ *  @retval true if rule is added and bus is closed.
+ *****************************************************************************/
+bool CanCapture_AddFilterMask(uint8_t bus, uint32_t id, uint32_t mask, uint8_t flags)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+
+	if((!captureBus) || (captureBus->Open))
+	{
+		return false;
+	}
+
+	captureBus->FilterPending = true;
+
+	return CanFilter_AddMask(&captureBus->Filter, id, mask, flags);
+}
+
+/******************************************************************************
+ *  @brief  Queue frame for transmission. Main loop.
+ *
+ *  @param  bus - bus index.
+ *  @param  frame - frame to send.
+ *
+ *  @retval false if bus is closed, silent or has no free mailbox.
+ *****************************************************************************/
+bool CanCapture_Transmit(uint8_t bus, const CanFrame_t *frame)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+	uint32_t mailbox;
+
+	if((!captureBus) || (!CanCapture_CanSend(captureBus)) || (!frame))
+	{
+		return false;
+	}
+
+	return CanCapture_AddTx(captureBus, frame, &mailbox);
+}
+
+/******************************************************************************
+ *  @brief  Get controller state and events latched since the last call.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval CAN_CAPTURE_STATUS_xxx flags.
+ *****************************************************************************/
+uint8_t CanCapture_GetStatus(uint8_t bus)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+	uint32_t primask;
+	uint32_t esr;
+	uint8_t status;
+
+	if(!captureBus)
+	{
+		return 0;
+	}
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	status = captureBus->Status;
+	captureBus->Status = 0;
+	__set_PRIMASK(primask);
+
+	esr = captureBus->Handle->Instance->ESR;
+	if(esr & CAN_ESR_EWGF)
+	{
+		status |= CAN_CAPTURE_STATUS_ERROR_WARNING;
+	}
+	if(esr & CAN_ESR_EPVF)
+	{
+		status |= CAN_CAPTURE_STATUS_ERROR_PASSIVE;
+	}
+	if(esr & CAN_ESR_BOFF)
+	{
+		status |= CAN_CAPTURE_STATUS_BUS_OFF;
+	}
+
+	return status;
+}
+
+/******************************************************************************
+ *  @brief  Get capture counters.
+ *
+ *  @param  bus - bus index.
+ *  @param  stats - pointer to statistics read to.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void CanCapture_GetStats(uint8_t bus, CanCapture_Stats_t *stats)
+{
+	CanCapture_Bus_t *captureBus = CanCapture_GetBus(bus);
+
+	if((captureBus) && (stats))
+	{
+		*stats = captureBus->Stats;
+		stats->QueueDropped = captureBus->Frames.Dropped;
+		stats->QueueHighWater = captureBus->Frames.HighWater;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Rx FIFO interrupt: drain every pending mailbox straight from
+ *          registers into frame queue, drained frames are published together
+ *          on exit. One timestamp is taken on entry, every frame pending then
+ *          was received before it. With CAN_CAPTURE_TTCM the timestamp is
+ *          taken after draining and belongs to the newest frame, older ones
+ *          are placed back from it by their SOF stamps.
+ *
+ *  @param  bus - bus index.
+ *  @param  fifo - CAN_RX_FIFO0 or CAN_RX_FIFO1.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void CanCapture_RxIrqHandler(uint8_t bus, uint32_t fifo)
+{
+#if (CAN_CAPTURE_TTCM == 0)
+	uint64_t timestamp = CAN_CAPTURE_TIMESTAMP();
+#endif
+	CanCapture_Bus_t *captureBus = &canCaptureBuses[bus];
+	CAN_TypeDef *can = captureBus->Handle->Instance;
+	CAN_FIFOMailBox_TypeDef *mailbox = &can->sFIFOMailBox[fifo];
+	volatile uint32_t *rfr = (fifo == CAN_RX_FIFO0) ? &can->RF0R : &can->RF1R;
+	uint16_t events = 0;
+	uint32_t pending = 0;
+	uint32_t rf;
+
+	CAN_CAPTURE_PROFILE_START();
+
+	//RF0R and RF1R share bit layout, flags are cleared by writing 1
+	rf = *rfr;
+	if(rf & CAN_RF0R_FOVR0)
+	{
+		CAN_CAPTURE_RFR_WRITE(rfr, CAN_RF0R_FOVR0 | CAN_RF0R_FULL0);
+		captureBus->Stats.FifoOverruns++;
+		captureBus->Status |= CAN_CAPTURE_STATUS_OVERRUN;
+		events |= USB_VCP_EVENT_RX_OVERRUN;
+	}
+
+	while((rf & CAN_RF0R_FMP0) != 0)
+	{
+		uint32_t rir = mailbox->RIR;
+		CanFrame_t *slot = NULL;
+
+		//Only frames passed by the superset bank need the rule list
+		if((captureBus->SoftwareFilter) &&
+		   (((rir ^ captureBus->SoftwareId) & captureBus->SoftwareMask) == 0) &&
+		   (!CanFilter_Match(&captureBus->Filter, rir)))
+		{
+			captureBus->Stats.FilterDropped++;
+		}
+		else
+		{
+			slot = CanFrameBuffer_GetWriteSlot(&captureBus->Frames, pending);
+
+			if(!slot)
+			{
+				captureBus->Status |= CAN_CAPTURE_STATUS_QUEUE_FULL;
+				events |= USB_VCP_EVENT_BUFFER_OVERFLOW;
+			}
+		}
+
+		if(slot)
+		{
+			uint32_t rdtr = mailbox->RDTR;
+			uint32_t dlc = rdtr & CAN_RDT0R_DLC;
+			uint32_t data[2];
+
+			data[0] = mailbox->RDLR;
+			data[1] = mailbox->RDHR;
+
+			if(rir & CAN_RI0R_IDE)
+			{
+				slot->Id = rir >> CAN_RI0R_EXID_Pos;
+				slot->Flags = CAN_FRAME_FLAG_EXT;
+			}
+			else
+			{
+				slot->Id = rir >> CAN_RI0R_STID_Pos;
+				slot->Flags = 0;
+			}
+			if(rir & CAN_RI0R_RTR)
+			{
+				slot->Flags |= CAN_FRAME_FLAG_RTR;
+			}
+
+			slot->Dlc = (dlc > CAN_FRAME_MAX_DATA) ? CAN_FRAME_MAX_DATA : (uint8_t)dlc;
+#if (CAN_CAPTURE_TTCM == 1)
+			//SOF stamp, CAN bit times, converted once the newest frame is known
+			slot->Timestamp = (uint16_t)(rdtr >> CAN_RDT0R_TIME_Pos);
+#else
+			slot->Timestamp = timestamp;
+#endif
+			slot->Bus = bus;
+			memcpy(slot->Data, data, CAN_FRAME_MAX_DATA);
+
+			pending++;
+		}
+
+		//Next frame moves to the output mailbox once hardware clears RFOM
+		CAN_CAPTURE_RFR_WRITE(rfr, CAN_RF0R_RFOM0);
+		do
+		{
+			rf = *rfr;
+		}
+		while(rf & CAN_RF0R_RFOM0);
+	}
+
+#if (CAN_CAPTURE_TTCM == 1)
+	if(pending > 0)
+	{
+		uint64_t timestamp = CAN_CAPTURE_TIMESTAMP();
+		uint16_t newestTime = (uint16_t)CanFrameBuffer_GetWriteSlot(&captureBus->Frames, pending - 1)->Timestamp;
+		uint32_t index;
+
+		//Bit distance to the newest frame is far below the 16 bit wrap: the
+		//FIFO holds three frames
+		for(index = 0; index < pending; index++)
+		{
+			CanFrame_t *slot = CanFrameBuffer_GetWriteSlot(&captureBus->Frames, index);
+			uint16_t distance = newestTime - (uint16_t)slot->Timestamp;
+
+			slot->Timestamp = timestamp - (((uint64_t)distance * captureBus->BitTime) >> 16);
+		}
+	}
+#endif
+
+	CanFrameBuffer_Commit(&captureBus->Frames, pending);
+	captureBus->Stats.RxFrames += pending;
+
+	if(events)
+	{
+		USB_VCP_NotifyEvent(captureBus->InterfaceNumber, events);
+	}
+
+	CAN_CAPTURE_PROFILE_STOP(captureBus->Stats.RxIrqCyclesMax);
+}
+
+/******************************************************************************
+ *  @brief  Tx mailbox empty interrupt: completion status of every finished
+ *          mailbox is counted, cleared and passed to gs_usb, which echoes
+ *          its host frames from here. A running load test refills the
+ *          mailboxes.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void CanCapture_TxIrqHandler(uint8_t bus)
+{
+	uint64_t timestamp = CAN_CAPTURE_TIMESTAMP();
+	CanCapture_Bus_t *captureBus = &canCaptureBuses[bus];
+	CAN_TypeDef *can = captureBus->Handle->Instance;
+	uint32_t tsr = can->TSR;
+	uint32_t clear = 0;
+	uint8_t mailbox;
+
+	for(mailbox = 0; mailbox < CAN_CAPTURE_TX_MAILBOXES; mailbox++)
+	{
+		//Status bytes of mailboxes share layout: RQCP, TXOK, ALST, TERR
+		uint32_t status = tsr >> CAN_CAPTURE_TSR_SHIFT(mailbox);
+		bool sent = ((status & CAN_TSR_TXOK0) != 0);
+
+		if(!(status & CAN_TSR_RQCP0))
+		{
+			continue;
+		}
+
+		clear |= CAN_TSR_RQCP0 << CAN_CAPTURE_TSR_SHIFT(mailbox);
+		if(sent)
+		{
+			captureBus->Stats.TxFrames++;
+		}
+		else
+		{
+			captureBus->Stats.TxErrors++;
+		}
+
+#if (USBD_GSUSB_ENABLE == 1)
+		if(bus < GSUSB_NUM_CHANNELS)
+		{
+			USBD_GS_TxComplete(bus, mailbox, sent, (uint32_t)timestamp);
+		}
+#else
+		(void)timestamp;
+#endif
+	}
+
+	if(clear)
+	{
+		CAN_CAPTURE_TSR_WRITE(&can->TSR, clear);
+	}
+
+	//After the status is cleared: TXRQ of a refilled mailbox clears it too
+	CanCapture_RunLoadTest(bus);
+}
+
+/******************************************************************************
+ *  @brief  Status change interrupt: error warning, error passive, bus-off.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void CanCapture_ErrorIrqHandler(uint8_t bus)
+{
+	CanCapture_Bus_t *captureBus = &canCaptureBuses[bus];
+	CAN_TypeDef *can = captureBus->Handle->Instance;
+	uint32_t esr = can->ESR;
+
+	can->MSR = CAN_MSR_ERRI;
+
+	//Host reads controller state with CanCapture_GetStatus
+	if(esr & CAN_ESR_BOFF)
+	{
+		captureBus->Stats.BusOff++;
+	}
+	else if(esr & CAN_ESR_EPVF)
+	{
+		captureBus->Stats.ErrorPassive++;
+	}
+}
+
+/*-- EOF --------------------------------------------------------------------*/
@@ -0,0 +1,604 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    CanFilter.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+#include "CanFilter.h"
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+#define CAN_FILTER_STD_ID_MAX		0x7FFU
+#define CAN_FILTER_EXT_ID_MAX		0x1FFFFFFFU
+
+//Register layout fields
+#define CAN_FILTER_STID				(CAN_FILTER_STD_ID_MAX << CAN_FILTER_STID_POS)
+#define CAN_FILTER_EXID				(0x3FFFFU << CAN_FILTER_EXID_POS)
+#define CAN_FILTER_EXID_LOW			(0x7FFFU << CAN_FILTER_EXID_POS)	//Bits a 16 bit filter cannot compare
+
+//Register values of one bank: 4 in 16 bit scale, 2 in 32 bit scale
+#define CAN_FILTER_BANK_VALUES		4
+
+/*-- Local typedefs ---------------------------------------------------------*/
+//Bank entry form of a rule
+typedef enum
+{
+	CAN_FILTER_KIND_LIST_16 = 0,			//Exact, one frame type: one 16 bit list entry
+	CAN_FILTER_KIND_BOTH_16,				//Exact, both frame types: two 16 bit list entries
+	CAN_FILTER_KIND_MASK_16,
+	CAN_FILTER_KIND_LIST_32,				//Exact, one frame type: one 32 bit list entry
+	CAN_FILTER_KIND_MASK_32,
+}CanFilter_Kind_t;
+
+//Rule count of every kind
+typedef struct
+{
+	uint32_t Count[CAN_FILTER_KIND_MASK_32 + 1];
+}CanFilter_Census_t;
+
+//Choice between equal kinds, see CanFilter_Cost
+typedef struct
+{
+	uint32_t BothAsMask;					//Leading BOTH_16 rules placed as 16 bit masks
+	uint32_t List16As32;					//Leading LIST_16 rules placed in a spare 32 bit list entry
+}CanFilter_Layout_t;
+
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+/*-- Local functions --------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Check that every frame passed by inner rule is passed by outer.
+ *
+ *  @param  outer - wider rule.
+ *  @param  inner - narrower rule.
+ *
+ *  @retval true if outer covers inner.
+ *****************************************************************************/
+static bool CanFilter_Covers(const CanFilter_Rule_t *outer, const CanFilter_Rule_t *inner)
+{
+	return (((outer->Mask & inner->Mask) == outer->Mask) && (((outer->Id ^ inner->Id) & outer->Mask) == 0));
+}
+
+/******************************************************************************
+ *  @brief  Remove rule keeping order of the rest, order is priority when
+ *          the list does not fit the banks.
+ *
+ *  @param  filter - rule list.
+ *  @param  index - rule to remove.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void CanFilter_Remove(CanFilter_t *filter, uint32_t index)
+{
+	filter->Count--;
+	memmove(&filter->Rules[index], &filter->Rules[index + 1], (filter->Count - index) * sizeof(*filter->Rules));
+}
+
+/******************************************************************************
+ *  @brief  Add rule in register layout. Rules covered by another one are
+ *          dropped, two rules of equal mask which differ in one compared
+ *          bit are merged, so the list stays exact and short.
+ *
+ *  @param  filter - rule list.
+ *  @param  id - identifier, register layout.
+ *  @param  mask - compared bits, register layout.
+ *
+ *  @retval false if rule list is full.
+ *****************************************************************************/
+static bool CanFilter_Insert(CanFilter_t *filter, uint32_t id, uint32_t mask)
+{
+	CanFilter_Rule_t rule;
+	uint32_t index = 0;
+
+	rule.Id = id & mask;
+	rule.Mask = mask;
+
+	while(index < filter->Count)
+	{
+		const CanFilter_Rule_t *other = &filter->Rules[index];
+		uint32_t difference = other->Id ^ rule.Id;
+
+		if(CanFilter_Covers(other, &rule))
+		{
+			return true;
+		}
+
+		if(CanFilter_Covers(&rule, other))
+		{
+			CanFilter_Remove(filter, index);
+		}
+		else if((other->Mask == rule.Mask) && ((difference & (difference - 1)) == 0))
+		{
+			//Merged rule may cover or pair with rules already checked
+			rule.Mask &= ~difference;
+			rule.Id &= rule.Mask;
+			CanFilter_Remove(filter, index);
+			index = 0;
+		}
+		else
+		{
+			index++;
+		}
+	}
+
+	if(filter->Count >= CAN_FILTER_MAX_RULES)
+	{
+		return false;
+	}
+
+	filter->Rules[filter->Count++] = rule;
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Convert register layout value to 16 bit filter layout:
+ *          STID[15:5], RTR, IDE, EXID[17:15].
+ *
+ *  @param  value - identifier or mask, 32 bit register layout.
+ *
+ *  @retval 16 bit filter value.
+ *****************************************************************************/
+static uint32_t CanFilter_To16(uint32_t value)
+{
+	return ((value >> 16) & 0xFFE0U) | ((value & CAN_FILTER_RTR) << 3) | ((value & CAN_FILTER_IDE) << 1) | ((value >> 18) & 0x7U);
+}
+
+/******************************************************************************
+ *  @brief  Get bank entry form of a rule.
+ *
+ *  @param  rule - rule.
+ *
+ *  @retval CAN_FILTER_KIND_xxx.
+ *****************************************************************************/
+static CanFilter_Kind_t CanFilter_GetKind(const CanFilter_Rule_t *rule)
+{
+	uint32_t exact = CAN_FILTER_STID | CAN_FILTER_IDE | CAN_FILTER_RTR;
+	bool fits16 = ((rule->Mask & CAN_FILTER_EXID_LOW) == 0);
+
+	if(rule->Id & CAN_FILTER_IDE)
+	{
+		exact |= CAN_FILTER_EXID;
+	}
+
+	if((rule->Mask & CAN_FILTER_IDE) && (rule->Mask == exact))
+	{
+		return fits16 ? CAN_FILTER_KIND_LIST_16 : CAN_FILTER_KIND_LIST_32;
+	}
+
+	if((rule->Mask & CAN_FILTER_IDE) && (rule->Mask == (exact & ~CAN_FILTER_RTR)) && (fits16))
+	{
+		return CAN_FILTER_KIND_BOTH_16;
+	}
+
+	return fits16 ? CAN_FILTER_KIND_MASK_16 : CAN_FILTER_KIND_MASK_32;
+}
+
+/******************************************************************************
+ *  @brief  Count rules of every kind.
+ *
+ *  @param  filter - rule list.
+ *  @param  count - leading rules to count.
+ *  @param  census - pointer to counters.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void CanFilter_TakeCensus(const CanFilter_t *filter, uint32_t count, CanFilter_Census_t *census)
+{
+	uint32_t index;
+
+	memset(census, 0, sizeof(*census));
+
+	for(index = 0; index < count; index++)
+	{
+		census->Count[CanFilter_GetKind(&filter->Rules[index])]++;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Find the fewest banks for a census. Exact rules of both frame
+ *          types take two 16 bit list entries or one 16 bit mask, and an
+ *          odd 32 bit list bank has room for one 16 bit list rule: every
+ *          choice is tried.
+ *
+ *  @param  census - rule counts.
+ *  @param  layout - pointer to best choice.
+ *
+ *  @retval count of banks.
+ *****************************************************************************/
+static uint32_t CanFilter_Cost(const CanFilter_Census_t *census, CanFilter_Layout_t *layout)
+{
+	const uint32_t *count = census->Count;
+	uint32_t moveMax = ((count[CAN_FILTER_KIND_LIST_32] & 1) && (count[CAN_FILTER_KIND_LIST_16] > 0)) ? 1 : 0;
+	uint32_t best = UINT32_MAX;
+	uint32_t move;
+	uint32_t both;
+
+	for(move = 0; move <= moveMax; move++)
+	{
+		for(both = 0; both <= count[CAN_FILTER_KIND_BOTH_16]; both++)
+		{
+			uint32_t list16 = (count[CAN_FILTER_KIND_LIST_16] - move) + (2 * (count[CAN_FILTER_KIND_BOTH_16] - both));
+			uint32_t mask16 = count[CAN_FILTER_KIND_MASK_16] + both;
+			uint32_t list32 = count[CAN_FILTER_KIND_LIST_32] + move;
+			uint32_t banks = ((list16 + 3) / 4) + ((mask16 + 1) / 2) + ((list32 + 1) / 2) + count[CAN_FILTER_KIND_MASK_32];
+
+			if(banks < best)
+			{
+				best = banks;
+				layout->BothAsMask = both;
+				layout->List16As32 = move;
+			}
+		}
+	}
+
+	return best;
+}
+
+/******************************************************************************
+ *  @brief  Close a bank, unused entries repeat the used ones.
+ *
+ *  @param  plan - compiled filter.
+ *  @param  mode - bank mode.
+ *  @param  values - register values, CAN_FILTER_BANK_VALUES.
+ *  @param  count - used values.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void CanFilter_Flush(CanFilter_Plan_t *plan, CanFilter_BankMode_t mode, uint32_t *values, uint32_t count)
+{
+	CanFilter_Bank_t *bank = &plan->Banks[plan->Count++];
+	uint32_t index;
+
+	for(index = count; index < CAN_FILTER_BANK_VALUES; index++)
+	{
+		values[index] = values[index - count];
+	}
+
+	bank->Mode = mode;
+
+	if((mode == CAN_FILTER_BANK_MASK_16) || (mode == CAN_FILTER_BANK_LIST_16))
+	{
+		bank->Fr1 = (values[1] << 16) | values[0];
+		bank->Fr2 = (values[3] << 16) | values[2];
+	}
+	else
+	{
+		bank->Fr1 = values[0];
+		bank->Fr2 = values[1];
+	}
+}
+
+/******************************************************************************
+ *  @brief  Pack leading rules into banks of one mode.
+ *
+ *  @param  filter - rule list.
+ *  @param  count - leading rules to pack.
+ *  @param  layout - choice of CanFilter_Cost.
+ *  @param  mode - bank mode to fill.
+ *  @param  plan - compiled filter.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void CanFilter_Pack(const CanFilter_t *filter, uint32_t count, const CanFilter_Layout_t *layout, CanFilter_BankMode_t mode, CanFilter_Plan_t *plan)
+{
+	uint32_t size = ((mode == CAN_FILTER_BANK_MASK_16) || (mode == CAN_FILTER_BANK_LIST_16)) ? 4 : 2;
+	uint32_t values[CAN_FILTER_BANK_VALUES];
+	uint32_t used = 0;
+	uint32_t both = 0;
+	uint32_t list16 = 0;
+	uint32_t index;
+
+	for(index = 0; index < count; index++)
+	{
+		const CanFilter_Rule_t *rule = &filter->Rules[index];
+		uint32_t entry[2];
+		uint32_t entries = 0;
+		CanFilter_BankMode_t target;
+
+		switch(CanFilter_GetKind(rule))
+		{
+			case CAN_FILTER_KIND_LIST_16:
+			{
+				if(list16++ < layout->List16As32)
+				{
+					target = CAN_FILTER_BANK_LIST_32;
+					entry[entries++] = rule->Id;
+				}
+				else
+				{
+					target = CAN_FILTER_BANK_LIST_16;
+					entry[entries++] = CanFilter_To16(rule->Id);
+				}
+			}
+			break;
+
+			case CAN_FILTER_KIND_BOTH_16:
+			{
+				if(both++ < layout->BothAsMask)
+				{
+					target = CAN_FILTER_BANK_MASK_16;
+					entry[entries++] = CanFilter_To16(rule->Id);
+					entry[entries++] = CanFilter_To16(rule->Mask);
+				}
+				else
+				{
+					target = CAN_FILTER_BANK_LIST_16;
+					entry[entries++] = CanFilter_To16(rule->Id);
+					entry[entries++] = CanFilter_To16(rule->Id | CAN_FILTER_RTR);
+				}
+			}
+			break;
+
+			case CAN_FILTER_KIND_MASK_16:
+			{
+				target = CAN_FILTER_BANK_MASK_16;
+				entry[entries++] = CanFilter_To16(rule->Id);
+				entry[entries++] = CanFilter_To16(rule->Mask);
+			}
+			break;
+
+			case CAN_FILTER_KIND_LIST_32:
+			{
+				target = CAN_FILTER_BANK_LIST_32;
+				entry[entries++] = rule->Id;
+			}
+			break;
+
+			default:
+			{
+				target = CAN_FILTER_BANK_MASK_32;
+				entry[entries++] = rule->Id;
+				entry[entries++] = rule->Mask;
+			}
+			break;
+		}
+
+		if(target == mode)
+		{
+			uint32_t part;
+
+			for(part = 0; part < entries; part++)
+			{
+				values[used++] = entry[part];
+
+				if(used == size)
+				{
+					CanFilter_Flush(plan, mode, values, used);
+					used = 0;
+				}
+			}
+		}
+	}
+
+	if(used > 0)
+	{
+		CanFilter_Flush(plan, mode, values, used);
+	}
+}
+
+/*-- Exported functions -----------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Init empty rule list: every frame is accepted.
+ *
+ *  @param  filter - rule list.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void CanFilter_Init(CanFilter_t *filter)
+{
+	if(filter)
+	{
+		filter->Count = 0;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Accept identifiers first..last. The range is split into aligned
+ *          power of two blocks, one mask rule each.
+ *
+ *  @param  filter - rule list.
+ *  @param  first - first identifier.
+ *  @param  last - last identifier.
+ *  @param  flags - CAN_FILTER_FLAG_xxx.
+ *
+ *  @retval false if range is invalid or rule list is full. Blocks added
+ *          before the list filled up are kept.
+ *****************************************************************************/
+bool CanFilter_AddRange(CanFilter_t *filter, uint32_t first, uint32_t last, uint8_t flags)
+{
+	uint32_t idMax = (flags & CAN_FILTER_FLAG_EXT) ? CAN_FILTER_EXT_ID_MAX : CAN_FILTER_STD_ID_MAX;
+
+	if((!filter) || (first > last) || (last > idMax))
+	{
+		return false;
+	}
+
+	while(true)
+	{
+		//Largest block aligned at first which ends inside the range
+		uint32_t size = (first != 0) ? (first & (~first + 1)) : (idMax + 1);
+
+		while((size - 1) > (last - first))
+		{
+			size >>= 1;
+		}
+
+		if(!CanFilter_AddMask(filter, first, idMax & ~(size - 1), flags))
+		{
+			return false;
+		}
+
+		if((last - first) == (size - 1))
+		{
+			return true;
+		}
+
+		first += size;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Accept identifiers which equal id in bits set in mask.
+ *
+ *  @param  filter - rule list.
+ *  @param  id - identifier.
+ *  @param  mask - compared identifier bits.
+ *  @param  flags - CAN_FILTER_FLAG_xxx.
+ *
+ *  @retval false if identifier is invalid or rule list is full.
+ *****************************************************************************/
+bool CanFilter_AddMask(CanFilter_t *filter, uint32_t id, uint32_t mask, uint8_t flags)
+{
+	uint32_t registerId;
+	uint32_t registerMask;
+
+	if(!filter)
+	{
+		return false;
+	}
+
+	if(flags & CAN_FILTER_FLAG_EXT)
+	{
+		if(id > CAN_FILTER_EXT_ID_MAX)
+		{
+			return false;
+		}
+		registerId = (id << CAN_FILTER_EXID_POS) | CAN_FILTER_IDE;
+		registerMask = ((mask & CAN_FILTER_EXT_ID_MAX) << CAN_FILTER_EXID_POS) | CAN_FILTER_IDE;
+	}
+	else
+	{
+		if(id > CAN_FILTER_STD_ID_MAX)
+		{
+			return false;
+		}
+		registerId = id << CAN_FILTER_STID_POS;
+		registerMask = ((mask & CAN_FILTER_STD_ID_MAX) << CAN_FILTER_STID_POS) | CAN_FILTER_IDE;
+	}
+
+	if(flags & CAN_FILTER_FLAG_DATA_ONLY)
+	{
+		registerMask |= CAN_FILTER_RTR;
+	}
+	else if(flags & CAN_FILTER_FLAG_REMOTE_ONLY)
+	{
+		registerMask |= CAN_FILTER_RTR;
+		registerId |= CAN_FILTER_RTR;
+	}
+
+	return CanFilter_Insert(filter, registerId, registerMask);
+}
+
+/******************************************************************************
+ *  @brief  Compile rule list into the fewest filter banks: list mode for
+ *          exact identifiers, mask mode for the rest, 16 bit scale when the
+ *          rule does not compare low extended identifier bits. Rules which
+ *          do not fit are covered by one 32 bit mask bank passing a superset,
+ *          frames it passes must be checked by CanFilter_Match.
+ *
+ *  @param  filter - rule list, not empty.
+ *  @param  maxBanks - filter banks available, 1..CAN_FILTER_MAX_BANKS.
+ *  @param  plan - pointer to compiled filter.
+ *
+ *  @retval count of banks used.
+ *****************************************************************************/
+uint32_t CanFilter_Compile(const CanFilter_t *filter, uint32_t maxBanks, CanFilter_Plan_t *plan)
+{
+	CanFilter_Census_t census;
+	CanFilter_Layout_t layout;
+	uint32_t count;
+	uint32_t index;
+
+	if((!filter) || (!plan) || (filter->Count == 0) || (maxBanks == 0))
+	{
+		return 0;
+	}
+
+	if(maxBanks > CAN_FILTER_MAX_BANKS)
+	{
+		maxBanks = CAN_FILTER_MAX_BANKS;
+	}
+
+	memset(plan, 0, sizeof(*plan));
+
+	count = filter->Count;
+	CanFilter_TakeCensus(filter, count, &census);
+
+	if(CanFilter_Cost(&census, &layout) > maxBanks)
+	{
+		//Leading rules go to hardware, one bank is left for the superset
+		do
+		{
+			count--;
+			CanFilter_TakeCensus(filter, count, &census);
+		}
+		while(CanFilter_Cost(&census, &layout) > (maxBanks - 1));
+
+		plan->Software = true;
+		plan->SoftwareMask = filter->Rules[count].Mask;
+		plan->SoftwareId = filter->Rules[count].Id;
+
+		for(index = count + 1; index < filter->Count; index++)
+		{
+			plan->SoftwareMask &= filter->Rules[index].Mask & ~(filter->Rules[index].Id ^ plan->SoftwareId);
+		}
+		plan->SoftwareId &= plan->SoftwareMask;
+	}
+
+	plan->HardwareRules = count;
+
+	CanFilter_Pack(filter, count, &layout, CAN_FILTER_BANK_LIST_16, plan);
+	CanFilter_Pack(filter, count, &layout, CAN_FILTER_BANK_MASK_16, plan);
+	CanFilter_Pack(filter, count, &layout, CAN_FILTER_BANK_LIST_32, plan);
+	CanFilter_Pack(filter, count, &layout, CAN_FILTER_BANK_MASK_32, plan);
+
+	if(plan->Software)
+	{
+		CanFilter_Bank_t *bank = &plan->Banks[plan->Count++];
+
+		bank->Mode = CAN_FILTER_BANK_MASK_32;
+		bank->Fr1 = plan->SoftwareId;
+		bank->Fr2 = plan->SoftwareMask;
+	}
+
+	return plan->Count;
+}
+
+/******************************************************************************
+ *  @brief  Software acceptance check of a received frame.
+ *
+ *  @param  filter - rule list.
+ *  @param  rir - RIR register of the frame.
+ *
+ *  @retval true if a rule passes the frame or rule list is empty.
+ *****************************************************************************/
+bool CanFilter_Match(const CanFilter_t *filter, uint32_t rir)
+{
+	uint32_t index;
+
+	if(filter->Count == 0)
+	{
+		return true;
+	}
+
+	for(index = 0; index < filter->Count; index++)
+	{
+		if(((rir ^ filter->Rules[index].Id) & filter->Rules[index].Mask) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*-- EOF --------------------------------------------------------------------*/
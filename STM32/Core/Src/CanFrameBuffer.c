@@ -0,0 +1,276 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    CanFrameBuffer.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+#include "CanFrameBuffer.h"
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+#include "stm32f4xx.h"
+
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+//Slot must be visible before the index that publishes it
+#define CAN_FRAME_BUFFER_BARRIER()		__DMB()
+
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+/*-- Local functions --------------------------------------------------------*/
+/*-- Exported functions -----------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Get free slot past Head to fill in place. Producer side. Several
+ *          slots may be filled before they are published together by
+ *          CanFrameBuffer_Commit, e.g. to fix them up as a batch.
+ *
+ *  @param  buffer - pointer to frame buffer.
+ *  @param  pending - count of slots already filled and not committed.
+ *
+ *  @retval pointer to slot, NULL if buffer is full (frame is counted as dropped).
+ *****************************************************************************/
+CanFrame_t *CanFrameBuffer_GetWriteSlot(CanFrameBuffer_t *buffer, uint32_t pending)
+{
+	CanFrame_t *slot = NULL;
+
+	if(buffer)
+	{
+		uint32_t head = buffer->Head + pending;
+
+		if((head - buffer->Tail) < buffer->Size)
+		{
+			slot = &buffer->Slots[head & (buffer->Size - 1)];
+		}
+		else
+		{
+			buffer->Dropped++;
+		}
+	}
+
+	return slot;
+}
+
+/******************************************************************************
+ *  @brief  Publish slots returned by CanFrameBuffer_GetWriteSlot. Producer side.
+ *
+ *  @param  buffer - pointer to frame buffer.
+ *  @param  count - count of filled slots.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void CanFrameBuffer_Commit(CanFrameBuffer_t *buffer, uint32_t count)
+{
+	if((buffer) && (count > 0))
+	{
+		uint32_t head = buffer->Head + count;
+		uint32_t load;
+
+		CAN_FRAME_BUFFER_BARRIER();
+		buffer->Head = head;
+
+		load = head - buffer->Tail;
+		if(load > buffer->HighWater)
+		{
+			buffer->HighWater = load;
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  Add frame to frame buffer. Producer side.
+ *
+ *  @param  buffer - pointer to frame buffer.
+ *  @param  frame - pointer to frame to add.
+ *
+ *  @retval true if frame was stored, false if it was dropped.
+ *****************************************************************************/
+bool CanFrameBuffer_Push(CanFrameBuffer_t *buffer, const CanFrame_t *frame)
+{
+	bool result = false;
+
+	if(frame)
+	{
+		CanFrame_t *slot = CanFrameBuffer_GetWriteSlot(buffer, 0);
+
+		if(slot)
+		{
+			*slot = *frame;
+			CanFrameBuffer_Commit(buffer, 1);
+
+			result = true;
+		}
+	}
+
+	return result;
+}
+
+/******************************************************************************
+ *  @brief  Get frames from frame buffer. Consumer side.
+ *
+ *  @param  buffer - pointer to frame buffer.
+ *  @param  frames - pointer to frame array read to.
+ *  @param  count - maximum count of frames to read.
+ *
+ *  @retval frames count readed from buffer.
+ *****************************************************************************/
+uint32_t CanFrameBuffer_PopArray(CanFrameBuffer_t *buffer, CanFrame_t *frames, uint32_t count)
+{
+	uint32_t getFrames = 0;
+
+	if((buffer) && (frames) && (count > 0))
+	{
+		uint32_t tail = buffer->Tail;
+		uint32_t load = buffer->Head - tail;
+
+		getFrames = (load > count) ? count : load;
+
+		if(getFrames > 0)
+		{
+			uint32_t offset = tail & (buffer->Size - 1);
+			uint32_t first = buffer->Size - offset;
+
+			if(first > getFrames)
+			{
+				first = getFrames;
+			}
+
+			CAN_FRAME_BUFFER_BARRIER();
+			memcpy(frames, &buffer->Slots[offset], first * sizeof(CanFrame_t));
+
+			if(getFrames > first)
+			{
+				memcpy(&frames[first], buffer->Slots, (getFrames - first) * sizeof(CanFrame_t));
+			}
+
+			CAN_FRAME_BUFFER_BARRIER();
+			buffer->Tail = tail + getFrames;
+		}
+	}
+
+	return getFrames;
+}
+
+/******************************************************************************
+ *  @brief  Get the largest contiguous run of frames without copying.
+ *          Consumer side. Frames stay in buffer until CanFrameBuffer_Consume.
+ *
+ *  @param  buffer - pointer to frame buffer.
+ *  @param  count - pointer to frames count, 0 if buffer is empty.
+ *
+ *  @retval pointer to the oldest frame.
+ *****************************************************************************/
+CanFrame_t *CanFrameBuffer_PeekContiguous(CanFrameBuffer_t *buffer, uint32_t *count)
+{
+	CanFrame_t *frames = NULL;
+	uint32_t peekFrames = 0;
+
+	if(buffer)
+	{
+		uint32_t tail = buffer->Tail;
+		uint32_t offset = tail & (buffer->Size - 1);
+		uint32_t load = buffer->Head - tail;
+
+		peekFrames = buffer->Size - offset;
+
+		if(peekFrames > load)
+		{
+			peekFrames = load;
+		}
+
+		CAN_FRAME_BUFFER_BARRIER();
+		frames = &buffer->Slots[offset];
+	}
+
+	if(count)
+	{
+		*count = peekFrames;
+	}
+
+	return frames;
+}
+
+/******************************************************************************
+ *  @brief  Release frames returned by CanFrameBuffer_PeekContiguous.
+ *          Consumer side.
+ *
+ *  @param  buffer - pointer to frame buffer.
+ *  @param  count - count of frames to release.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void CanFrameBuffer_Consume(CanFrameBuffer_t *buffer, uint32_t count)
+{
+	if(buffer)
+	{
+		uint32_t tail = buffer->Tail;
+		uint32_t load = buffer->Head - tail;
+
+		if(count > load)
+		{
+			count = load;
+		}
+
+		CAN_FRAME_BUFFER_BARRIER();
+		buffer->Tail = tail + count;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Clear the frame buffer. Consumer side: all unread frames are dropped.
+ *
+ *  @param  buffer - pointer to frame buffer.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void CanFrameBuffer_Clear(CanFrameBuffer_t *buffer)
+{
+	if(buffer)
+	{
+		buffer->Tail = buffer->Head;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Get count of frames in frame buffer.
+ *
+ *  @param  buffer - pointer to frame buffer.
+ *
+ *  @retval frames count in buffer.
+ *****************************************************************************/
+uint32_t CanFrameBuffer_GetLoad(CanFrameBuffer_t *buffer)
+{
+	uint32_t result = 0;
+
+	if(buffer)
+	{
+		result = buffer->Head - buffer->Tail;
+	}
+
+	return result;
+}
+
+/******************************************************************************
+ *  @brief  Get count of free slots in frame buffer.
+ *
+ *  @param  buffer - pointer to frame buffer.
+ *
+ *  @retval free slots count in buffer.
+ *****************************************************************************/
+uint32_t CanFrameBuffer_GetFree(CanFrameBuffer_t *buffer)
+{
+	uint32_t result = 0;
+
+	if(buffer)
+	{
+		result = buffer->Size - (buffer->Head - buffer->Tail);
+	}
+
+	return result;
+}
+/*-- EOF --------------------------------------------------------------------*/
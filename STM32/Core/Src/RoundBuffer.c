@@ -13,75 +13,440 @@
 
 /*-- Other libraries --------------------------------------------------------*/
 /*-- Hardware specific libraries --------------------------------------------*/
+#include "RoundBufferPort.h"
+
 /*-- Project specific includes ----------------------------------------------*/
 /*-- Imported functions -----------------------------------------------------*/
 /*-- Local Macro Definitions ------------------------------------------------*/
+//Claimed while the consumer reads indices: producer must not drop anything
+#define ROUND_BUFFER_CLAIM_ALL			0xFFFFFFFFU
+
 /*-- Local function prototypes ----------------------------------------------*/
 /*-- Local variables --------------------------------------------------------*/
 /*-- Local functions --------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Copy array to buffer storage starting at free running index.
+ *          At most two memcpy segments: up to the end of storage and the rest
+ *          from the beginning.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  index - free running index of the first byte.
+ *  @param  inArray - pointer to byte array.
+ *  @param  length - count of bytes to copy.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void RoundBuffer_CopyIn(RoundBuffer_t *buffer, uint32_t index, const uint8_t *inArray, uint32_t length)
+{
+	uint32_t offset = index & (buffer->Size - 1);
+	uint32_t first = buffer->Size - offset;
+
+	if(first > length)
+	{
+		first = length;
+	}
+
+	memcpy(&buffer->Buff[offset], inArray, first);
+
+	if(length > first)
+	{
+		memcpy(buffer->Buff, &inArray[first], length - first);
+	}
+}
+
+/******************************************************************************
+ *  @brief  Copy data from buffer storage starting at free running index.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  index - free running index of the first byte.
+ *  @param  outArray - pointer to byte array read to.
+ *  @param  length - count of bytes to copy.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void RoundBuffer_CopyOut(RoundBuffer_t *buffer, uint32_t index, uint8_t *outArray, uint32_t length)
+{
+	uint32_t offset = index & (buffer->Size - 1);
+	uint32_t first = buffer->Size - offset;
+
+	if(first > length)
+	{
+		first = length;
+	}
+
+	memcpy(outArray, &buffer->Buff[offset], first);
+
+	if(length > first)
+	{
+		memcpy(&outArray[first], buffer->Buff, length - first);
+	}
+}
+
+/******************************************************************************
+ *  @brief  Move bytes of buffer storage down to a lower free running index.
+ *          Source and destination wrap independently: up to three memmove
+ *          segments.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  to - free running index of the first destination byte.
+ *  @param  from - free running index of the first source byte, above to.
+ *  @param  length - count of bytes to move.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void RoundBuffer_Move(RoundBuffer_t *buffer, uint32_t to, uint32_t from, uint32_t length)
+{
+	while(length > 0)
+	{
+		uint32_t toOffset = to & (buffer->Size - 1);
+		uint32_t fromOffset = from & (buffer->Size - 1);
+		uint32_t segment = length;
+
+		if(segment > (buffer->Size - toOffset))
+		{
+			segment = buffer->Size - toOffset;
+		}
+
+		if(segment > (buffer->Size - fromOffset))
+		{
+			segment = buffer->Size - fromOffset;
+		}
+
+		memmove(&buffer->Buff[toOffset], &buffer->Buff[fromOffset], segment);
+
+		to += segment;
+		from += segment;
+		length -= segment;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Drop oldest unclaimed records to free space for a new one.
+ *          Producer side, with interrupts masked so the consumer cannot
+ *          claim in between. Without a claim Tail is moved. Bytes claimed by
+ *          RoundBuffer_PeekContiguous stay in place: records behind them are
+ *          dropped and the newer ones are moved down over them, Head steps
+ *          back.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  length - count of bytes which must be free.
+ *
+ *  @retval true if space was freed.
+ *****************************************************************************/
+static bool RoundBuffer_DropOldest(RoundBuffer_t *buffer, uint32_t length)
+{
+	bool result = false;
+	uint32_t lockState = ROUND_BUFFER_LOCK();
+	uint32_t claimed = buffer->Claimed;
+
+	if(claimed != ROUND_BUFFER_CLAIM_ALL)
+	{
+		uint32_t tail = buffer->Tail;
+		uint32_t head = buffer->Head;
+		uint32_t buffLoad = head - tail;
+		uint32_t dropBytes = length - (buffer->Size - buffLoad);
+		uint32_t dropRecords = 1;
+
+		//A record partly claimed is kept whole
+		if(buffer->RecordSize > 1)
+		{
+			claimed = ((claimed + buffer->RecordSize - 1) / buffer->RecordSize) * buffer->RecordSize;
+			dropRecords = (dropBytes + buffer->RecordSize - 1) / buffer->RecordSize;
+			dropBytes = dropRecords * buffer->RecordSize;
+		}
+
+		if((claimed <= buffLoad) && (dropBytes <= (buffLoad - claimed)))
+		{
+			if(claimed == 0)
+			{
+				buffer->Tail = tail + dropBytes;
+			}
+			else
+			{
+				RoundBuffer_Move(buffer, tail + claimed, tail + claimed + dropBytes, buffLoad - claimed - dropBytes);
+				buffer->Head = head - dropBytes;
+			}
+
+			buffer->Stats.DroppedBytes += dropBytes;
+			buffer->Stats.DroppedRecords += dropRecords;
+			result = true;
+		}
+	}
+
+	ROUND_BUFFER_UNLOCK(lockState);
+
+	return result;
+}
+
+/******************************************************************************
+ *  @brief  Make sure a whole record fits, applying the overflow policy.
+ *          Producer side. A record which cannot be stored is counted as
+ *          dropped.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  length - record length.
+ *
+ *  @retval true if record can be written at Head.
+ *****************************************************************************/
+static bool RoundBuffer_Reserve(RoundBuffer_t *buffer, uint32_t length)
+{
+	bool result = false;
+
+	if(length <= buffer->Size)
+	{
+		result = ((buffer->Size - (buffer->Head - buffer->Tail)) >= length);
+
+		if(!result)
+		{
+			switch(buffer->Policy)
+			{
+				case ROUND_BUFFER_OVERFLOW_DROP_OLDEST:
+				{
+					result = RoundBuffer_DropOldest(buffer, length);
+				}
+				break;
+
+				case ROUND_BUFFER_OVERFLOW_BLOCK:
+				{
+					uint32_t tickStart = ROUND_BUFFER_GET_TICK();
+
+					while((!result) && ((ROUND_BUFFER_GET_TICK() - tickStart) < buffer->Timeout))
+					{
+						result = ((buffer->Size - (buffer->Head - buffer->Tail)) >= length);
+					}
+				}
+				break;
+
+				case ROUND_BUFFER_OVERFLOW_REJECT:
+				default:
+				{
+				}
+				break;
+			}
+		}
+	}
+
+	if(!result)
+	{
+		buffer->Stats.DroppedBytes += length;
+		buffer->Stats.DroppedRecords++;
+	}
+
+	return result;
+}
+
+/******************************************************************************
+ *  @brief  Publish written bytes and update high-water mark. Producer side.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  head - new Head value.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void RoundBuffer_Publish(RoundBuffer_t *buffer, uint32_t head)
+{
+	uint32_t buffLoad;
+
+	ROUND_BUFFER_BARRIER();
+	buffer->Head = head;
+
+	buffLoad = head - buffer->Tail;
+	if(buffLoad > buffer->Stats.HighWater)
+	{
+		buffer->Stats.HighWater = buffLoad;
+	}
+}
+
 /*-- Exported functions -----------------------------------------------------*/
 /******************************************************************************
- *  @brief  Add byte to round buffer.
+ *  @brief  Set overflow policy of round buffer.
  *
  *  @param  buffer - pointer to round buffer.
- *  @param  byte - byte to add.
+ *  @param  policy - what to do when a record does not fit.
+ *  @param  recordSize - size of dropped unit for DROP_OLDEST, 0 for bytes.
+ *  @param  timeout - wait time in ms for BLOCK.
  *
  *  @retval None.
  *****************************************************************************/
-void RoundBuffer_AddByte(RoundBuffer_t *buffer, uint8_t byte)
+void RoundBuffer_SetOverflowPolicy(RoundBuffer_t *buffer, RoundBuffer_OverflowPolicy_t policy, uint32_t recordSize, uint32_t timeout)
 {
 	if(buffer)
 	{
-		buffer->Buff[buffer->Head++] = byte;
+		buffer->Policy = policy;
+		buffer->RecordSize = recordSize;
+		buffer->Timeout = timeout;
+	}
+}
 
-		if (buffer->Head >= buffer->Size)
+/******************************************************************************
+ *  @brief  Get drop counters and high-water mark of round buffer.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  stats - pointer to statistics read to.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void RoundBuffer_GetStats(RoundBuffer_t *buffer, RoundBuffer_Stats_t *stats)
+{
+	if((buffer) && (stats))
+	{
+		*stats = buffer->Stats;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Reset drop counters and high-water mark of round buffer.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void RoundBuffer_ResetStats(RoundBuffer_t *buffer)
+{
+	if(buffer)
+	{
+		memset(&buffer->Stats, 0, sizeof(buffer->Stats));
+	}
+}
+
+/******************************************************************************
+ *  @brief  Add byte to round buffer. Producer side. While there is room the
+ *          byte is stored and published at once, overflow policy is applied
+ *          only when buffer is full.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  byte - byte to add.
+ *
+ *  @retval true if byte was stored, false if it was dropped.
+ *****************************************************************************/
+bool RoundBuffer_AddByte(RoundBuffer_t *buffer, uint8_t byte)
+{
+	bool result = false;
+
+	if(buffer)
+	{
+		uint32_t head = buffer->Head;
+		uint32_t buffLoad = head - buffer->Tail;
+
+		if(buffLoad < buffer->Size)
 		{
-			buffer->Head = 0;
+			buffer->Buff[head & (buffer->Size - 1)] = byte;
+
+			ROUND_BUFFER_BARRIER();
+			buffer->Head = head + 1;
+
+			if(buffLoad >= buffer->Stats.HighWater)
+			{
+				buffer->Stats.HighWater = buffLoad + 1;
+			}
+
+			result = true;
+		}
+		else if(RoundBuffer_Reserve(buffer, 1))
+		{
+			head = buffer->Head;
+			buffer->Buff[head & (buffer->Size - 1)] = byte;
+
+			RoundBuffer_Publish(buffer, head + 1);
+
+			result = true;
 		}
 	}
+
+	return result;
 }
 
 /******************************************************************************
- *  @brief  Add byte array to round buffer.
+ *  @brief  Add byte array to round buffer as one record. Producer side.
+ *          Record is stored completely or not at all, depending on the
+ *          overflow policy.
  *
  *  @param  buffer - pointer to round buffer.
  *  @param  inArray - pointer to byte array.
  *  @param  length - count of bytes to add.
  *
- *  @retval None.
+ *  @retval bytes count stored to buffer: length or 0.
  *****************************************************************************/
-void RoundBuffer_AddArray(RoundBuffer_t *buffer, uint8_t *inArray, uint32_t length)
+uint32_t RoundBuffer_AddArray(RoundBuffer_t *buffer, uint8_t *inArray, uint32_t length)
 {
+	uint32_t addBytes = 0;
+
 	if((buffer) && (inArray) && (length > 0))
 	{
-		while (length > 0)
+		if(RoundBuffer_Reserve(buffer, length))
 		{
-			buffer->Buff[buffer->Head++] = *inArray++;
+			uint32_t head = buffer->Head;
 
-			if(buffer->Head >= buffer->Size)
-			{
-				buffer->Head = 0;
-			}
+			RoundBuffer_CopyIn(buffer, head, inArray, length);
 
-			length--;
+			RoundBuffer_Publish(buffer, head + length);
+
+			addBytes = length;
 		}
+	}
+
+	return addBytes;
+}
+
+/******************************************************************************
+ *  @brief  Get the largest contiguous free region at Head to fill in place.
+ *          Producer side. Overflow policy is not applied: a producer which
+ *          needs more space than returned falls back to RoundBuffer_AddArray.
+ *          Bytes become visible to the consumer by RoundBuffer_Commit.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  length - pointer to region length, 0 if buffer is full.
+ *
+ *  @retval pointer to the first free byte in buffer storage.
+ *****************************************************************************/
+uint8_t *RoundBuffer_GetWriteContiguous(RoundBuffer_t *buffer, uint32_t *length)
+{
+	uint8_t *data = NULL;
+	uint32_t writeBytes = 0;
+
+	if(buffer)
+	{
+		uint32_t head = buffer->Head;
+		uint32_t offset = head & (buffer->Size - 1);
+		uint32_t buffFree = buffer->Size - (head - buffer->Tail);
+
+		writeBytes = buffer->Size - offset;
 
-		/*
-		uint32_t i = 0;
-		for(i = length; i > 0; i--)
+		if(writeBytes > buffFree)
 		{
-			buffer->Buff[buffer->Head++] = *inArray++;
-			if(buffer->Head >= buffer->Size)
-			{
-				buffer->Head = 0;
-			}
+			writeBytes = buffFree;
 		}
-		*/
+
+		data = &buffer->Buff[offset];
+	}
+
+	if(length)
+	{
+		*length = writeBytes;
+	}
+
+	return data;
+}
+
+/******************************************************************************
+ *  @brief  Publish bytes written to region returned by
+ *          RoundBuffer_GetWriteContiguous. Producer side.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  length - count of written bytes.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void RoundBuffer_Commit(RoundBuffer_t *buffer, uint32_t length)
+{
+	if((buffer) && (length > 0))
+	{
+		RoundBuffer_Publish(buffer, buffer->Head + length);
 	}
 }
 
 /******************************************************************************
- *  @brief  Clear the round buffer.
+ *  @brief  Clear the round buffer. Consumer side: all unread data is dropped.
  *
  *  @param  buffer - pointer to round buffer.
  *
@@ -91,14 +456,18 @@ void RoundBuffer_Clear(RoundBuffer_t *buffer)
 {
 	if(buffer)
 	{
-		buffer->Tail = 0;
-		buffer->Head = 0;
-		memset(buffer->Buff, 0, buffer->Size);
+		buffer->Claimed = ROUND_BUFFER_CLAIM_ALL;
+		ROUND_BUFFER_BARRIER();
+		buffer->Tail = buffer->Head;
+		ROUND_BUFFER_BARRIER();
+		buffer->Claimed = 0;
 	}
 }
 
 /******************************************************************************
- *  @brief  Get one byte from round buffer.
+ *  @brief  Get one byte from round buffer. Consumer side. Only DROP_OLDEST
+ *          lets the producer move Tail, so only then the byte is claimed
+ *          while it is read.
  *
  *  @param  buffer - pointer to round buffer.
  *
@@ -110,18 +479,35 @@ uint8_t RoundBuffer_GetByte(RoundBuffer_t *buffer)
 
 	if (buffer)
 	{
-		if(RoundBuffer_GetLoad(buffer) > 0)
+		uint32_t tail;
+
+		if(buffer->Policy != ROUND_BUFFER_OVERFLOW_DROP_OLDEST)
 		{
-			uint32_t tail = buffer->Tail;
+			tail = buffer->Tail;
+			if(buffer->Head != tail)
+			{
+				data = buffer->Buff[tail & (buffer->Size - 1)];
 
-			data = buffer->Buff[tail++];
+				ROUND_BUFFER_BARRIER();
+				buffer->Tail = tail + 1;
+			}
+		}
+		else
+		{
+			buffer->Claimed = ROUND_BUFFER_CLAIM_ALL;
+			ROUND_BUFFER_BARRIER();
 
-			if(tail >= buffer->Size)
+			tail = buffer->Tail;
+			if(buffer->Head != tail)
 			{
-				tail = 0;
+				ROUND_BUFFER_BARRIER();
+				data = buffer->Buff[tail & (buffer->Size - 1)];
+
+				ROUND_BUFFER_BARRIER();
+				buffer->Tail = tail + 1;
 			}
 
-			buffer->Tail = tail;
+			buffer->Claimed = 0;
 		}
 	}
 
@@ -129,7 +515,7 @@ uint8_t RoundBuffer_GetByte(RoundBuffer_t *buffer)
 }
 
 /******************************************************************************
- *  @brief  Get byte array from round buffer.
+ *  @brief  Get byte array from round buffer. Consumer side.
  *
  *  @param  buffer - pointer to round buffer.
  *  @param  outArray - pointer to byte array read to.
@@ -143,33 +529,131 @@ uint32_t RoundBuffer_GetArray(RoundBuffer_t *buffer, uint8_t *outArray, uint32_t
 
 	if((buffer) && (outArray) && (length > 0))
 	{
-		uint32_t buffLoad = RoundBuffer_GetLoad(buffer);
+		uint32_t tail;
+		uint32_t buffLoad;
 
-		if(buffLoad > 0)
-		{
-			uint32_t i = 0;
+		buffer->Claimed = ROUND_BUFFER_CLAIM_ALL;
+		ROUND_BUFFER_BARRIER();
 
-			//Calculating
-			if(buffLoad > length)
-			{
-				getBytes = length;
-			}
-			else
-			{
-				getBytes = buffLoad;
-			}
+		tail = buffer->Tail;
+		buffLoad = buffer->Head - tail;
 
-			//Reading
-			for(i = 0; i < getBytes; i++)
-			{
-				outArray[i] = RoundBuffer_GetByte(buffer);
-			}
+		getBytes = (buffLoad > length) ? length : buffLoad;
+
+		if(getBytes > 0)
+		{
+			ROUND_BUFFER_BARRIER();
+			RoundBuffer_CopyOut(buffer, tail, outArray, getBytes);
+
+			ROUND_BUFFER_BARRIER();
+			buffer->Tail = tail + getBytes;
 		}
+
+		buffer->Claimed = 0;
 	}
 
 	return getBytes;
 }
 
+/******************************************************************************
+ *  @brief  Get the largest contiguous readable region without copying.
+ *          Consumer side. Data stays in the buffer and is protected from
+ *          DROP_OLDEST until RoundBuffer_Consume, unclaimed data behind it
+ *          is not.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  length - pointer to region length, 0 if buffer is empty.
+ *
+ *  @retval pointer to the first unread byte in buffer storage.
+ *****************************************************************************/
+uint8_t *RoundBuffer_PeekContiguous(RoundBuffer_t *buffer, uint32_t *length)
+{
+	uint8_t *data = NULL;
+	uint32_t peekBytes = 0;
+
+	if(buffer)
+	{
+		uint32_t tail;
+		uint32_t offset;
+		uint32_t buffLoad;
+
+		buffer->Claimed = ROUND_BUFFER_CLAIM_ALL;
+		ROUND_BUFFER_BARRIER();
+
+		tail = buffer->Tail;
+		offset = tail & (buffer->Size - 1);
+		buffLoad = buffer->Head - tail;
+
+		peekBytes = buffer->Size - offset;
+
+		if(peekBytes > buffLoad)
+		{
+			peekBytes = buffLoad;
+		}
+
+		//Claim narrows to the region returned, producer may drop behind it
+		buffer->Claimed = peekBytes;
+
+		ROUND_BUFFER_BARRIER();
+		data = &buffer->Buff[offset];
+	}
+
+	if(length)
+	{
+		*length = peekBytes;
+	}
+
+	return data;
+}
+
+/******************************************************************************
+ *  @brief  Release bytes previously returned by RoundBuffer_PeekContiguous.
+ *          Consumer side.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *  @param  length - count of bytes to release.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void RoundBuffer_Consume(RoundBuffer_t *buffer, uint32_t length)
+{
+	if(buffer)
+	{
+		uint32_t tail = buffer->Tail;
+		uint32_t buffLoad = buffer->Head - tail;
+
+		if(length > buffLoad)
+		{
+			length = buffLoad;
+		}
+
+		ROUND_BUFFER_BARRIER();
+		buffer->Tail = tail + length;
+
+		ROUND_BUFFER_BARRIER();
+		buffer->Claimed = 0;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Get size of round buffer storage.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *
+ *  @retval buffer size in bytes.
+ *****************************************************************************/
+uint32_t RoundBuffer_GetSize(RoundBuffer_t *buffer)
+{
+	uint32_t result = 0;
+
+	if(buffer)
+	{
+		result = buffer->Size;
+	}
+
+	return result;
+}
+
 /******************************************************************************
  *  @brief  Get count of bytes in round buffer.
  *
@@ -183,16 +667,28 @@ uint32_t RoundBuffer_GetLoad(RoundBuffer_t *buffer)
 
 	if(buffer)
 	{
-		int32_t bytes_num = buffer->Head - buffer->Tail;
+		result = buffer->Head - buffer->Tail;
+	}
 
-		if(bytes_num < 0)
-		{
-			bytes_num += buffer->Size;
-		}
+	return result;
+}
+
+/******************************************************************************
+ *  @brief  Get count of free bytes in round buffer.
+ *
+ *  @param  buffer - pointer to round buffer.
+ *
+ *  @retval free bytes count in buffer.
+ *****************************************************************************/
+uint32_t RoundBuffer_GetFree(RoundBuffer_t *buffer)
+{
+	uint32_t result = 0;
 
-		result = (uint32_t)bytes_num;
+	if(buffer)
+	{
+		result = buffer->Size - (buffer->Head - buffer->Tail);
 	}
-	
+
 	return result;
 }
 /*-- EOF --------------------------------------------------------------------*/
@@ -0,0 +1,698 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    Slcan.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+#include "Slcan.h"
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+#define SLCAN_CR					'\r'
+#define SLCAN_BELL					'\a'
+
+#define SLCAN_STD_ID_DIGITS			3
+#define SLCAN_EXT_ID_DIGITS			8
+#define SLCAN_STD_ID_MAX			0x7FFU
+#define SLCAN_EXT_ID_MAX			0x1FFFFFFFU
+
+//Timestamp of Z1 mode wraps every minute, ms
+#define SLCAN_TIMESTAMP_PERIOD		60000U
+
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+//Nibble to ASCII hex
+static const uint8_t slcanHex[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+
+//S0..S8 bitrates, bit/s
+static const uint32_t slcanBitrates[] = { 10000, 20000, 50000, 100000, 125000, 250000, 500000, 800000, 1000000 };
+
+/*-- Local functions --------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Convert one ASCII hex digit.
+ *
+ *  @param  c - character.
+ *
+ *  @retval digit value, -1 if character is not a hex digit.
+ *****************************************************************************/
+static int32_t Slcan_Nibble(char c)
+{
+	if((c >= '0') && (c <= '9'))
+	{
+		return c - '0';
+	}
+
+	c |= 0x20;
+	if((c >= 'a') && (c <= 'f'))
+	{
+		return c - 'a' + 10;
+	}
+
+	return -1;
+}
+
+/******************************************************************************
+ *  @brief  Parse fixed count of ASCII hex digits.
+ *
+ *  @param  text - first digit.
+ *  @param  digits - count of digits, up to 8.
+ *  @param  value - pointer to parsed value.
+ *
+ *  @retval true if all characters are hex digits.
+ *****************************************************************************/
+static bool Slcan_ParseHex(const char *text, uint32_t digits, uint32_t *value)
+{
+	uint32_t result = 0;
+	uint32_t index;
+
+	for(index = 0; index < digits; index++)
+	{
+		int32_t nibble = Slcan_Nibble(text[index]);
+
+		if(nibble < 0)
+		{
+			return false;
+		}
+
+		result = (result << 4) | (uint32_t)nibble;
+	}
+
+	*value = result;
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Parse t, T, r, R command line into a frame.
+ *
+ *  @param  line - command line without CR.
+ *  @param  length - line length.
+ *  @param  frame - pointer to frame to fill.
+ *
+ *  @retval true if line is a valid frame.
+ *****************************************************************************/
+static bool Slcan_ParseFrame(const char *line, uint32_t length, CanFrame_t *frame)
+{
+	bool ext = ((line[0] == 'T') || (line[0] == 'R'));
+	bool rtr = ((line[0] == 'r') || (line[0] == 'R'));
+	uint32_t idDigits = ext ? SLCAN_EXT_ID_DIGITS : SLCAN_STD_ID_DIGITS;
+	uint32_t value;
+	uint32_t index;
+	const char *data;
+
+	if(length < (1 + idDigits + 1))
+	{
+		return false;
+	}
+
+	if((!Slcan_ParseHex(&line[1], idDigits, &value)) || (value > (ext ? SLCAN_EXT_ID_MAX : SLCAN_STD_ID_MAX)))
+	{
+		return false;
+	}
+	frame->Id = value;
+
+	value = (uint32_t)Slcan_Nibble(line[1 + idDigits]);
+	if(value > CAN_FRAME_MAX_DATA)
+	{
+		return false;
+	}
+	frame->Dlc = (uint8_t)value;
+
+	frame->Flags = (ext ? CAN_FRAME_FLAG_EXT : 0) | (rtr ? CAN_FRAME_FLAG_RTR : 0);
+	frame->Timestamp = 0;
+
+	if(rtr)
+	{
+		return (length == (1 + idDigits + 1));
+	}
+
+	if(length != (1 + idDigits + 1 + (2 * frame->Dlc)))
+	{
+		return false;
+	}
+
+	data = &line[1 + idDigits + 1];
+	for(index = 0; index < frame->Dlc; index++)
+	{
+		if(!Slcan_ParseHex(&data[2 * index], 2, &value))
+		{
+			return false;
+		}
+		frame->Data[index] = (uint8_t)value;
+	}
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Parse k, K command line with a rule.
+ *
+ *  @param  line - command line without CR.
+ *  @param  length - line length, at least 2.
+ *  @param  filter - pointer to rule to fill.
+ *
+ *  @retval true if line is a valid rule.
+ *****************************************************************************/
+static bool Slcan_ParseFilter(const char *line, uint32_t length, Slcan_Filter_t *filter)
+{
+	bool ext = (line[0] == 'K');
+	uint32_t idDigits = ext ? SLCAN_EXT_ID_DIGITS : SLCAN_STD_ID_DIGITS;
+	uint32_t idMax = ext ? SLCAN_EXT_ID_MAX : SLCAN_STD_ID_MAX;
+
+	filter->Flags = ext ? CAN_FILTER_FLAG_EXT : 0;
+
+	if(line[length - 1] == 't')
+	{
+		filter->Flags |= CAN_FILTER_FLAG_DATA_ONLY;
+		length--;
+	}
+	else if(line[length - 1] == 'r')
+	{
+		filter->Flags |= CAN_FILTER_FLAG_REMOTE_ONLY;
+		length--;
+	}
+
+	if((length < (1 + idDigits)) || (!Slcan_ParseHex(&line[1], idDigits, &filter->Id)) || (filter->Id > idMax))
+	{
+		return false;
+	}
+
+	if(length == (1 + idDigits))
+	{
+		filter->Type = SLCAN_FILTER_RANGE;
+		filter->Value = filter->Id;
+		return true;
+	}
+
+	if((length != (1 + idDigits + 1 + idDigits)) ||
+	   (!Slcan_ParseHex(&line[1 + idDigits + 1], idDigits, &filter->Value)) || (filter->Value > idMax))
+	{
+		return false;
+	}
+
+	switch(line[1 + idDigits])
+	{
+		case '-':
+		{
+			filter->Type = SLCAN_FILTER_RANGE;
+			return (filter->Value >= filter->Id);
+		}
+
+		case '/':
+		{
+			filter->Type = SLCAN_FILTER_MASK;
+			return true;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  Encode frame as SLCAN line with CR.
+ *
+ *  @param  slcan - channel state.
+ *  @param  out - output, at least SLCAN_MAX_FRAME_LINE bytes.
+ *  @param  frame - frame to encode.
+ *
+ *  @retval line length.
+ *****************************************************************************/
+static uint32_t Slcan_FormatFrame(const Slcan_t *slcan, uint8_t *out, const CanFrame_t *frame)
+{
+	uint8_t *p = out;
+	uint32_t id = frame->Id;
+	uint32_t dlc = (frame->Dlc > CAN_FRAME_MAX_DATA) ? CAN_FRAME_MAX_DATA : frame->Dlc;
+	bool rtr = ((frame->Flags & CAN_FRAME_FLAG_RTR) != 0);
+	uint32_t index;
+
+	if(frame->Flags & CAN_FRAME_FLAG_EXT)
+	{
+		*p++ = rtr ? 'R' : 'T';
+		p[0] = slcanHex[(id >> 28) & 0x1];
+		p[1] = slcanHex[(id >> 24) & 0xF];
+		p[2] = slcanHex[(id >> 20) & 0xF];
+		p[3] = slcanHex[(id >> 16) & 0xF];
+		p[4] = slcanHex[(id >> 12) & 0xF];
+		p[5] = slcanHex[(id >> 8) & 0xF];
+		p[6] = slcanHex[(id >> 4) & 0xF];
+		p[7] = slcanHex[id & 0xF];
+		p += SLCAN_EXT_ID_DIGITS;
+	}
+	else
+	{
+		*p++ = rtr ? 'r' : 't';
+		p[0] = slcanHex[(id >> 8) & 0x7];
+		p[1] = slcanHex[(id >> 4) & 0xF];
+		p[2] = slcanHex[id & 0xF];
+		p += SLCAN_STD_ID_DIGITS;
+	}
+
+	*p++ = slcanHex[dlc];
+
+	if(!rtr)
+	{
+		for(index = 0; index < dlc; index++)
+		{
+			p[0] = slcanHex[frame->Data[index] >> 4];
+			p[1] = slcanHex[frame->Data[index] & 0xF];
+			p += 2;
+		}
+	}
+
+	if(slcan->Timestamp)
+	{
+		uint32_t timestamp = (uint32_t)((frame->Timestamp / 1000U) % SLCAN_TIMESTAMP_PERIOD);
+
+		p[0] = slcanHex[(timestamp >> 12) & 0xF];
+		p[1] = slcanHex[(timestamp >> 8) & 0xF];
+		p[2] = slcanHex[(timestamp >> 4) & 0xF];
+		p[3] = slcanHex[timestamp & 0xF];
+		p += 4;
+	}
+
+	*p++ = SLCAN_CR;
+
+	return (uint32_t)(p - out);
+}
+
+/******************************************************************************
+ *  @brief  Put reply to Tx round buffer.
+ *
+ *  @param  txBuffer - channel Tx round buffer.
+ *  @param  reply - reply bytes.
+ *  @param  length - reply length.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Slcan_Reply(RoundBuffer_t *txBuffer, const uint8_t *reply, uint32_t length)
+{
+	RoundBuffer_AddArray(txBuffer, (uint8_t *)reply, length);
+}
+
+/******************************************************************************
+ *  @brief  Put acknowledge or error reply.
+ *
+ *  @param  txBuffer - channel Tx round buffer.
+ *  @param  ok - true for CR, false for BELL.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Slcan_ReplyStatus(RoundBuffer_t *txBuffer, bool ok)
+{
+	RoundBuffer_AddByte(txBuffer, ok ? SLCAN_CR : SLCAN_BELL);
+}
+
+/******************************************************************************
+ *  @brief  Execute one command line.
+ *
+ *  @param  slcan - channel state.
+ *  @param  line - command line without CR.
+ *  @param  length - line length.
+ *  @param  txBuffer - channel Tx round buffer for the reply.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Slcan_Execute(Slcan_t *slcan, const char *line, uint32_t length, RoundBuffer_t *txBuffer)
+{
+	const Slcan_Backend_t *backend = slcan->Backend;
+	uint8_t reply[SLCAN_MAX_REPLY];
+	Slcan_Filter_t filter;
+	CanFrame_t frame;
+	uint32_t value;
+	bool ok = false;
+
+	//LF of CR LF terminated lines starts the next line
+	while((length > 0) && (line[0] == '\n'))
+	{
+		line++;
+		length--;
+	}
+
+	if(length == 0)
+	{
+		return;
+	}
+
+	switch(line[0])
+	{
+		case 'O':
+		case 'L':
+		{
+			if((length == 1) && (!slcan->Open))
+			{
+				ok = ((!backend) || (!backend->Open) ||
+					  backend->Open(slcan->Channel, (line[0] == 'L') ? SLCAN_MODE_LISTEN_ONLY : SLCAN_MODE_NORMAL));
+				slcan->Open = ok;
+			}
+		}
+		break;
+
+		case 'Y':
+		{
+			if((length == 2) && ((uint32_t)Slcan_Nibble(line[1]) <= SLCAN_MODE_SILENT_LOOPBACK))
+			{
+				value = (uint32_t)Slcan_Nibble(line[1]);
+
+				if(!slcan->Open)
+				{
+					ok = ((!backend) || (!backend->Open) || backend->Open(slcan->Channel, (Slcan_Mode_t)value));
+					slcan->Open = ok;
+				}
+				else
+				{
+					//Running bus restarts in the new mode, captured frames are kept
+					ok = ((!backend) || (!backend->SetMode) || backend->SetMode(slcan->Channel, (Slcan_Mode_t)value));
+				}
+			}
+		}
+		break;
+
+		case 'y':
+		{
+			if((length == 2) && (slcan->Open) && ((line[1] == '0') || (line[1] == '1')))
+			{
+				ok = ((!backend) || (!backend->SetLoadTest) || backend->SetLoadTest(slcan->Channel, (line[1] == '1')));
+			}
+		}
+		break;
+
+		case 'C':
+		{
+			if(length == 1)
+			{
+				if((backend) && (backend->Close))
+				{
+					backend->Close(slcan->Channel);
+				}
+				slcan->Open = false;
+				ok = true;
+			}
+		}
+		break;
+
+		case 'S':
+		{
+			if((length == 2) && (!slcan->Open))
+			{
+				value = (uint32_t)Slcan_Nibble(line[1]);
+
+				if(value < (sizeof(slcanBitrates) / sizeof(*slcanBitrates)))
+				{
+					ok = ((!backend) || (!backend->SetBitrate) || backend->SetBitrate(slcan->Channel, slcanBitrates[value]));
+				}
+			}
+		}
+		break;
+
+		case 's':
+		{
+			if((length == 5) && (!slcan->Open) && (Slcan_ParseHex(&line[1], 4, &value)))
+			{
+				ok = ((!backend) || (!backend->SetBtr) || backend->SetBtr(slcan->Channel, (uint8_t)(value >> 8), (uint8_t)value));
+			}
+		}
+		break;
+
+		case 't':
+		case 'T':
+		case 'r':
+		case 'R':
+		{
+			if((slcan->Open) && (Slcan_ParseFrame(line, length, &frame)))
+			{
+				if((!backend) || (!backend->Transmit) || backend->Transmit(slcan->Channel, &frame))
+				{
+					reply[0] = (frame.Flags & CAN_FRAME_FLAG_EXT) ? 'Z' : 'z';
+					reply[1] = SLCAN_CR;
+					Slcan_Reply(txBuffer, reply, 2);
+					return;
+				}
+			}
+		}
+		break;
+
+		case 'F':
+		{
+			if((length == 1) && (slcan->Open))
+			{
+				value = ((backend) && (backend->GetStatus)) ? backend->GetStatus(slcan->Channel) : 0;
+
+				reply[0] = 'F';
+				reply[1] = slcanHex[(value >> 4) & 0xF];
+				reply[2] = slcanHex[value & 0xF];
+				reply[3] = SLCAN_CR;
+				Slcan_Reply(txBuffer, reply, 4);
+				return;
+			}
+		}
+		break;
+
+		case 'k':
+		case 'K':
+		{
+			if(!slcan->Open)
+			{
+				if(length == 1)
+				{
+					ok = ((!backend) || (!backend->SetFilter) || backend->SetFilter(slcan->Channel, NULL));
+				}
+				else if(Slcan_ParseFilter(line, length, &filter))
+				{
+					ok = ((!backend) || (!backend->SetFilter) || backend->SetFilter(slcan->Channel, &filter));
+				}
+			}
+		}
+		break;
+
+		case 'Z':
+		{
+			if((length == 2) && ((line[1] == '0') || (line[1] == '1')))
+			{
+				slcan->Timestamp = (line[1] == '1');
+				ok = true;
+			}
+		}
+		break;
+
+		case 'V':
+		{
+			if(length == 1)
+			{
+				reply[0] = 'V';
+				reply[1] = slcanHex[SLCAN_HW_VERSION >> 4];
+				reply[2] = slcanHex[SLCAN_HW_VERSION & 0xF];
+				reply[3] = slcanHex[SLCAN_SW_VERSION >> 4];
+				reply[4] = slcanHex[SLCAN_SW_VERSION & 0xF];
+				reply[5] = SLCAN_CR;
+				Slcan_Reply(txBuffer, reply, 6);
+				return;
+			}
+		}
+		break;
+
+		case 'N':
+		{
+			if(length == 1)
+			{
+				reply[0] = 'N';
+				reply[1] = slcanHex[(slcan->Serial >> 12) & 0xF];
+				reply[2] = slcanHex[(slcan->Serial >> 8) & 0xF];
+				reply[3] = slcanHex[(slcan->Serial >> 4) & 0xF];
+				reply[4] = slcanHex[slcan->Serial & 0xF];
+				reply[5] = SLCAN_CR;
+				Slcan_Reply(txBuffer, reply, 6);
+				return;
+			}
+		}
+		break;
+
+		default:
+		{
+		}
+		break;
+	}
+
+	Slcan_ReplyStatus(txBuffer, ok);
+}
+
+/*-- Exported functions -----------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Init SLCAN channel state: closed, no timestamps, no backend.
+ *
+ *  @param  slcan - channel state.
+ *  @param  channel - channel number passed to backend.
+ *  @param  serial - serial number reported by N command.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void Slcan_Init(Slcan_t *slcan, uint8_t channel, uint16_t serial)
+{
+	if(slcan)
+	{
+		memset(slcan, 0, sizeof(*slcan));
+		slcan->Channel = channel;
+		slcan->Serial = serial;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Set CAN controller callbacks of SLCAN channel.
+ *
+ *  @param  slcan - channel state.
+ *  @param  backend - callbacks, NULL acknowledges commands without a bus.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void Slcan_SetBackend(Slcan_t *slcan, const Slcan_Backend_t *backend)
+{
+	if(slcan)
+	{
+		slcan->Backend = backend;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Parse and execute command lines from Rx round buffer, put replies
+ *          to Tx round buffer. Lines are scanned in place in the contiguous
+ *          ring region, only a line split by ring wrap is copied. Processing
+ *          stops while Tx buffer cannot hold a reply.
+ *
+ *  @param  slcan - channel state.
+ *  @param  rxBuffer - channel Rx round buffer.
+ *  @param  txBuffer - channel Tx round buffer.
+ *  @param  budget - maximum count of bytes to process.
+ *
+ *  @retval count of processed bytes.
+ *****************************************************************************/
+uint32_t Slcan_Process(Slcan_t *slcan, RoundBuffer_t *rxBuffer, RoundBuffer_t *txBuffer, uint32_t budget)
+{
+	uint32_t processed = 0;
+	bool stalled = false;
+
+	while((processed < budget) && (!stalled))
+	{
+		uint32_t length = 0;
+		uint32_t used = 0;
+		const char *data = (const char *)RoundBuffer_PeekContiguous(rxBuffer, &length);
+
+		if(length == 0)
+		{
+			break;
+		}
+
+		if(length > (budget - processed))
+		{
+			length = budget - processed;
+		}
+
+		while(used < length)
+		{
+			const char *start = &data[used];
+			const char *end;
+			uint32_t lineLength;
+
+			if(RoundBuffer_GetFree(txBuffer) < SLCAN_MAX_REPLY)
+			{
+				stalled = true;
+				break;
+			}
+
+			end = memchr(start, SLCAN_CR, length - used);
+			lineLength = (end) ? (uint32_t)(end - start) : (length - used);
+
+			if((end) && (slcan->LineLength == 0) && (!slcan->LineOverflow))
+			{
+				//Whole line is contiguous: execute in place
+				Slcan_Execute(slcan, start, lineLength, txBuffer);
+			}
+			else
+			{
+				//Line split by ring wrap or budget: collect it
+				if((slcan->LineLength + lineLength) <= SLCAN_MAX_LINE)
+				{
+					memcpy(&slcan->Line[slcan->LineLength], start, lineLength);
+					slcan->LineLength += lineLength;
+				}
+				else
+				{
+					slcan->LineOverflow = true;
+				}
+
+				if(end)
+				{
+					if(slcan->LineOverflow)
+					{
+						Slcan_ReplyStatus(txBuffer, false);
+					}
+					else
+					{
+						Slcan_Execute(slcan, slcan->Line, slcan->LineLength, txBuffer);
+					}
+
+					slcan->LineLength = 0;
+					slcan->LineOverflow = false;
+				}
+			}
+
+			used += lineLength + ((end) ? 1 : 0);
+		}
+
+		RoundBuffer_Consume(rxBuffer, used);
+		processed += used;
+	}
+
+	return processed;
+}
+
+/******************************************************************************
+ *  @brief  Encode received frame to Tx round buffer. Frame line is written
+ *          straight into ring storage when it fits contiguously, otherwise
+ *          it is built on stack and copied.
+ *
+ *  @param  slcan - channel state.
+ *  @param  txBuffer - channel Tx round buffer.
+ *  @param  frame - frame to encode.
+ *
+ *  @retval false if channel is closed or Tx buffer is full.
+ *****************************************************************************/
+bool Slcan_EncodeFrame(Slcan_t *slcan, RoundBuffer_t *txBuffer, const CanFrame_t *frame)
+{
+	uint8_t line[SLCAN_MAX_FRAME_LINE];
+	uint32_t length = 0;
+	uint8_t *out;
+
+	if((!slcan) || (!frame) || (!slcan->Open))
+	{
+		return false;
+	}
+
+	//SLCAN has no error frame format
+	if(frame->Flags & CAN_FRAME_FLAG_ERR)
+	{
+		return true;
+	}
+
+	out = RoundBuffer_GetWriteContiguous(txBuffer, &length);
+
+	if(length >= SLCAN_MAX_FRAME_LINE)
+	{
+		RoundBuffer_Commit(txBuffer, Slcan_FormatFrame(slcan, out, frame));
+		return true;
+	}
+
+	length = Slcan_FormatFrame(slcan, line, frame);
+
+	return (RoundBuffer_AddArray(txBuffer, line, length) == length);
+}
+/*-- EOF --------------------------------------------------------------------*/
@@ -0,0 +1,97 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    Timestamp.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+#include "Timestamp.h"
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+/*-- Project specific includes ----------------------------------------------*/
+#include "tim.h"
+
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+//Upper 32 bits of the microsecond clock, TIM2 overflows
+static volatile uint32_t timestampHigh;
+
+/*-- Local functions --------------------------------------------------------*/
+/*-- Exported functions -----------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Start microsecond clock. Call once after MX_TIM2_Init.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void Timestamp_Init(void)
+{
+	timestampHigh = 0;
+
+	//Update event of HAL_TIM_Base_Init raised the flag, it is not a wrap
+	__HAL_TIM_CLEAR_FLAG(&htim2, TIM_FLAG_UPDATE);
+
+	if(HAL_TIM_Base_Start_IT(&htim2) != HAL_OK)
+	{
+		Error_Handler();
+	}
+}
+
+/******************************************************************************
+ *  @brief  Get microseconds since Timestamp_Init. Safe in any context: an
+ *          overflow not yet counted by the update interrupt (caller is an
+ *          ISR or has interrupts masked) is detected by the pending flag.
+ *
+ *  @param  None.
+ *
+ *  @retval time, microseconds.
+ *****************************************************************************/
+uint64_t Timestamp_Get(void)
+{
+	uint32_t high;
+	uint32_t low;
+	uint32_t pending;
+
+	do
+	{
+		high = timestampHigh;
+		//Counter first: a flag raised after it belongs to a later wrap
+		low = TIM2->CNT;
+		pending = TIM2->SR & TIM_SR_UIF;
+	}
+	while(high != timestampHigh);
+
+	if((pending) && (low < 0x80000000U))
+	{
+		high++;
+	}
+
+	return ((uint64_t)high << 32) | low;
+}
+
+/******************************************************************************
+ *  @brief  TIM2 update interrupt: counter wrapped.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void Timestamp_IrqHandler(void)
+{
+	if(TIM2->SR & TIM_SR_UIF)
+	{
+		TIM2->SR = ~TIM_SR_UIF;
+		timestampHigh++;
+	}
+}
+
+/*-- EOF --------------------------------------------------------------------*/
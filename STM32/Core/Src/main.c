@@ -19,6 +19,8 @@
 /* USER CODE END Header */
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
+#include "can.h"
+#include "tim.h"
 #include "usart.h"
 #include "usb_device.h"
 #include "gpio.h"
@@ -26,6 +28,9 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "usbd_vcp.h"
+#include "usbd_gsusb.h"
+#include "CanCapture.h"
+#include "Timestamp.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -87,9 +92,15 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_CAN1_Init();
+  MX_CAN2_Init();
+  MX_TIM2_Init();
   MX_USART2_UART_Init();
   MX_USB_DEVICE_Init();
   /* USER CODE BEGIN 2 */
+  Timestamp_Init();
+  USB_VCP_Init();
+  CanCapture_Init();
 
   /* USER CODE END 2 */
 
@@ -100,6 +111,10 @@ int main(void)
     /* USER CODE END WHILE */
     USB_VCP_Run();
     /* USER CODE BEGIN 3 */
+    CanCapture_Run();
+#if (USBD_GSUSB_ENABLE == 1)
+    USBD_GS_Run();
+#endif
   }
   /* USER CODE END 3 */
 }
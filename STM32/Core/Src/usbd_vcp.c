@@ -9,46 +9,483 @@
 #include "usbd_vcp.h"
 
 /*-- Standard C/C++ Libraries -----------------------------------------------*/
+#include <string.h>
+
 /*-- Other libraries --------------------------------------------------------*/
 #include "RoundBuffer.h"
 /*-- Hardware specific libraries --------------------------------------------*/
 /*-- Project specific includes ----------------------------------------------*/
 #include "usbd_cdc.h"
 #include "usbd_cdc_if.h"
+#include "usbd_vendor.h"
 /*-- Imported functions -----------------------------------------------------*/
 /*-- Local Macro Definitions ------------------------------------------------*/
-/*-- Local variables --------------------------------------------------------*/
-#if (NUM_OF_CDC_UARTS > 1)
-uint8_t _usb_cdc1_TxBuff[512] = { 0 };
-RoundBuffer_t USB_CDC1_TxBuffer[] = {_usb_cdc1_TxBuff, sizeof(_usb_cdc1_TxBuff), 0, 0};
-uint8_t _usb_cdc1_RxBuff[512] = { 0 };
-RoundBuffer_t USB_CDC1_RxBuffer[] = {_usb_cdc1_RxBuff, sizeof(_usb_cdc1_RxBuff), 0, 0};
+//Bulk IN and OUT max packet size
+#if defined (USE_OTG_FS)
+#define USB_VCP_TX_PACKET_SIZE			CDC_DATA_FS_MAX_PACKET_SIZE
+#define USB_VCP_RX_PACKET_SIZE			CDC_DATA_FS_OUT_PACKET_SIZE
+#endif
+#if defined (USE_OTG_HS)
+#define USB_VCP_TX_PACKET_SIZE			CDC_DATA_HS_MAX_PACKET_SIZE
+#define USB_VCP_RX_PACKET_SIZE			CDC_DATA_HS_OUT_PACKET_SIZE
+#endif
+
+#if ((USB_VCP_TX_TRANSFER_SIZE % USB_VCP_TX_PACKET_SIZE) != 0) || (USB_VCP_TX_TRANSFER_SIZE > 0xFFFF)
+#error "USB_VCP_TX_TRANSFER_SIZE must be a multiple of max packet size and fit CDC_Transmit length"
+#endif
+
+#if (USB_VCP_PROFILE == 1)
+#define USB_VCP_PROFILE_START()			uint32_t profileStart = DWT->CYCCNT
+#define USB_VCP_PROFILE_STOP(max)		do { uint32_t cycles = DWT->CYCCNT - profileStart; if(cycles > (max)) { (max) = cycles; } } while(0)
+#else
+#define USB_VCP_PROFILE_START()
+#define USB_VCP_PROFILE_STOP(max)
+#endif
+
+#if (NUM_OF_CDC_UARTS > 0)
+#ifndef USB_VCP_CDC1_TX_BUFFER_SIZE
+#define USB_VCP_CDC1_TX_BUFFER_SIZE		USB_VCP_TX_BUFFER_SIZE
+#endif
+#ifndef USB_VCP_CDC1_RX_BUFFER_SIZE
+#define USB_VCP_CDC1_RX_BUFFER_SIZE		USB_VCP_RX_BUFFER_SIZE
+#endif
+#ifndef USB_VCP_CDC1_WEIGHT
+#define USB_VCP_CDC1_WEIGHT				USB_VCP_WEIGHT
+#endif
+#if !ROUND_BUFFER_IS_POW2(USB_VCP_CDC1_TX_BUFFER_SIZE) || !ROUND_BUFFER_IS_POW2(USB_VCP_CDC1_RX_BUFFER_SIZE)
+#error "USB_VCP_CDC1 buffer sizes must be powers of two"
+#endif
+#if (USB_VCP_CDC1_RX_BUFFER_SIZE < USB_VCP_RX_PACKET_SIZE)
+#error "USB_VCP_CDC1_RX_BUFFER_SIZE must hold one OUT packet"
+#endif
 #endif
 
 #if (NUM_OF_CDC_UARTS > 1)
-uint8_t _usb_cdc2_TxBuff[512] = { 0 };
-RoundBuffer_t USB_CDC2_TxBuffer[] = {_usb_cdc2_TxBuff, sizeof(_usb_cdc2_TxBuff), 0, 0};
-uint8_t _usb_cdc2_RxBuff[512] = { 0 };
-RoundBuffer_t USB_CDC2_RxBuffer[] = {_usb_cdc2_RxBuff, sizeof(_usb_cdc2_RxBuff), 0, 0};
+#ifndef USB_VCP_CDC2_TX_BUFFER_SIZE
+#define USB_VCP_CDC2_TX_BUFFER_SIZE		USB_VCP_TX_BUFFER_SIZE
+#endif
+#ifndef USB_VCP_CDC2_RX_BUFFER_SIZE
+#define USB_VCP_CDC2_RX_BUFFER_SIZE		USB_VCP_RX_BUFFER_SIZE
+#endif
+#ifndef USB_VCP_CDC2_WEIGHT
+#define USB_VCP_CDC2_WEIGHT				USB_VCP_WEIGHT
+#endif
+#if !ROUND_BUFFER_IS_POW2(USB_VCP_CDC2_TX_BUFFER_SIZE) || !ROUND_BUFFER_IS_POW2(USB_VCP_CDC2_RX_BUFFER_SIZE)
+#error "USB_VCP_CDC2 buffer sizes must be powers of two"
+#endif
+#if (USB_VCP_CDC2_RX_BUFFER_SIZE < USB_VCP_RX_PACKET_SIZE)
+#error "USB_VCP_CDC2_RX_BUFFER_SIZE must hold one OUT packet"
+#endif
 #endif
 
 #if (NUM_OF_CDC_UARTS > 2)
-uint8_t _usb_cdc3_TxBuff[512] = { 0 };
-RoundBuffer_t USB_CDC3_TxBuffer[] = {_usb_cdc3_TxBuff, sizeof(_usb_cdc3_TxBuff), 0, 0};
-uint8_t _usb_cdc3_RxBuff[512] = { 0 };
-RoundBuffer_t USB_CDC3_RxBuffer[] = {_usb_cdc3_RxBuff, sizeof(_usb_cdc3_RxBuff), 0, 0};
+#ifndef USB_VCP_CDC3_TX_BUFFER_SIZE
+#define USB_VCP_CDC3_TX_BUFFER_SIZE		USB_VCP_TX_BUFFER_SIZE
+#endif
+#ifndef USB_VCP_CDC3_RX_BUFFER_SIZE
+#define USB_VCP_CDC3_RX_BUFFER_SIZE		USB_VCP_RX_BUFFER_SIZE
+#endif
+#ifndef USB_VCP_CDC3_WEIGHT
+#define USB_VCP_CDC3_WEIGHT				USB_VCP_WEIGHT
+#endif
+#if !ROUND_BUFFER_IS_POW2(USB_VCP_CDC3_TX_BUFFER_SIZE) || !ROUND_BUFFER_IS_POW2(USB_VCP_CDC3_RX_BUFFER_SIZE)
+#error "USB_VCP_CDC3 buffer sizes must be powers of two"
+#endif
+#if (USB_VCP_CDC3_RX_BUFFER_SIZE < USB_VCP_RX_PACKET_SIZE)
+#error "USB_VCP_CDC3_RX_BUFFER_SIZE must hold one OUT packet"
+#endif
 #endif
 
 #if (NUM_OF_CDC_UARTS > 3)
-uint8_t _usb_cdc4_TxBuff[512] = { 0 };
-RoundBuffer_t USB_CDC4_TxBuffer[] = {_usb_cdc4_TxBuff, sizeof(_usb_cdc4_TxBuff), 0, 0};
-uint8_t _usb_cdc4_RxBuff[512] = { 0 };
-RoundBuffer_t USB_CDC4_RxBuffer[] = {_usb_cdc4_RxBuff, sizeof(_usb_cdc4_RxBuff), 0, 0};
+#ifndef USB_VCP_CDC4_TX_BUFFER_SIZE
+#define USB_VCP_CDC4_TX_BUFFER_SIZE		USB_VCP_TX_BUFFER_SIZE
+#endif
+#ifndef USB_VCP_CDC4_RX_BUFFER_SIZE
+#define USB_VCP_CDC4_RX_BUFFER_SIZE		USB_VCP_RX_BUFFER_SIZE
+#endif
+#ifndef USB_VCP_CDC4_WEIGHT
+#define USB_VCP_CDC4_WEIGHT				USB_VCP_WEIGHT
+#endif
+#if !ROUND_BUFFER_IS_POW2(USB_VCP_CDC4_TX_BUFFER_SIZE) || !ROUND_BUFFER_IS_POW2(USB_VCP_CDC4_RX_BUFFER_SIZE)
+#error "USB_VCP_CDC4 buffer sizes must be powers of two"
+#endif
+#if (USB_VCP_CDC4_RX_BUFFER_SIZE < USB_VCP_RX_PACKET_SIZE)
+#error "USB_VCP_CDC4_RX_BUFFER_SIZE must hold one OUT packet"
+#endif
+#endif
+
+#if (USBD_VENDOR_ENABLE == 1)
+//Capture stream: deeper Tx ring, so USB keeps two transfers queued
+#ifndef USB_VCP_VENDOR_TX_BUFFER_SIZE
+#define USB_VCP_VENDOR_TX_BUFFER_SIZE	(2 * USB_VCP_TX_BUFFER_SIZE)
+#endif
+#ifndef USB_VCP_VENDOR_RX_BUFFER_SIZE
+#define USB_VCP_VENDOR_RX_BUFFER_SIZE	USB_VCP_RX_BUFFER_SIZE
+#endif
+#ifndef USB_VCP_VENDOR_WEIGHT
+#define USB_VCP_VENDOR_WEIGHT			USB_VCP_WEIGHT
+#endif
+#if !ROUND_BUFFER_IS_POW2(USB_VCP_VENDOR_TX_BUFFER_SIZE) || !ROUND_BUFFER_IS_POW2(USB_VCP_VENDOR_RX_BUFFER_SIZE)
+#error "USB_VCP_VENDOR buffer sizes must be powers of two"
+#endif
+#if (USB_VCP_VENDOR_RX_BUFFER_SIZE < USB_VCP_RX_PACKET_SIZE)
+#error "USB_VCP_VENDOR_RX_BUFFER_SIZE must hold one OUT packet"
+#endif
+#endif
+
+//One entry of usbVcpChannels
+#if (USB_VCP_SLCAN == 1)
+#define USB_VCP_CHANNEL(n)				{ .InterfaceNumber = CDC_ITF_NUMBER_##n, .Port = &usbVcpCdcPort, .RxBuffer = USB_CDC##n##_RxBuffer, .TxBuffer = USB_CDC##n##_TxBuffer, \
+										  .Weight = USB_VCP_CDC##n##_WEIGHT, .Process = USB_VCP_Slcan, .Context = &usbVcpSlcan[(n) - 1] }
+#else
+#define USB_VCP_CHANNEL(n)				{ .InterfaceNumber = CDC_ITF_NUMBER_##n, .Port = &usbVcpCdcPort, .RxBuffer = USB_CDC##n##_RxBuffer, .TxBuffer = USB_CDC##n##_TxBuffer, \
+										  .Weight = USB_VCP_CDC##n##_WEIGHT, .Process = USB_VCP_Echo }
 #endif
 
+//CDC channels follow host DTR, vendor interface has no control lines
+#define USB_VCP_IS_GATED(channel)		((USB_VCP_DTR_GATING == 1) && ((channel)->Port == &usbVcpCdcPort))
+
 /*-- Local function prototypes ----------------------------------------------*/
+#if (USB_VCP_SLCAN == 1)
+static uint32_t USB_VCP_Slcan(void *context, RoundBuffer_t *rxBuffer, RoundBuffer_t *txBuffer, uint32_t budget);
+#else
+static uint32_t USB_VCP_Echo(void *context, RoundBuffer_t *rxBuffer, RoundBuffer_t *txBuffer, uint32_t budget);
+#endif
+#if (USBD_VENDOR_ENABLE == 1)
+static uint32_t USB_VCP_Vendor(void *context, RoundBuffer_t *rxBuffer, RoundBuffer_t *txBuffer, uint32_t budget);
+#endif
+
+/*-- Local variables --------------------------------------------------------*/
+#if (NUM_OF_CDC_UARTS > 0)
+__ALIGN_BEGIN uint8_t _usb_cdc1_TxBuff[USB_VCP_CDC1_TX_BUFFER_SIZE] __ALIGN_END = { 0 };
+RoundBuffer_t USB_CDC1_TxBuffer[] = { ROUND_BUFFER_INIT(_usb_cdc1_TxBuff) };
+uint8_t _usb_cdc1_RxBuff[USB_VCP_CDC1_RX_BUFFER_SIZE] = { 0 };
+RoundBuffer_t USB_CDC1_RxBuffer[] = { ROUND_BUFFER_INIT(_usb_cdc1_RxBuff) };
+#endif
+
+#if (NUM_OF_CDC_UARTS > 1)
+__ALIGN_BEGIN uint8_t _usb_cdc2_TxBuff[USB_VCP_CDC2_TX_BUFFER_SIZE] __ALIGN_END = { 0 };
+RoundBuffer_t USB_CDC2_TxBuffer[] = { ROUND_BUFFER_INIT(_usb_cdc2_TxBuff) };
+uint8_t _usb_cdc2_RxBuff[USB_VCP_CDC2_RX_BUFFER_SIZE] = { 0 };
+RoundBuffer_t USB_CDC2_RxBuffer[] = { ROUND_BUFFER_INIT(_usb_cdc2_RxBuff) };
+#endif
+
+#if (NUM_OF_CDC_UARTS > 2)
+__ALIGN_BEGIN uint8_t _usb_cdc3_TxBuff[USB_VCP_CDC3_TX_BUFFER_SIZE] __ALIGN_END = { 0 };
+RoundBuffer_t USB_CDC3_TxBuffer[] = { ROUND_BUFFER_INIT(_usb_cdc3_TxBuff) };
+uint8_t _usb_cdc3_RxBuff[USB_VCP_CDC3_RX_BUFFER_SIZE] = { 0 };
+RoundBuffer_t USB_CDC3_RxBuffer[] = { ROUND_BUFFER_INIT(_usb_cdc3_RxBuff) };
+#endif
+
+#if (NUM_OF_CDC_UARTS > 3)
+__ALIGN_BEGIN uint8_t _usb_cdc4_TxBuff[USB_VCP_CDC4_TX_BUFFER_SIZE] __ALIGN_END = { 0 };
+RoundBuffer_t USB_CDC4_TxBuffer[] = { ROUND_BUFFER_INIT(_usb_cdc4_TxBuff) };
+uint8_t _usb_cdc4_RxBuff[USB_VCP_CDC4_RX_BUFFER_SIZE] = { 0 };
+RoundBuffer_t USB_CDC4_RxBuffer[] = { ROUND_BUFFER_INIT(_usb_cdc4_RxBuff) };
+#endif
+
+#if (USBD_VENDOR_ENABLE == 1)
+__ALIGN_BEGIN uint8_t _usb_vendor_TxBuff[USB_VCP_VENDOR_TX_BUFFER_SIZE] __ALIGN_END = { 0 };
+RoundBuffer_t USB_VENDOR_TxBuffer[] = { ROUND_BUFFER_INIT(_usb_vendor_TxBuff) };
+uint8_t _usb_vendor_RxBuff[USB_VCP_VENDOR_RX_BUFFER_SIZE] = { 0 };
+RoundBuffer_t USB_VENDOR_RxBuffer[] = { ROUND_BUFFER_INIT(_usb_vendor_RxBuff) };
+#endif
+
+//Endpoint drivers
+static const USB_VCP_Port_t usbVcpCdcPort = { CDC_Transmit, CDC_CheckTransmitAvailable, CDC_ReceiveResume, CDC_SendSerialState };
+#if (USBD_VENDOR_ENABLE == 1)
+static const USB_VCP_Port_t usbVcpVendorPort = { VENDOR_Transmit, VENDOR_CheckTransmitAvailable, VENDOR_ReceiveResume, NULL };
+#endif
+
+#if (USB_VCP_SLCAN == 1)
+//SLCAN state of CDC channels, index is CDC_ITF_NUMBER_n - 1
+static Slcan_t usbVcpSlcan[NUM_OF_CDC_UARTS];
+#endif
+
+//Channel descriptors, index is interface number - 1, serviced in weighted
+//round robin by USB_VCP_Run
+static USB_VCP_Channel_t usbVcpChannels[USB_VCP_NUM_CHANNELS] =
+{
+#if (NUM_OF_CDC_UARTS > 0)
+	USB_VCP_CHANNEL(1),
+#endif
+#if (NUM_OF_CDC_UARTS > 1)
+	USB_VCP_CHANNEL(2),
+#endif
+#if (NUM_OF_CDC_UARTS > 2)
+	USB_VCP_CHANNEL(3),
+#endif
+#if (NUM_OF_CDC_UARTS > 3)
+	USB_VCP_CHANNEL(4),
+#endif
+#if (USBD_VENDOR_ENABLE == 1)
+	{ .InterfaceNumber = VENDOR_ITF_NUMBER, .Port = &usbVcpVendorPort, .RxBuffer = USB_VENDOR_RxBuffer, .TxBuffer = USB_VENDOR_TxBuffer,
+	  .Weight = USB_VCP_VENDOR_WEIGHT, .Process = USB_VCP_Vendor },
+#endif
+};
+
+//Channel which opens the next round
+static uint32_t usbVcpNextChannel = 0;
+
+static USB_VCP_Stats_t usbVcpStats = { 0 };
+
 /*-- Local functions --------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Find channel descriptor by CDC interface number.
+ *
+ *  @param  interfaceNumber - CDC interface number.
+ *
+ *  @retval pointer to channel, NULL if interface is unknown.
+ *****************************************************************************/
+static USB_VCP_Channel_t *USB_VCP_GetChannel(uint8_t interfaceNumber)
+{
+	//Channels are laid out in interface number order starting from 1
+	if((interfaceNumber == 0) || (interfaceNumber > USB_VCP_NUM_CHANNELS))
+	{
+		return NULL;
+	}
+
+	return &usbVcpChannels[interfaceNumber - 1];
+}
+
+#if (USB_VCP_SLCAN == 0)
+/******************************************************************************
+ *  @brief  CDC channel handler without SLCAN: echo received data back to host.
+ *
+ *  @param  context - not used.
+ *  @param  rxBuffer - channel Rx round buffer.
+ *  @param  txBuffer - channel Tx round buffer.
+ *  @param  budget - maximum count of bytes to process.
+ *
+ *  @retval count of processed bytes.
+ *****************************************************************************/
+static uint32_t USB_VCP_Echo(void *context, RoundBuffer_t *rxBuffer, RoundBuffer_t *txBuffer, uint32_t budget)
+{
+	uint32_t rxDataLength = 0;
+	uint8_t *rxData = NULL;
+	uint32_t txFree;
+
+	rxData = RoundBuffer_PeekContiguous(rxBuffer, &rxDataLength);
+
+	txFree = RoundBuffer_GetFree(txBuffer);
+	if(rxDataLength > txFree)
+	{
+		rxDataLength = txFree;
+	}
+	if(rxDataLength > budget)
+	{
+		rxDataLength = budget;
+	}
+
+	rxDataLength = RoundBuffer_AddArray(txBuffer, rxData, rxDataLength);
+	RoundBuffer_Consume(rxBuffer, rxDataLength);
+
+	return rxDataLength;
+}
+#endif
+
+#if (USBD_VENDOR_ENABLE == 1)
+/******************************************************************************
+ *  @brief  Vendor channel handler: the interface only streams frames to host,
+ *          see USB_VCP_VendorSendFrame. Host data is discarded so the OUT
+ *          endpoint never stays paused.
+ *
+ *  @param  context - not used.
+ *  @param  rxBuffer - channel Rx round buffer.
+ *  @param  txBuffer - not used.
+ *  @param  budget - maximum count of bytes to process.
+ *
+ *  @retval count of processed bytes.
+ *****************************************************************************/
+static uint32_t USB_VCP_Vendor(void *context, RoundBuffer_t *rxBuffer, RoundBuffer_t *txBuffer, uint32_t budget)
+{
+	uint32_t rxDataLength = RoundBuffer_GetLoad(rxBuffer);
+
+	(void)context;
+	(void)txBuffer;
+
+	if(rxDataLength > budget)
+	{
+		rxDataLength = budget;
+	}
+
+	RoundBuffer_Consume(rxBuffer, rxDataLength);
+
+	return rxDataLength;
+}
+#endif
+
+#if (USB_VCP_SLCAN == 1)
+/******************************************************************************
+ *  @brief  CDC channel handler: SLCAN command lines.
+ *
+ *  @param  context - channel Slcan_t.
+ *  @param  rxBuffer - channel Rx round buffer.
+ *  @param  txBuffer - channel Tx round buffer.
+ *  @param  budget - maximum count of bytes to process.
+ *
+ *  @retval count of processed bytes.
+ *****************************************************************************/
+static uint32_t USB_VCP_Slcan(void *context, RoundBuffer_t *rxBuffer, RoundBuffer_t *txBuffer, uint32_t budget)
+{
+	return Slcan_Process((Slcan_t *)context, rxBuffer, txBuffer, budget);
+}
+#endif
+
+/******************************************************************************
+ *  @brief  Start IN transfer straight from channel Tx round buffer.
+ *          Must be called from USB ISR context or with interrupts disabled.
+ *
+ *  @param  channel - channel descriptor.
+ *  @param  flush - true to send data shorter than one max packet.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void USB_VCP_StartTransmit(USB_VCP_Channel_t *channel, bool flush)
+{
+	uint32_t txDataLength = 0;
+	uint8_t *txData = NULL;
+
+	//Nobody reads a closed port, keep IN pipe idle
+	if(!channel->HostOpen)
+	{
+		return;
+	}
+
+	//Coalescing: keep a partial packet until SOF flush
+	if((!flush) && (RoundBuffer_GetLoad(channel->TxBuffer) < USB_VCP_TX_PACKET_SIZE))
+	{
+		return;
+	}
+
+	txData = RoundBuffer_PeekContiguous(channel->TxBuffer, &txDataLength);
+	if(txDataLength > 0)
+	{
+		if(txDataLength > USB_VCP_TX_TRANSFER_SIZE)
+		{
+			txDataLength = USB_VCP_TX_TRANSFER_SIZE;
+		}
+
+		if(channel->Port->Transmit(txData, txDataLength, channel->InterfaceNumber) == USBD_OK)
+		{
+			channel->SofAge = 0;
+
+			usbVcpStats.TxTransfers++;
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  Change host side state of a gated channel (USB ISR). Backlog left
+ *          from the previous session is dropped on open. Ring storage of a
+ *          transfer in flight is dropped on its completion instead.
+ *
+ *  @param  channel - channel descriptor.
+ *  @param  open - true if host opened the port.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void USB_VCP_SetHostOpen(USB_VCP_Channel_t *channel, bool open)
+{
+	if((open) && (!channel->HostOpen))
+	{
+		if(channel->Port->TransmitAvailable(channel->InterfaceNumber))
+		{
+			RoundBuffer_Clear(channel->TxBuffer);
+		}
+		else
+		{
+			channel->TxFlush = true;
+		}
+	}
+
+	channel->HostOpen = open;
+}
+
+/******************************************************************************
+ *  @brief  Reset host side state of all channels: gated channels wait for
+ *          DTR, others stream right away.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void USB_VCP_ResetHostState(void)
+{
+	uint32_t index;
+
+	for(index = 0; index < USB_VCP_NUM_CHANNELS; index++)
+	{
+		usbVcpChannels[index].TxFlush = false;
+		usbVcpChannels[index].HostOpen = !USB_VCP_IS_GATED(&usbVcpChannels[index]);
+	}
+}
+
 /*-- Exported functions -----------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Init VCP data path. Call once after MX_USB_DEVICE_Init.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void USB_VCP_Init(void)
+{
+#if (USB_VCP_SLCAN == 1)
+	uint32_t index;
+
+	for(index = 0; index < NUM_OF_CDC_UARTS; index++)
+	{
+		Slcan_Init(&usbVcpSlcan[index], (uint8_t)index, (uint16_t)HAL_GetUIDw0());
+	}
+#endif
+
+#if (USB_VCP_PROFILE == 1)
+	//Enable DWT cycle counter for profiling
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+	USB_VCP_ResetHostState();
+	USB_VCP_ResetStats();
+}
+
+/******************************************************************************
+ *  @brief  Get data path counters.
+ *
+ *  @param  stats - pointer to statistics read to.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void USB_VCP_GetStats(USB_VCP_Stats_t *stats)
+{
+	if(stats)
+	{
+		uint32_t elapsed = HAL_GetTick() - usbVcpStats.StartTick;
+
+		*stats = usbVcpStats;
+
+		if(elapsed > 0)
+		{
+			stats->TxBytesPerSecond = (uint32_t)(((uint64_t)stats->TxBytes * 1000U) / elapsed);
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  Reset data path counters.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void USB_VCP_ResetStats(void)
+{
+	memset(&usbVcpStats, 0, sizeof(usbVcpStats));
+	usbVcpStats.StartTick = HAL_GetTick();
+}
+
 /******************************************************************************
  *  @brief  Function
  *
@@ -58,7 +495,8 @@ RoundBuffer_t USB_CDC4_RxBuffer[] = {_usb_cdc4_RxBuff, sizeof(_usb_cdc4_RxBuff),
  *****************************************************************************/
 int8_t USB_VCP_ConfigCallback(uint8_t cmd, uint8_t* pbuf, uint16_t length, uint8_t interfaceNumber)
 {
-	static uint8_t tempSettBuff[7] = { 0 };
+	//115200 8N1 until host sets its own line coding
+	static uint8_t tempSettBuff[7] = { 0x00, 0xC2, 0x01, 0x00, 0x00, 0x00, 0x08 };
 	
   switch(cmd)
   {
@@ -112,7 +550,16 @@ int8_t USB_VCP_ConfigCallback(uint8_t cmd, uint8_t* pbuf, uint16_t length, uint8
     break;
 
     case CDC_SET_CONTROL_LINE_STATE:
+	{
+		//Request is passed in place of data, wValue bit 0 is DTR
+		USB_VCP_Channel_t *channel = USB_VCP_GetChannel(interfaceNumber);
+		USBD_SetupReqTypedef *req = (USBD_SetupReqTypedef *)pbuf;
 
+		if((channel) && (USB_VCP_IS_GATED(channel)))
+		{
+			USB_VCP_SetHostOpen(channel, ((req->wValue & CDC_CONTROL_LINE_DTR) != 0));
+		}
+	}
     break;
 
     case CDC_SEND_BREAK:
@@ -135,44 +582,17 @@ int8_t USB_VCP_ConfigCallback(uint8_t cmd, uint8_t* pbuf, uint16_t length, uint8
  *****************************************************************************/
 void USB_VCP_SendData(uint8_t *buffer, uint16_t length, uint8_t interfaceNumber)
 {
-	switch (interfaceNumber)
-	{
-#if (NUM_OF_CDC_UARTS > 0)
-		case CDC_ITF_NUMBER_1:
-		{
-			RoundBuffer_AddArray(USB_CDC1_TxBuffer, buffer, length);
-		}
-		break;
-#endif
-		
-#if (NUM_OF_CDC_UARTS > 1)
-		case CDC_ITF_NUMBER_2:
-		{
-			RoundBuffer_AddArray(USB_CDC2_TxBuffer, buffer, length);
-		}
-		break;
-#endif
+	USB_VCP_Channel_t *channel = USB_VCP_GetChannel(interfaceNumber);
 
-#if (NUM_OF_CDC_UARTS > 2)
-		case CDC_ITF_NUMBER_3:
+	if(channel)
+	{
+		if(!channel->HostOpen)
 		{
-			RoundBuffer_AddArray(USB_CDC3_TxBuffer, buffer, length);
+			usbVcpStats.GatedBytes += length;
+			return;
 		}
-		break;
-#endif
 
-#if (NUM_OF_CDC_UARTS > 3)
-		case CDC_ITF_NUMBER_4:
-		{
-			RoundBuffer_AddArray(USB_CDC4_TxBuffer, buffer, length);
-		}
-		break;
-#endif
-		
-		default:
-		{
-		}
-		break;
+		RoundBuffer_AddArray(channel->TxBuffer, buffer, length);
 	}
 }
 
@@ -232,53 +652,86 @@ void USB_VCP_IF4_SendData(uint8_t *buffer, uint16_t length)
 #endif
 
 /******************************************************************************
- *  @brief  Function
+ *  @brief  CDC interface init callback (USB ISR): every OUT endpoint is
+ *          armed again by CDC_Init. New configuration starts with ports
+ *          closed until host sets DTR.
  *
  *  @param  None.
  *
  *  @retval None.
  *****************************************************************************/
-void USB_VCP_DataReceivedCallback(uint8_t* buffer, uint16_t length, uint8_t interfaceNumber)
+void USB_VCP_InitCallback(void)
 {
-	switch (interfaceNumber)
+	uint32_t index;
+
+	for(index = 0; index < USB_VCP_NUM_CHANNELS; index++)
 	{
-#if (NUM_OF_CDC_UARTS > 0)
-		case CDC_ITF_NUMBER_1:
-		{
-			RoundBuffer_AddArray(USB_CDC1_RxBuffer, buffer, length);
-		}
-		break;
-#endif
-		
-#if (NUM_OF_CDC_UARTS > 1)
-		case CDC_ITF_NUMBER_2:
-		{
-			RoundBuffer_AddArray(USB_CDC2_RxBuffer, buffer, length);
-		}
-		break;
-#endif
+		usbVcpChannels[index].RxPaused = false;
+	}
 
-#if (NUM_OF_CDC_UARTS > 2)
-		case CDC_ITF_NUMBER_3:
+	USB_VCP_ResetHostState();
+}
+
+/******************************************************************************
+ *  @brief  Check if OUT endpoint may be armed for one more packet (USB ISR).
+ *          Called before the received packet is stored, so the Rx round
+ *          buffer must fit both of them. If not, channel is paused and
+ *          endpoint is armed later from USB_VCP_Run.
+ *
+ *  @param  interfaceNumber - CDC interface number.
+ *  @param  pending - count of received bytes not stored yet.
+ *
+ *  @retval true if OUT endpoint may be armed now.
+ *****************************************************************************/
+bool USB_VCP_ReceiveCredit(uint8_t interfaceNumber, uint32_t pending)
+{
+	USB_VCP_Channel_t *channel = USB_VCP_GetChannel(interfaceNumber);
+	bool result = true;
+
+	if(channel)
+	{
+		if(RoundBuffer_GetFree(channel->RxBuffer) < (pending + USB_VCP_RX_PACKET_SIZE))
 		{
-			RoundBuffer_AddArray(USB_CDC3_RxBuffer, buffer, length);
+			channel->RxPaused = true;
+			result = false;
 		}
-		break;
-#endif
+	}
 
-#if (NUM_OF_CDC_UARTS > 3)
-		case CDC_ITF_NUMBER_4:
+	return result;
+}
+
+/******************************************************************************
+ *  @brief  OUT packet received callback (USB ISR). Stores packet to channel
+ *          Rx round buffer.
+ *
+ *  @param  buffer - pointer to received data.
+ *  @param  length - count of received bytes.
+ *  @param  interfaceNumber - CDC interface number.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void USB_VCP_DataReceivedCallback(uint8_t* buffer, uint16_t length, uint8_t interfaceNumber)
+{
+	USB_VCP_Channel_t *channel = USB_VCP_GetChannel(interfaceNumber);
+
+	USB_VCP_PROFILE_START();
+
+	usbVcpStats.RxBytes += length;
+
+	if(channel)
+	{
+#if (USB_VCP_DATA_OPENS_PORT == 1)
+		//Some terminals never set DTR: a host which writes also reads
+		if((!channel->HostOpen) && (USB_VCP_IS_GATED(channel)))
 		{
-			RoundBuffer_AddArray(USB_CDC4_RxBuffer, buffer, length);
+			USB_VCP_SetHostOpen(channel, true);
 		}
-		break;
 #endif
-		
-		default:
-		{
-		}
-		break;
+
+		RoundBuffer_AddArray(channel->RxBuffer, buffer, length);
 	}
+
+	USB_VCP_PROFILE_STOP(usbVcpStats.RxCyclesMax);
 }
 
 /******************************************************************************
@@ -306,139 +759,338 @@ void USB_VCP_CableDisconnected(PCD_HandleTypeDef *hpcd)
 }
 
 /******************************************************************************
- *  @brief  Function
+ *  @brief  Transmit complete callback. Releases the sent bytes from the
+ *          Tx round buffer (USB core transmits straight from ring storage)
+ *          and starts the next transfer if data is pending.
  *
- *  @param  None.
+ *  @param  buffer - pointer to sent data.
+ *  @param  length - count of sent bytes.
+ *  @param  interfaceNumber - CDC interface number.
  *
  *  @retval None.
  *****************************************************************************/
-void USB_VCP_Run(void)
-{	
-	uint16_t rxDataLength = 0;
-	uint16_t txDataLength = 0;
-#if defined (USE_OTG_FS)
-  static uint8_t dataTxBuffer[CDC_DATA_FS_MAX_PACKET_SIZE];
-#endif
-#if defined (USE_OTG_HS)
-  static uint8_t dataTxBuffer[CDC_DATA_HS_MAX_PACKET_SIZE];
-#endif
-	
+void USB_VCP_TransmitCompleteCallback(uint8_t* buffer, uint32_t length, uint8_t interfaceNumber)
+{
+	USB_VCP_Channel_t *channel = USB_VCP_GetChannel(interfaceNumber);
 
-#if (NUM_OF_CDC_UARTS > 0)
-	//Parsing of received data
-	rxDataLength = RoundBuffer_GetLoad(USB_CDC1_RxBuffer);
-	if(rxDataLength > 0)
-	{	
-		for(uint16_t i = 0; i < rxDataLength; i++)
+	USB_VCP_PROFILE_START();
+
+	//Chain the next transfer right from the ISR so IN pipe stays busy,
+	//main loop only refills the ring
+	//Sent length may be shorter than requested (DMA bounce copy)
+	usbVcpStats.TxBytes += length;
+
+	if(channel)
+	{
+		if(channel->TxFlush)
 		{
-			RoundBuffer_AddByte(USB_CDC1_TxBuffer, RoundBuffer_GetByte(USB_CDC1_RxBuffer));
+			//Port was opened meanwhile, rest of the ring is stale too
+			channel->TxFlush = false;
+			RoundBuffer_Clear(channel->TxBuffer);
 		}
+		else
+		{
+			RoundBuffer_Consume(channel->TxBuffer, length);
+		}
+		USB_VCP_StartTransmit(channel, (USB_VCP_COALESCE_SOF == 0));
 	}
-	
-	//Sending prepeared data
-	txDataLength = RoundBuffer_GetLoad(USB_CDC1_TxBuffer);
-	if(txDataLength > 0)
+
+	USB_VCP_PROFILE_STOP(usbVcpStats.TxCpltCyclesMax);
+}
+
+/******************************************************************************
+ *  @brief  Start of frame callback (USB ISR): flush partial packets which
+ *          waited USB_VCP_COALESCE_SOF frames on idle pipes.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void USB_VCP_SOFCallback(void)
+{
+#if (USB_VCP_COALESCE_SOF > 0)
+	uint32_t index;
+
+	for(index = 0; index < USB_VCP_NUM_CHANNELS; index++)
 	{
-    if(CDC_CheckTransmitAvailable(CDC_ITF_NUMBER_1))
-    {
-      if(txDataLength > sizeof(dataTxBuffer))
-      {
-        txDataLength = sizeof(dataTxBuffer);
-      }
-      
-      txDataLength = RoundBuffer_GetArray(USB_CDC1_TxBuffer, dataTxBuffer, txDataLength);
-      
-      CDC_Transmit(dataTxBuffer, txDataLength, CDC_ITF_NUMBER_1);
-    }
+		USB_VCP_Channel_t *channel = &usbVcpChannels[index];
+
+		if((RoundBuffer_GetLoad(channel->TxBuffer) > 0) && (channel->Port->TransmitAvailable(channel->InterfaceNumber)))
+		{
+			if(++channel->SofAge >= USB_VCP_COALESCE_SOF)
+			{
+				USB_VCP_StartTransmit(channel, true);
+			}
+		}
 	}
 #endif
-	
-#if (NUM_OF_CDC_UARTS > 1)
-	//Parsing of received data
-	rxDataLength = RoundBuffer_GetLoad(USB_CDC2_RxBuffer);
-	if(rxDataLength > 0)
-	{	
-		for(uint16_t i = 0; i < rxDataLength; i++)
+}
+
+/******************************************************************************
+ *  @brief  Send pending channel events to host. Tx round buffer drops are
+ *          picked up here, other events come from USB_VCP_NotifyEvent.
+ *          A busy command endpoint keeps events pending for the next call.
+ *
+ *  @param  channel - channel descriptor.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void USB_VCP_SendEvents(USB_VCP_Channel_t *channel)
+{
+	uint32_t txDropped = channel->TxBuffer->Stats.DroppedRecords;
+	uint32_t primask;
+	uint16_t events;
+
+	if(channel->Port->Notify == NULL)
+	{
+		return;
+	}
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(txDropped != channel->TxDropped)
+	{
+		channel->TxDropped = txDropped;
+		channel->Events |= USB_VCP_EVENT_BUFFER_OVERFLOW;
+	}
+
+	events = channel->Events;
+	if(events != 0)
+	{
+		//DSR tells the host the channel is alive, event bits are one-shot
+		if(channel->Port->Notify(CDC_SERIAL_STATE_TX_CARRIER | events, channel->InterfaceNumber) == USBD_OK)
 		{
-			RoundBuffer_AddByte(USB_CDC2_TxBuffer, RoundBuffer_GetByte(USB_CDC2_RxBuffer));
+			channel->Events &= (uint16_t)~events;
 		}
 	}
-	
-	//Sending prepeared data
-	txDataLength = RoundBuffer_GetLoad(USB_CDC2_TxBuffer);
-	if(txDataLength > 0)
+
+	__set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ *  @brief  Service one channel: process received data within channel
+ *          budget and start transmission of prepeared data.
+ *
+ *  @param  channel - channel descriptor.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void USB_VCP_RunChannel(USB_VCP_Channel_t *channel)
+{
+	uint32_t quantum = channel->Weight * USB_VCP_QUANTUM;
+	uint32_t processed;
+
+	//Deficit round robin: unused budget is carried to the next round
+	//while channel has pending data, at most one quantum of it
+	channel->Deficit += quantum;
+	processed = channel->Process(channel->Context, channel->RxBuffer, channel->TxBuffer, channel->Deficit);
+
+	if(RoundBuffer_GetLoad(channel->RxBuffer) == 0)
 	{
-    if(CDC_CheckTransmitAvailable(CDC_ITF_NUMBER_2))
-    {
-      if(txDataLength > sizeof(dataTxBuffer))
-      {
-        txDataLength = sizeof(dataTxBuffer);
-      }
-      
-      txDataLength = RoundBuffer_GetArray(USB_CDC2_TxBuffer, dataTxBuffer, txDataLength);
-      
-      CDC_Transmit(dataTxBuffer, txDataLength, CDC_ITF_NUMBER_2);
-    }
+		channel->Deficit = 0;
 	}
-#endif
-	
-#if (NUM_OF_CDC_UARTS > 2)
-	//Parsing of received data
-	rxDataLength = RoundBuffer_GetLoad(USB_CDC3_RxBuffer);
-	if(rxDataLength > 0)
-	{	
-		for(uint16_t i = 0; i < rxDataLength; i++)
+	else
+	{
+		channel->Deficit -= processed;
+		if(channel->Deficit > quantum)
 		{
-			RoundBuffer_AddByte(USB_CDC3_TxBuffer, RoundBuffer_GetByte(USB_CDC3_RxBuffer));
+			channel->Deficit = quantum;
 		}
 	}
-	
-	//Sending prepeared data
-	txDataLength = RoundBuffer_GetLoad(USB_CDC3_TxBuffer);
-	if(txDataLength > 0)
+
+	//Return OUT credit once a whole packet fits again. Endpoint is not armed
+	//while paused, so no Rx ISR can race with this.
+	if((channel->RxPaused) && (RoundBuffer_GetFree(channel->RxBuffer) >= USB_VCP_RX_PACKET_SIZE))
 	{
-    if(CDC_CheckTransmitAvailable(CDC_ITF_NUMBER_3))
-    {
-      if(txDataLength > sizeof(dataTxBuffer))
-      {
-        txDataLength = sizeof(dataTxBuffer);
-      }
-      
-      txDataLength = RoundBuffer_GetArray(USB_CDC3_TxBuffer, dataTxBuffer, txDataLength);
-      
-      CDC_Transmit(dataTxBuffer, txDataLength, CDC_ITF_NUMBER_3);
-    }
+		channel->RxPaused = false;
+		channel->Port->ReceiveResume(channel->InterfaceNumber);
 	}
-#endif
-	
-#if (NUM_OF_CDC_UARTS > 3)
-	//Parsing of received data
-	rxDataLength = RoundBuffer_GetLoad(USB_CDC4_RxBuffer);
-	if(rxDataLength > 0)
-	{	
-		for(uint16_t i = 0; i < rxDataLength; i++)
+
+	USB_VCP_SendEvents(channel);
+
+	//Kick transmission of prepeared data if pipe is idle. Bytes are consumed
+	//and next transfers chained in USB_VCP_TransmitCompleteCallback.
+	//SOF flush may start a transfer on an idle pipe too, so lock out USB ISR.
+	//Endpoint is not polled at all while there is nothing to send.
+	if((RoundBuffer_GetLoad(channel->TxBuffer) > 0) && (channel->Port->TransmitAvailable(channel->InterfaceNumber)))
+	{
+		uint32_t primask = __get_PRIMASK();
+
+		__disable_irq();
+
+		if(channel->Port->TransmitAvailable(channel->InterfaceNumber))
 		{
-			RoundBuffer_AddByte(USB_CDC4_TxBuffer, RoundBuffer_GetByte(USB_CDC4_RxBuffer));
+			USB_VCP_StartTransmit(channel, (USB_VCP_COALESCE_SOF == 0));
 		}
+
+		__set_PRIMASK(primask);
 	}
-	
-	//Sending prepeared data
-	txDataLength = RoundBuffer_GetLoad(USB_CDC4_TxBuffer);
-	if(txDataLength > 0)
+}
+
+/******************************************************************************
+ *  @brief  Service all channels, one round of weighted round robin.
+ *          Each call opens the round with the next channel.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void USB_VCP_Run(void)
+{
+	uint32_t index;
+	uint32_t channel = usbVcpNextChannel;
+
+	USB_VCP_PROFILE_START();
+
+	for(index = 0; index < USB_VCP_NUM_CHANNELS; index++)
+	{
+		USB_VCP_RunChannel(&usbVcpChannels[channel]);
+
+		if(++channel >= USB_VCP_NUM_CHANNELS)
+		{
+			channel = 0;
+		}
+	}
+
+	if(++usbVcpNextChannel >= USB_VCP_NUM_CHANNELS)
 	{
-    if(CDC_CheckTransmitAvailable(CDC_ITF_NUMBER_4))
-    {
-      if(txDataLength > sizeof(dataTxBuffer))
-      {
-        txDataLength = sizeof(dataTxBuffer);
-      }
-      
-      txDataLength = RoundBuffer_GetArray(USB_CDC4_TxBuffer, dataTxBuffer, txDataLength);
-      
-      CDC_Transmit(dataTxBuffer, txDataLength, CDC_ITF_NUMBER_4);
-    }
+		usbVcpNextChannel = 0;
 	}
+
+	usbVcpStats.RunCalls++;
+
+#if (USB_VCP_PROFILE == 1)
+	usbVcpStats.RunCyclesLast = DWT->CYCCNT - profileStart;
+	usbVcpStats.RunCyclesTotal += usbVcpStats.RunCyclesLast;
+	USB_VCP_PROFILE_STOP(usbVcpStats.RunCyclesMax);
 #endif
 }
 
-/*-- EOF --------------------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Report channel events to host (any context, CAN ISR included).
+ *          Events are merged until USB_VCP_Run sends them by SERIAL_STATE
+ *          notification.
+ *
+ *  @param  interfaceNumber - CDC interface number.
+ *  @param  events - USB_VCP_EVENT_xxx bits.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void USB_VCP_NotifyEvent(uint8_t interfaceNumber, uint16_t events)
+{
+	USB_VCP_Channel_t *channel = USB_VCP_GetChannel(interfaceNumber);
+
+	if(channel)
+	{
+		uint32_t primask = __get_PRIMASK();
+
+		__disable_irq();
+		channel->Events |= events;
+		__set_PRIMASK(primask);
+	}
+}
+
+/******************************************************************************
+ *  @brief  Check if host has the channel open. Producers may skip fetching
+ *          and encoding of data for a closed channel.
+ *
+ *  @param  interfaceNumber - CDC interface number.
+ *
+ *  @retval true if data sent to channel reaches host.
+ *****************************************************************************/
+bool USB_VCP_IsHostOpen(uint8_t interfaceNumber)
+{
+	USB_VCP_Channel_t *channel = USB_VCP_GetChannel(interfaceNumber);
+
+	return ((channel) && (channel->HostOpen));
+}
+
+#if (USB_VCP_SLCAN == 1)
+/******************************************************************************
+ *  @brief  Set CAN controller callbacks of all SLCAN channels. Backend
+ *          channel number is CDC_ITF_NUMBER_n - 1.
+ *
+ *  @param  backend - callbacks, NULL acknowledges commands without a bus.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void USB_VCP_SlcanSetBackend(const Slcan_Backend_t *backend)
+{
+	uint32_t index;
+
+	for(index = 0; index < NUM_OF_CDC_UARTS; index++)
+	{
+		Slcan_SetBackend(&usbVcpSlcan[index], backend);
+	}
+}
+
+/******************************************************************************
+ *  @brief  Send received CAN frame to host as SLCAN line. Main loop only:
+ *          shares the Tx round buffer producer side with command replies.
+ *
+ *  @param  interfaceNumber - CDC interface number.
+ *  @param  frame - received frame.
+ *
+ *  @retval false if channel is closed by host or Tx buffer is full.
+ *          Frames for a port closed by host are counted in GatedFrames.
+ *****************************************************************************/
+bool USB_VCP_SlcanSendFrame(uint8_t interfaceNumber, const CanFrame_t *frame)
+{
+	if((interfaceNumber == 0) || (interfaceNumber > NUM_OF_CDC_UARTS))
+	{
+		return false;
+	}
+
+	if(!usbVcpChannels[interfaceNumber - 1].HostOpen)
+	{
+		usbVcpStats.GatedFrames++;
+		return false;
+	}
+
+	return Slcan_EncodeFrame(&usbVcpSlcan[interfaceNumber - 1], usbVcpChannels[interfaceNumber - 1].TxBuffer, frame);
+}
+#endif
+
+#if (USBD_VENDOR_ENABLE == 1)
+/******************************************************************************
+ *  @brief  Send captured CAN frame to host as a binary record of the vendor
+ *          bulk stream, layout at USB_VCP_VENDOR_RECORD_SIZE. Main loop only.
+ *          Record is stored whole or dropped and counted by the Tx ring.
+ *
+ *  @param  frame - captured frame.
+ *
+ *  @retval false if Tx buffer is full.
+ *****************************************************************************/
+bool USB_VCP_VendorSendFrame(const CanFrame_t *frame)
+{
+	uint8_t record[USB_VCP_VENDOR_RECORD_SIZE] = { 0 };
+	uint32_t length = frame->Dlc;
+	uint32_t index;
+
+	for(index = 0; index < 8; index++)
+	{
+		record[index] = (uint8_t)(frame->Timestamp >> (8 * index));
+	}
+	for(index = 0; index < 4; index++)
+	{
+		record[8 + index] = (uint8_t)(frame->Id >> (8 * index));
+	}
+	record[12] = frame->Flags;
+	record[13] = frame->Dlc;
+	record[14] = frame->Bus;
+
+	if(length > CAN_FRAME_MAX_DATA)
+	{
+		length = CAN_FRAME_MAX_DATA;
+	}
+	if(!(frame->Flags & CAN_FRAME_FLAG_RTR))
+	{
+		memcpy(&record[16], frame->Data, length);
+	}
+
+	return (RoundBuffer_AddArray(USB_VENDOR_TxBuffer, record, sizeof(record)) == sizeof(record));
+}
+#endif
+
+/*-- EOF --------------------------------------------------------------------*/
\ No newline at end of file
@@ -46,6 +46,8 @@ extern "C" {
 //#define CDC_OUT_EP                                  0x01U  /* EP1 for data OUT */
 //#define CDC_CMD_EP                                  0x82U  /* EP2 for CDC commands */
 
+#if (USBD_GSUSB_ENABLE == 0)
+
 #if (NUM_OF_CDC_UARTS > 0)
 #define CDC_ITF_NUMBER_1                                1  // ITF number
 #define CDC_ITF_CMD_1                               0x00U  // ITF1 for data IN
@@ -82,18 +84,62 @@ extern "C" {
 #define CDC_EP_CMD_4                                0x88U  // EP8 for CDC commands
 #endif
 
+#else
+
+//gs_usb interface takes interface 0, EP1 IN and EP2 OUT (fixed in older Linux
+//drivers), so CDC interfaces move up by one and command endpoints come first
+#if (NUM_OF_CDC_UARTS > 0)
+#define CDC_ITF_NUMBER_1                                1  // ITF number
+#define CDC_ITF_CMD_1                               0x01U  // ITF1 for data IN
+#define CDC_ITF_DATA_1                              0x02U  // ITF1 for data OUT
+#define CDC_EP_DATA_OUT_1                           0x03U  // EP3 for data OUT
+#define CDC_EP_DATA_IN_1                            0x83U  // EP3 for data IN
+#define CDC_EP_CMD_1                                0x82U  // EP2 for CDC commands
+#endif
+
+#if (NUM_OF_CDC_UARTS > 1)
+#define CDC_ITF_NUMBER_2                                2  // ITF number
+#define CDC_ITF_CMD_2                               0x03U  // ITF2 for data IN
+#define CDC_ITF_DATA_2                              0x04U  // ITF2 for data OUT
+#define CDC_EP_DATA_OUT_2                           0x05U  // EP5 for data OUT
+#define CDC_EP_DATA_IN_2                            0x85U  // EP5 for data IN
+#define CDC_EP_CMD_2                                0x84U  // EP4 for CDC commands
+#endif
+
+#if (NUM_OF_CDC_UARTS > 2)
+#define CDC_ITF_NUMBER_3                                3  // ITF number
+#define CDC_ITF_CMD_3                               0x05U  // ITF3 for data IN
+#define CDC_ITF_DATA_3                              0x06U  // ITF3 for data OUT
+#define CDC_EP_DATA_OUT_3                           0x07U  // EP7 for data OUT
+#define CDC_EP_DATA_IN_3                            0x87U  // EP7 for data IN
+#define CDC_EP_CMD_3                                0x86U  // EP6 for CDC commands
+#endif
+
+#if (NUM_OF_CDC_UARTS > 3)
+#define CDC_ITF_NUMBER_4                                4  // ITF number
+#define CDC_ITF_CMD_4                               0x07U  // ITF4 for data IN
+#define CDC_ITF_DATA_4                              0x08U  // ITF4 for data OUT
+#define CDC_EP_DATA_OUT_4                           0x09U  // EP9 for data OUT
+#define CDC_EP_DATA_IN_4                            0x89U  // EP9 for data IN
+#define CDC_EP_CMD_4                                0x88U  // EP8 for CDC commands
+#endif
+
+#endif /* USBD_GSUSB_ENABLE */
+
+/* Command endpoint polling: HS interval is 2^(bInterval-1) microframes, FS is
+   bInterval frames. Both 4 ms, serial state notifications reach the host fast */
 #ifndef CDC_HS_BINTERVAL
-#define CDC_HS_BINTERVAL                            0x10U
+#define CDC_HS_BINTERVAL                            0x06U
 #endif /* CDC_HS_BINTERVAL */
 
 #ifndef CDC_FS_BINTERVAL
-#define CDC_FS_BINTERVAL                            0x10U
+#define CDC_FS_BINTERVAL                            0x04U
 #endif /* CDC_FS_BINTERVAL */
 
 /* CDC Endpoints parameters: you can fine tune these values depending on the needed baudrates and performance. */
 #define CDC_DATA_HS_MAX_PACKET_SIZE                 512U  /* Endpoint IN & OUT Packet size */
 #define CDC_DATA_FS_MAX_PACKET_SIZE                 64U  /* Endpoint IN & OUT Packet size */
-#define CDC_CMD_PACKET_SIZE                         8U  /* Control Endpoint Packet size */
+#define CDC_CMD_PACKET_SIZE                         16U  /* Control Endpoint Packet size, holds one SERIAL_STATE notification */
 
 #define USB_CDC_CONFIG_DESC_SIZ                     67U
 #define CDC_DATA_HS_IN_PACKET_SIZE                  CDC_DATA_HS_MAX_PACKET_SIZE
@@ -115,6 +161,24 @@ extern "C" {
 #define CDC_SET_CONTROL_LINE_STATE                  0x22U
 #define CDC_SEND_BREAK                              0x23U
 
+/* Notifications on the command endpoint (PSTN120) */
+#define CDC_NOTIFICATION_REQUEST_TYPE               0xA1U
+#define CDC_NOTIFICATION_SERIAL_STATE               0x20U
+#define CDC_NOTIFICATION_SERIAL_STATE_SIZE          10U
+
+/* SERIAL_STATE bitmap: state bits are held, the others are one-shot events */
+#define CDC_SERIAL_STATE_RX_CARRIER                 0x0001U  /* DCD, state */
+#define CDC_SERIAL_STATE_TX_CARRIER                 0x0002U  /* DSR, state */
+#define CDC_SERIAL_STATE_BREAK                      0x0004U
+#define CDC_SERIAL_STATE_RING_SIGNAL                0x0008U
+#define CDC_SERIAL_STATE_FRAMING                    0x0010U
+#define CDC_SERIAL_STATE_PARITY                     0x0020U
+#define CDC_SERIAL_STATE_OVERRUN                    0x0040U
+
+/* SET_CONTROL_LINE_STATE wValue bits */
+#define CDC_CONTROL_LINE_DTR                        0x0001U
+#define CDC_CONTROL_LINE_RTS                        0x0002U
+
 /**
   * @}
   */
@@ -142,6 +206,7 @@ typedef struct _USBD_CDC_Itf
   int8_t (* Control)(uint8_t cmd, uint8_t *pbuf, uint16_t length, uint8_t interfaceNumber);
   int8_t (* Receive)(uint8_t *Buf, uint32_t *Len, uint8_t interfaceNumber);
   int8_t (* TransmitCplt)(uint8_t *Buf, uint32_t *Len, uint8_t interfaceNumber);
+  int8_t (* SOF)(void);
 } USBD_CDC_ItfTypeDef;
 
 
@@ -162,6 +227,9 @@ typedef struct
 
   __IO uint32_t TxState;
   __IO uint32_t RxState;
+
+  uint32_t Notification[CDC_CMD_PACKET_SIZE / 4U];      /* Force 32bits alignment */
+  __IO uint32_t NotifyState;
 } USBD_CDC_HandleTypeDef;
 
 
@@ -196,16 +264,13 @@ extern USBD_CompClassTypeDef USBD_CDC;
 /** @defgroup USB_CORE_Exported_Functions
   * @{
   */
-uint8_t *USBD_CDC_GetHSCfgDesc(uint16_t *length);
-uint8_t *USBD_CDC_GetFSCfgDesc(uint16_t *length);
-uint8_t *USBD_CDC_GetOtherSpeedCfgDesc(uint16_t *length);
-
 uint8_t USBD_CDC_CheckSendingAvailable(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber);
 uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_CDC_ItfTypeDef *fops);
 uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber, uint8_t *pbuff, uint32_t length);
 uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber, uint8_t *pbuff);
 uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber);
 uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber);
+uint8_t USBD_CDC_SendSerialState(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber, uint16_t serialState);
 /**
   * @}
   */
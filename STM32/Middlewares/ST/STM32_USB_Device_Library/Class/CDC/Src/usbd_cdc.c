@@ -59,9 +59,6 @@ EndBSPDependencies */
 #include "usbd_cdc.h"
 #include "usbd_ctlreq.h"
 
-#include "usbhelper.h"
-#include "cdchelper.h"
-
 /** @addtogroup STM32_USB_DEVICE_LIBRARY
   * @{
   */
@@ -107,10 +104,9 @@ static uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *re
 static uint8_t USBD_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
 static uint8_t USBD_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
 static uint8_t USBD_CDC_EP0_RxReady(USBD_HandleTypeDef *pdev);
+static uint8_t USBD_CDC_SOF(USBD_HandleTypeDef *pdev);
+static USBD_CDC_HandleTypeDef *USBD_CDC_GetChannel(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber, uint8_t *index);
 
-uint8_t *USBD_CDC_GetFSCfgDesc(uint16_t *length);
-uint8_t *USBD_CDC_GetHSCfgDesc(uint16_t *length);
-uint8_t *USBD_CDC_GetOtherSpeedCfgDesc(uint16_t *length);
 uint8_t *USBD_CDC_GetDeviceQualifierDescriptor(uint16_t *length);
 
 /* USB Standard Device Descriptor */
@@ -138,188 +134,176 @@ __ALIGN_BEGIN static uint8_t USBD_CDC_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_
 
 
 /* CDC interface class callbacks structure */
-USBD_CompClassTypeDef USBD_CDC =
+
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_Private_Functions
+  * @{
+  */
+
+/* endpoint numbers and "instance" (base register address) for each UART */
+/* one USBD_CfgParams entry per CDC channel */
+#define CDC_CHANNEL_PARAMS(n)                                                   \
+  {                                                                             \
+    .interfaceNumber = CDC_ITF_NUMBER_##n,                                      \
+    .data_in_ep  = CDC_EP_DATA_IN_##n,                                          \
+    .data_out_ep = CDC_EP_DATA_OUT_##n,                                         \
+    .command_ep  = CDC_EP_CMD_##n,                                              \
+    .command_itf = CDC_ITF_CMD_##n,                                             \
+  }
+
+static const USBD_CDC_ParamsTypeDef USBD_CfgParams[NUM_OF_CDC_UARTS] = 
 {
-  USBD_CDC_Init,
-  USBD_CDC_DeInit,
-  USBD_CDC_Setup,
-  NULL,                 /* EP0_TxSent, */
-  USBD_CDC_EP0_RxReady,
-  USBD_CDC_DataIn,
-  USBD_CDC_DataOut,
-  NULL,
+#if (NUM_OF_CDC_UARTS > 0)
+  CDC_CHANNEL_PARAMS(1),
+#endif
+#if (NUM_OF_CDC_UARTS > 1)
+  CDC_CHANNEL_PARAMS(2),
+#endif
+#if (NUM_OF_CDC_UARTS > 2)
+  CDC_CHANNEL_PARAMS(3),
+#endif
+#if (NUM_OF_CDC_UARTS > 3)
+  CDC_CHANNEL_PARAMS(4),
+#endif
 };
 
-/* bespoke struct for this device; struct members are added and removed as needed */
-struct configuration_1
+/* context for each and every UART managed by this CDC implementation */
+static USBD_CDC_HandleTypeDef cdcContextData[NUM_OF_CDC_UARTS];
+
+/* O(1) lookup for the ISR: endpoint number / interface -> channel index + 1, 0 - not CDC */
+static const uint8_t cdcInEpChannel[16] =
 {
-  struct configuration_descriptor config;
-  struct cdc_interface cdc[NUM_OF_CDC_UARTS];
+#if (NUM_OF_CDC_UARTS > 0)
+  [CDC_EP_DATA_IN_1 & 0x0FU] = 1,
+#endif
+#if (NUM_OF_CDC_UARTS > 1)
+  [CDC_EP_DATA_IN_2 & 0x0FU] = 2,
+#endif
+#if (NUM_OF_CDC_UARTS > 2)
+  [CDC_EP_DATA_IN_3 & 0x0FU] = 3,
+#endif
+#if (NUM_OF_CDC_UARTS > 3)
+  [CDC_EP_DATA_IN_4 & 0x0FU] = 4,
+#endif
 };
 
-/* fully initialize the bespoke struct as a const */
-__ALIGN_BEGIN static const struct configuration_1 USBD_Composite_CfgHSDesc __ALIGN_END =
+static const uint8_t cdcCmdEpChannel[16] =
 {
-  {
-    /*Configuration Descriptor*/
-    sizeof(struct configuration_descriptor),         /* bLength */
-    USB_DESC_TYPE_CONFIGURATION,                     /* bDescriptorType */
-    USB_UINT16(sizeof(USBD_Composite_CfgHSDesc)),    /* wTotalLength */
-    USBD_MAX_NUM_INTERFACES,                         /* bNumInterfaces */
-    0x01,                                            /* bConfigurationValue */
-    0x00,                                            /* iConfiguration */
-    0x80,                                            /* bmAttributes */
-    50,                                              /* MaxPower */
-  },
-
-  {
 #if (NUM_OF_CDC_UARTS > 0)
-    /* CDC1 */
-    CDC_HS_DESCRIPTOR(CDC_ITF_CMD_1, CDC_ITF_DATA_1, CDC_EP_CMD_1, CDC_EP_DATA_OUT_1, CDC_EP_DATA_IN_1)
+  [CDC_EP_CMD_1 & 0x0FU] = 1,
 #endif
 #if (NUM_OF_CDC_UARTS > 1)
-    /* CDC2 */
-    CDC_HS_DESCRIPTOR(CDC_ITF_CMD_2, CDC_ITF_DATA_2, CDC_EP_CMD_2, CDC_EP_DATA_OUT_2, CDC_EP_DATA_IN_2)
+  [CDC_EP_CMD_2 & 0x0FU] = 2,
 #endif
 #if (NUM_OF_CDC_UARTS > 2)
-    /* CDC3 */
-    CDC_HS_DESCRIPTOR(CDC_ITF_CMD_3, CDC_ITF_DATA_3, CDC_EP_CMD_3, CDC_EP_DATA_OUT_3, CDC_EP_DATA_IN_3)
+  [CDC_EP_CMD_3 & 0x0FU] = 3,
 #endif
 #if (NUM_OF_CDC_UARTS > 3)
-    /* CDC4 */
-    CDC_HS_DESCRIPTOR(CDC_ITF_CMD_4, CDC_ITF_DATA_4, CDC_EP_CMD_4, CDC_EP_DATA_OUT_4, CDC_EP_DATA_IN_4)
+  [CDC_EP_CMD_4 & 0x0FU] = 4,
 #endif
-  },
 };
 
-/* fully initialize the bespoke struct as a const */
-__ALIGN_BEGIN static const struct configuration_1 USBD_Composite_CfgFSDesc __ALIGN_END =
+static const uint8_t cdcOutEpChannel[16] =
 {
-  {
-    /*Configuration Descriptor*/
-    sizeof(struct configuration_descriptor),         /* bLength */
-    USB_DESC_TYPE_CONFIGURATION,                     /* bDescriptorType */
-    USB_UINT16(sizeof(USBD_Composite_CfgFSDesc)),    /* wTotalLength */
-    USBD_MAX_NUM_INTERFACES,                         /* bNumInterfaces */
-    0x01,                                            /* bConfigurationValue */
-    0x00,                                            /* iConfiguration */
-    0x80,                                            /* bmAttributes */
-    50,                                              /* MaxPower */
-  },
-
-  {
 #if (NUM_OF_CDC_UARTS > 0)
-    /* CDC1 */
-    CDC_FS_DESCRIPTOR(CDC_ITF_CMD_1, CDC_ITF_DATA_1, CDC_EP_CMD_1, CDC_EP_DATA_OUT_1, CDC_EP_DATA_IN_1)
+  [CDC_EP_DATA_OUT_1 & 0x0FU] = 1,
 #endif
 #if (NUM_OF_CDC_UARTS > 1)
-    /* CDC2 */
-    CDC_FS_DESCRIPTOR(CDC_ITF_CMD_2, CDC_ITF_DATA_2, CDC_EP_CMD_2, CDC_EP_DATA_OUT_2, CDC_EP_DATA_IN_2)
+  [CDC_EP_DATA_OUT_2 & 0x0FU] = 2,
 #endif
 #if (NUM_OF_CDC_UARTS > 2)
-    /* CDC3 */
-    CDC_FS_DESCRIPTOR(CDC_ITF_CMD_3, CDC_ITF_DATA_3, CDC_EP_CMD_3, CDC_EP_DATA_OUT_3, CDC_EP_DATA_IN_3)
+  [CDC_EP_DATA_OUT_3 & 0x0FU] = 3,
 #endif
 #if (NUM_OF_CDC_UARTS > 3)
-    /* CDC4 */
-    CDC_FS_DESCRIPTOR(CDC_ITF_CMD_4, CDC_ITF_DATA_4, CDC_EP_CMD_4, CDC_EP_DATA_OUT_4, CDC_EP_DATA_IN_4)
+  [CDC_EP_DATA_OUT_4 & 0x0FU] = 4,
 #endif
-  },
 };
 
-/* fully initialize the bespoke struct as a const */
-__ALIGN_BEGIN static const struct configuration_1 USBD_Composite_CfgOtherDesc __ALIGN_END =
+static const uint8_t cdcItfNumberChannel[NUM_OF_CDC_UARTS + 1] =
 {
-  {
-    /*Configuration Descriptor*/
-    sizeof(struct configuration_descriptor),         /* bLength */
-    USB_DESC_TYPE_CONFIGURATION,                     /* bDescriptorType */
-    USB_UINT16(sizeof(USBD_Composite_CfgOtherDesc)), /* wTotalLength */
-    USBD_MAX_NUM_INTERFACES,                         /* bNumInterfaces */
-    0x01,                                            /* bConfigurationValue */
-    0x00,                                            /* iConfiguration */
-    0x80,                                            /* bmAttributes */
-    50,                                              /* MaxPower */
-  },
-
-  {
 #if (NUM_OF_CDC_UARTS > 0)
-    /* CDC1 */
-    CDC_OTHER_SPEED_DESCRIPTOR(CDC_ITF_CMD_1, CDC_ITF_DATA_1, CDC_EP_CMD_1, CDC_EP_DATA_OUT_1, CDC_EP_DATA_IN_1)
+  [CDC_ITF_NUMBER_1] = 1,
 #endif
 #if (NUM_OF_CDC_UARTS > 1)
-    /* CDC2 */
-    CDC_OTHER_SPEED_DESCRIPTOR(CDC_ITF_CMD_2, CDC_ITF_DATA_2, CDC_EP_CMD_2, CDC_EP_DATA_OUT_2, CDC_EP_DATA_IN_2)
+  [CDC_ITF_NUMBER_2] = 2,
 #endif
 #if (NUM_OF_CDC_UARTS > 2)
-    /* CDC3 */
-    CDC_OTHER_SPEED_DESCRIPTOR(CDC_ITF_CMD_3, CDC_ITF_DATA_3, CDC_EP_CMD_3, CDC_EP_DATA_OUT_3, CDC_EP_DATA_IN_3)
+  [CDC_ITF_NUMBER_3] = 3,
 #endif
 #if (NUM_OF_CDC_UARTS > 3)
-    /* CDC4 */
-    CDC_OTHER_SPEED_DESCRIPTOR(CDC_ITF_CMD_4, CDC_ITF_DATA_4, CDC_EP_CMD_4, CDC_EP_DATA_OUT_4, CDC_EP_DATA_IN_4)
+  [CDC_ITF_NUMBER_4] = 4,
 #endif
-  },
 };
 
-/* pointer and length of configuration descriptor for main USB driver */
-uint8_t *USBD_CfgHSDesc_pnt = (uint8_t *)&USBD_Composite_CfgHSDesc;
-uint16_t USBD_CfgHSDesc_len = sizeof(USBD_Composite_CfgHSDesc);
-
-uint8_t *USBD_CfgFSDesc_pnt = (uint8_t *)&USBD_Composite_CfgFSDesc;
-uint16_t USBD_CfgFSDesc_len = sizeof(USBD_Composite_CfgFSDesc);
-
-/**
-  * @}
-  */
+static const uint8_t cdcCmdItfChannel[USBD_MAX_NUM_INTERFACES] =
+{
+#if (NUM_OF_CDC_UARTS > 0)
+  [CDC_ITF_CMD_1] = 1,
+#endif
+#if (NUM_OF_CDC_UARTS > 1)
+  [CDC_ITF_CMD_2] = 2,
+#endif
+#if (NUM_OF_CDC_UARTS > 2)
+  [CDC_ITF_CMD_3] = 3,
+#endif
+#if (NUM_OF_CDC_UARTS > 3)
+  [CDC_ITF_CMD_4] = 4,
+#endif
+};
 
-/** @defgroup USBD_CDC_Private_Functions
-  * @{
-  */
+/* interfaces and endpoints owned by CDC, for composite dispatch tables */
+static const uint8_t cdcInterfaces[] =
+{
+#if (NUM_OF_CDC_UARTS > 0)
+  CDC_ITF_CMD_1, CDC_ITF_DATA_1,
+#endif
+#if (NUM_OF_CDC_UARTS > 1)
+  CDC_ITF_CMD_2, CDC_ITF_DATA_2,
+#endif
+#if (NUM_OF_CDC_UARTS > 2)
+  CDC_ITF_CMD_3, CDC_ITF_DATA_3,
+#endif
+#if (NUM_OF_CDC_UARTS > 3)
+  CDC_ITF_CMD_4, CDC_ITF_DATA_4,
+#endif
+};
 
-/* endpoint numbers and "instance" (base register address) for each UART */
-static const USBD_CDC_ParamsTypeDef USBD_CfgParams[NUM_OF_CDC_UARTS] = 
+static const uint8_t cdcEndpoints[] =
 {
 #if (NUM_OF_CDC_UARTS > 0)
-  {
-	.interfaceNumber = CDC_ITF_NUMBER_1,
-    .data_in_ep  = CDC_EP_DATA_IN_1,
-    .data_out_ep = CDC_EP_DATA_OUT_1,
-    .command_ep  = CDC_EP_CMD_1,
-    .command_itf = CDC_ITF_CMD_1,
-  },
+  CDC_EP_DATA_IN_1, CDC_EP_DATA_OUT_1, CDC_EP_CMD_1,
 #endif
 #if (NUM_OF_CDC_UARTS > 1)
-  {
-	.interfaceNumber = CDC_ITF_NUMBER_2,
-    .data_in_ep  = CDC_EP_DATA_IN_2,
-    .data_out_ep = CDC_EP_DATA_OUT_2,
-    .command_ep  = CDC_EP_CMD_2,
-    .command_itf = CDC_ITF_CMD_2,
-  },
+  CDC_EP_DATA_IN_2, CDC_EP_DATA_OUT_2, CDC_EP_CMD_2,
 #endif
 #if (NUM_OF_CDC_UARTS > 2)
-  {
-	.interfaceNumber = CDC_ITF_NUMBER_3,
-    .data_in_ep  = CDC_EP_DATA_IN_3,
-    .data_out_ep = CDC_EP_DATA_OUT_3,
-    .command_ep  = CDC_EP_CMD_3,
-    .command_itf = CDC_ITF_CMD_3,
-  },
+  CDC_EP_DATA_IN_3, CDC_EP_DATA_OUT_3, CDC_EP_CMD_3,
 #endif
 #if (NUM_OF_CDC_UARTS > 3)
-  {
-	.interfaceNumber = CDC_ITF_NUMBER_4,
-    .data_in_ep  = CDC_EP_DATA_IN_4,
-    .data_out_ep = CDC_EP_DATA_OUT_4,
-    .command_ep  = CDC_EP_CMD_4,
-    .command_itf = CDC_ITF_CMD_4,
-  },
+  CDC_EP_DATA_IN_4, CDC_EP_DATA_OUT_4, CDC_EP_CMD_4,
 #endif
 };
 
-/* context for each and every UART managed by this CDC implementation */
-static USBD_CDC_HandleTypeDef cdcContextData[NUM_OF_CDC_UARTS];
+USBD_CompClassTypeDef USBD_CDC =
+{
+  USBD_CDC_Init,
+  USBD_CDC_DeInit,
+  USBD_CDC_Setup,
+  NULL,                 /* EP0_TxSent, */
+  USBD_CDC_EP0_RxReady,
+  USBD_CDC_DataIn,
+  USBD_CDC_DataOut,
+  USBD_CDC_SOF,
+  cdcInterfaces,
+  sizeof(cdcInterfaces),
+  cdcEndpoints,
+  sizeof(cdcEndpoints),
+  0U,                   /* VendorCode, no vendor requests */
+};
 
 /**
   * @}
@@ -395,6 +379,7 @@ static uint8_t USBD_CDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
     /* Init Xfer states */
     hcdc->TxState = 0U;
     hcdc->RxState = 0U;
+    hcdc->NotifyState = 0U;
 
     /* Configure the UART peripheral */
     //Not used
@@ -483,38 +468,39 @@ static uint8_t USBD_CDC_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *re
   {
     case USB_REQ_TYPE_CLASS:
     {
-      uint8_t index;
-      
-      for (index = 0; index < NUM_OF_CDC_UARTS; index++,hcdc++)
-			{
-        /* Check the interface number */
-        if (USBD_CfgParams[index].command_itf != req->wIndex)
-        {
-          continue;
-        }
-        else
+      uint8_t index = 0U;
+
+      /* Check the interface number */
+      if (req->wIndex < USBD_MAX_NUM_INTERFACES)
+      {
+        index = cdcCmdItfChannel[req->wIndex];
+      }
+
+      if (index != 0U)
+      {
+        index--;
+        hcdc += index;
+
+        if (req->wLength != 0U)
         {
-          if (req->wLength != 0U)
+          if ((req->bmRequest & 0x80U) != 0U)
           {
-            if ((req->bmRequest & 0x80U) != 0U)
-            {
-              ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(req->bRequest, (uint8_t *)hcdc->data, req->wLength, USBD_CfgParams[index].interfaceNumber);
-              
-              (void)USBD_CtlSendData(pdev, (uint8_t *)hcdc->data, req->wLength);
-            }
-            else
-            {
-              hcdc->CmdOpCode = req->bRequest;
-              hcdc->CmdLength = (uint8_t)req->wLength;
-
-              (void)USBD_CtlPrepareRx(pdev, (uint8_t *)hcdc->data, req->wLength);
-            }
+            ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(req->bRequest, (uint8_t *)hcdc->data, req->wLength, USBD_CfgParams[index].interfaceNumber);
+            
+            (void)USBD_CtlSendData(pdev, (uint8_t *)hcdc->data, req->wLength);
           }
           else
           {
-            ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(req->bRequest, (uint8_t *)req, 0U, USBD_CfgParams[index].interfaceNumber);
+            hcdc->CmdOpCode = req->bRequest;
+            hcdc->CmdLength = (uint8_t)req->wLength;
+
+            (void)USBD_CtlPrepareRx(pdev, (uint8_t *)hcdc->data, req->wLength);
           }
         }
+        else
+        {
+          ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(req->bRequest, (uint8_t *)req, 0U, USBD_CfgParams[index].interfaceNumber);
+        }
       }
     }
     break;
@@ -598,36 +584,39 @@ static uint8_t USBD_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
   USBD_CDC_HandleTypeDef *hcdc;
   PCD_HandleTypeDef *hpcd = pdev->pData;
-  uint8_t index;
+  uint8_t index = cdcInEpChannel[epnum & 0x0FU];
+
+  if ((pdev->pClassData != NULL) && (index == 0U) && (cdcCmdEpChannel[epnum & 0x0FU] != 0U))
+  {
+    /* Notification sent, command endpoint is free for the next one */
+    hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData + (cdcCmdEpChannel[epnum & 0x0FU] - 1U);
+    hcdc->NotifyState = 0U;
+
+    return (uint8_t)USBD_OK;
+  }
 
-  if (pdev->pClassData == NULL)
+  if ((pdev->pClassData == NULL) || (index == 0U))
   {
     return (uint8_t)USBD_FAIL;
   }
 
-  hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData;
+  index--;
+  hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData + index;
 
-  for (index = 0; index < NUM_OF_CDC_UARTS; index++,hcdc++)
+  if ((pdev->ep_in[epnum].total_length > 0U) && ((pdev->ep_in[epnum].total_length % hpcd->IN_ep[epnum].maxpacket) == 0U))
   {
-    if (USBD_CfgParams[index].data_in_ep == (epnum | 0x80))
-    {
-      if ((pdev->ep_in[epnum].total_length > 0U) && ((pdev->ep_in[epnum].total_length % hpcd->IN_ep[epnum].maxpacket) == 0U))
-      {
-        /* Update the packet total length */
-        pdev->ep_in[epnum].total_length = 0U;
+    /* Update the packet total length */
+    pdev->ep_in[epnum].total_length = 0U;
 
-        /* Send ZLP */
-        (void)USBD_LL_Transmit(pdev, epnum, NULL, 0U);
-      }
-      else
-      {
-        hcdc->TxState = 0U;
-        ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->TransmitCplt(hcdc->TxBuffer, &hcdc->TxLength, USBD_CfgParams[index].interfaceNumber);
-      }
-      
-      break;
-    }
+    /* Send ZLP */
+    (void)USBD_LL_Transmit(pdev, epnum, NULL, 0U);
   }
+  else
+  {
+    hcdc->TxState = 0U;
+    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->TransmitCplt(hcdc->TxBuffer, &hcdc->TxLength, USBD_CfgParams[index].interfaceNumber);
+  }
+
   return (uint8_t)USBD_OK;
 }
 
@@ -640,29 +629,24 @@ static uint8_t USBD_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
   */
 static uint8_t USBD_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData;
-  uint8_t index;
+  USBD_CDC_HandleTypeDef *hcdc;
+  uint8_t index = cdcOutEpChannel[epnum & 0x0FU];
 
-  if (pdev->pClassData == NULL)
+  if ((pdev->pClassData == NULL) || (index == 0U))
   {
     return (uint8_t)USBD_FAIL;
   }
 
-  for (index = 0; index < NUM_OF_CDC_UARTS; index++,hcdc++)
-  {
-    if (USBD_CfgParams[index].data_out_ep == epnum)
-    {
-      /* Get the received data length */
-      hcdc->RxLength = USBD_LL_GetRxDataSize(pdev, epnum);
+  index--;
+  hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData + index;
 
-      /* USB data will be immediately processed, this allow next USB traffic being
-      NAKed till the end of the application Xfer */
+  /* Get the received data length */
+  hcdc->RxLength = USBD_LL_GetRxDataSize(pdev, epnum);
 
-      ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Receive(hcdc->RxBuffer, &hcdc->RxLength, USBD_CfgParams[index].interfaceNumber);
+  /* USB data will be immediately processed, this allow next USB traffic being
+  NAKed till the end of the application Xfer */
 
-      break;
-    }
-  }
+  ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Receive(hcdc->RxBuffer, &hcdc->RxLength, USBD_CfgParams[index].interfaceNumber);
 
   return (uint8_t)USBD_OK;
 }
@@ -676,68 +660,45 @@ static uint8_t USBD_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 static uint8_t USBD_CDC_EP0_RxReady(USBD_HandleTypeDef *pdev)
 {
   USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData;
-  uint8_t index;
+  uint8_t index = 0U;
 
-  for (index = 0; index < NUM_OF_CDC_UARTS; index++,hcdc++)
+  if (pdev->request.wIndex < USBD_MAX_NUM_INTERFACES)
   {
-    if (USBD_CfgParams[index].command_itf != pdev->request.wIndex)
-    {
-      continue;
-    }
-    else
-    {
-      if ((pdev->pUserData != NULL) && (hcdc->CmdOpCode != 0xFFU))
-      {
-        ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(hcdc->CmdOpCode, (uint8_t *)hcdc->data, (uint16_t)hcdc->CmdLength, USBD_CfgParams[index].interfaceNumber);
-        hcdc->CmdOpCode = 0xFFU;
-
-      }
-    }
+    index = cdcCmdItfChannel[pdev->request.wIndex];
   }
 
-  return (uint8_t)USBD_OK;
-}
-
-/**
-  * @brief  USBD_CDC_GetFSCfgDesc
-  *         Return configuration descriptor
-  * @param  speed : current device speed
-  * @param  length : pointer data length
-  * @retval pointer to descriptor buffer
-  */
-uint8_t *USBD_CDC_GetFSCfgDesc(uint16_t *length)
-{
-  *length = (uint16_t)sizeof(USBD_Composite_CfgFSDesc);
+  if ((hcdc == NULL) || (index == 0U))
+  {
+    return (uint8_t)USBD_OK;
+  }
 
-  return (uint8_t *)&USBD_Composite_CfgFSDesc;
-}
+  index--;
+  hcdc += index;
 
-/**
-  * @brief  USBD_CDC_GetHSCfgDesc
-  *         Return configuration descriptor
-  * @param  speed : current device speed
-  * @param  length : pointer data length
-  * @retval pointer to descriptor buffer
-  */
-uint8_t *USBD_CDC_GetHSCfgDesc(uint16_t *length)
-{
-  *length = (uint16_t)sizeof(USBD_Composite_CfgHSDesc);
+  if ((pdev->pUserData != NULL) && (hcdc->CmdOpCode != 0xFFU))
+  {
+    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(hcdc->CmdOpCode, (uint8_t *)hcdc->data, (uint16_t)hcdc->CmdLength, USBD_CfgParams[index].interfaceNumber);
+    hcdc->CmdOpCode = 0xFFU;
+  }
 
-  return (uint8_t *)&USBD_Composite_CfgHSDesc;
+  return (uint8_t)USBD_OK;
 }
 
 /**
-  * @brief  USBD_CDC_GetCfgDesc
-  *         Return configuration descriptor
-  * @param  speed : current device speed
-  * @param  length : pointer data length
-  * @retval pointer to descriptor buffer
+  * @brief  USBD_CDC_SOF
+  *         Handle start of frame (1 ms FS, 125 us HS microframe)
+  * @param  pdev: device instance
+  * @retval status
   */
-uint8_t *USBD_CDC_GetOtherSpeedCfgDesc(uint16_t *length)
+static uint8_t USBD_CDC_SOF(USBD_HandleTypeDef *pdev)
 {
-  *length = (uint16_t)sizeof(USBD_Composite_CfgOtherDesc);
+  if ((pdev->pClassData != NULL) && (pdev->pUserData != NULL) &&
+      (((USBD_CDC_ItfTypeDef *)pdev->pUserData)->SOF != NULL))
+  {
+    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->SOF();
+  }
 
-  return (uint8_t *)&USBD_Composite_CfgOtherDesc;
+  return (uint8_t)USBD_OK;
 }
 
 /**
@@ -753,18 +714,52 @@ uint8_t *USBD_CDC_GetDeviceQualifierDescriptor(uint16_t *length)
   return USBD_CDC_DeviceQualifierDesc;
 }
 
+/**
+  * @brief  USBD_CDC_GetChannel
+  *         Channel of a logical CDC interface number
+  * @param  pdev: device instance
+  * @param  interfaceNumber: CDC interface number, CDC_ITF_NUMBER_x
+  * @param  index: channel index in USBD_CfgParams
+  * @retval channel context, NULL if the class is not configured or there is
+  *         no such channel
+  */
+static USBD_CDC_HandleTypeDef *USBD_CDC_GetChannel(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber, uint8_t *index)
+{
+  uint8_t channel = 0U;
+
+  if ((pdev->pClassData != NULL) && (interfaceNumber <= NUM_OF_CDC_UARTS))
+  {
+    channel = cdcItfNumberChannel[interfaceNumber];
+  }
+
+  if (channel == 0U)
+  {
+    return NULL;
+  }
+
+  *index = channel - 1U;
+
+  return (USBD_CDC_HandleTypeDef *)pdev->pClassData + *index;
+}
+
+/**
+  * @brief  USBD_CDC_CheckSendingAvailable
+  *         Check if IN endpoint of the channel is idle
+  * @param  pdev: device instance
+  * @param  interfaceNumber: CDC interface number
+  * @retval USBD_OK if idle, USBD_BUSY during a transfer, USBD_FAIL if the
+  *         class is not configured or there is no such channel
+  */
 uint8_t USBD_CDC_CheckSendingAvailable(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData;
+  USBD_CDC_HandleTypeDef *hcdc;
   uint8_t index;
-  
-  //Switch to correct handler
-  for (index = 0; index < NUM_OF_CDC_UARTS; index++,hcdc++)
+
+  hcdc = USBD_CDC_GetChannel(pdev, interfaceNumber, &index);
+
+  if (hcdc == NULL)
   {
-    if (USBD_CfgParams[index].interfaceNumber == interfaceNumber)
-    {
-      break;
-    }
+    return (uint8_t)USBD_FAIL;
   }
 
   if (hcdc->TxState != 0)
@@ -803,16 +798,14 @@ uint8_t USBD_CDC_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_CDC_ItfTypeDef
   */
 uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber, uint8_t *pbuff, uint32_t length)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData;
+  USBD_CDC_HandleTypeDef *hcdc;
   uint8_t index;
 
-  //Switch to correct handler
-  for (index = 0; index < NUM_OF_CDC_UARTS; index++,hcdc++)
+  hcdc = USBD_CDC_GetChannel(pdev, interfaceNumber, &index);
+
+  if (hcdc == NULL)
   {
-    if (USBD_CfgParams[index].interfaceNumber == interfaceNumber)
-    {
-      break;
-    }
+    return (uint8_t)USBD_FAIL;
   }
   
   hcdc->TxBuffer = pbuff;
@@ -830,16 +823,14 @@ uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber,
   */
 uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber, uint8_t *pbuff)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData;
+  USBD_CDC_HandleTypeDef *hcdc;
   uint8_t index;
 
-  //Switch to correct handler
-  for (index = 0; index < NUM_OF_CDC_UARTS; index++,hcdc++)
+  hcdc = USBD_CDC_GetChannel(pdev, interfaceNumber, &index);
+
+  if (hcdc == NULL)
   {
-    if (USBD_CfgParams[index].interfaceNumber == interfaceNumber)
-    {
-      break;
-    }
+    return (uint8_t)USBD_FAIL;
   }
 
   hcdc->RxBuffer = pbuff;
@@ -855,22 +846,15 @@ uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber,
   */
 uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData;
+  USBD_CDC_HandleTypeDef *hcdc;
   USBD_StatusTypeDef ret = USBD_BUSY;
   uint8_t index;
 
-  if (pdev->pClassData == NULL)
-  {
-    return (uint8_t)USBD_FAIL;
-  }
+  hcdc = USBD_CDC_GetChannel(pdev, interfaceNumber, &index);
 
-  //Switch to correct handler
-  for (index = 0; index < NUM_OF_CDC_UARTS; index++,hcdc++)
+  if (hcdc == NULL)
   {
-    if (USBD_CfgParams[index].interfaceNumber == interfaceNumber)
-    {
-      break;
-    }
+    return (uint8_t)USBD_FAIL;
   }
 
   if (hcdc->TxState == 0U)
@@ -891,6 +875,51 @@ uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t interfaceNumbe
 }
 
 
+/**
+  * @brief  USBD_CDC_SendSerialState
+  *         Send SERIAL_STATE notification on command endpoint
+  * @param  pdev: device instance
+  * @param  interfaceNumber: CDC interface number
+  * @param  serialState: CDC_SERIAL_STATE_xxx bitmap
+  * @retval status, USBD_BUSY while previous notification is not sent
+  */
+uint8_t USBD_CDC_SendSerialState(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber, uint16_t serialState)
+{
+  USBD_CDC_HandleTypeDef *hcdc;
+  uint8_t *packet;
+  uint8_t index;
+
+  hcdc = USBD_CDC_GetChannel(pdev, interfaceNumber, &index);
+
+  if ((hcdc == NULL) || (pdev->dev_state != USBD_STATE_CONFIGURED))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if (hcdc->NotifyState != 0U)
+  {
+    return (uint8_t)USBD_BUSY;
+  }
+
+  hcdc->NotifyState = 1U;
+
+  packet = (uint8_t *)hcdc->Notification;
+  packet[0] = CDC_NOTIFICATION_REQUEST_TYPE;
+  packet[1] = CDC_NOTIFICATION_SERIAL_STATE;
+  packet[2] = 0U;                                      /* wValue */
+  packet[3] = 0U;
+  packet[4] = USBD_CfgParams[index].command_itf;       /* wIndex: interface */
+  packet[5] = 0U;
+  packet[6] = 2U;                                      /* wLength */
+  packet[7] = 0U;
+  packet[8] = LOBYTE(serialState);
+  packet[9] = HIBYTE(serialState);
+
+  USBD_LL_Transmit(pdev, USBD_CfgParams[index].command_ep, packet, CDC_NOTIFICATION_SERIAL_STATE_SIZE);
+
+  return (uint8_t)USBD_OK;
+}
+
 /**
   * @brief  USBD_CDC_ReceivePacket
   *         prepare OUT Endpoint for reception
@@ -899,21 +928,14 @@ uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t interfaceNumbe
   */
 uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev, uint8_t interfaceNumber)
 {
-  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)pdev->pClassData;
+  USBD_CDC_HandleTypeDef *hcdc;
   uint8_t index;
 
-  if (pdev->pClassData == NULL)
-  {
-    return (uint8_t)USBD_FAIL;
-  }
+  hcdc = USBD_CDC_GetChannel(pdev, interfaceNumber, &index);
 
-  //Switch to correct handler
-  for (index = 0; index < NUM_OF_CDC_UARTS; index++,hcdc++)
+  if (hcdc == NULL)
   {
-    if (USBD_CfgParams[index].interfaceNumber == interfaceNumber)
-    {
-      break;
-    }
+    return (uint8_t)USBD_FAIL;
   }
 
   if (pdev->dev_speed == USBD_SPEED_HIGH)
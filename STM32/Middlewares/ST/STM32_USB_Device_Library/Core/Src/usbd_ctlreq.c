@@ -406,12 +406,20 @@ static void USBD_GetDescriptor(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *r
     if (pdev->dev_speed == USBD_SPEED_HIGH)
     {
       pbuf = pdev->pClass->GetHSConfigDescriptor(&len);
-      pbuf[1] = USB_DESC_TYPE_CONFIGURATION;
+      /* Descriptor may be const in flash: write only a wrong type */
+      if (pbuf[1] != USB_DESC_TYPE_CONFIGURATION)
+      {
+        pbuf[1] = USB_DESC_TYPE_CONFIGURATION;
+      }
     }
     else
     {
       pbuf = pdev->pClass->GetFSConfigDescriptor(&len);
-      pbuf[1] = USB_DESC_TYPE_CONFIGURATION;
+      /* Descriptor may be const in flash: write only a wrong type */
+      if (pbuf[1] != USB_DESC_TYPE_CONFIGURATION)
+      {
+        pbuf[1] = USB_DESC_TYPE_CONFIGURATION;
+      }
     }
     break;
 
@@ -535,7 +543,11 @@ static void USBD_GetDescriptor(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *r
     if (pdev->dev_speed == USBD_SPEED_HIGH)
     {
       pbuf = pdev->pClass->GetOtherSpeedConfigDescriptor(&len);
-      pbuf[1] = USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION;
+      /* Descriptor may be const in flash: write only a wrong type */
+      if (pbuf[1] != USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION)
+      {
+        pbuf[1] = USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION;
+      }
     }
     else
     {
@@ -0,0 +1,657 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    CanCaptureTest.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+/*
+ * Host test of the capture engine against the bxCAN model of HostCan.c.
+ * Every bus carries back to back frames at 1 Mbit/s, 100 % load, time runs
+ * in bit times (1 us). The test stands for the NVIC: the Rx ISR of a FIFO
+ * runs a fixed latency after its first pending frame, CanCapture_Run runs
+ * once per 1 ms like a busy main loop. Every frame must reach the SLCAN
+ * stream once with its content and timestamp, no FIFO overrun and no queue
+ * drop allowed. Order holds per Rx FIFO: even and odd identifiers take
+ * different FIFOs, a late ISR may drain them in either order. The blocked
+ * ISR case must see the overrun reported, the last cases check the Tx
+ * mailboxes and the Tx ISR refill of the silent loopback load test. Build
+ * with CAN_CAPTURE_TTCM=1 to check SOF spaced timestamps.
+ */
+
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+/*-- Project specific includes ----------------------------------------------*/
+#include "can.h"
+#include "CanCapture.h"
+#include "usbd_vcp.h"
+#include "HostHal.h"
+#include "HostCan.h"
+
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+#if (USB_VCP_SLCAN != 1)
+#error "CanCaptureTest reads the SLCAN stream, build with USB_VCP_SLCAN=1"
+#endif
+
+//Frames a bus may carry in one case
+#define TEST_MAX_FRAMES					32768
+
+//Main loop period, bit times
+#define TEST_RUN_PERIOD					1000
+
+//Lowest frame rate of 8 byte data frames at full 1 Mbit/s load, frames/s
+#define TEST_MIN_RATE_DATA8				8000
+
+/*-- Local typedefs ---------------------------------------------------------*/
+typedef enum
+{
+	TEST_TRAFFIC_DATA8 = 0,					//Standard data frames, 8 bytes
+	TEST_TRAFFIC_MIXED,						//Standard, extended, remote, 0..8 bytes
+}Test_Traffic_t;
+
+typedef struct
+{
+	const char *Name;
+	Test_Traffic_t Traffic;
+	uint32_t Duration;						//Bit times
+	uint32_t IrqLatency;					//Bit times from first pending frame to ISR
+	bool ExpectOverrun;
+}Test_Case_t;
+
+//Frame on the bus and its way through the engine
+typedef struct
+{
+	uint32_t Sof;							//Bit time of start of frame
+	uint64_t Expected;						//Timestamp the frame must carry
+	bool Drained;
+}Test_Frame_t;
+
+typedef struct
+{
+	uint32_t Sent;
+	uint32_t NextEnd;						//Bit time the next frame is complete
+	uint32_t Received;						//Frames on the SLCAN stream
+	uint32_t Errors;
+	uint32_t Order[2][TEST_MAX_FRAMES];		//Frames a FIFO stored, oldest first
+	uint32_t Written[2];					//Frames stored, lost ones excluded
+	uint32_t Drained[2];					//Frames ISR read out
+	uint32_t Read[2];						//Frames on the SLCAN stream
+	uint64_t LastTimestamp[2];
+	int64_t PendingSince[2];				//Bit time FIFO became pending, -1 idle
+	uint32_t IrqCalls;
+}Test_Bus_t;
+
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+static const Test_Case_t testCases[] =
+{
+	{ "8 byte frames",               TEST_TRAFFIC_DATA8, 1000000, 20,   false },
+	{ "mixed frames",                TEST_TRAFFIC_MIXED, 1000000, 20,   false },
+	{ "mixed frames, ISR +100 us",   TEST_TRAFFIC_MIXED, 1000000, 100,  false },
+	{ "8 byte frames, ISR blocked",  TEST_TRAFFIC_DATA8, 100000,  2000, true  },
+};
+
+static Test_Frame_t testFrames[CAN_CAPTURE_NUM_BUSES][TEST_MAX_FRAMES];
+static Test_Bus_t testBuses[CAN_CAPTURE_NUM_BUSES];
+static const Test_Case_t *testCase;
+static uint64_t testNow;
+static uint32_t testOverrunEvents;
+
+static HostHal_Latency_t testIrq;
+
+/*-- Local functions --------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Frame number sequence of a bus.
+ *
+ *  @param  bus - bus index.
+ *  @param  sequence - frame number.
+ *  @param  frame - frame filled.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_MakeFrame(uint8_t bus, uint32_t sequence, CanFrame_t *frame)
+{
+	uint32_t index;
+
+	memset(frame, 0, sizeof(*frame));
+	frame->Bus = bus;
+
+	if(testCase->Traffic == TEST_TRAFFIC_DATA8)
+	{
+		frame->Id = (sequence * 5U + bus) & 0x7FFU;
+		frame->Dlc = CAN_FRAME_MAX_DATA;
+	}
+	else
+	{
+		switch(sequence % 4)
+		{
+			case 1:
+			{
+				frame->Flags = CAN_FRAME_FLAG_EXT;
+				frame->Id = (sequence * 0x10001U + bus) & 0x1FFFFFFFU;
+			}
+			break;
+
+			case 3:
+			{
+				frame->Flags = CAN_FRAME_FLAG_RTR;
+				frame->Id = (sequence * 7U + bus) & 0x7FFU;
+			}
+			break;
+
+			default:
+			{
+				frame->Id = (sequence * 7U + bus) & 0x7FFU;
+			}
+			break;
+		}
+		frame->Dlc = (uint8_t)(sequence % (CAN_FRAME_MAX_DATA + 1));
+	}
+
+	if(!(frame->Flags & CAN_FRAME_FLAG_RTR))
+	{
+		for(index = 0; index < frame->Dlc; index++)
+		{
+			frame->Data[index] = (index < 4) ? (uint8_t)(sequence >> (8 * index)) : (uint8_t)(sequence * 31U + index + bus);
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  Run Rx ISR of a FIFO and note timestamps its frames must carry:
+ *          ISR entry time, with TTCM the newest frame at ISR time and older
+ *          ones back from it by SOF distance.
+ *
+ *  @param  bus - bus index.
+ *  @param  fifo - CAN_RX_FIFO0 or CAN_RX_FIFO1.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_RunIrq(uint8_t bus, uint32_t fifo)
+{
+	Test_Bus_t *testBus = &testBuses[bus];
+	uint32_t released = HostCan_GetReleased(bus, fifo);
+	uint32_t stored;
+	uint32_t newest;
+	uint32_t index;
+	uint64_t start;
+
+	start = HostHal_Cycles();
+	CanCapture_RxIrqHandler(bus, fifo);
+	HostHal_LatencyAdd(&testIrq, start);
+	testBus->IrqCalls++;
+
+	released = HostCan_GetReleased(bus, fifo) - released;
+	stored = testBus->Written[fifo] - testBus->Drained[fifo];
+	if((released == 0) || (released > stored))
+	{
+		printf("FAIL: bus %u FIFO %u ISR released %u of %u frames\n", bus, fifo, released, stored);
+		testBus->Errors++;
+		return;
+	}
+
+	newest = testBus->Order[fifo][testBus->Drained[fifo] + released - 1];
+	for(index = 0; index < released; index++)
+	{
+		Test_Frame_t *testFrame = &testFrames[bus][testBus->Order[fifo][testBus->Drained[fifo] + index]];
+
+#if (CAN_CAPTURE_TTCM == 1)
+		testFrame->Expected = testNow - (testFrames[bus][newest].Sof - testFrame->Sof);
+#else
+		(void)newest;
+		testFrame->Expected = testNow;
+#endif
+		testFrame->Drained = true;
+	}
+
+	testBus->Drained[fifo] += released;
+}
+
+/******************************************************************************
+ *  @brief  Put the next frame of a bus on the wire.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_SendFrame(uint8_t bus)
+{
+	Test_Bus_t *testBus = &testBuses[bus];
+	uint32_t sequence = testBus->Sent;
+	uint32_t lost = HostCan_GetLost(bus);
+	CanFrame_t frame;
+	int32_t fifo;
+
+	Test_MakeFrame(bus, sequence, &frame);
+	testFrames[bus][sequence].Sof = (uint32_t)testNow - HostCan_FrameBits(&frame);
+	testFrames[bus][sequence].Drained = false;
+
+	fifo = HostCan_Receive(bus, &frame, testFrames[bus][sequence].Sof);
+	if(fifo == HOST_CAN_FILTERED)
+	{
+		printf("FAIL: bus %u frame %u filtered\n", bus, sequence);
+		testBus->Errors++;
+	}
+	else
+	{
+		//Full FIFO: the new frame replaced the last mailbox
+		if(HostCan_GetLost(bus) != lost)
+		{
+			testBus->Written[fifo]--;
+		}
+		testBus->Order[fifo][testBus->Written[fifo]++] = sequence;
+
+		if(testBus->PendingSince[fifo] < 0)
+		{
+			testBus->PendingSince[fifo] = (int64_t)testNow;
+		}
+	}
+
+	testBus->Sent++;
+	Test_MakeFrame(bus, testBus->Sent, &frame);
+	testBus->NextEnd += HostCan_FrameBits(&frame);
+}
+
+/******************************************************************************
+ *  @brief  Run one case bit time by bit time, then drain the engine.
+ *
+ *  @param  runCase - case parameters.
+ *
+ *  @retval count of errors.
+ *****************************************************************************/
+static uint32_t Test_RunCase(const Test_Case_t *runCase)
+{
+	CanCapture_Stats_t before[CAN_CAPTURE_NUM_BUSES];
+	CanCapture_Stats_t stats;
+	uint32_t allocations = HostHal_Allocations;
+	uint32_t errors = 0;
+	uint32_t lost[CAN_CAPTURE_NUM_BUSES];
+	uint32_t end;
+	uint32_t run;
+	uint8_t bus;
+
+	testCase = runCase;
+	memset(testBuses, 0, sizeof(testBuses));
+	memset(&testIrq, 0, sizeof(testIrq));
+	testOverrunEvents = 0;
+	end = (uint32_t)testNow + runCase->Duration;
+
+	for(bus = 0; bus < CAN_CAPTURE_NUM_BUSES; bus++)
+	{
+		CanFrame_t frame;
+
+		CanCapture_GetStats(bus, &before[bus]);
+		lost[bus] = HostCan_GetLost(bus);
+		testBuses[bus].PendingSince[0] = -1;
+		testBuses[bus].PendingSince[1] = -1;
+		Test_MakeFrame(bus, 0, &frame);
+		testBuses[bus].NextEnd = (uint32_t)testNow + HostCan_FrameBits(&frame);
+	}
+
+	for(; testNow < end; testNow++)
+	{
+		for(bus = 0; bus < CAN_CAPTURE_NUM_BUSES; bus++)
+		{
+			uint32_t fifo;
+
+			if((testNow == testBuses[bus].NextEnd) && (testBuses[bus].Sent < TEST_MAX_FRAMES))
+			{
+				Test_SendFrame(bus);
+			}
+
+			for(fifo = CAN_RX_FIFO0; fifo <= CAN_RX_FIFO1; fifo++)
+			{
+				if((testBuses[bus].PendingSince[fifo] >= 0) && ((testNow - (uint64_t)testBuses[bus].PendingSince[fifo]) >= runCase->IrqLatency) &&
+				   (HostCan_IsRxPending(bus, fifo)))
+				{
+					Test_RunIrq(bus, fifo);
+					testBuses[bus].PendingSince[fifo] = HostCan_IsRxPending(bus, fifo) ? (int64_t)testNow : -1;
+				}
+			}
+		}
+
+		if((testNow % TEST_RUN_PERIOD) == 0)
+		{
+			HostHal_AdvanceTick(1);
+			CanCapture_Run();
+		}
+	}
+
+	//Bus goes idle, ISR and main loop drain what is left
+	for(run = 0; run < 64; run++)
+	{
+		for(bus = 0; bus < CAN_CAPTURE_NUM_BUSES; bus++)
+		{
+			uint32_t fifo;
+
+			for(fifo = CAN_RX_FIFO0; fifo <= CAN_RX_FIFO1; fifo++)
+			{
+				if(HostCan_IsRxPending(bus, fifo))
+				{
+					Test_RunIrq(bus, fifo);
+				}
+			}
+		}
+		testNow += TEST_RUN_PERIOD;
+		HostHal_AdvanceTick(1);
+		CanCapture_Run();
+	}
+
+	for(bus = 0; bus < CAN_CAPTURE_NUM_BUSES; bus++)
+	{
+		Test_Bus_t *testBus = &testBuses[bus];
+		uint32_t busLost = HostCan_GetLost(bus) - lost[bus];
+		uint32_t rate = (uint32_t)(((uint64_t)testBus->Sent * 1000000ULL) / runCase->Duration);
+
+		CanCapture_GetStats(bus, &stats);
+		stats.RxFrames -= before[bus].RxFrames;
+		stats.FifoOverruns -= before[bus].FifoOverruns;
+		stats.QueueDropped -= before[bus].QueueDropped;
+
+		errors += testBus->Errors;
+
+		if(runCase->ExpectOverrun)
+		{
+			if((busLost == 0) || (stats.FifoOverruns == 0) || (testOverrunEvents == 0) ||
+			   (testBus->Received + busLost != testBus->Sent))
+			{
+				printf("FAIL: bus %u blocked ISR: %u lost, %u overruns, %u events, %u of %u frames received\n",
+					   bus, busLost, stats.FifoOverruns, testOverrunEvents, testBus->Received, testBus->Sent);
+				errors++;
+			}
+		}
+		else
+		{
+			if((busLost > 0) || (stats.FifoOverruns > 0) || (stats.QueueDropped > 0) ||
+			   (stats.RxFrames != testBus->Sent) || (testBus->Received != testBus->Sent))
+			{
+				printf("FAIL: bus %u: %u lost, %u overruns, %u queue drops, %u of %u frames received\n",
+					   bus, busLost, stats.FifoOverruns, stats.QueueDropped, testBus->Received, testBus->Sent);
+				errors++;
+			}
+			if((runCase->Traffic == TEST_TRAFFIC_DATA8) && (rate < TEST_MIN_RATE_DATA8))
+			{
+				printf("FAIL: bus %u carried %u frames/s\n", bus, rate);
+				errors++;
+			}
+		}
+
+		printf("%-28s bus %u %6u frames/s %6u frames %3u lost, %5u ISR calls, queue high water %u\n",
+			   runCase->Name, bus, rate, testBus->Sent, busLost, testBus->IrqCalls, stats.QueueHighWater);
+	}
+
+	printf("    Rx ISR %lu calls, %.0f avg %lu max %s\n", (unsigned long)testIrq.Calls, HostHal_LatencyAverage(&testIrq),
+		   (unsigned long)testIrq.Max, HostHal_CyclesUnit());
+
+	allocations = HostHal_Allocations - allocations;
+	if(allocations > 0)
+	{
+		printf("FAIL: %u heap calls\n", allocations);
+		errors++;
+	}
+
+	return errors;
+}
+
+/******************************************************************************
+ *  @brief  Fill the Tx mailboxes of bus 0, complete them one aborted, two
+ *          sent and check the stats Tx ISR keeps.
+ *
+ *  @retval count of errors.
+ *****************************************************************************/
+static uint32_t Test_RunTx(void)
+{
+	CanCapture_Stats_t before;
+	CanCapture_Stats_t stats;
+	CanFrame_t frame;
+	CanFrame_t sent;
+	uint32_t errors = 0;
+	uint32_t index;
+
+	//Silent mode never sends, bus goes on the wire
+	if((!CanCapture_Close(0)) || (!CanCapture_Open(0, CAN_CAPTURE_MODE_NORMAL)))
+	{
+		printf("FAIL: bus 0 open in normal mode\n");
+		return 1;
+	}
+
+	CanCapture_GetStats(0, &before);
+	memset(&frame, 0, sizeof(frame));
+	frame.Dlc = 2;
+
+	for(index = 0; index < 3; index++)
+	{
+		frame.Id = 0x100U + index;
+		frame.Data[0] = (uint8_t)index;
+		if(!CanCapture_Transmit(0, &frame))
+		{
+			printf("FAIL: Tx mailbox %u refused\n", index);
+			errors++;
+		}
+	}
+
+	if(CanCapture_Transmit(0, &frame))
+	{
+		printf("FAIL: Tx accepted with all mailboxes pending\n");
+		errors++;
+	}
+
+	for(index = 0; index < 3; index++)
+	{
+		if((!HostCan_Transmit(0, &sent, index != 1)) || (sent.Id != 0x100U + index) || (sent.Dlc != 2) || (sent.Data[0] != index))
+		{
+			printf("FAIL: Tx mailbox %u content, id %lx\n", index, (unsigned long)sent.Id);
+			errors++;
+		}
+		CanCapture_TxIrqHandler(0);
+	}
+
+	CanCapture_GetStats(0, &stats);
+	if(HostCan_IsTxPending(0) || (stats.TxFrames - before.TxFrames != 2) || (stats.TxErrors - before.TxErrors != 1))
+	{
+		printf("FAIL: Tx ISR: %u sent, %u errors\n", stats.TxFrames - before.TxFrames, stats.TxErrors - before.TxErrors);
+		errors++;
+	}
+
+	printf("%-28s 3 mailboxes, %u sent, %u aborted\n", "Tx", stats.TxFrames - before.TxFrames, stats.TxErrors - before.TxErrors);
+
+	return errors;
+}
+
+/******************************************************************************
+ *  @brief  Load test: silent loopback only, Tx ISR refills every mailbox it
+ *          completes, switch to a mode which reaches the bus stops it.
+ *
+ *  @retval count of errors.
+ *****************************************************************************/
+static uint32_t Test_RunLoadTest(void)
+{
+	CanCapture_Stats_t before;
+	CanCapture_Stats_t stats;
+	CanFrame_t sent;
+	uint32_t errors = 0;
+	uint32_t index;
+
+	if(CanCapture_SetLoadTest(0, true))
+	{
+		printf("FAIL: load test started in normal mode\n");
+		errors++;
+	}
+
+	if((!CanCapture_SetMode(0, CAN_CAPTURE_MODE_LOOPBACK)) || (CanCapture_SetLoadTest(0, true)))
+	{
+		printf("FAIL: load test started in loopback mode\n");
+		errors++;
+	}
+
+	if((!CanCapture_SetMode(0, CAN_CAPTURE_MODE_SILENT_LOOPBACK)) || (!CanCapture_SetLoadTest(0, true)))
+	{
+		printf("FAIL: load test refused in silent loopback mode\n");
+		return errors + 1;
+	}
+
+	//Main loop fills the mailboxes, from then on the Tx ISR keeps them full
+	CanCapture_GetStats(0, &before);
+	CanCapture_Run();
+
+	for(index = 0; index < 6; index++)
+	{
+		if((!HostCan_Transmit(0, &sent, true)) || (sent.Data[0] != (uint8_t)(before.LoadTestFrames + index)))
+		{
+			printf("FAIL: load test frame %u\n", index);
+			errors++;
+		}
+		CanCapture_TxIrqHandler(0);
+	}
+
+	CanCapture_GetStats(0, &stats);
+	if((stats.LoadTestFrames - before.LoadTestFrames != 3 + 6) || (HAL_CAN_GetTxMailboxesFreeLevel(&hcan1) != 0))
+	{
+		printf("FAIL: Tx ISR refill, %u frames queued\n", stats.LoadTestFrames - before.LoadTestFrames);
+		errors++;
+	}
+
+	printf("%-28s %u frames, %u refilled by Tx ISR\n", "Load test", stats.LoadTestFrames - before.LoadTestFrames, index);
+
+	//Loopback also drives the bus: test stops, pending frames drain
+	CanCapture_SetMode(0, CAN_CAPTURE_MODE_LOOPBACK);
+	while(HostCan_Transmit(0, &sent, true))
+	{
+		CanCapture_TxIrqHandler(0);
+	}
+
+	CanCapture_Run();
+	CanCapture_GetStats(0, &before);
+	if((before.LoadTestFrames != stats.LoadTestFrames) || (HostCan_IsTxPending(0)) || (HAL_CAN_GetTxMailboxesFreeLevel(&hcan1) != 3))
+	{
+		printf("FAIL: load test kept in loopback mode\n");
+		errors++;
+	}
+
+	return errors;
+}
+
+/*-- Stubs of the USB side --------------------------------------------------*/
+uint64_t Timestamp_Get(void)
+{
+	return testNow;
+}
+
+void USB_VCP_NotifyEvent(uint8_t interfaceNumber, uint16_t events)
+{
+	if(events & USB_VCP_EVENT_RX_OVERRUN)
+	{
+		testOverrunEvents++;
+	}
+}
+
+void USB_VCP_SlcanSetBackend(const Slcan_Backend_t *backend)
+{
+}
+
+bool USB_VCP_VendorSendFrame(const CanFrame_t *frame)
+{
+	return true;
+}
+
+bool USB_VCP_SlcanSendFrame(uint8_t interfaceNumber, const CanFrame_t *frame)
+{
+	Test_Bus_t *testBus;
+	Test_Frame_t *testFrame;
+	CanFrame_t expected;
+	uint32_t sequence;
+	uint32_t rir;
+	int32_t fifo;
+
+	if(frame->Bus >= CAN_CAPTURE_NUM_BUSES)
+	{
+		printf("FAIL: frame of bus %u\n", frame->Bus);
+		testBuses[0].Errors++;
+		return true;
+	}
+
+	//Frame is the oldest of its FIFO not yet streamed
+	testBus = &testBuses[frame->Bus];
+	rir = (frame->Flags & CAN_FRAME_FLAG_EXT) ? ((frame->Id << CAN_RI0R_EXID_Pos) | CAN_RI0R_IDE) : (frame->Id << CAN_RI0R_STID_Pos);
+	rir |= (frame->Flags & CAN_FRAME_FLAG_RTR) ? CAN_RI0R_RTR : 0;
+	fifo = HostCan_FilterMatch(frame->Bus, rir);
+
+	if((fifo == HOST_CAN_FILTERED) || (testBus->Read[fifo] >= testBus->Drained[fifo]))
+	{
+		printf("FAIL: bus %u frame id %lx not drained\n", frame->Bus, (unsigned long)frame->Id);
+		testBus->Errors++;
+		return true;
+	}
+
+	sequence = testBus->Order[fifo][testBus->Read[fifo]++];
+
+	testFrame = &testFrames[frame->Bus][sequence];
+	Test_MakeFrame(frame->Bus, sequence, &expected);
+
+	if((frame->Id != expected.Id) || (frame->Flags != expected.Flags) || (frame->Dlc != expected.Dlc) ||
+	   ((!(frame->Flags & CAN_FRAME_FLAG_RTR)) && (memcmp(frame->Data, expected.Data, frame->Dlc) != 0)))
+	{
+		if(testBus->Errors++ < 8)
+		{
+			printf("FAIL: bus %u frame %u content, id %lx flags %x dlc %u\n", frame->Bus, sequence, (unsigned long)frame->Id, frame->Flags, frame->Dlc);
+		}
+	}
+	else if((!testFrame->Drained) || (frame->Timestamp != testFrame->Expected) || (frame->Timestamp < testBus->LastTimestamp[fifo]))
+	{
+		if(testBus->Errors++ < 8)
+		{
+			printf("FAIL: bus %u frame %u timestamp %llu, %llu expected, SOF at %u\n", frame->Bus, sequence,
+				   (unsigned long long)frame->Timestamp, (unsigned long long)testFrame->Expected, testFrame->Sof);
+		}
+	}
+
+	testBus->LastTimestamp[fifo] = frame->Timestamp;
+	testBus->Received++;
+
+	return true;
+}
+
+/*-- Exported functions -----------------------------------------------------*/
+int main(void)
+{
+	uint32_t errors = 0;
+	uint32_t index;
+	uint8_t bus;
+
+	CanCapture_Init();
+
+	//Frames before the first case start with a bus-long gap of time
+	testNow = TEST_RUN_PERIOD;
+
+	for(bus = 0; bus < CAN_CAPTURE_NUM_BUSES; bus++)
+	{
+		if((!CanCapture_SetBitrate(bus, 1000000)) || (!CanCapture_Open(bus, CAN_CAPTURE_MODE_SILENT)))
+		{
+			printf("FAIL: bus %u open at 1 Mbit/s\n", bus);
+			return 1;
+		}
+	}
+
+	printf("CAN capture, %u buses at 1 Mbit/s full load, TTCM %u\n", CAN_CAPTURE_NUM_BUSES, CAN_CAPTURE_TTCM);
+
+	for(index = 0; index < sizeof(testCases) / sizeof(testCases[0]); index++)
+	{
+		errors += Test_RunCase(&testCases[index]);
+	}
+
+	errors += Test_RunTx();
+	errors += Test_RunLoadTest();
+
+	return (errors > 0) ? 1 : 0;
+}
+/*-- EOF --------------------------------------------------------------------*/
@@ -0,0 +1,467 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    CanFilterTest.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+/*
+ * Host test of the acceptance filter compiler. Every rule set is compiled
+ * into filter banks, then each frame of the 11 bit identifier space, data
+ * and remote, is run through the banks as bxCAN would and through the
+ * software check of a superset bank. The verdict must equal the rules as
+ * written. The 29 bit space is swept whole for one rule set; the others
+ * sweep every identifier bit a 16 bit bank compares against low bits taken
+ * from rule bounds.
+ */
+
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+#include "CanFilter.h"
+
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+#define TEST_STD_ID_MAX					0x7FFU
+#define TEST_EXT_ID_MAX					0x1FFFFFFFU
+
+//Extended identifier bits a 16 bit bank sees: ID[28:18] as STID, ID[17:15]
+#define TEST_EXT_LOW_BITS				15
+#define TEST_EXT_LOW_MAX				((1U << TEST_EXT_LOW_BITS) - 1)
+
+#define TEST_MAX_RULES					24
+#define TEST_MAX_LOW					(4 * 2 * TEST_MAX_RULES + 2)
+
+//Mismatches printed per rule set
+#define TEST_MAX_REPORTS				8
+
+/*-- Local typedefs ---------------------------------------------------------*/
+typedef enum
+{
+	TEST_RULE_RANGE = 0,					//A - first, B - last
+	TEST_RULE_MASK,							//A - identifier, B - mask
+}Test_RuleType_t;
+
+typedef struct
+{
+	Test_RuleType_t Type;
+	uint32_t A;
+	uint32_t B;
+	uint8_t Flags;							//CAN_FILTER_FLAG_xxx
+}Test_Rule_t;
+
+typedef struct
+{
+	const char *Name;
+	uint32_t MaxBanks;
+	bool FullSweep;							//Whole 29 bit space
+	bool ExpectSoftware;					//Rules do not fit the banks
+	uint32_t Count;
+	Test_Rule_t Rules[TEST_MAX_RULES];
+}Test_Set_t;
+
+typedef struct
+{
+	uint32_t Frames;
+	uint32_t Accepted;
+	uint32_t Software;						//Frames passed by the superset bank
+	uint32_t Errors;
+}Test_Result_t;
+
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+static const Test_Set_t testSets[] =
+{
+	{
+		"standard ranges and identifiers", CAN_FILTER_MAX_BANKS, false, false, 7,
+		{
+			{ TEST_RULE_RANGE, 0x100,      0x17F,      0 },
+			{ TEST_RULE_MASK,  0x123,      0x7FF,      CAN_FILTER_FLAG_DATA_ONLY },
+			{ TEST_RULE_MASK,  0x321,      0x7FF,      CAN_FILTER_FLAG_DATA_ONLY },
+			{ TEST_RULE_MASK,  0x555,      0x7FF,      0 },
+			{ TEST_RULE_RANGE, 0x7F0,      0x7FF,      CAN_FILTER_FLAG_REMOTE_ONLY },
+			{ TEST_RULE_RANGE, 0x001,      0x00A,      0 },
+			{ TEST_RULE_MASK,  0x600,      0x70F,      CAN_FILTER_FLAG_DATA_ONLY },
+		}
+	},
+	{
+		"extended masks and identifiers", CAN_FILTER_MAX_BANKS, true, false, 8,
+		{
+			{ TEST_RULE_MASK,  0x18DA00F1, 0x1FFF00FF, CAN_FILTER_FLAG_EXT },
+			{ TEST_RULE_MASK,  0x01234567, 0x1FFFFFFF, CAN_FILTER_FLAG_EXT | CAN_FILTER_FLAG_DATA_ONLY },
+			{ TEST_RULE_RANGE, 0x18FEF000, 0x18FEF0FF, CAN_FILTER_FLAG_EXT },
+			{ TEST_RULE_MASK,  0x0CF00400, 0x03FFFF00, CAN_FILTER_FLAG_EXT | CAN_FILTER_FLAG_REMOTE_ONLY },
+			{ TEST_RULE_RANGE, 0x00040000, 0x000BFFFF, CAN_FILTER_FLAG_EXT },
+			{ TEST_RULE_MASK,  0x1FFFFFFF, 0x1FFFFFFF, CAN_FILTER_FLAG_EXT },
+			{ TEST_RULE_MASK,  0x7DF,      0x7FF,      0 },
+			{ TEST_RULE_RANGE, 0x7E0,      0x7EF,      CAN_FILTER_FLAG_DATA_ONLY },
+		}
+	},
+	{
+		"rules beyond three banks", 3, false, true, 14,
+		{
+			{ TEST_RULE_MASK,  0x080,      0x7FF,      0 },
+			{ TEST_RULE_MASK,  0x081,      0x7FF,      CAN_FILTER_FLAG_DATA_ONLY },
+			{ TEST_RULE_MASK,  0x0C2,      0x7FF,      CAN_FILTER_FLAG_REMOTE_ONLY },
+			{ TEST_RULE_MASK,  0x1A4,      0x7FF,      0 },
+			{ TEST_RULE_MASK,  0x2B5,      0x7FF,      CAN_FILTER_FLAG_DATA_ONLY },
+			{ TEST_RULE_MASK,  0x3C6,      0x7FF,      0 },
+			{ TEST_RULE_MASK,  0x4D7,      0x7FF,      0 },
+			{ TEST_RULE_MASK,  0x5E8,      0x7FF,      CAN_FILTER_FLAG_DATA_ONLY },
+			{ TEST_RULE_RANGE, 0x700,      0x73F,      0 },
+			{ TEST_RULE_MASK,  0x10000001, 0x1FFFFFFF, CAN_FILTER_FLAG_EXT },
+			{ TEST_RULE_MASK,  0x10000100, 0x1FFFFFFF, CAN_FILTER_FLAG_EXT | CAN_FILTER_FLAG_DATA_ONLY },
+			{ TEST_RULE_RANGE, 0x10010000, 0x1001FFFF, CAN_FILTER_FLAG_EXT },
+			{ TEST_RULE_MASK,  0x00ABCDEF, 0x00FFFFF0, CAN_FILTER_FLAG_EXT },
+			{ TEST_RULE_MASK,  0x7FF,      0x7FF,      CAN_FILTER_FLAG_REMOTE_ONLY },
+		}
+	},
+	{
+		"mixed rules in one bank", 1, false, true, 4,
+		{
+			{ TEST_RULE_RANGE, 0x200,      0x2FF,      0 },
+			{ TEST_RULE_MASK,  0x3FF,      0x7FF,      CAN_FILTER_FLAG_DATA_ONLY },
+			{ TEST_RULE_MASK,  0x18DAF100, 0x1FFFFF00, CAN_FILTER_FLAG_EXT },
+			{ TEST_RULE_RANGE, 0x00000000, 0x0000000F, CAN_FILTER_FLAG_EXT | CAN_FILTER_FLAG_REMOTE_ONLY },
+		}
+	},
+	{
+		"single range", CAN_FILTER_MAX_BANKS, false, false, 1,
+		{
+			{ TEST_RULE_RANGE, 0x001,      0x7FE,      0 },
+		}
+	},
+};
+
+/*-- Local functions --------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Acceptance of a frame by the rules as written.
+ *
+ *  @param  set - rule set.
+ *  @param  id - identifier.
+ *  @param  extended - 29 bit identifier.
+ *  @param  remote - remote frame.
+ *
+ *  @retval true if a rule accepts the frame.
+ *****************************************************************************/
+static bool Test_Reference(const Test_Set_t *set, uint32_t id, bool extended, bool remote)
+{
+	uint32_t index;
+
+	for(index = 0; index < set->Count; index++)
+	{
+		const Test_Rule_t *rule = &set->Rules[index];
+		bool ruleExtended = ((rule->Flags & CAN_FILTER_FLAG_EXT) != 0);
+
+		if((ruleExtended != extended) ||
+		   ((rule->Flags & CAN_FILTER_FLAG_DATA_ONLY) && (remote)) ||
+		   ((rule->Flags & CAN_FILTER_FLAG_REMOTE_ONLY) && (!remote)))
+		{
+			continue;
+		}
+
+		if(rule->Type == TEST_RULE_RANGE)
+		{
+			if((id >= rule->A) && (id <= rule->B))
+			{
+				return true;
+			}
+		}
+		else if(((id ^ rule->A) & rule->B) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/******************************************************************************
+ *  @brief  Match a frame against filter banks as the controller does,
+ *          16 bit scale compares STID, RTR, IDE, EXID[17:15].
+ *
+ *  @param  plan - compiled filter.
+ *  @param  rir - RIR register of the frame.
+ *  @param  id - identifier.
+ *  @param  extended - 29 bit identifier.
+ *  @param  remote - remote frame.
+ *
+ *  @retval index of the passing bank, -1 if none passes.
+ *****************************************************************************/
+static int32_t Test_BankMatch(const CanFilter_Plan_t *plan, uint32_t rir, uint32_t id, bool extended, bool remote)
+{
+	uint32_t half;
+	uint32_t index;
+
+	if(extended)
+	{
+		half = ((id >> 18) << 5) | (remote ? 0x10U : 0) | 0x08U | ((id >> 15) & 0x7U);
+	}
+	else
+	{
+		half = (id << 5) | (remote ? 0x10U : 0);
+	}
+
+	for(index = 0; index < plan->Count; index++)
+	{
+		const CanFilter_Bank_t *bank = &plan->Banks[index];
+		uint32_t fr1 = bank->Fr1;
+		uint32_t fr2 = bank->Fr2;
+		bool pass;
+
+		switch(bank->Mode)
+		{
+			case CAN_FILTER_BANK_MASK_32:
+			{
+				pass = (((rir ^ fr1) & fr2) == 0);
+			}
+			break;
+
+			case CAN_FILTER_BANK_LIST_32:
+			{
+				pass = ((rir == fr1) || (rir == fr2));
+			}
+			break;
+
+			case CAN_FILTER_BANK_MASK_16:
+			{
+				pass = ((((half ^ fr1) & (fr1 >> 16)) & 0xFFFFU) == 0) || ((((half ^ fr2) & (fr2 >> 16)) & 0xFFFFU) == 0);
+			}
+			break;
+
+			default:
+			{
+				pass = (half == (fr1 & 0xFFFFU)) || (half == (fr1 >> 16)) || (half == (fr2 & 0xFFFFU)) || (half == (fr2 >> 16));
+			}
+			break;
+		}
+
+		if(pass)
+		{
+			return (int32_t)index;
+		}
+	}
+
+	return -1;
+}
+
+/******************************************************************************
+ *  @brief  Check one frame: banks, then software check of the superset
+ *          bank like CanCapture_RxIrqHandler, against the reference.
+ *
+ *  @param  set - rule set.
+ *  @param  filter - rule list.
+ *  @param  plan - compiled filter.
+ *  @param  id - identifier.
+ *  @param  extended - 29 bit identifier.
+ *  @param  result - counters.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_Frame(const Test_Set_t *set, const CanFilter_t *filter, const CanFilter_Plan_t *plan, uint32_t id, bool extended,
+					   Test_Result_t *result)
+{
+	uint32_t remote;
+
+	for(remote = 0; remote < 2; remote++)
+	{
+		uint32_t rir = extended ? ((id << CAN_FILTER_EXID_POS) | CAN_FILTER_IDE) : (id << CAN_FILTER_STID_POS);
+		bool expected = Test_Reference(set, id, extended, remote);
+		bool matched;
+		bool accepted;
+		int32_t bank;
+
+		rir |= remote ? CAN_FILTER_RTR : 0;
+		bank = Test_BankMatch(plan, rir, id, extended, remote);
+		accepted = (bank >= 0);
+		matched = CanFilter_Match(filter, rir);
+
+		if((accepted) && (plan->Software) && (((rir ^ plan->SoftwareId) & plan->SoftwareMask) == 0))
+		{
+			result->Software++;
+			accepted = matched;
+		}
+
+		result->Frames++;
+		result->Accepted += accepted ? 1 : 0;
+
+		if((accepted != expected) || (matched != expected))
+		{
+			if(result->Errors++ < TEST_MAX_REPORTS)
+			{
+				printf("FAIL: %s id %lx %s %s: banks %d, software %u, rules %u\n", set->Name, (unsigned long)id,
+					   extended ? "ext" : "std", remote ? "remote" : "data", (int)bank, matched, expected);
+			}
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  Collect low 15 bits of extended rule bounds, one off each way,
+ *          for the partial 29 bit sweep.
+ *
+ *  @param  set - rule set.
+ *  @param  low - pointer to values, TEST_MAX_LOW.
+ *
+ *  @retval count of values.
+ *****************************************************************************/
+static uint32_t Test_LowBits(const Test_Set_t *set, uint32_t *low)
+{
+	uint32_t count = 0;
+	uint32_t index;
+
+	low[count++] = 0;
+	low[count++] = TEST_EXT_LOW_MAX;
+
+	for(index = 0; index < set->Count; index++)
+	{
+		const Test_Rule_t *rule = &set->Rules[index];
+		uint32_t bounds[2];
+		uint32_t bound;
+
+		if(!(rule->Flags & CAN_FILTER_FLAG_EXT))
+		{
+			continue;
+		}
+
+		bounds[0] = rule->A;
+		bounds[1] = (rule->Type == TEST_RULE_RANGE) ? rule->B : (rule->A | ~rule->B);
+
+		for(bound = 0; bound < 2; bound++)
+		{
+			low[count++] = (bounds[bound] - 1) & TEST_EXT_LOW_MAX;
+			low[count++] = (bounds[bound] + 1) & TEST_EXT_LOW_MAX;
+			low[count++] = bounds[bound] & TEST_EXT_LOW_MAX;
+			low[count++] = (bounds[bound] & rule->B) & TEST_EXT_LOW_MAX;
+		}
+	}
+
+	return count;
+}
+
+/******************************************************************************
+ *  @brief  Compile a rule set and sweep the identifier space.
+ *
+ *  @param  set - rule set.
+ *
+ *  @retval count of errors.
+ *****************************************************************************/
+static uint32_t Test_RunSet(const Test_Set_t *set)
+{
+	static CanFilter_t filter;
+	static CanFilter_Plan_t plan;
+	Test_Result_t result;
+	uint32_t low[TEST_MAX_LOW];
+	uint32_t lowCount;
+	uint32_t banks;
+	uint32_t index;
+	uint32_t id;
+
+	memset(&result, 0, sizeof(result));
+	CanFilter_Init(&filter);
+
+	for(index = 0; index < set->Count; index++)
+	{
+		const Test_Rule_t *rule = &set->Rules[index];
+		bool added = (rule->Type == TEST_RULE_RANGE) ? CanFilter_AddRange(&filter, rule->A, rule->B, rule->Flags) :
+													  CanFilter_AddMask(&filter, rule->A, rule->B, rule->Flags);
+
+		if(!added)
+		{
+			printf("FAIL: %s rule %u rejected\n", set->Name, index);
+			return 1;
+		}
+	}
+
+	banks = CanFilter_Compile(&filter, set->MaxBanks, &plan);
+	if((banks == 0) || (banks > set->MaxBanks) || (banks != plan.Count) || (plan.Software != set->ExpectSoftware))
+	{
+		printf("FAIL: %s compiled to %u of %u banks, software %u\n", set->Name, banks, set->MaxBanks, plan.Software);
+		result.Errors++;
+	}
+
+	for(id = 0; id <= TEST_STD_ID_MAX; id++)
+	{
+		Test_Frame(set, &filter, &plan, id, false, &result);
+	}
+
+	if(set->FullSweep)
+	{
+		for(id = 0; id <= TEST_EXT_ID_MAX; id++)
+		{
+			Test_Frame(set, &filter, &plan, id, true, &result);
+		}
+	}
+	else
+	{
+		uint32_t high;
+
+		//Every bit a 16 bit bank compares, low bits from rule bounds
+		lowCount = Test_LowBits(set, low);
+		for(high = 0; high <= (TEST_EXT_ID_MAX >> TEST_EXT_LOW_BITS); high++)
+		{
+			for(index = 0; index < lowCount; index++)
+			{
+				Test_Frame(set, &filter, &plan, (high << TEST_EXT_LOW_BITS) | low[index], true, &result);
+			}
+		}
+
+		//Every low bit pattern next to extended rules
+		for(index = 0; index < set->Count; index++)
+		{
+			const Test_Rule_t *rule = &set->Rules[index];
+
+			if(rule->Flags & CAN_FILTER_FLAG_EXT)
+			{
+				for(id = rule->A & ~TEST_EXT_LOW_MAX; id <= (rule->A | TEST_EXT_LOW_MAX); id++)
+				{
+					Test_Frame(set, &filter, &plan, id, true, &result);
+				}
+			}
+		}
+	}
+
+	printf("%-32s %2u rules, %2u of %2u banks%s, %10u frames, %9u accepted, %8u software checks\n", set->Name, filter.Count,
+		   banks, set->MaxBanks, plan.Software ? " + software" : "", result.Frames, result.Accepted, result.Software);
+
+	return result.Errors;
+}
+
+/*-- Exported functions -----------------------------------------------------*/
+int main(void)
+{
+	CanFilter_t filter;
+	uint32_t errors = 0;
+	uint32_t index;
+
+	//Empty list accepts every frame and compiles to nothing
+	CanFilter_Init(&filter);
+	if((!CanFilter_Match(&filter, 0x123U << CAN_FILTER_STID_POS)) || (CanFilter_Compile(&filter, CAN_FILTER_MAX_BANKS, &(CanFilter_Plan_t){ 0 }) != 0))
+	{
+		printf("FAIL: empty rule list\n");
+		errors++;
+	}
+
+	//Bounds past the identifier space are rejected
+	if((CanFilter_AddRange(&filter, 0x10, 0x800, 0)) || (CanFilter_AddRange(&filter, 0x20, 0x10, 0)) ||
+	   (CanFilter_AddMask(&filter, 0x800, 0x7FF, 0)) || (CanFilter_AddMask(&filter, 0x20000000, 0, CAN_FILTER_FLAG_EXT)))
+	{
+		printf("FAIL: invalid rule accepted\n");
+		errors++;
+	}
+
+	for(index = 0; index < sizeof(testSets) / sizeof(testSets[0]); index++)
+	{
+		errors += Test_RunSet(&testSets[index]);
+	}
+
+	return (errors > 0) ? 1 : 0;
+}
+/*-- EOF --------------------------------------------------------------------*/
@@ -0,0 +1,454 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    GsUsbTest.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+/*
+ * Host test of the gs_usb protocol through the real USB device stack, the
+ * capture engine as backend and the bxCAN model of HostCan.c. The test plays
+ * the Linux gs_usb driver: control requests, host frames on the bulk OUT
+ * endpoint, echoes and received frames on the bulk IN endpoint. It stands
+ * for the NVIC between main loop passes: the Tx ISR runs while a mailbox
+ * completed, the Rx ISR while a frame is pending. A host frame must be
+ * echoed only after its Tx mailbox completed, with GSUSB_CAN_ERR_FLAG if it
+ * failed or the channel cannot send; frames of a stopped channel are
+ * dropped and a channel waiting for mailboxes never holds up the other one.
+ */
+
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+#include "stm32f4xx_hal.h"
+#include "usb_device.h"
+#include "usbd_gsusb.h"
+
+/*-- Project specific includes ----------------------------------------------*/
+#include "CanCapture.h"
+#include "usbd_vcp.h"
+#include "HostHal.h"
+#include "HostCan.h"
+#include "HostUsb.h"
+
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+#if (USBD_GSUSB_ENABLE != 1) || (USB_VCP_SLCAN != 0)
+#error "GsUsbTest talks gs_usb, build with USBD_GSUSB_ENABLE=1 and USB_VCP_SLCAN=0"
+#endif
+
+//Main loop passes allowed for one step of a case
+#define TEST_RUN_LIMIT					16
+
+//Host frames a case may read back
+#define TEST_MAX_IN						64
+
+//Host frames sent to a channel which waits for its mailboxes: three
+//mailboxes and two queued frames
+#define TEST_BLOCKED_FRAMES				5
+
+/*-- Local typedefs ---------------------------------------------------------*/
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+static uint64_t testNow;
+static uint32_t testErrors;
+static uint32_t testEchoId;
+
+static USBD_GS_HostFrameTypeDef testIn[TEST_MAX_IN];
+static uint32_t testInCount;
+
+/*-- Local functions --------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Report a failed check.
+ *
+ *  @param  ok - check result.
+ *  @param  what - checked property.
+ *
+ *  @retval ok.
+ *****************************************************************************/
+static bool Test_Check(bool ok, const char *what)
+{
+	if(!ok)
+	{
+		printf("FAIL: %s\n", what);
+		testErrors++;
+	}
+
+	return ok;
+}
+
+/******************************************************************************
+ *  @brief  One main loop pass, then pending CAN interrupts. A mailbox the
+ *          test completed meets the main loop first, like one completing
+ *          while USBD_GS_Run masks interrupts.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_Run(void)
+{
+	uint8_t bus;
+
+	testNow += 100;
+	HostHal_AdvanceTick(1);
+
+	CanCapture_Run();
+	USBD_GS_Run();
+
+	for(bus = 0; bus < CAN_CAPTURE_NUM_BUSES; bus++)
+	{
+		uint32_t fifo;
+
+		while(HostCan_IsTxPending(bus))
+		{
+			CanCapture_TxIrqHandler(bus);
+		}
+
+		for(fifo = CAN_RX_FIFO0; fifo <= CAN_RX_FIFO1; fifo++)
+		{
+			while(HostCan_IsRxPending(bus, fifo))
+			{
+				CanCapture_RxIrqHandler(bus, fifo);
+			}
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  Host reads every host frame the device has, main loop runs in
+ *          between.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_ReadIn(void)
+{
+	uint32_t run;
+
+	testInCount = 0;
+
+	for(run = 0; run < TEST_RUN_LIMIT; run++)
+	{
+		int32_t result;
+
+		Test_Run();
+		result = HostUsb_In(GSUSB_EP_DATA_IN, (uint8_t *)&testIn[testInCount], sizeof(testIn[0]));
+
+		if(result == HOST_USB_NAK)
+		{
+			continue;
+		}
+
+		if(!Test_Check(result == (int32_t)GSUSB_HOST_FRAME_SIZE, "IN transfer is one host frame") ||
+		   !Test_Check(testInCount < (TEST_MAX_IN - 1), "IN frames of a step"))
+		{
+			return;
+		}
+
+		testInCount++;
+		run = 0;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Host writes a host frame to the bulk OUT endpoint.
+ *
+ *  @param  channel - gs_usb channel.
+ *  @param  id - standard identifier, first data byte too.
+ *
+ *  @retval echo_id of the frame.
+ *****************************************************************************/
+static uint32_t Test_Send(uint8_t channel, uint32_t id)
+{
+	USBD_GS_HostFrameTypeDef hostFrame;
+	uint32_t run;
+
+	memset(&hostFrame, 0, sizeof(hostFrame));
+	hostFrame.echo_id = testEchoId++;
+	hostFrame.can_id = id;
+	hostFrame.can_dlc = 2;
+	hostFrame.channel = channel;
+	hostFrame.data[0] = (uint8_t)id;
+	hostFrame.data[1] = (uint8_t)hostFrame.echo_id;
+
+	for(run = 0; run < TEST_RUN_LIMIT; run++)
+	{
+		if(HostUsb_Out(GSUSB_EP_DATA_OUT, (const uint8_t *)&hostFrame, GSUSB_HOST_FRAME_SIZE) == (int32_t)GSUSB_HOST_FRAME_SIZE)
+		{
+			break;
+		}
+		Test_Run();
+	}
+
+	Test_Check(run < TEST_RUN_LIMIT, "OUT endpoint takes host frame");
+
+	return hostFrame.echo_id;
+}
+
+/******************************************************************************
+ *  @brief  Check an IN host frame is the echo of a sent frame.
+ *
+ *  @param  hostFrame - IN host frame.
+ *  @param  echoId - echo_id of the sent frame.
+ *  @param  channel - gs_usb channel of the sent frame.
+ *  @param  error - GSUSB_CAN_ERR_FLAG expected.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_CheckEcho(const USBD_GS_HostFrameTypeDef *hostFrame, uint32_t echoId, uint8_t channel, bool error)
+{
+	if((hostFrame->echo_id != echoId) || (hostFrame->channel != channel) ||
+	   (((hostFrame->can_id & GSUSB_CAN_ERR_FLAG) != 0) != error) || (hostFrame->data[1] != (uint8_t)echoId))
+	{
+		printf("FAIL: echo %lu channel %u can_id %08lx, echo %lu channel %u%s expected\n",
+			   (unsigned long)hostFrame->echo_id, hostFrame->channel, (unsigned long)hostFrame->can_id,
+			   (unsigned long)echoId, channel, error ? " with error flag" : "");
+		testErrors++;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Complete the oldest Tx mailbox of a bus.
+ *
+ *  @param  bus - bus index.
+ *  @param  sent - false if the frame fails.
+ *  @param  id - identifier the frame must have.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_Complete(uint8_t bus, bool sent, uint32_t id)
+{
+	CanFrame_t frame;
+
+	if(Test_Check(HostCan_Transmit(bus, &frame, sent), "Tx mailbox pending"))
+	{
+		Test_Check((frame.Id == id) && (frame.Dlc == 2) && (frame.Data[0] == (uint8_t)id), "Tx mailbox holds host frame");
+	}
+}
+
+/******************************************************************************
+ *  @brief  Set bit timing of 1 Mbit/s and start or stop a channel.
+ *
+ *  @param  channel - gs_usb channel.
+ *  @param  mode - GSUSB_MODE_START or GSUSB_MODE_RESET.
+ *  @param  flags - GSUSB_FEATURE_xxx.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_Mode(uint8_t channel, uint32_t mode, uint32_t flags)
+{
+	//45 MHz / 3 = 15 time quanta per bit: 1 + 11 + 3
+	const USBD_GS_BitTimingTypeDef timing = { 5, 6, 3, 1, 3 };
+	const uint32_t request[2] = { mode, flags };
+
+	if(mode == GSUSB_MODE_START)
+	{
+		Test_Check(HostUsb_ControlWrite(HOST_USB_REQ_VENDOR_ITF_OUT, GSUSB_BREQ_BITTIMING, channel, GSUSB_ITF, (const uint8_t *)&timing, sizeof(timing)) == (int32_t)sizeof(timing), "bit timing request");
+	}
+	Test_Check(HostUsb_ControlWrite(HOST_USB_REQ_VENDOR_ITF_OUT, GSUSB_BREQ_MODE, channel, GSUSB_ITF, (const uint8_t *)request, sizeof(request)) == (int32_t)sizeof(request), "mode request");
+
+	//Capture engine applies the request from the main loop
+	Test_Run();
+}
+
+/******************************************************************************
+ *  @brief  Device info the driver reads on probe.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_Probe(void)
+{
+	uint32_t reply[10];
+
+	Test_Check((HostUsb_ControlRead(HOST_USB_REQ_VENDOR_ITF_IN, GSUSB_BREQ_DEVICE_CONFIG, 0, GSUSB_ITF, (uint8_t *)reply, 12) == 12) &&
+			   ((reply[0] >> 24) == (GSUSB_NUM_CHANNELS - 1U)), "device config reports channels");
+	Test_Check((HostUsb_ControlRead(HOST_USB_REQ_VENDOR_ITF_IN, GSUSB_BREQ_BT_CONST, 1, GSUSB_ITF, (uint8_t *)reply, 40) == 40) &&
+			   (reply[1] == HOST_HAL_PCLK1_HZ), "bit timing constants report CAN clock");
+	Test_Check(HostUsb_ControlRead(HOST_USB_REQ_VENDOR_ITF_IN, GSUSB_BREQ_BT_CONST, GSUSB_NUM_CHANNELS, GSUSB_ITF, (uint8_t *)reply, 40) == HOST_USB_STALL,
+			   "unknown channel stalls");
+}
+
+/******************************************************************************
+ *  @brief  Echo waits for the Tx mailbox: nothing comes back before the
+ *          frame is on the bus, a failed mailbox is echoed with error flag.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_EchoOnCompletion(void)
+{
+	uint32_t echoIds[3];
+	uint32_t index;
+
+	for(index = 0; index < 3; index++)
+	{
+		echoIds[index] = Test_Send(0, 0x100 + index);
+	}
+
+	Test_ReadIn();
+	Test_Check(testInCount == 0, "no echo before Tx mailbox completes");
+
+	Test_Complete(0, true, 0x100);
+	Test_Complete(0, false, 0x101);
+	Test_ReadIn();
+	if(Test_Check(testInCount == 2, "echo per completed mailbox"))
+	{
+		Test_CheckEcho(&testIn[0], echoIds[0], 0, false);
+		Test_CheckEcho(&testIn[1], echoIds[1], 0, true);
+	}
+
+	Test_Complete(0, true, 0x102);
+	Test_ReadIn();
+	if(Test_Check(testInCount == 1, "echo of last mailbox"))
+	{
+		Test_CheckEcho(&testIn[0], echoIds[2], 0, false);
+	}
+}
+
+/******************************************************************************
+ *  @brief  Channel 0 waits for its mailboxes, channel 1 must keep sending;
+ *          queued frames of channel 0 follow as mailboxes complete.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_BusyChannel(void)
+{
+	uint32_t echoIds[TEST_BLOCKED_FRAMES];
+	uint32_t otherId;
+	uint32_t index;
+
+	for(index = 0; index < TEST_BLOCKED_FRAMES; index++)
+	{
+		echoIds[index] = Test_Send(0, 0x200 + index);
+	}
+	otherId = Test_Send(1, 0x300);
+
+	Test_ReadIn();
+	Test_Complete(1, true, 0x300);
+	Test_ReadIn();
+	if(Test_Check(testInCount == 1, "busy channel 0 does not hold up channel 1"))
+	{
+		Test_CheckEcho(&testIn[0], otherId, 1, false);
+	}
+
+	for(index = 0; index < TEST_BLOCKED_FRAMES; index++)
+	{
+		Test_Complete(0, true, 0x200 + index);
+		Test_ReadIn();
+		if(Test_Check(testInCount == 1, "queued frame takes the free mailbox"))
+		{
+			Test_CheckEcho(&testIn[0], echoIds[index], 0, false);
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  Listen only channel echoes its frames with error flag at once,
+ *          stopped channel drops them; neither reaches a mailbox.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_CannotSend(void)
+{
+	CanFrame_t frame;
+	uint32_t echoId;
+
+	Test_Mode(1, GSUSB_MODE_RESET, 0);
+	Test_Mode(1, GSUSB_MODE_START, GSUSB_FEATURE_LISTEN_ONLY);
+
+	echoId = Test_Send(1, 0x400);
+	Test_ReadIn();
+	if(Test_Check(testInCount == 1, "listen only channel echoes at once"))
+	{
+		Test_CheckEcho(&testIn[0], echoId, 1, true);
+	}
+	Test_Check(!HostCan_Transmit(1, &frame, true), "listen only channel keeps mailboxes empty");
+
+	Test_Mode(1, GSUSB_MODE_RESET, 0);
+	(void)Test_Send(1, 0x401);
+	Test_ReadIn();
+	Test_Check(testInCount == 0, "stopped channel drops frames");
+	Test_Check(!HostCan_Transmit(1, &frame, true), "stopped channel keeps mailboxes empty");
+
+	//Channel 0 is unaffected
+	echoId = Test_Send(0, 0x402);
+	Test_ReadIn();
+	Test_Complete(0, true, 0x402);
+	Test_ReadIn();
+	if(Test_Check(testInCount == 1, "started channel still sends"))
+	{
+		Test_CheckEcho(&testIn[0], echoId, 0, false);
+	}
+}
+
+/******************************************************************************
+ *  @brief  Frames from the bus reach the host with the Rx echo_id.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_Receive(void)
+{
+	CanFrame_t frame;
+
+	memset(&frame, 0, sizeof(frame));
+	frame.Id = 0x123;
+	frame.Dlc = 3;
+	frame.Data[0] = 0xA5;
+
+	Test_Check(HostCan_Receive(0, &frame, 0) != HOST_CAN_FILTERED, "accept all filter");
+	Test_ReadIn();
+	if(Test_Check(testInCount == 1, "received frame on IN endpoint"))
+	{
+		Test_Check((testIn[0].echo_id == GSUSB_ECHO_ID_RX) && (testIn[0].can_id == 0x123) && (testIn[0].can_dlc == 3) &&
+				   (testIn[0].channel == 0) && (testIn[0].data[0] == 0xA5), "received frame content");
+	}
+}
+
+/*-- Stubs of the clock -----------------------------------------------------*/
+uint64_t Timestamp_Get(void)
+{
+	return testNow;
+}
+
+/*-- Exported functions -----------------------------------------------------*/
+int main(void)
+{
+	MX_USB_DEVICE_Init();
+	USB_VCP_Init();
+	CanCapture_Init();
+
+	HostUsb_Connect();
+
+	printf("gs_usb protocol over %u channels\n", GSUSB_NUM_CHANNELS);
+
+	Test_Probe();
+	Test_Mode(0, GSUSB_MODE_START, 0);
+	Test_Mode(1, GSUSB_MODE_START, 0);
+
+	Test_EchoOnCompletion();
+	Test_BusyChannel();
+	Test_CannotSend();
+	Test_Receive();
+
+	printf("%s, %u errors\n", (testErrors > 0) ? "FAIL" : "pass", testErrors);
+
+	return (testErrors > 0) ? 1 : 0;
+}
+/*-- EOF --------------------------------------------------------------------*/
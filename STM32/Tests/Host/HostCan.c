@@ -0,0 +1,659 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    HostCan.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+/*
+ * bxCAN controllers emulated on the development machine: register blocks
+ * behind hcanx, filter banks of CAN1 shared by all, two three-deep Rx
+ * FIFOs and three Tx mailboxes per controller. The test puts
+ * frames on the bus with HostCan_Receive and stands for the NVIC: it calls
+ * the Rx ISR while HostCan_IsRxPending and the Tx ISR while
+ * HostCan_IsTxPending, HostCan_Transmit completes the oldest Tx mailbox.
+ * Firmware reads mailbox and status registers directly, register writes with
+ * side effects go through HostCan_RfrWrite and HostCan_TsrWrite. HAL_CAN_xxx
+ * functions used by firmware act on the same model.
+ */
+
+#include "HostCan.h"
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+/*-- Project specific includes ----------------------------------------------*/
+#include "can.h"
+
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+#define HOST_CAN_FIFO_DEPTH				3
+#define HOST_CAN_TX_MAILBOXES			3
+#define HOST_CAN_FILTER_BANKS			28
+
+//Status bits of Tx mailbox x in TSR: RQCP, TXOK, ALST, TERR
+#define HOST_CAN_TSR_SHIFT(mailbox)		(8U * (mailbox))
+#define HOST_CAN_TSR_STATUS				(CAN_TSR_RQCP0 | CAN_TSR_TXOK0 | CAN_TSR_ALST0 | CAN_TSR_TERR0)
+
+//Filter bank classes in match priority order: 32 bit before 16 bit, list
+//before mask, then lower bank number
+#define HOST_CAN_CLASS_LIST_32			0
+#define HOST_CAN_CLASS_MASK_32			1
+#define HOST_CAN_CLASS_LIST_16			2
+#define HOST_CAN_CLASS_MASK_16			3
+
+/*-- Local typedefs ---------------------------------------------------------*/
+typedef struct
+{
+	CAN_FIFOMailBox_TypeDef Mailboxes[HOST_CAN_FIFO_DEPTH];
+	uint32_t Count;
+	bool Full;
+	bool Overrun;
+	uint32_t Released;						//Frames released by RFOM
+}HostCan_Fifo_t;
+
+typedef struct
+{
+	HostCan_Fifo_t Fifos[2];
+	CanFrame_t Tx[HOST_CAN_TX_MAILBOXES];	//Frames of Tx mailboxes
+	bool TxPending[HOST_CAN_TX_MAILBOXES];
+	uint32_t TxOrder[HOST_CAN_TX_MAILBOXES];	//Request number of pending mailboxes
+	uint32_t TxRequests;
+	uint32_t TxStatus;						//Completion status bits of TSR
+	uint32_t Lost;							//Frames overwritten in a full FIFO
+}HostCan_Controller_t;
+
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+static CAN_TypeDef hostCanRegisters[HOST_CAN_NUM_BUSES];
+static HostCan_Controller_t hostCanControllers[HOST_CAN_NUM_BUSES];
+
+CAN_HandleTypeDef hcan1 = { .Instance = &hostCanRegisters[0] };
+CAN_HandleTypeDef hcan2 = { .Instance = &hostCanRegisters[1] };
+
+/*-- Local functions --------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Get bus index of a handle.
+ *
+ *  @param  hcan - CAN handle.
+ *
+ *  @retval bus index.
+ *****************************************************************************/
+static uint8_t HostCan_GetBus(const CAN_HandleTypeDef *hcan)
+{
+	return (uint8_t)(hcan->Instance - hostCanRegisters);
+}
+
+/******************************************************************************
+ *  @brief  Show FIFO state in RFxR and its oldest frame in the output
+ *          mailbox registers.
+ *
+ *  @param  bus - bus index.
+ *  @param  fifo - CAN_RX_FIFO0 or CAN_RX_FIFO1.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void HostCan_Publish(uint8_t bus, uint32_t fifo)
+{
+	CAN_TypeDef *can = &hostCanRegisters[bus];
+	HostCan_Fifo_t *model = &hostCanControllers[bus].Fifos[fifo];
+	uint32_t rf = model->Count;
+
+	//RF0R and RF1R share bit layout
+	if(model->Full)
+	{
+		rf |= CAN_RF0R_FULL0;
+	}
+	if(model->Overrun)
+	{
+		rf |= CAN_RF0R_FOVR0;
+	}
+
+	if(model->Count > 0)
+	{
+		can->sFIFOMailBox[fifo] = model->Mailboxes[0];
+	}
+
+	if(fifo == CAN_RX_FIFO0)
+	{
+		can->RF0R = rf;
+	}
+	else
+	{
+		can->RF1R = rf;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Match one filter bank.
+ *
+ *  @param  bank - filter bank number.
+ *  @param  rir - identifier in RIR layout.
+ *  @param  bankClass - HOST_CAN_CLASS_xxx the bank must have.
+ *
+ *  @retval true if bank is active, of the class and passes the frame.
+ *****************************************************************************/
+static bool HostCan_MatchBank(uint32_t bank, uint32_t rir, uint32_t bankClass)
+{
+	const CAN_TypeDef *can = &hostCanRegisters[0];
+	uint32_t bit = 1UL << bank;
+	uint32_t fr1 = can->sFilterRegister[bank].FR1;
+	uint32_t fr2 = can->sFilterRegister[bank].FR2;
+	bool list = ((can->FM1R & bit) != 0);
+	bool scale32 = ((can->FS1R & bit) != 0);
+	uint32_t value;
+	uint32_t index;
+
+	if(((can->FA1R & bit) == 0) || (bankClass != ((scale32 ? 0U : 2U) + (list ? 0U : 1U))))
+	{
+		return false;
+	}
+
+	if(scale32)
+	{
+		//Bit 0 is TXRQ in Tx layout, never compared
+		rir &= ~1UL;
+		return list ? ((rir == (fr1 & ~1UL)) || (rir == (fr2 & ~1UL))) : (((rir ^ fr1) & fr2 & ~1UL) == 0);
+	}
+
+	//16 bit layout: STID[10:0] RTR IDE EXID[17:15]
+	value = ((rir >> 16) & 0xFFE0U) | ((rir & CAN_RI0R_RTR) << 3) | ((rir & CAN_RI0R_IDE) << 1) | ((rir >> 18) & 0x7U);
+
+	if(list)
+	{
+		const uint32_t ids[4] = { fr1 & 0xFFFFU, fr1 >> 16, fr2 & 0xFFFFU, fr2 >> 16 };
+
+		for(index = 0; index < 4; index++)
+		{
+			if(value == ids[index])
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	return ((((value ^ fr1) & (fr1 >> 16)) & 0xFFFFU) == 0) || ((((value ^ fr2) & (fr2 >> 16)) & 0xFFFFU) == 0);
+}
+
+/******************************************************************************
+ *  @brief  Show Tx mailbox state in TSR: empty mailboxes and completion
+ *          status.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void HostCan_PublishTx(uint8_t bus)
+{
+	const HostCan_Controller_t *controller = &hostCanControllers[bus];
+	uint32_t tsr = controller->TxStatus;
+	uint32_t mailbox;
+
+	for(mailbox = 0; mailbox < HOST_CAN_TX_MAILBOXES; mailbox++)
+	{
+		if(!controller->TxPending[mailbox])
+		{
+			tsr |= CAN_TSR_TME0 << mailbox;
+		}
+	}
+
+	hostCanRegisters[bus].TSR = tsr;
+}
+
+/*-- Exported functions -----------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Register write to RF0R or RF1R: FULL and FOVR are cleared by
+ *          writing 1, RFOM releases the output mailbox.
+ *
+ *  @param  rfr - register written.
+ *  @param  value - written value.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void HostCan_RfrWrite(volatile uint32_t *rfr, uint32_t value)
+{
+	uint8_t bus;
+
+	for(bus = 0; bus < HOST_CAN_NUM_BUSES; bus++)
+	{
+		uint32_t fifo;
+
+		for(fifo = CAN_RX_FIFO0; fifo <= CAN_RX_FIFO1; fifo++)
+		{
+			HostCan_Fifo_t *model = &hostCanControllers[bus].Fifos[fifo];
+
+			if(rfr != ((fifo == CAN_RX_FIFO0) ? &hostCanRegisters[bus].RF0R : &hostCanRegisters[bus].RF1R))
+			{
+				continue;
+			}
+
+			if(value & CAN_RF0R_FULL0)
+			{
+				model->Full = false;
+			}
+			if(value & CAN_RF0R_FOVR0)
+			{
+				model->Overrun = false;
+			}
+			if((value & CAN_RF0R_RFOM0) && (model->Count > 0))
+			{
+				model->Count--;
+				memmove(&model->Mailboxes[0], &model->Mailboxes[1], model->Count * sizeof(model->Mailboxes[0]));
+				model->Released++;
+			}
+
+			HostCan_Publish(bus, fifo);
+		}
+	}
+}
+
+/******************************************************************************
+ *  @brief  Register write to TSR: RQCPx written 1 clears all completion
+ *          status of mailbox x.
+ *
+ *  @param  tsr - register written.
+ *  @param  value - written value.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void HostCan_TsrWrite(volatile uint32_t *tsr, uint32_t value)
+{
+	uint8_t bus;
+
+	for(bus = 0; bus < HOST_CAN_NUM_BUSES; bus++)
+	{
+		uint32_t mailbox;
+
+		if(tsr != &hostCanRegisters[bus].TSR)
+		{
+			continue;
+		}
+
+		for(mailbox = 0; mailbox < HOST_CAN_TX_MAILBOXES; mailbox++)
+		{
+			if(value & (CAN_TSR_RQCP0 << HOST_CAN_TSR_SHIFT(mailbox)))
+			{
+				hostCanControllers[bus].TxStatus &= ~(HOST_CAN_TSR_STATUS << HOST_CAN_TSR_SHIFT(mailbox));
+			}
+		}
+
+		HostCan_PublishTx(bus);
+	}
+}
+
+/******************************************************************************
+ *  @brief  Frame received from bus: acceptance filter, then FIFO of the
+ *          matching bank. A full FIFO sets FOVR, the new frame overwrites
+ *          its last mailbox (FIFO lock mode off). Time triggered mode
+ *          stamps RDTR TIME with the bit time of SOF.
+ *
+ *  @param  bus - bus index.
+ *  @param  frame - received frame.
+ *  @param  sofTime - bit time of start of frame.
+ *
+ *  @retval FIFO of the frame, HOST_CAN_FILTERED if no bank passed it.
+ *****************************************************************************/
+int32_t HostCan_Receive(uint8_t bus, const CanFrame_t *frame, uint32_t sofTime)
+{
+	HostCan_Fifo_t *model;
+	CAN_FIFOMailBox_TypeDef mailbox;
+	uint32_t data[2] = { 0, 0 };
+	int32_t fifo;
+
+	if(frame->Flags & CAN_FRAME_FLAG_EXT)
+	{
+		mailbox.RIR = (frame->Id << CAN_RI0R_EXID_Pos) | CAN_RI0R_IDE;
+	}
+	else
+	{
+		mailbox.RIR = frame->Id << CAN_RI0R_STID_Pos;
+	}
+	if(frame->Flags & CAN_FRAME_FLAG_RTR)
+	{
+		mailbox.RIR |= CAN_RI0R_RTR;
+	}
+
+	fifo = HostCan_FilterMatch(bus, mailbox.RIR);
+	if(fifo == HOST_CAN_FILTERED)
+	{
+		return HOST_CAN_FILTERED;
+	}
+
+	mailbox.RDTR = frame->Dlc;
+	if(hostCanRegisters[bus].MCR & CAN_MCR_TTCM)
+	{
+		mailbox.RDTR |= (sofTime & 0xFFFFU) << CAN_RDT0R_TIME_Pos;
+	}
+	if(!(frame->Flags & CAN_FRAME_FLAG_RTR))
+	{
+		memcpy(data, frame->Data, (frame->Dlc > CAN_FRAME_MAX_DATA) ? CAN_FRAME_MAX_DATA : frame->Dlc);
+	}
+	mailbox.RDLR = data[0];
+	mailbox.RDHR = data[1];
+
+	model = &hostCanControllers[bus].Fifos[fifo];
+	if(model->Count == HOST_CAN_FIFO_DEPTH)
+	{
+		model->Mailboxes[HOST_CAN_FIFO_DEPTH - 1] = mailbox;
+		model->Overrun = true;
+		hostCanControllers[bus].Lost++;
+	}
+	else
+	{
+		model->Mailboxes[model->Count++] = mailbox;
+		if(model->Count == HOST_CAN_FIFO_DEPTH)
+		{
+			model->Full = true;
+		}
+	}
+
+	HostCan_Publish(bus, (uint32_t)fifo);
+
+	return fifo;
+}
+
+/******************************************************************************
+ *  @brief  Run acceptance filter of a bus over its filter banks: CAN1 owns
+ *          banks below CAN2SB, CAN2 the rest.
+ *
+ *  @param  bus - bus index.
+ *  @param  rir - identifier, IDE and RTR in RIR layout.
+ *
+ *  @retval FIFO of the matching bank, HOST_CAN_FILTERED if none matched.
+ *****************************************************************************/
+int32_t HostCan_FilterMatch(uint8_t bus, uint32_t rir)
+{
+	const CAN_TypeDef *can = &hostCanRegisters[0];
+	uint32_t slaveStart = (can->FMR & CAN_FMR_CAN2SB) >> CAN_FMR_CAN2SB_Pos;
+	uint32_t first = (bus == 0) ? 0 : slaveStart;
+	uint32_t last = (bus == 0) ? slaveStart : HOST_CAN_FILTER_BANKS;
+	uint32_t bankClass;
+	uint32_t bank;
+
+	for(bankClass = HOST_CAN_CLASS_LIST_32; bankClass <= HOST_CAN_CLASS_MASK_16; bankClass++)
+	{
+		for(bank = first; bank < last; bank++)
+		{
+			if(HostCan_MatchBank(bank, rir, bankClass))
+			{
+				return (can->FFA1R & (1UL << bank)) ? (int32_t)CAN_RX_FIFO1 : (int32_t)CAN_RX_FIFO0;
+			}
+		}
+	}
+
+	return HOST_CAN_FILTERED;
+}
+
+/******************************************************************************
+ *  @brief  Rx FIFO interrupt line: controller started, message pending
+ *          interrupt enabled and a frame in the FIFO.
+ *
+ *  @param  bus - bus index.
+ *  @param  fifo - CAN_RX_FIFO0 or CAN_RX_FIFO1.
+ *
+ *  @retval true if the ISR must run.
+ *****************************************************************************/
+bool HostCan_IsRxPending(uint8_t bus, uint32_t fifo)
+{
+	const CAN_TypeDef *can = &hostCanRegisters[bus];
+	uint32_t enable = (fifo == CAN_RX_FIFO0) ? CAN_IER_FMPIE0 : CAN_IER_FMPIE1;
+
+	return ((can->MCR & CAN_MCR_INRQ) == 0) && ((can->IER & enable) != 0) && (hostCanControllers[bus].Fifos[fifo].Count > 0);
+}
+
+/******************************************************************************
+ *  @brief  Tx interrupt line: controller started, Tx mailbox empty
+ *          interrupt enabled and a mailbox completed.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval true if the ISR must run.
+ *****************************************************************************/
+bool HostCan_IsTxPending(uint8_t bus)
+{
+	const CAN_TypeDef *can = &hostCanRegisters[bus];
+	uint32_t completed = hostCanControllers[bus].TxStatus & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2);
+
+	return ((can->MCR & CAN_MCR_INRQ) == 0) && ((can->IER & CAN_IER_TMEIE) != 0) && (completed != 0);
+}
+
+/******************************************************************************
+ *  @brief  Oldest pending Tx mailbox completes: leaves on bus, or fails with
+ *          arbitration lost and is not retransmitted.
+ *
+ *  @param  bus - bus index.
+ *  @param  frame - frame of the mailbox.
+ *  @param  sent - false if the frame fails.
+ *
+ *  @retval false if no mailbox is pending.
+ *****************************************************************************/
+bool HostCan_Transmit(uint8_t bus, CanFrame_t *frame, bool sent)
+{
+	HostCan_Controller_t *controller = &hostCanControllers[bus];
+	uint32_t oldest = HOST_CAN_TX_MAILBOXES;
+	uint32_t mailbox;
+
+	for(mailbox = 0; mailbox < HOST_CAN_TX_MAILBOXES; mailbox++)
+	{
+		if((controller->TxPending[mailbox]) &&
+		   ((oldest == HOST_CAN_TX_MAILBOXES) || ((int32_t)(controller->TxOrder[mailbox] - controller->TxOrder[oldest]) < 0)))
+		{
+			oldest = mailbox;
+		}
+	}
+
+	if(oldest == HOST_CAN_TX_MAILBOXES)
+	{
+		return false;
+	}
+
+	*frame = controller->Tx[oldest];
+	controller->TxPending[oldest] = false;
+	controller->TxStatus |= (sent ? (CAN_TSR_RQCP0 | CAN_TSR_TXOK0) : (CAN_TSR_RQCP0 | CAN_TSR_ALST0)) << HOST_CAN_TSR_SHIFT(oldest);
+	HostCan_PublishTx(bus);
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Frames lost by Rx FIFO overrun.
+ *
+ *  @param  bus - bus index.
+ *
+ *  @retval frames count.
+ *****************************************************************************/
+uint32_t HostCan_GetLost(uint8_t bus)
+{
+	return hostCanControllers[bus].Lost;
+}
+
+/******************************************************************************
+ *  @brief  Frames released from a FIFO by firmware.
+ *
+ *  @param  bus - bus index.
+ *  @param  fifo - CAN_RX_FIFO0 or CAN_RX_FIFO1.
+ *
+ *  @retval frames count.
+ *****************************************************************************/
+uint32_t HostCan_GetReleased(uint8_t bus, uint32_t fifo)
+{
+	return hostCanControllers[bus].Fifos[fifo].Released;
+}
+
+/******************************************************************************
+ *  @brief  Nominal frame length without stuff bits, intermission included:
+ *          frames back to back at this length are 100 % bus load.
+ *
+ *  @param  frame - frame.
+ *
+ *  @retval bit times.
+ *****************************************************************************/
+uint32_t HostCan_FrameBits(const CanFrame_t *frame)
+{
+	uint32_t bits = (frame->Flags & CAN_FRAME_FLAG_EXT) ? 67U : 47U;
+
+	if(!(frame->Flags & CAN_FRAME_FLAG_RTR))
+	{
+		bits += 8U * ((frame->Dlc > CAN_FRAME_MAX_DATA) ? CAN_FRAME_MAX_DATA : frame->Dlc);
+	}
+
+	return bits;
+}
+
+/*-- HAL --------------------------------------------------------------------*/
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef *hcan)
+{
+	CAN_TypeDef *can;
+
+	if((!hcan) || (!hcan->Instance))
+	{
+		return HAL_ERROR;
+	}
+
+	can = hcan->Instance;
+	can->MCR = CAN_MCR_INRQ | ((hcan->Init.TimeTriggeredMode == ENABLE) ? CAN_MCR_TTCM : 0U);
+	can->BTR = hcan->Init.Mode | hcan->Init.SyncJumpWidth | hcan->Init.TimeSeg1 | hcan->Init.TimeSeg2 | (hcan->Init.Prescaler - 1U);
+	HostCan_PublishTx(HostCan_GetBus(hcan));
+	hcan->State = HAL_CAN_STATE_READY;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, CAN_FilterTypeDef *sFilterConfig)
+{
+	//Filter banks are registers of CAN1 for both controllers
+	CAN_TypeDef *can = &hostCanRegisters[0];
+	uint32_t bank = sFilterConfig->FilterBank;
+	uint32_t bit = 1UL << bank;
+
+	if(bank >= HOST_CAN_FILTER_BANKS)
+	{
+		return HAL_ERROR;
+	}
+
+	can->FMR = (can->FMR & ~CAN_FMR_CAN2SB) | (sFilterConfig->SlaveStartFilterBank << CAN_FMR_CAN2SB_Pos);
+	can->FA1R &= ~bit;
+
+	if(sFilterConfig->FilterScale == CAN_FILTERSCALE_16BIT)
+	{
+		can->FS1R &= ~bit;
+		can->sFilterRegister[bank].FR1 = ((sFilterConfig->FilterMaskIdLow & 0xFFFFU) << 16) | (sFilterConfig->FilterIdLow & 0xFFFFU);
+		can->sFilterRegister[bank].FR2 = ((sFilterConfig->FilterMaskIdHigh & 0xFFFFU) << 16) | (sFilterConfig->FilterIdHigh & 0xFFFFU);
+	}
+	else
+	{
+		can->FS1R |= bit;
+		can->sFilterRegister[bank].FR1 = ((sFilterConfig->FilterIdHigh & 0xFFFFU) << 16) | (sFilterConfig->FilterIdLow & 0xFFFFU);
+		can->sFilterRegister[bank].FR2 = ((sFilterConfig->FilterMaskIdHigh & 0xFFFFU) << 16) | (sFilterConfig->FilterMaskIdLow & 0xFFFFU);
+	}
+
+	can->FM1R = (sFilterConfig->FilterMode == CAN_FILTERMODE_IDLIST) ? (can->FM1R | bit) : (can->FM1R & ~bit);
+	can->FFA1R = (sFilterConfig->FilterFIFOAssignment == CAN_FILTER_FIFO1) ? (can->FFA1R | bit) : (can->FFA1R & ~bit);
+	if(sFilterConfig->FilterActivation == ENABLE)
+	{
+		can->FA1R |= bit;
+	}
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan, uint32_t ActiveITs)
+{
+	hcan->Instance->IER |= ActiveITs;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef *hcan, uint32_t InactiveITs)
+{
+	hcan->Instance->IER &= ~InactiveITs;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef *hcan)
+{
+	if(hcan->State != HAL_CAN_STATE_READY)
+	{
+		return HAL_ERROR;
+	}
+
+	hcan->Instance->MCR &= ~CAN_MCR_INRQ;
+	hcan->State = HAL_CAN_STATE_LISTENING;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef *hcan)
+{
+	if(hcan->State != HAL_CAN_STATE_LISTENING)
+	{
+		return HAL_ERROR;
+	}
+
+	hcan->Instance->MCR |= CAN_MCR_INRQ;
+	hcan->State = HAL_CAN_STATE_READY;
+
+	return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef *hcan)
+{
+	const HostCan_Controller_t *controller = &hostCanControllers[HostCan_GetBus(hcan)];
+	uint32_t level = 0;
+	uint32_t mailbox;
+
+	for(mailbox = 0; mailbox < HOST_CAN_TX_MAILBOXES; mailbox++)
+	{
+		if(!controller->TxPending[mailbox])
+		{
+			level++;
+		}
+	}
+
+	return level;
+}
+
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, CAN_TxHeaderTypeDef *pHeader, uint8_t aData[], uint32_t *pTxMailbox)
+{
+	uint8_t bus = HostCan_GetBus(hcan);
+	HostCan_Controller_t *controller = &hostCanControllers[bus];
+	CanFrame_t *frame;
+	uint32_t mailbox;
+
+	//Lowest empty mailbox takes the request
+	for(mailbox = 0; (mailbox < HOST_CAN_TX_MAILBOXES) && (controller->TxPending[mailbox]); mailbox++)
+	{
+	}
+
+	if((hcan->State != HAL_CAN_STATE_LISTENING) || (mailbox == HOST_CAN_TX_MAILBOXES))
+	{
+		return HAL_ERROR;
+	}
+
+	frame = &controller->Tx[mailbox];
+	memset(frame, 0, sizeof(*frame));
+	frame->Id = (pHeader->IDE == CAN_ID_EXT) ? pHeader->ExtId : pHeader->StdId;
+	frame->Flags = ((pHeader->IDE == CAN_ID_EXT) ? CAN_FRAME_FLAG_EXT : 0U) | ((pHeader->RTR == CAN_RTR_REMOTE) ? CAN_FRAME_FLAG_RTR : 0U);
+	frame->Dlc = (uint8_t)pHeader->DLC;
+	frame->Bus = bus;
+	memcpy(frame->Data, aData, CAN_FRAME_MAX_DATA);
+
+	//TXRQ clears completion status of the mailbox
+	controller->TxPending[mailbox] = true;
+	controller->TxOrder[mailbox] = controller->TxRequests++;
+	controller->TxStatus &= ~(HOST_CAN_TSR_STATUS << HOST_CAN_TSR_SHIFT(mailbox));
+	HostCan_PublishTx(bus);
+	*pTxMailbox = CAN_TX_MAILBOX0 << mailbox;
+
+	return HAL_OK;
+}
+
+/*-- EOF --------------------------------------------------------------------*/
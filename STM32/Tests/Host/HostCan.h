@@ -0,0 +1,45 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    HostCan.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+#ifndef HOST_CAN_H
+#define HOST_CAN_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+#include "CanFrameBuffer.h"
+
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Exported macro ---------------------------------------------------------*/
+//Controllers of the model: bus n is hcann + 1
+#define HOST_CAN_NUM_BUSES				2
+
+//Result of HostCan_Receive and HostCan_FilterMatch: no filter bank passed
+#define HOST_CAN_FILTERED				(-1)
+
+//Rx FIFO and Tx status register writes of CanCapture go to the controller
+//model, build CanCapture.c with -include HostCan.h
+#define CAN_CAPTURE_RFR_WRITE(rfr, value)	HostCan_RfrWrite((rfr), (value))
+#define CAN_CAPTURE_TSR_WRITE(tsr, value)	HostCan_TsrWrite((tsr), (value))
+
+/*-- Exported functions -----------------------------------------------------*/
+void HostCan_RfrWrite(volatile uint32_t *rfr, uint32_t value);
+void HostCan_TsrWrite(volatile uint32_t *tsr, uint32_t value);
+int32_t HostCan_Receive(uint8_t bus, const CanFrame_t *frame, uint32_t sofTime);
+int32_t HostCan_FilterMatch(uint8_t bus, uint32_t rir);
+bool HostCan_IsRxPending(uint8_t bus, uint32_t fifo);
+bool HostCan_IsTxPending(uint8_t bus);
+bool HostCan_Transmit(uint8_t bus, CanFrame_t *frame, bool sent);
+uint32_t HostCan_GetLost(uint8_t bus);
+uint32_t HostCan_GetReleased(uint8_t bus, uint32_t fifo);
+uint32_t HostCan_FrameBits(const CanFrame_t *frame);
+
+#endif // HOST_CAN_H
+/*-- EOF --------------------------------------------------------------------*/
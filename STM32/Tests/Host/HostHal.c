@@ -0,0 +1,174 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    HostHal.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+/*
+ * HAL services used by firmware modules, emulated on the development
+ * machine: millisecond tick driven by the test, interrupt mask of the
+ * emulated core and fixed device ID and clocks. Heap calls of the linked
+ * firmware are counted (link with -Wl,--wrap=malloc,--wrap=calloc,
+ * --wrap=realloc), the data path must not allocate.
+ */
+
+#include "HostHal.h"
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+//Before CMSIS names (__I, __O) are defined
+#include <x86intrin.h>
+#endif
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Imported functions -----------------------------------------------------*/
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+/*-- Local Macro Definitions ------------------------------------------------*/
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+uint32_t HostHal_Primask;
+volatile uint32_t HostHal_Allocations;
+
+static uint32_t hostHalTick;
+
+/*-- Local functions --------------------------------------------------------*/
+/*-- Exported functions -----------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Move HAL tick forward, emulated SysTick.
+ *
+ *  @param  ms - milliseconds passed.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void HostHal_AdvanceTick(uint32_t ms)
+{
+	hostHalTick += ms;
+}
+
+/******************************************************************************
+ *  @brief  CPU time stamp: TSC cycles on x86, nanoseconds elsewhere.
+ *
+ *  @param  None.
+ *
+ *  @retval time stamp.
+ *****************************************************************************/
+uint64_t HostHal_Cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/******************************************************************************
+ *  @brief  Unit of HostHal_Cycles for reports.
+ *
+ *  @param  None.
+ *
+ *  @retval unit name.
+ *****************************************************************************/
+const char *HostHal_CyclesUnit(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return "cycle";
+#else
+	return "ns";
+#endif
+}
+
+/******************************************************************************
+ *  @brief  Account one call of a measured site.
+ *
+ *  @param  latency - call site counters.
+ *  @param  start - HostHal_Cycles before the call.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void HostHal_LatencyAdd(HostHal_Latency_t *latency, uint64_t start)
+{
+	uint64_t cycles = HostHal_Cycles() - start;
+
+	latency->Calls++;
+	latency->Total += cycles;
+	if(cycles > latency->Max)
+	{
+		latency->Max = cycles;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Average cost of a call site.
+ *
+ *  @param  latency - call site counters.
+ *
+ *  @retval average per call, HostHal_Cycles units.
+ *****************************************************************************/
+double HostHal_LatencyAverage(const HostHal_Latency_t *latency)
+{
+	return (latency->Calls > 0) ? ((double)latency->Total / (double)latency->Calls) : 0.0;
+}
+
+/*-- HAL --------------------------------------------------------------------*/
+uint32_t HAL_GetTick(void)
+{
+	return hostHalTick;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	hostHalTick += Delay;
+}
+
+uint32_t HAL_GetUIDw0(void)
+{
+	return HOST_HAL_UID_W0;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+	return HOST_HAL_PCLK1_HZ;
+}
+
+void Error_Handler(void)
+{
+	fprintf(stderr, "Error_Handler called\n");
+	abort();
+}
+
+/*-- Heap -------------------------------------------------------------------*/
+void *__wrap_malloc(size_t size)
+{
+	HostHal_Allocations++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	HostHal_Allocations++;
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size)
+{
+	HostHal_Allocations++;
+	return __real_realloc(pointer, size);
+}
+
+/*-- EOF --------------------------------------------------------------------*/
@@ -0,0 +1,43 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    HostHal.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Exported macro ---------------------------------------------------------*/
+//Unique device ID and APB1 clock reported to firmware
+#define HOST_HAL_UID_W0					0x00350041UL
+#define HOST_HAL_PCLK1_HZ				45000000UL
+
+/*-- Typedefs ---------------------------------------------------------------*/
+//Cost of one call site, host CPU time stamps (HostHal_Cycles)
+typedef struct
+{
+	uint64_t Calls;
+	uint64_t Total;
+	uint64_t Max;
+}HostHal_Latency_t;
+
+/*-- Exported variables -----------------------------------------------------*/
+extern uint32_t HostHal_Primask;
+extern volatile uint32_t HostHal_Allocations;
+
+/*-- Exported functions -----------------------------------------------------*/
+void HostHal_AdvanceTick(uint32_t ms);
+uint64_t HostHal_Cycles(void);
+const char *HostHal_CyclesUnit(void);
+void HostHal_LatencyAdd(HostHal_Latency_t *latency, uint64_t start);
+double HostHal_LatencyAverage(const HostHal_Latency_t *latency);
+
+#endif // HOST_HAL_H
+/*-- EOF --------------------------------------------------------------------*/
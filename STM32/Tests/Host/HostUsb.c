@@ -0,0 +1,478 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    HostUsb.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+/*
+ * Simulated USB device controller and host. Replaces USB_DEVICE/Target
+ * usbd_conf.c: USBD_LL_xxx only record what the stack arms, the host side
+ * functions below play transactions against it and raise the same
+ * USBD_LL_xxxStage callbacks the PCD interrupt would, with the transfer
+ * semantics of the OTG core: EP0 completes every packet, other endpoints
+ * complete on a full transfer or a short packet. Full speed only, the
+ * test thread stands for the USB interrupt between main loop calls.
+ */
+
+#include "HostUsb.h"
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+#include "usbd_core.h"
+
+/*-- Project specific includes ----------------------------------------------*/
+#include "HostHal.h"
+
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+#define HOST_USB_EP_NUM(epAddr)			((uint8_t)((epAddr) & 0x0FU))
+#define HOST_USB_EP_IS_IN(epAddr)		(((epAddr) & 0x80U) != 0U)
+
+//Address given to the device on enumeration
+#define HOST_USB_DEVICE_ADDRESS			1U
+
+#define HOST_USB_CONFIG_DESC_MAX		512U
+
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+static PCD_HandleTypeDef hostUsbPcd;
+static USBD_HandleTypeDef *hostUsbDevice;
+
+//Transfer armed by the stack and not completed yet
+static bool hostUsbInArmed[16];
+static bool hostUsbOutArmed[16];
+
+static uint8_t hostUsbAddress;
+
+/*-- Local functions --------------------------------------------------------*/
+static void HostUsb_Fail(const char *reason, uint8_t epAddr)
+{
+	fprintf(stderr, "HostUsb: %s, endpoint 0x%02X\n", reason, epAddr);
+	abort();
+}
+
+static PCD_EPTypeDef *HostUsb_Endpoint(uint8_t epAddr)
+{
+	return HOST_USB_EP_IS_IN(epAddr) ? &hostUsbPcd.IN_ep[HOST_USB_EP_NUM(epAddr)] : &hostUsbPcd.OUT_ep[HOST_USB_EP_NUM(epAddr)];
+}
+
+static bool *HostUsb_Armed(uint8_t epAddr)
+{
+	return HOST_USB_EP_IS_IN(epAddr) ? &hostUsbInArmed[HOST_USB_EP_NUM(epAddr)] : &hostUsbOutArmed[HOST_USB_EP_NUM(epAddr)];
+}
+
+/******************************************************************************
+ *  @brief  Host sends SETUP packet. SETUP is always accepted, it clears EP0
+ *          stall and aborts stages of the previous request.
+ *
+ *  @param  bmRequest, bRequest, wValue, wIndex, wLength - request fields.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void HostUsb_Setup(uint8_t bmRequest, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength)
+{
+	uint8_t *setup = (uint8_t *)hostUsbPcd.Setup;
+
+	setup[0] = bmRequest;
+	setup[1] = bRequest;
+	setup[2] = (uint8_t)wValue;
+	setup[3] = (uint8_t)(wValue >> 8);
+	setup[4] = (uint8_t)wIndex;
+	setup[5] = (uint8_t)(wIndex >> 8);
+	setup[6] = (uint8_t)wLength;
+	setup[7] = (uint8_t)(wLength >> 8);
+
+	hostUsbPcd.IN_ep[0].is_stall = 0U;
+	hostUsbPcd.OUT_ep[0].is_stall = 0U;
+	hostUsbInArmed[0] = false;
+	hostUsbOutArmed[0] = false;
+
+	USBD_LL_SetupStage(hostUsbDevice, setup);
+}
+
+/*-- Exported functions -----------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Bus reset and enumeration: device descriptor, address and
+ *          configuration. Aborts if the device does not configure.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void HostUsb_Connect(void)
+{
+	static uint8_t configuration[HOST_USB_CONFIG_DESC_MAX];
+	uint8_t device[USB_LEN_DEV_DESC];
+	uint16_t totalLength;
+
+	if(hostUsbDevice == NULL)
+	{
+		HostUsb_Fail("USBD_LL_Init not called", 0U);
+	}
+
+	USBD_LL_SetSpeed(hostUsbDevice, USBD_SPEED_FULL);
+	USBD_LL_Reset(hostUsbDevice);
+
+	if((HostUsb_ControlRead(HOST_USB_REQ_DEVICE_IN, USB_REQ_GET_DESCRIPTOR, (USB_DESC_TYPE_DEVICE << 8), 0U, device, sizeof(device)) != (int32_t)sizeof(device)) ||
+	   (device[1] != USB_DESC_TYPE_DEVICE))
+	{
+		HostUsb_Fail("device descriptor", 0U);
+	}
+
+	if(HostUsb_ControlWrite(HOST_USB_REQ_DEVICE_OUT, USB_REQ_SET_ADDRESS, HOST_USB_DEVICE_ADDRESS, 0U, NULL, 0U) != 0)
+	{
+		HostUsb_Fail("SET_ADDRESS", 0U);
+	}
+
+	if(HostUsb_ControlRead(HOST_USB_REQ_DEVICE_IN, USB_REQ_GET_DESCRIPTOR, (USB_DESC_TYPE_CONFIGURATION << 8), 0U, configuration, USB_LEN_CFG_DESC) != USB_LEN_CFG_DESC)
+	{
+		HostUsb_Fail("configuration descriptor", 0U);
+	}
+
+	totalLength = (uint16_t)(configuration[2] | (configuration[3] << 8));
+	if((totalLength > sizeof(configuration)) ||
+	   (HostUsb_ControlRead(HOST_USB_REQ_DEVICE_IN, USB_REQ_GET_DESCRIPTOR, (USB_DESC_TYPE_CONFIGURATION << 8), 0U, configuration, totalLength) != totalLength))
+	{
+		HostUsb_Fail("configuration descriptor", 0U);
+	}
+
+	if((HostUsb_ControlWrite(HOST_USB_REQ_DEVICE_OUT, USB_REQ_SET_CONFIGURATION, configuration[5], 0U, NULL, 0U) != 0) ||
+	   (hostUsbDevice->dev_state != USBD_STATE_CONFIGURED))
+	{
+		HostUsb_Fail("SET_CONFIGURATION", 0U);
+	}
+}
+
+/******************************************************************************
+ *  @brief  Control transfer with IN data stage.
+ *
+ *  @param  bmRequest, bRequest, wValue, wIndex - request fields.
+ *  @param  data - buffer for received data.
+ *  @param  wLength - requested length.
+ *
+ *  @retval received length or HOST_USB_STALL / HOST_USB_NAK.
+ *****************************************************************************/
+int32_t HostUsb_ControlRead(uint8_t bmRequest, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t *data, uint16_t wLength)
+{
+	uint8_t packet[USB_MAX_EP0_SIZE];
+	uint32_t received = 0;
+	int32_t result;
+
+	HostUsb_Setup(bmRequest, bRequest, wValue, wIndex, wLength);
+
+	while(received < wLength)
+	{
+		uint32_t length;
+
+		result = HostUsb_In(0x80U, packet, sizeof(packet));
+		if(result < 0)
+		{
+			return result;
+		}
+
+		length = (uint32_t)result;
+		if(length > (wLength - received))
+		{
+			HostUsb_Fail("control data longer than wLength", 0x80U);
+		}
+
+		memcpy(&data[received], packet, length);
+		received += length;
+
+		if(length < hostUsbPcd.IN_ep[0].maxpacket)
+		{
+			break;
+		}
+	}
+
+	//Status stage: zero length OUT
+	result = HostUsb_Out(0x00U, NULL, 0U);
+
+	return (result < 0) ? result : (int32_t)received;
+}
+
+/******************************************************************************
+ *  @brief  Control transfer with OUT or no data stage.
+ *
+ *  @param  bmRequest, bRequest, wValue, wIndex - request fields.
+ *  @param  data - data to send, NULL if wLength is 0.
+ *  @param  wLength - data length.
+ *
+ *  @retval sent length or HOST_USB_STALL / HOST_USB_NAK.
+ *****************************************************************************/
+int32_t HostUsb_ControlWrite(uint8_t bmRequest, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, const uint8_t *data, uint16_t wLength)
+{
+	uint32_t sent = 0;
+	int32_t result;
+
+	HostUsb_Setup(bmRequest, bRequest, wValue, wIndex, wLength);
+
+	while(sent < wLength)
+	{
+		uint32_t length = wLength - sent;
+
+		if(length > hostUsbPcd.OUT_ep[0].maxpacket)
+		{
+			length = hostUsbPcd.OUT_ep[0].maxpacket;
+		}
+
+		result = HostUsb_Out(0x00U, &data[sent], length);
+		if(result < 0)
+		{
+			return result;
+		}
+
+		sent += length;
+	}
+
+	//Status stage: zero length IN
+	result = HostUsb_In(0x80U, NULL, 0U);
+
+	return (result < 0) ? result : (int32_t)sent;
+}
+
+/******************************************************************************
+ *  @brief  Host sends one OUT data packet.
+ *
+ *  @param  epAddr - OUT endpoint address.
+ *  @param  data - packet data.
+ *  @param  length - packet length, up to max packet size.
+ *
+ *  @retval accepted length or HOST_USB_NAK / HOST_USB_STALL.
+ *****************************************************************************/
+int32_t HostUsb_Out(uint8_t epAddr, const uint8_t *data, uint32_t length)
+{
+	PCD_EPTypeDef *ep = HostUsb_Endpoint(epAddr);
+	bool *armed = HostUsb_Armed(epAddr);
+	uint8_t epNum = HOST_USB_EP_NUM(epAddr);
+
+	if(ep->is_stall)
+	{
+		return HOST_USB_STALL;
+	}
+
+	if(!*armed)
+	{
+		return HOST_USB_NAK;
+	}
+
+	if((length > ep->maxpacket) || ((ep->xfer_count + length) > ep->xfer_len))
+	{
+		HostUsb_Fail("OUT packet overruns armed transfer", epAddr);
+	}
+
+	if(length > 0)
+	{
+		memcpy(ep->xfer_buff, data, length);
+		ep->xfer_buff += length;
+	}
+	ep->xfer_count += length;
+
+	if((epNum == 0U) || (ep->xfer_count >= ep->xfer_len) || (length < ep->maxpacket))
+	{
+		*armed = false;
+		USBD_LL_DataOutStage(hostUsbDevice, epNum, ep->xfer_buff);
+	}
+
+	return (int32_t)length;
+}
+
+/******************************************************************************
+ *  @brief  Host reads the armed IN transfer: one packet on EP0, the whole
+ *          transfer on other endpoints.
+ *
+ *  @param  epAddr - IN endpoint address.
+ *  @param  data - buffer for data.
+ *  @param  capacity - buffer size, must hold the transfer.
+ *
+ *  @retval received length or HOST_USB_NAK / HOST_USB_STALL.
+ *****************************************************************************/
+int32_t HostUsb_In(uint8_t epAddr, uint8_t *data, uint32_t capacity)
+{
+	PCD_EPTypeDef *ep = HostUsb_Endpoint(epAddr);
+	bool *armed = HostUsb_Armed(epAddr);
+	uint8_t epNum = HOST_USB_EP_NUM(epAddr);
+	uint32_t length;
+
+	if(ep->is_stall)
+	{
+		return HOST_USB_STALL;
+	}
+
+	if(!*armed)
+	{
+		return HOST_USB_NAK;
+	}
+
+	length = ep->xfer_len;
+	if((epNum == 0U) && (length > ep->maxpacket))
+	{
+		length = ep->maxpacket;
+	}
+
+	if(length > capacity)
+	{
+		HostUsb_Fail("IN transfer longer than host buffer", epAddr);
+	}
+
+	if(length > 0)
+	{
+		memcpy(data, ep->xfer_buff, length);
+		ep->xfer_buff += length;
+	}
+	ep->xfer_count = length;
+
+	//Completion may arm the next transfer on the same endpoint
+	*armed = false;
+	USBD_LL_DataInStage(hostUsbDevice, epNum, ep->xfer_buff);
+
+	return (int32_t)length;
+}
+
+/******************************************************************************
+ *  @brief  Start of frame, moves HAL tick by one full speed frame.
+ *
+ *  @param  None.
+ *
+ *  @retval None.
+ *****************************************************************************/
+void HostUsb_Sof(void)
+{
+	HostHal_AdvanceTick(1U);
+	USBD_LL_SOF(hostUsbDevice);
+}
+
+uint16_t HostUsb_MaxPacket(uint8_t epAddr)
+{
+	return (uint16_t)HostUsb_Endpoint(epAddr)->maxpacket;
+}
+
+bool HostUsb_IsArmed(uint8_t epAddr)
+{
+	return *HostUsb_Armed(epAddr);
+}
+
+/*-- Low level driver -------------------------------------------------------*/
+USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
+{
+	memset(&hostUsbPcd, 0, sizeof(hostUsbPcd));
+	memset(hostUsbInArmed, 0, sizeof(hostUsbInArmed));
+	memset(hostUsbOutArmed, 0, sizeof(hostUsbOutArmed));
+
+	hostUsbPcd.pData = pdev;
+	pdev->pData = &hostUsbPcd;
+	hostUsbDevice = pdev;
+
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_DeInit(USBD_HandleTypeDef *pdev)
+{
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Start(USBD_HandleTypeDef *pdev)
+{
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Stop(USBD_HandleTypeDef *pdev)
+{
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_OpenEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t ep_type, uint16_t ep_mps)
+{
+	PCD_EPTypeDef *ep = HostUsb_Endpoint(ep_addr);
+
+	ep->num = HOST_USB_EP_NUM(ep_addr);
+	ep->is_in = HOST_USB_EP_IS_IN(ep_addr) ? 1U : 0U;
+	ep->type = ep_type;
+	ep->maxpacket = ep_mps;
+	ep->is_stall = 0U;
+	*HostUsb_Armed(ep_addr) = false;
+
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_CloseEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+	*HostUsb_Armed(ep_addr) = false;
+
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_FlushEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_StallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+	HostUsb_Endpoint(ep_addr)->is_stall = 1U;
+
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_ClearStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+	HostUsb_Endpoint(ep_addr)->is_stall = 0U;
+
+	return USBD_OK;
+}
+
+uint8_t USBD_LL_IsStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+	return HostUsb_Endpoint(ep_addr)->is_stall;
+}
+
+USBD_StatusTypeDef USBD_LL_SetUSBAddress(USBD_HandleTypeDef *pdev, uint8_t dev_addr)
+{
+	hostUsbAddress = dev_addr;
+
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Transmit(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint32_t size)
+{
+	PCD_EPTypeDef *ep = HostUsb_Endpoint(ep_addr | 0x80U);
+
+	ep->xfer_buff = pbuf;
+	ep->xfer_len = size;
+	ep->xfer_count = 0U;
+	hostUsbInArmed[HOST_USB_EP_NUM(ep_addr)] = true;
+
+	return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint32_t size)
+{
+	PCD_EPTypeDef *ep = HostUsb_Endpoint(ep_addr & 0x7FU);
+
+	ep->xfer_buff = pbuf;
+	ep->xfer_len = size;
+	ep->xfer_count = 0U;
+	hostUsbOutArmed[HOST_USB_EP_NUM(ep_addr)] = true;
+
+	return USBD_OK;
+}
+
+uint32_t USBD_LL_GetRxDataSize(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+	return hostUsbPcd.OUT_ep[HOST_USB_EP_NUM(ep_addr)].xfer_count;
+}
+
+void USBD_LL_Delay(uint32_t Delay)
+{
+	HAL_Delay(Delay);
+}
+
+/*-- EOF --------------------------------------------------------------------*/
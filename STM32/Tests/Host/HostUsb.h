@@ -0,0 +1,42 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    HostUsb.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+#ifndef HOST_USB_H
+#define HOST_USB_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Exported macro ---------------------------------------------------------*/
+//Negative results of host transactions
+#define HOST_USB_NAK					(-1)	//Endpoint not armed, retry later
+#define HOST_USB_STALL					(-2)	//Request or endpoint stalled
+
+//bmRequestType of control requests
+#define HOST_USB_REQ_DEVICE_IN			0x80U
+#define HOST_USB_REQ_DEVICE_OUT			0x00U
+#define HOST_USB_REQ_CLASS_ITF_IN		0xA1U
+#define HOST_USB_REQ_CLASS_ITF_OUT		0x21U
+#define HOST_USB_REQ_VENDOR_ITF_IN		0xC1U
+#define HOST_USB_REQ_VENDOR_ITF_OUT		0x41U
+
+/*-- Exported functions -----------------------------------------------------*/
+void HostUsb_Connect(void);
+int32_t HostUsb_ControlRead(uint8_t bmRequest, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint8_t *data, uint16_t wLength);
+int32_t HostUsb_ControlWrite(uint8_t bmRequest, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, const uint8_t *data, uint16_t wLength);
+int32_t HostUsb_Out(uint8_t epAddr, const uint8_t *data, uint32_t length);
+int32_t HostUsb_In(uint8_t epAddr, uint8_t *data, uint32_t capacity);
+void HostUsb_Sof(void);
+uint16_t HostUsb_MaxPacket(uint8_t epAddr);
+bool HostUsb_IsArmed(uint8_t epAddr);
+
+#endif // HOST_USB_H
+/*-- EOF --------------------------------------------------------------------*/
@@ -0,0 +1,372 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    RoundBufferBench.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+/*
+ * Host benchmark of RoundBuffer: bytes per CPU cycle of the SPSC ring with
+ * memcpy segments against the byte loop ring it replaced (kept below as
+ * OldRoundBuffer). Producer and consumer alternate in one thread, the way
+ * the USB ISR and the main loop share CDC buffers. Data is checked in a
+ * separate pass, the process fails on any mismatch.
+ */
+
+#include "RoundBuffer.h"
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+//Size of CDC Rx/Tx buffers in usbd_vcp.c
+#define BENCH_BUFFER_SIZE			1024
+
+//Bytes moved through the ring per run, best run is reported
+#define BENCH_BYTES					(16UL * 1024UL * 1024UL)
+#define BENCH_RUNS					5
+
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+//Ring of baseline firmware: wrap checked per byte, no full flag
+typedef struct
+{
+	uint8_t *Buff;
+	uint32_t Size;
+	uint32_t Tail;
+	uint32_t Head;
+}OldRoundBuffer_t;
+
+typedef struct
+{
+	const char *Name;
+	uint32_t Record;						//Producer record length, 1 - byte API
+	uint32_t Read;							//Consumer read length, 1 - byte API
+}Bench_Case_t;
+
+static const Bench_Case_t benchCases[] =
+{
+	{ "byte / byte",     1,  1  },
+	{ "slcan 23 / 64",   23, 64 },
+	{ "packet 64 / 64",  64, 64 },
+	{ "packet 64 / 512", 64, 512 },
+};
+
+static uint8_t benchStorage[BENCH_BUFFER_SIZE];
+static uint8_t benchIn[BENCH_BUFFER_SIZE];
+static uint8_t benchOut[BENCH_BUFFER_SIZE];
+
+/*-- Local functions --------------------------------------------------------*/
+static uint32_t OldRoundBuffer_GetLoad(OldRoundBuffer_t *buffer)
+{
+	int32_t bytes_num = buffer->Head - buffer->Tail;
+
+	if(bytes_num < 0)
+	{
+		bytes_num += buffer->Size;
+	}
+
+	return (uint32_t)bytes_num;
+}
+
+static void OldRoundBuffer_AddByte(OldRoundBuffer_t *buffer, uint8_t byte)
+{
+	buffer->Buff[buffer->Head++] = byte;
+
+	if (buffer->Head >= buffer->Size)
+	{
+		buffer->Head = 0;
+	}
+}
+
+static void OldRoundBuffer_AddArray(OldRoundBuffer_t *buffer, uint8_t *inArray, uint32_t length)
+{
+	while (length > 0)
+	{
+		buffer->Buff[buffer->Head++] = *inArray++;
+
+		if(buffer->Head >= buffer->Size)
+		{
+			buffer->Head = 0;
+		}
+
+		length--;
+	}
+}
+
+static uint8_t OldRoundBuffer_GetByte(OldRoundBuffer_t *buffer)
+{
+	uint8_t data = 0x00;
+
+	if(OldRoundBuffer_GetLoad(buffer) > 0)
+	{
+		uint32_t tail = buffer->Tail;
+
+		data = buffer->Buff[tail++];
+
+		if(tail >= buffer->Size)
+		{
+			tail = 0;
+		}
+
+		buffer->Tail = tail;
+	}
+
+	return data;
+}
+
+static uint32_t OldRoundBuffer_GetArray(OldRoundBuffer_t *buffer, uint8_t *outArray, uint32_t length)
+{
+	uint32_t getBytes = 0;
+	uint32_t buffLoad = OldRoundBuffer_GetLoad(buffer);
+	uint32_t i;
+
+	getBytes = (buffLoad > length) ? length : buffLoad;
+
+	for(i = 0; i < getBytes; i++)
+	{
+		outArray[i] = OldRoundBuffer_GetByte(buffer);
+	}
+
+	return getBytes;
+}
+
+/******************************************************************************
+ *  @brief  CPU time stamp: TSC cycles on x86, nanoseconds elsewhere.
+ *
+ *  @param  None.
+ *
+ *  @retval time stamp.
+ *****************************************************************************/
+static uint64_t Bench_Cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/******************************************************************************
+ *  @brief  Move bytes through the baseline ring.
+ *
+ *  @param  benchCase - record and read lengths.
+ *  @param  bytes - count of bytes to move.
+ *  @param  check - compare every read byte with the written sequence.
+ *
+ *  @retval mismatched bytes count.
+ *****************************************************************************/
+static uint32_t Bench_RunOld(const Bench_Case_t *benchCase, uint32_t bytes, bool check)
+{
+	OldRoundBuffer_t buffer = { benchStorage, sizeof(benchStorage), 0, 0 };
+	uint32_t written = 0;
+	uint32_t read = 0;
+	uint32_t errors = 0;
+	uint8_t sequence = 0;
+
+	while(read < bytes)
+	{
+		//Old ring cannot tell full from empty, one byte stays unused
+		while((written < bytes) && ((buffer.Size - 1 - OldRoundBuffer_GetLoad(&buffer)) >= benchCase->Record))
+		{
+			if(benchCase->Record == 1)
+			{
+				OldRoundBuffer_AddByte(&buffer, (uint8_t)written);
+			}
+			else
+			{
+				OldRoundBuffer_AddArray(&buffer, &benchIn[written & 0xFF], benchCase->Record);
+			}
+
+			written += benchCase->Record;
+		}
+
+		if(benchCase->Read == 1)
+		{
+			benchOut[0] = OldRoundBuffer_GetByte(&buffer);
+
+			if(check && (benchOut[0] != sequence++))
+			{
+				errors++;
+			}
+
+			read++;
+		}
+		else
+		{
+			uint32_t length = OldRoundBuffer_GetArray(&buffer, benchOut, benchCase->Read);
+			uint32_t i;
+
+			for(i = 0; check && (i < length); i++)
+			{
+				if(benchOut[i] != sequence++)
+				{
+					errors++;
+				}
+			}
+
+			read += length;
+		}
+	}
+
+	return errors;
+}
+
+/******************************************************************************
+ *  @brief  Move bytes through RoundBuffer.
+ *
+ *  @param  benchCase - record and read lengths.
+ *  @param  bytes - count of bytes to move.
+ *  @param  check - compare every read byte with the written sequence.
+ *
+ *  @retval mismatched bytes count.
+ *****************************************************************************/
+static uint32_t Bench_RunNew(const Bench_Case_t *benchCase, uint32_t bytes, bool check)
+{
+	RoundBuffer_t buffer = ROUND_BUFFER_INIT(benchStorage);
+	uint32_t written = 0;
+	uint32_t read = 0;
+	uint32_t errors = 0;
+	uint8_t sequence = 0;
+
+	while(read < bytes)
+	{
+		while((written < bytes) && (RoundBuffer_GetFree(&buffer) >= benchCase->Record))
+		{
+			if(benchCase->Record == 1)
+			{
+				RoundBuffer_AddByte(&buffer, (uint8_t)written);
+			}
+			else
+			{
+				RoundBuffer_AddArray(&buffer, &benchIn[written & 0xFF], benchCase->Record);
+			}
+
+			written += benchCase->Record;
+		}
+
+		if(benchCase->Read == 1)
+		{
+			benchOut[0] = RoundBuffer_GetByte(&buffer);
+
+			if(check && (benchOut[0] != sequence++))
+			{
+				errors++;
+			}
+
+			read++;
+		}
+		else
+		{
+			uint32_t length = RoundBuffer_GetArray(&buffer, benchOut, benchCase->Read);
+			uint32_t i;
+
+			for(i = 0; check && (i < length); i++)
+			{
+				if(benchOut[i] != sequence++)
+				{
+					errors++;
+				}
+			}
+
+			read += length;
+		}
+	}
+
+	return errors;
+}
+
+/******************************************************************************
+ *  @brief  Best time of several runs.
+ *
+ *  @param  run - ring under test.
+ *  @param  benchCase - record and read lengths.
+ *
+ *  @retval cycles of the fastest run.
+ *****************************************************************************/
+static uint64_t Bench_Measure(uint32_t (*run)(const Bench_Case_t *, uint32_t, bool), const Bench_Case_t *benchCase)
+{
+	uint64_t best = UINT64_MAX;
+	uint32_t index;
+
+	for(index = 0; index < BENCH_RUNS; index++)
+	{
+		uint64_t start = Bench_Cycles();
+		uint64_t cycles;
+
+		run(benchCase, BENCH_BYTES, false);
+		cycles = Bench_Cycles() - start;
+
+		if(cycles < best)
+		{
+			best = cycles;
+		}
+	}
+
+	return best;
+}
+
+/*-- Exported functions -----------------------------------------------------*/
+int main(void)
+{
+	uint32_t errors = 0;
+	uint32_t index;
+
+	//Record bytes continue the sequence whatever the record length is
+	for(index = 0; index < sizeof(benchIn); index++)
+	{
+		benchIn[index] = (uint8_t)index;
+	}
+
+	printf("RoundBuffer %u bytes, %lu MiB per run, best of %u, bytes/%s\n",
+		   BENCH_BUFFER_SIZE, BENCH_BYTES >> 20, BENCH_RUNS,
+#if defined(__x86_64__) || defined(__i386__)
+		   "cycle"
+#else
+		   "ns"
+#endif
+		   );
+	printf("%-18s %10s %10s %8s\n", "record / read", "old", "new", "speedup");
+
+	for(index = 0; index < sizeof(benchCases) / sizeof(benchCases[0]); index++)
+	{
+		const Bench_Case_t *benchCase = &benchCases[index];
+		uint64_t oldCycles;
+		uint64_t newCycles;
+
+		errors += Bench_RunOld(benchCase, 1UL << 20, true);
+		errors += Bench_RunNew(benchCase, 1UL << 20, true);
+
+		oldCycles = Bench_Measure(Bench_RunOld, benchCase);
+		newCycles = Bench_Measure(Bench_RunNew, benchCase);
+
+		printf("%-18s %10.3f %10.3f %7.1fx\n", benchCase->Name,
+			   (double)BENCH_BYTES / (double)oldCycles,
+			   (double)BENCH_BYTES / (double)newCycles,
+			   (double)oldCycles / (double)newCycles);
+	}
+
+	if(errors > 0)
+	{
+		printf("FAIL: %u bytes mismatched\n", errors);
+		return 1;
+	}
+
+	return 0;
+}
+/*-- EOF --------------------------------------------------------------------*/
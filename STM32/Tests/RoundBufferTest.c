@@ -0,0 +1,273 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    RoundBufferTest.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+/*
+ * Host test of RoundBuffer overflow handling on a 16 byte ring of 4 byte
+ * records: REJECT on the single byte path, DROP_OLDEST without a claim and
+ * DROP_OLDEST while the consumer holds bytes of RoundBuffer_PeekContiguous,
+ * including a claim which ends inside a record split by the wrap. Claimed
+ * bytes must stay in place, the oldest unclaimed records must go and the
+ * rest must come out in order.
+ */
+
+#include "RoundBuffer.h"
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+#define TEST_BUFFER_SIZE				16
+#define TEST_RECORD_SIZE				4
+
+/*-- Local typedefs ---------------------------------------------------------*/
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+static uint8_t testStorage[TEST_BUFFER_SIZE];
+static uint32_t testErrors;
+
+/*-- Local functions --------------------------------------------------------*/
+/******************************************************************************
+ *  @brief  Report a failed check.
+ *
+ *  @param  ok - check result.
+ *  @param  what - checked property.
+ *
+ *  @retval ok.
+ *****************************************************************************/
+static bool Test_Check(bool ok, const char *what)
+{
+	if(!ok)
+	{
+		printf("FAIL: %s\n", what);
+		testErrors++;
+	}
+
+	return ok;
+}
+
+/******************************************************************************
+ *  @brief  Empty ring of 4 byte records with given overflow policy.
+ *
+ *  @param  buffer - ring to set up.
+ *  @param  policy - overflow policy.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_Init(RoundBuffer_t *buffer, RoundBuffer_OverflowPolicy_t policy)
+{
+	RoundBuffer_t init = ROUND_BUFFER_INIT(testStorage);
+
+	*buffer = init;
+	RoundBuffer_SetOverflowPolicy(buffer, policy, TEST_RECORD_SIZE, 0);
+}
+
+/******************************************************************************
+ *  @brief  Add record filled with its number.
+ *
+ *  @param  buffer - ring.
+ *  @param  number - record number.
+ *
+ *  @retval true if record was stored.
+ *****************************************************************************/
+static bool Test_AddRecord(RoundBuffer_t *buffer, uint8_t number)
+{
+	uint8_t record[TEST_RECORD_SIZE];
+
+	memset(record, number, sizeof(record));
+
+	return (RoundBuffer_AddArray(buffer, record, sizeof(record)) == sizeof(record));
+}
+
+/******************************************************************************
+ *  @brief  Read the ring out and compare with expected bytes.
+ *
+ *  @param  buffer - ring.
+ *  @param  expected - bytes which must be left.
+ *  @param  length - count of expected bytes.
+ *
+ *  @retval true if ring held exactly expected bytes.
+ *****************************************************************************/
+static bool Test_ReadAll(RoundBuffer_t *buffer, const uint8_t *expected, uint32_t length)
+{
+	uint8_t out[TEST_BUFFER_SIZE + 1];
+	uint32_t read = RoundBuffer_GetArray(buffer, out, sizeof(out));
+
+	return ((read == length) && (memcmp(out, expected, length) == 0));
+}
+
+/******************************************************************************
+ *  @brief  Single byte path: fills up, rejects one byte, reads back.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_Bytes(void)
+{
+	RoundBuffer_t buffer;
+	RoundBuffer_Stats_t stats;
+	bool stored = true;
+	bool order = true;
+	uint32_t index;
+
+	Test_Init(&buffer, ROUND_BUFFER_OVERFLOW_REJECT);
+
+	for(index = 0; index < TEST_BUFFER_SIZE; index++)
+	{
+		stored &= RoundBuffer_AddByte(&buffer, (uint8_t)index);
+	}
+
+	Test_Check(stored, "bytes stored up to size");
+	Test_Check(!RoundBuffer_AddByte(&buffer, 0xFF), "byte rejected when full");
+
+	RoundBuffer_GetStats(&buffer, &stats);
+	Test_Check((stats.DroppedRecords == 1) && (stats.DroppedBytes == 1) && (stats.HighWater == TEST_BUFFER_SIZE), "byte stats");
+
+	for(index = 0; index < TEST_BUFFER_SIZE; index++)
+	{
+		order &= (RoundBuffer_GetByte(&buffer) == index);
+	}
+
+	Test_Check(order && (RoundBuffer_GetLoad(&buffer) == 0), "bytes read in order");
+}
+
+/******************************************************************************
+ *  @brief  DROP_OLDEST without a claim moves Tail.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_DropUnclaimed(void)
+{
+	static const uint8_t expected[] = { 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5 };
+	RoundBuffer_t buffer;
+	RoundBuffer_Stats_t stats;
+	uint8_t number;
+
+	Test_Init(&buffer, ROUND_BUFFER_OVERFLOW_DROP_OLDEST);
+
+	for(number = 1; number <= 5; number++)
+	{
+		Test_Check(Test_AddRecord(&buffer, number), "record stored, oldest dropped");
+	}
+
+	RoundBuffer_GetStats(&buffer, &stats);
+	Test_Check((stats.DroppedRecords == 1) && (stats.DroppedBytes == TEST_RECORD_SIZE), "unclaimed drop stats");
+	Test_Check(Test_ReadAll(&buffer, expected, sizeof(expected)), "records after unclaimed drop");
+}
+
+/******************************************************************************
+ *  @brief  DROP_OLDEST while the consumer holds the two oldest records of a
+ *          wrapped ring: the third goes, the fourth moves down.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_DropBehindClaim(void)
+{
+	static const uint8_t claimedBytes[] = { 1, 1, 1, 1, 2, 2, 2, 2 };
+	static const uint8_t expected[] = { 4, 4, 4, 4, 5, 5, 5, 5 };
+	RoundBuffer_t buffer;
+	RoundBuffer_Stats_t stats;
+	uint8_t out[2 * TEST_RECORD_SIZE];
+	uint8_t *data;
+	uint32_t length;
+	uint8_t number;
+
+	Test_Init(&buffer, ROUND_BUFFER_OVERFLOW_DROP_OLDEST);
+
+	//Tail in the middle of storage: claimed records end at the wrap
+	Test_AddRecord(&buffer, 0);
+	Test_AddRecord(&buffer, 0);
+	RoundBuffer_GetArray(&buffer, out, sizeof(out));
+
+	for(number = 1; number <= 4; number++)
+	{
+		Test_AddRecord(&buffer, number);
+	}
+
+	data = RoundBuffer_PeekContiguous(&buffer, &length);
+	Test_Check(length == sizeof(claimedBytes), "claim up to the wrap");
+
+	Test_Check(Test_AddRecord(&buffer, 5), "record stored behind claim");
+	Test_Check(memcmp(data, claimedBytes, sizeof(claimedBytes)) == 0, "claimed bytes untouched");
+
+	RoundBuffer_GetStats(&buffer, &stats);
+	Test_Check((stats.DroppedRecords == 1) && (stats.DroppedBytes == TEST_RECORD_SIZE), "drop behind claim stats");
+
+	RoundBuffer_Consume(&buffer, length);
+	Test_Check(Test_ReadAll(&buffer, expected, sizeof(expected)), "records after drop behind claim");
+
+	//Whole ring claimed: nothing to drop
+	Test_Init(&buffer, ROUND_BUFFER_OVERFLOW_DROP_OLDEST);
+
+	for(number = 1; number <= 4; number++)
+	{
+		Test_AddRecord(&buffer, number);
+	}
+
+	RoundBuffer_PeekContiguous(&buffer, &length);
+	Test_Check(!Test_AddRecord(&buffer, 5), "record rejected when all is claimed");
+	RoundBuffer_Consume(&buffer, length);
+}
+
+/******************************************************************************
+ *  @brief  Claim ends inside a record split by the wrap: the record is kept
+ *          whole, the next one goes.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Test_DropPartialClaim(void)
+{
+	static const uint8_t expected[] = { 4, 4, 4, 4, 6, 6, 6, 6, 7, 7, 7, 7, 8, 8, 8, 8 };
+	RoundBuffer_t buffer;
+	uint8_t out[TEST_BUFFER_SIZE];
+	uint32_t length;
+	uint8_t number;
+
+	Test_Init(&buffer, ROUND_BUFFER_OVERFLOW_DROP_OLDEST);
+
+	//Records start 2 bytes into storage, record 4 is split by the wrap
+	RoundBuffer_AddArray(&buffer, out, 2);
+	RoundBuffer_GetArray(&buffer, out, 2);
+
+	for(number = 1; number <= 7; number++)
+	{
+		Test_AddRecord(&buffer, number);
+		if(number == 4)
+		{
+			RoundBuffer_GetArray(&buffer, out, 3 * TEST_RECORD_SIZE);
+		}
+	}
+
+	RoundBuffer_PeekContiguous(&buffer, &length);
+	Test_Check(length == 2, "claim ends inside a record");
+
+	Test_Check(Test_AddRecord(&buffer, 8), "record stored behind partial claim");
+
+	RoundBuffer_Consume(&buffer, length);
+	Test_Check(Test_ReadAll(&buffer, &expected[2], sizeof(expected) - 2), "records after drop behind partial claim");
+}
+
+/*-- Exported functions -----------------------------------------------------*/
+int main(void)
+{
+	printf("RoundBuffer overflow, %u byte ring of %u byte records\n", TEST_BUFFER_SIZE, TEST_RECORD_SIZE);
+
+	Test_Bytes();
+	Test_DropUnclaimed();
+	Test_DropBehindClaim();
+	Test_DropPartialClaim();
+
+	printf("%s, %u errors\n", (testErrors > 0) ? "FAIL" : "pass", testErrors);
+
+	return (testErrors > 0) ? 1 : 0;
+}
+/*-- EOF --------------------------------------------------------------------*/
@@ -0,0 +1,41 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    RoundBufferPort.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+#ifndef ROUND_BUFFER_PORT_H
+#define ROUND_BUFFER_PORT_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+#include <time.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+/*-- Project specific includes ----------------------------------------------*/
+/*-- Exported macro ---------------------------------------------------------*/
+/*
+ * Host services of RoundBuffer.c, shadows Core/Inc/RoundBufferPort.h.
+ * Producer and consumer run in one thread, so there is nothing to lock and
+ * the barrier only has to keep the compiler from reordering, like DMB does
+ * on the single core target.
+ */
+#define ROUND_BUFFER_BARRIER()			__atomic_thread_fence(__ATOMIC_ACQ_REL)
+#define ROUND_BUFFER_LOCK()				0U
+#define ROUND_BUFFER_UNLOCK(state)		((void)(state))
+#define ROUND_BUFFER_GET_TICK()			RoundBufferPort_GetTick()
+
+/*-- Exported functions -----------------------------------------------------*/
+static inline uint32_t RoundBufferPort_GetTick(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint32_t)((now.tv_sec * 1000) + (now.tv_nsec / 1000000));
+}
+
+#endif // ROUND_BUFFER_PORT_H
+/*-- EOF --------------------------------------------------------------------*/
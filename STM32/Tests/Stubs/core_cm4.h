@@ -0,0 +1,67 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    core_cm4.h
+ *
+ *   @author:  valeriy.williams
+ *   @company: lab.
+ */
+
+/*
+ * Host replacement of the CMSIS Cortex-M4 core header. stm32f446xx.h and HAL
+ * headers are the target ones, only core intrinsics are emulated: interrupt
+ * mask is a host variable (HostHal.c), barriers are compiler fences. Core
+ * peripherals (NVIC, SysTick, SCB) are not modelled.
+ */
+
+#ifndef CORE_CM4_H
+#define CORE_CM4_H
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdint.h>
+
+/*-- Exported macro ---------------------------------------------------------*/
+#define __I								volatile const
+#define __O								volatile
+#define __IO							volatile
+#define __IM							volatile const
+#define __OM							volatile
+#define __IOM							volatile
+
+#define __ASM							__asm__
+#define __INLINE						inline
+#define __STATIC_INLINE					static inline
+#define __STATIC_FORCEINLINE			static inline
+
+//Single core: ordering against ISR needs only the compiler to keep it
+#define __DMB()							__atomic_thread_fence(__ATOMIC_ACQ_REL)
+#define __DSB()							__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __ISB()							__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __NOP()							((void)0)
+#define __WFI()							((void)0)
+
+/*-- Exported variables -----------------------------------------------------*/
+//PRIMASK of emulated core: 1 - interrupts masked
+extern uint32_t HostHal_Primask;
+
+/*-- Exported functions -----------------------------------------------------*/
+static inline uint32_t __get_PRIMASK(void)
+{
+	return HostHal_Primask;
+}
+
+static inline void __set_PRIMASK(uint32_t priMask)
+{
+	HostHal_Primask = priMask & 1U;
+}
+
+static inline void __disable_irq(void)
+{
+	HostHal_Primask = 1U;
+}
+
+static inline void __enable_irq(void)
+{
+	HostHal_Primask = 0U;
+}
+
+#endif // CORE_CM4_H
+/*-- EOF --------------------------------------------------------------------*/
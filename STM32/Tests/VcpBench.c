@@ -0,0 +1,576 @@
+/*-- File description -------------------------------------------------------*/
+/**
+ *   @file:    VcpBench.c
+ *
+ *   @author:  valeriy.williams.
+ *   @company: Lab.
+ */
+
+/*
+ * Host benchmark of the VCP data path through the real USB device stack:
+ * simulated host writes OUT packets (CDC_Receive -> USB_VCP_DataReceivedCallback),
+ * main loop runs USB_VCP_Run, host reads IN transfers which chain the next
+ * CDC_Transmit from USB_VCP_TransmitCompleteCallback. CDC channels run the
+ * echo handler (built with USB_VCP_SLCAN=0), so every sent byte must come
+ * back in order. The vendor channel streams CAN frame records produced by
+ * USB_VCP_VendorSendFrame, every record must be decoded back in order.
+ * Reports bytes per CPU cycle, cost of every call site and heap calls of the
+ * firmware; fails on data mismatch, stall or any allocation.
+ */
+
+/*-- Standart C/C++ Libraries -----------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*-- Other libraries --------------------------------------------------------*/
+/*-- Hardware specific libraries --------------------------------------------*/
+#include "usb_device.h"
+#include "usbd_cdc.h"
+#include "usbd_cdc_if.h"
+#include "usbd_vendor.h"
+
+/*-- Project specific includes ----------------------------------------------*/
+#include "usbd_vcp.h"
+#include "HostHal.h"
+#include "HostUsb.h"
+
+/*-- Imported functions -----------------------------------------------------*/
+/*-- Local Macro Definitions ------------------------------------------------*/
+#if (USB_VCP_SLCAN != 0)
+#error "VcpBench needs echo channels, build with USB_VCP_SLCAN=0"
+#endif
+
+//Frames a case may take before the data path counts as stalled
+#define BENCH_FRAME_LIMIT				2000000UL
+
+//Main loop passes per 1 ms frame
+#define BENCH_RUNS_PER_FRAME			4
+
+#define BENCH_MAX_PIPES					NUM_OF_CDC_UARTS
+#define BENCH_ALL_PIPES					((1UL << BENCH_MAX_PIPES) - 1UL)
+
+/*-- Local function prototypes ----------------------------------------------*/
+/*-- Local variables --------------------------------------------------------*/
+//Frames streamed by the vendor case and produced per 1 ms frame: two buses
+//at full 1 Mbit/s load of short frames, about 8.5 frames/ms each, with margin
+#define BENCH_VENDOR_FRAMES				200000UL
+#define BENCH_VENDOR_FRAMES_PER_MS		20
+
+//Bulk pipe pair of one echo channel
+typedef struct
+{
+	const char *Name;
+	uint8_t OutEp;
+	uint8_t InEp;
+	uint8_t CmdInterface;					//DTR opens the port
+}Bench_Pipe_t;
+
+typedef struct
+{
+	const char *Name;
+	uint32_t Pipes;							//Bit mask of benchPipes
+	uint32_t Bytes;							//Echoed per pipe
+	uint32_t PacketSize;					//Host write size
+	uint32_t PacketsPerFrame;				//Host writes per pipe and frame
+}Bench_Case_t;
+
+typedef struct
+{
+	uint32_t Sent;
+	uint32_t Received;
+	uint32_t Errors;
+}Bench_PipeState_t;
+
+static const Bench_Pipe_t benchPipes[] =
+{
+	{ "cdc1", CDC_EP_DATA_OUT_1, CDC_EP_DATA_IN_1, CDC_ITF_CMD_1 },
+#if (NUM_OF_CDC_UARTS >= 2)
+	{ "cdc2", CDC_EP_DATA_OUT_2, CDC_EP_DATA_IN_2, CDC_ITF_CMD_2 },
+#endif
+#if (NUM_OF_CDC_UARTS >= 3)
+	{ "cdc3", CDC_EP_DATA_OUT_3, CDC_EP_DATA_IN_3, CDC_ITF_CMD_3 },
+#endif
+};
+
+static const Bench_Case_t benchCases[] =
+{
+	{ "cdc1 64 B writes",         0x01,            4UL << 20, 64, 16 },
+	{ "cdc1 8 B writes",          0x01,            256UL << 10, 8, 16 },
+	{ "all channels 64 B writes", BENCH_ALL_PIPES, 2UL << 20, 64, 6 },
+};
+
+static Bench_PipeState_t benchState[BENCH_MAX_PIPES];
+static uint8_t benchRx[USB_VCP_TX_TRANSFER_SIZE];
+
+static HostHal_Latency_t benchRxIsr;
+static HostHal_Latency_t benchRun;
+static HostHal_Latency_t benchTxIsr;
+static HostHal_Latency_t benchSof;
+
+/*-- Local functions --------------------------------------------------------*/
+static uint8_t Bench_Pattern(uint32_t pipe, uint32_t offset)
+{
+	return (uint8_t)((offset * 7U) + (offset >> 8) + pipe);
+}
+
+/******************************************************************************
+ *  @brief  Host writes up to PacketsPerFrame packets to a pipe, stops on NAK.
+ *
+ *  @param  benchCase - case parameters.
+ *  @param  pipe - index of benchPipes.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Bench_Write(const Bench_Case_t *benchCase, uint32_t pipe)
+{
+	Bench_PipeState_t *state = &benchState[pipe];
+	uint8_t packet[64];
+	uint32_t count;
+
+	for(count = 0; (count < benchCase->PacketsPerFrame) && (state->Sent < benchCase->Bytes); count++)
+	{
+		uint32_t length = benchCase->Bytes - state->Sent;
+		uint32_t index;
+		uint64_t start;
+		int32_t result;
+
+		if(length > benchCase->PacketSize)
+		{
+			length = benchCase->PacketSize;
+		}
+
+		for(index = 0; index < length; index++)
+		{
+			packet[index] = Bench_Pattern(pipe, state->Sent + index);
+		}
+
+		start = HostHal_Cycles();
+		result = HostUsb_Out(benchPipes[pipe].OutEp, packet, length);
+		if(result < 0)
+		{
+			break;
+		}
+		HostHal_LatencyAdd(&benchRxIsr, start);
+
+		state->Sent += length;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Host reads IN transfers of a pipe until NAK and checks the echo.
+ *
+ *  @param  pipe - index of benchPipes.
+ *
+ *  @retval false if the endpoint stalled.
+ *****************************************************************************/
+static bool Bench_Read(uint32_t pipe)
+{
+	Bench_PipeState_t *state = &benchState[pipe];
+
+	for(;;)
+	{
+		uint64_t start = HostHal_Cycles();
+		int32_t result = HostUsb_In(benchPipes[pipe].InEp, benchRx, sizeof(benchRx));
+		int32_t index;
+
+		if(result < 0)
+		{
+			return (result != HOST_USB_STALL);
+		}
+		HostHal_LatencyAdd(&benchTxIsr, start);
+
+		for(index = 0; index < result; index++)
+		{
+			if(benchRx[index] != Bench_Pattern(pipe, state->Received + (uint32_t)index))
+			{
+				state->Errors++;
+			}
+		}
+
+		state->Received += (uint32_t)result;
+	}
+}
+
+/******************************************************************************
+ *  @brief  Run one case frame by frame: host writes, main loop passes with
+ *          host reads, SOF.
+ *
+ *  @param  benchCase - case parameters.
+ *  @param  report - print results, false for a warm-up run.
+ *
+ *  @retval count of errors.
+ *****************************************************************************/
+static uint32_t Bench_RunCase(const Bench_Case_t *benchCase, bool report)
+{
+	USB_VCP_Stats_t stats;
+	uint32_t allocations = HostHal_Allocations;
+	uint32_t errors = 0;
+	uint32_t frames;
+	uint64_t bytes = 0;
+	uint32_t pipe;
+	uint32_t run;
+	bool done = false;
+
+	memset(benchState, 0, sizeof(benchState));
+	memset(&benchRxIsr, 0, sizeof(benchRxIsr));
+	memset(&benchRun, 0, sizeof(benchRun));
+	memset(&benchTxIsr, 0, sizeof(benchTxIsr));
+	memset(&benchSof, 0, sizeof(benchSof));
+	USB_VCP_ResetStats();
+
+	for(frames = 0; (!done) && (frames < BENCH_FRAME_LIMIT); frames++)
+	{
+		uint64_t start;
+
+		for(pipe = 0; pipe < BENCH_MAX_PIPES; pipe++)
+		{
+			if(benchCase->Pipes & (1UL << pipe))
+			{
+				Bench_Write(benchCase, pipe);
+			}
+		}
+
+		for(run = 0; run < BENCH_RUNS_PER_FRAME; run++)
+		{
+			start = HostHal_Cycles();
+			USB_VCP_Run();
+			HostHal_LatencyAdd(&benchRun, start);
+
+			done = true;
+			for(pipe = 0; pipe < BENCH_MAX_PIPES; pipe++)
+			{
+				if(benchCase->Pipes & (1UL << pipe))
+				{
+					if(!Bench_Read(pipe))
+					{
+						printf("FAIL: %s IN endpoint stalled\n", benchPipes[pipe].Name);
+						return 1;
+					}
+
+					if(benchState[pipe].Received < benchCase->Bytes)
+					{
+						done = false;
+					}
+				}
+			}
+		}
+
+		start = HostHal_Cycles();
+		HostUsb_Sof();
+		HostHal_LatencyAdd(&benchSof, start);
+	}
+
+	USB_VCP_GetStats(&stats);
+
+	for(pipe = 0; pipe < BENCH_MAX_PIPES; pipe++)
+	{
+		if(benchCase->Pipes & (1UL << pipe))
+		{
+			if((benchState[pipe].Errors > 0) || (benchState[pipe].Received != benchCase->Bytes))
+			{
+				printf("FAIL: %s echoed %u of %u bytes, %u mismatched\n", benchPipes[pipe].Name,
+					   benchState[pipe].Received, benchCase->Bytes, benchState[pipe].Errors);
+				errors++;
+			}
+			bytes += benchState[pipe].Received;
+		}
+	}
+
+	allocations = HostHal_Allocations - allocations;
+	if(allocations > 0)
+	{
+		printf("FAIL: %u heap calls on the data path\n", allocations);
+		errors++;
+	}
+
+	if(!report)
+	{
+		return errors;
+	}
+
+	printf("%-26s %6.2f MiB %7u frames %8.3f bytes/%s, %u IN transfers of %u bytes avg\n",
+		   benchCase->Name, (double)bytes / (1024.0 * 1024.0), frames,
+		   (double)bytes / (double)(benchRxIsr.Total + benchRun.Total + benchTxIsr.Total + benchSof.Total),
+		   HostHal_CyclesUnit(), stats.TxTransfers,
+		   (stats.TxTransfers > 0) ? (uint32_t)(stats.TxBytes / stats.TxTransfers) : 0U);
+	printf("    %-22s %10s %10s %10s\n", "call site", "calls", "avg", "max");
+	printf("    %-22s %10lu %10.0f %10lu\n", "OUT packet (Rx ISR)", (unsigned long)benchRxIsr.Calls, HostHal_LatencyAverage(&benchRxIsr), (unsigned long)benchRxIsr.Max);
+	printf("    %-22s %10lu %10.0f %10lu\n", "USB_VCP_Run", (unsigned long)benchRun.Calls, HostHal_LatencyAverage(&benchRun), (unsigned long)benchRun.Max);
+	printf("    %-22s %10lu %10.0f %10lu\n", "IN complete (Tx ISR)", (unsigned long)benchTxIsr.Calls, HostHal_LatencyAverage(&benchTxIsr), (unsigned long)benchTxIsr.Max);
+	printf("    %-22s %10lu %10.0f %10lu\n", "SOF", (unsigned long)benchSof.Calls, HostHal_LatencyAverage(&benchSof), (unsigned long)benchSof.Max);
+
+	return errors;
+}
+
+#if (USBD_VENDOR_ENABLE == 1)
+/******************************************************************************
+ *  @brief  Captured frame number sequence of the vendor case. Data bytes
+ *          past Dlc are set too, the record must carry them as 0.
+ *
+ *  @param  sequence - frame number.
+ *  @param  frame - frame filled.
+ *
+ *  @retval None.
+ *****************************************************************************/
+static void Bench_VendorFrame(uint32_t sequence, CanFrame_t *frame)
+{
+	uint32_t index;
+
+	frame->Timestamp = 0x100000000ULL + ((uint64_t)sequence * 61U);
+	frame->Flags = (sequence & 1U) ? CAN_FRAME_FLAG_EXT : 0U;
+	frame->Id = sequence & ((sequence & 1U) ? 0x1FFFFFFFUL : 0x7FFUL);
+	frame->Dlc = (uint8_t)(sequence % (CAN_FRAME_MAX_DATA + 1));
+	frame->Bus = (uint8_t)((sequence >> 1) & 1U);
+	for(index = 0; index < CAN_FRAME_MAX_DATA; index++)
+	{
+		frame->Data[index] = (uint8_t)(sequence + index);
+	}
+}
+
+/******************************************************************************
+ *  @brief  Check one record of the vendor stream against its frame.
+ *
+ *  @param  sequence - frame number.
+ *  @param  record - received record.
+ *
+ *  @retval true if the record matches.
+ *****************************************************************************/
+static bool Bench_VendorCheck(uint32_t sequence, const uint8_t *record)
+{
+	CanFrame_t frame;
+	uint64_t timestamp = 0;
+	uint32_t id = 0;
+	uint32_t index;
+
+	Bench_VendorFrame(sequence, &frame);
+
+	for(index = 0; index < 8; index++)
+	{
+		timestamp |= (uint64_t)record[index] << (8 * index);
+	}
+	for(index = 0; index < 4; index++)
+	{
+		id |= (uint32_t)record[8 + index] << (8 * index);
+	}
+
+	if((timestamp != frame.Timestamp) || (id != frame.Id) || (record[12] != frame.Flags) ||
+	   (record[13] != frame.Dlc) || (record[14] != frame.Bus) || (record[15] != 0))
+	{
+		return false;
+	}
+
+	for(index = 0; index < CAN_FRAME_MAX_DATA; index++)
+	{
+		if(record[16 + index] != ((index < frame.Dlc) ? frame.Data[index] : 0U))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/******************************************************************************
+ *  @brief  Stream frames through the vendor channel: main loop produces
+ *          records, host reads and decodes them and writes data the channel
+ *          must discard.
+ *
+ *  @param  report - print results, false for a warm-up run.
+ *
+ *  @retval count of errors.
+ *****************************************************************************/
+static uint32_t Bench_Vendor(bool report)
+{
+	static const uint8_t junk[64] = { 0 };
+	uint8_t record[USB_VCP_VENDOR_RECORD_SIZE];
+	uint32_t recordLength = 0;
+	uint32_t allocations = HostHal_Allocations;
+	uint32_t produced = 0;
+	uint32_t decoded = 0;
+	uint32_t mismatched = 0;
+	uint32_t nakedOut = 0;
+	uint32_t errors = 0;
+	uint64_t bytes = 0;
+	uint32_t frames;
+	uint32_t run;
+
+	memset(&benchRxIsr, 0, sizeof(benchRxIsr));
+	memset(&benchRun, 0, sizeof(benchRun));
+	memset(&benchTxIsr, 0, sizeof(benchTxIsr));
+
+	for(frames = 0; (decoded < BENCH_VENDOR_FRAMES) && (frames < BENCH_FRAME_LIMIT); frames++)
+	{
+		uint32_t count;
+
+		if(HostUsb_Out(VENDOR_EP_DATA_OUT, junk, sizeof(junk)) < 0)
+		{
+			nakedOut++;
+		}
+
+		for(count = 0; (count < BENCH_VENDOR_FRAMES_PER_MS) && (produced < BENCH_VENDOR_FRAMES); count++)
+		{
+			CanFrame_t frame;
+			uint64_t start;
+			bool sent;
+
+			Bench_VendorFrame(produced, &frame);
+			start = HostHal_Cycles();
+			sent = USB_VCP_VendorSendFrame(&frame);
+			HostHal_LatencyAdd(&benchRxIsr, start);
+			if(!sent)
+			{
+				break;
+			}
+			produced++;
+		}
+
+		for(run = 0; run < BENCH_RUNS_PER_FRAME; run++)
+		{
+			uint64_t start = HostHal_Cycles();
+			int32_t result;
+
+			USB_VCP_Run();
+			HostHal_LatencyAdd(&benchRun, start);
+
+			for(;;)
+			{
+				int32_t index;
+
+				start = HostHal_Cycles();
+				result = HostUsb_In(VENDOR_EP_DATA_IN, benchRx, sizeof(benchRx));
+				if(result < 0)
+				{
+					break;
+				}
+				HostHal_LatencyAdd(&benchTxIsr, start);
+
+				bytes += (uint32_t)result;
+				for(index = 0; index < result; index++)
+				{
+					record[recordLength++] = benchRx[index];
+					if(recordLength == sizeof(record))
+					{
+						if(!Bench_VendorCheck(decoded, record))
+						{
+							mismatched++;
+						}
+						decoded++;
+						recordLength = 0;
+					}
+				}
+			}
+
+			if(result == HOST_USB_STALL)
+			{
+				printf("FAIL: vendor IN endpoint stalled\n");
+				return 1;
+			}
+		}
+
+		HostUsb_Sof();
+	}
+
+	if((decoded != BENCH_VENDOR_FRAMES) || (mismatched > 0) || (recordLength != 0))
+	{
+		printf("FAIL: vendor decoded %u of %lu records, %u mismatched\n", decoded, BENCH_VENDOR_FRAMES, mismatched);
+		errors++;
+	}
+
+	if(nakedOut > 0)
+	{
+		printf("FAIL: vendor OUT endpoint NAKed %u writes\n", nakedOut);
+		errors++;
+	}
+
+	allocations = HostHal_Allocations - allocations;
+	if(allocations > 0)
+	{
+		printf("FAIL: %u heap calls on the data path\n", allocations);
+		errors++;
+	}
+
+	if(report)
+	{
+		printf("%-26s %6.2f MiB %7u frames %8.3f bytes/%s, %lu CAN frames/s\n",
+			   "vendor frame stream", (double)bytes / (1024.0 * 1024.0), frames,
+			   (double)bytes / (double)(benchRxIsr.Total + benchRun.Total + benchTxIsr.Total), HostHal_CyclesUnit(),
+			   (unsigned long)((uint64_t)decoded * 1000U / frames));
+		printf("    %-22s %10s %10s %10s\n", "call site", "calls", "avg", "max");
+		printf("    %-22s %10lu %10.0f %10lu\n", "USB_VCP_VendorSendFrame", (unsigned long)benchRxIsr.Calls, HostHal_LatencyAverage(&benchRxIsr), (unsigned long)benchRxIsr.Max);
+		printf("    %-22s %10lu %10.0f %10lu\n", "USB_VCP_Run", (unsigned long)benchRun.Calls, HostHal_LatencyAverage(&benchRun), (unsigned long)benchRun.Max);
+		printf("    %-22s %10lu %10.0f %10lu\n", "IN complete (Tx ISR)", (unsigned long)benchTxIsr.Calls, HostHal_LatencyAverage(&benchTxIsr), (unsigned long)benchTxIsr.Max);
+	}
+
+	return errors;
+}
+#endif
+
+/*-- Exported functions -----------------------------------------------------*/
+int main(void)
+{
+	//115200 8N1
+	static const uint8_t lineCoding[7] = { 0x00, 0xC2, 0x01, 0x00, 0x00, 0x00, 0x08 };
+	uint32_t allocations;
+	uint32_t errors = 0;
+	uint32_t index;
+
+	MX_USB_DEVICE_Init();
+	USB_VCP_Init();
+
+	//Main loop starts before the host configures the device: no class data
+	//yet, no channel may report its IN endpoint idle
+	USB_VCP_Run();
+	if(CDC_CheckTransmitAvailable(CDC_ITF_NUMBER_1)
+#if (USBD_VENDOR_ENABLE == 1)
+	   || VENDOR_CheckTransmitAvailable(VENDOR_ITF_NUMBER)
+#endif
+	   )
+	{
+		printf("FAIL: IN endpoint available before configuration\n");
+		return 1;
+	}
+
+	HostUsb_Connect();
+
+	if((!CDC_CheckTransmitAvailable(CDC_ITF_NUMBER_1)) || (CDC_CheckTransmitAvailable(0)))
+	{
+		printf("FAIL: IN endpoint state of configured device\n");
+		return 1;
+	}
+
+	//Terminal opens CDC ports: line coding, then DTR
+	for(index = 0; index < BENCH_MAX_PIPES; index++)
+	{
+		uint16_t cmdInterface = benchPipes[index].CmdInterface;
+
+		if((HostUsb_ControlWrite(HOST_USB_REQ_CLASS_ITF_OUT, CDC_SET_LINE_CODING, 0U, cmdInterface, lineCoding, sizeof(lineCoding)) != (int32_t)sizeof(lineCoding)) ||
+		   (HostUsb_ControlWrite(HOST_USB_REQ_CLASS_ITF_OUT, CDC_SET_CONTROL_LINE_STATE, CDC_CONTROL_LINE_DTR, cmdInterface, NULL, 0U) != 0))
+		{
+			printf("FAIL: %s port open\n", benchPipes[index].Name);
+			return 1;
+		}
+	}
+
+	allocations = HostHal_Allocations;
+
+	printf("VCP channels through USB device stack, host CPU, unit: %s\n", HostHal_CyclesUnit());
+
+	for(index = 0; index < sizeof(benchCases) / sizeof(benchCases[0]); index++)
+	{
+		//First run warms up caches and page mappings
+		errors += Bench_RunCase(&benchCases[index], false);
+		errors += Bench_RunCase(&benchCases[index], true);
+	}
+
+#if (USBD_VENDOR_ENABLE == 1)
+	errors += Bench_Vendor(false);
+	errors += Bench_Vendor(true);
+#endif
+
+	printf("heap calls: %u on init, 0 allowed on data path\n", allocations);
+
+	return (errors > 0) ? 1 : 0;
+}
+/*-- EOF --------------------------------------------------------------------*/
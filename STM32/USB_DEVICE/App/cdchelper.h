@@ -111,7 +111,7 @@ struct cdc_interface
         COMMAND_EP,                                      /* bEndpointAddress */ \
         0x03,                                            /* bmAttributes: Interrupt */ \
         USB_UINT16(CDC_CMD_PACKET_SIZE),                 /* wMaxPacketSize: */ \
-        0x10,                                            /* bInterval: */  \
+        CDC_HS_BINTERVAL,                                /* bInterval: */  \
       }, \
  \
       { \
@@ -217,7 +217,7 @@ struct cdc_interface
         COMMAND_EP,                                      /* bEndpointAddress */ \
         0x03,                                            /* bmAttributes: Interrupt */ \
         USB_UINT16(CDC_CMD_PACKET_SIZE),                 /* wMaxPacketSize: */ \
-        0x10,                                            /* bInterval: */  \
+        CDC_FS_BINTERVAL,                                /* bInterval: */  \
       }, \
  \
       { \
@@ -324,7 +324,7 @@ struct cdc_interface
         COMMAND_EP,                                      /* bEndpointAddress */ \
         0x03,                                            /* bmAttributes: Interrupt */ \
         USB_UINT16(CDC_CMD_PACKET_SIZE),                 /* wMaxPacketSize: */ \
-        0x10,                                            /* bInterval: */  \
+        CDC_FS_BINTERVAL,                                /* bInterval: */  \
       }, \
  \
       { \
@@ -346,8 +346,7 @@ struct cdc_interface
         USB_DESC_TYPE_ENDPOINT,                          /* bDescriptorType: Endpoint */ \
         DATAOUT_EP,                                      /* bEndpointAddress */ \
         0x02,                                            /* bmAttributes: Bulk */ \
-        0x40,                                            /* wMaxPacketSize: */ \
-		0x00, \
+        USB_UINT16(USB_FS_MAX_PACKET_SIZE),              /* wMaxPacketSize: */ \
         0x00,                                            /* bInterval: ignore for Bulk transfer */ \
       }, \
  \
@@ -357,8 +356,7 @@ struct cdc_interface
         USB_DESC_TYPE_ENDPOINT,                          /* bDescriptorType: Endpoint */ \
         DATAIN_EP,                                       /* bEndpointAddress */ \
         0x02,                                            /* bmAttributes: Bulk */ \
-        0x40,                                            /* wMaxPacketSize: */ \
-		0x00, \
+        USB_UINT16(USB_FS_MAX_PACKET_SIZE),              /* wMaxPacketSize: */ \
         0x00                                             /* bInterval: ignore for Bulk transfer */ \
       } \
     },
@@ -86,7 +86,7 @@ void MX_USB_DEVICE_Init(void)
   {
     Error_Handler();
   }
-  if (USBD_RegisterClass(pUsbDevice, &USBD_Composite) != USBD_OK)
+  if (USBD_Composite_Register(pUsbDevice) != USBD_OK)
   {
     Error_Handler();
   }
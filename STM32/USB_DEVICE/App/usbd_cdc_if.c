@@ -24,6 +24,7 @@
 #include "usbd_conf.h"
 #include "usbd_vcp.h"
 /* USER CODE BEGIN INCLUDE */
+#include <string.h>
 
 /* USER CODE END INCLUDE */
 
@@ -64,6 +65,12 @@
   */
 
 /* USER CODE BEGIN PRIVATE_DEFINES */
+/* OTG DMA transfers whole words from/to word aligned addresses */
+#define CDC_IS_DMA_ALIGNED(pointer)   ((((uint32_t)(pointer)) & 3U) == 0U)
+
+#if ((APP_RX_DATA_SIZE % 4U) != 0U) || ((APP_TX_BOUNCE_SIZE % 4U) != 0U)
+#error "APP_RX_DATA_SIZE and APP_TX_BOUNCE_SIZE must be multiples of 4"
+#endif
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -90,32 +97,17 @@
 
 /* Create buffer for reception and transmission           */
 /* It's up to user to redefine and/or remove those define */
-/** Received data over USB are stored in this buffer      */
-#if (NUM_OF_CDC_UARTS > 0)
-uint8_t UsbCdcRxBuffer_1[APP_RX_DATA_1_SIZE];
-#endif
-#if (NUM_OF_CDC_UARTS > 1)
-uint8_t UsbCdcRxBuffer_2[APP_RX_DATA_2_SIZE];
-#endif
-#if (NUM_OF_CDC_UARTS > 2)
-uint8_t UsbCdcRxBuffer_3[APP_RX_DATA_3_SIZE];
-#endif
-#if (NUM_OF_CDC_UARTS > 3)
-uint8_t UsbCdcRxBuffer_4[APP_RX_DATA_4_SIZE];
-#endif
+/** Received data over USB are stored in this buffer, two packets per channel:
+    next packet is received to one half while the other one is processed.
+    Data to send are transmitted straight from usbd_vcp Tx round buffers. */
+__ALIGN_BEGIN uint8_t UsbCdcRxBuffer[NUM_OF_CDC_UARTS][2][APP_RX_DATA_SIZE] __ALIGN_END;
 
-/** Data to send over USB CDC are stored in this buffer   */
-#if (NUM_OF_CDC_UARTS > 0)
-uint8_t UsbCdcTxBuffer_1[APP_TX_DATA_1_SIZE];
-#endif
-#if (NUM_OF_CDC_UARTS > 1)
-uint8_t UsbCdcTxBuffer_2[APP_TX_DATA_2_SIZE];
-#endif
-#if (NUM_OF_CDC_UARTS > 2)
-uint8_t UsbCdcTxBuffer_3[APP_TX_DATA_3_SIZE];
-#endif
-#if (NUM_OF_CDC_UARTS > 3)
-uint8_t UsbCdcTxBuffer_4[APP_TX_DATA_4_SIZE];
+/** Half of UsbCdcRxBuffer the OUT endpoint is armed on */
+static uint8_t UsbCdcRxActive[NUM_OF_CDC_UARTS];
+
+#if (USBD_DMA_ENABLE == 1)
+/** Aligned copy of transmit data which DMA can not read in place */
+__ALIGN_BEGIN static uint8_t UsbCdcTxBounce[NUM_OF_CDC_UARTS][APP_TX_BOUNCE_SIZE] __ALIGN_END;
 #endif
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
@@ -160,6 +152,7 @@ static int8_t CDC_DeInit(void);
 static int8_t CDC_Control(uint8_t cmd, uint8_t* pbuf, uint16_t length, uint8_t interfaceNumber);
 static int8_t CDC_Receive(uint8_t* pbuf, uint32_t *Len, uint8_t interfaceNumber);
 static int8_t CDC_TransmitCplt(uint8_t *pbuf, uint32_t *Len, uint8_t interfaceNumber);
+static int8_t CDC_SOF(void);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -175,7 +168,8 @@ USBD_CDC_ItfTypeDef USBD_Interface_fops =
   CDC_DeInit,
   CDC_Control,
   CDC_Receive,
-  CDC_TransmitCplt
+  CDC_TransmitCplt,
+  CDC_SOF
 };
 
 /* Private functions ---------------------------------------------------------*/
@@ -187,34 +181,19 @@ USBD_CDC_ItfTypeDef USBD_Interface_fops =
 static int8_t CDC_Init(void)
 {
   /* USER CODE BEGIN 8 */
+  uint8_t index;
+
+  USB_VCP_InitCallback();
+
   /* Set Application Buffers */
-  USBD_CDC_SetTxBuffer(pUsbDevice, CDC_ITF_NUMBER_1, UsbCdcTxBuffer_1, 0);
-  USBD_CDC_SetRxBuffer(pUsbDevice, CDC_ITF_NUMBER_1, UsbCdcRxBuffer_1);
-  
-#if (NUM_OF_CDC_UARTS > 0)
-  USBD_CDC_SetTxBuffer(pUsbDevice, CDC_ITF_NUMBER_1, UsbCdcTxBuffer_1, 0);
-  USBD_CDC_SetRxBuffer(pUsbDevice, CDC_ITF_NUMBER_1, UsbCdcRxBuffer_1);
-  USBD_CDC_ReceivePacket(pUsbDevice, CDC_ITF_NUMBER_1);
-#endif
-	
-#if (NUM_OF_CDC_UARTS > 1)
-  USBD_CDC_SetTxBuffer(pUsbDevice, CDC_ITF_NUMBER_2, UsbCdcTxBuffer_2, 0);
-  USBD_CDC_SetRxBuffer(pUsbDevice, CDC_ITF_NUMBER_2, UsbCdcRxBuffer_2);
-  USBD_CDC_ReceivePacket(pUsbDevice, CDC_ITF_NUMBER_2);
-#endif
-	
-#if (NUM_OF_CDC_UARTS > 2)
-  USBD_CDC_SetTxBuffer(pUsbDevice, CDC_ITF_NUMBER_3, UsbCdcTxBuffer_3, 0);
-  USBD_CDC_SetRxBuffer(pUsbDevice, CDC_ITF_NUMBER_3, UsbCdcRxBuffer_3);
-  USBD_CDC_ReceivePacket(pUsbDevice, CDC_ITF_NUMBER_3);
-#endif
-	
-#if (NUM_OF_CDC_UARTS > 3)
-  USBD_CDC_SetTxBuffer(pUsbDevice, CDC_ITF_NUMBER_4, UsbCdcTxBuffer_4, 0);
-  USBD_CDC_SetRxBuffer(pUsbDevice, CDC_ITF_NUMBER_4, UsbCdcRxBuffer_4);
-  USBD_CDC_ReceivePacket(pUsbDevice, CDC_ITF_NUMBER_4);
-#endif
-  
+  for (index = 0; index < NUM_OF_CDC_UARTS; index++)
+  {
+    USBD_CDC_SetTxBuffer(pUsbDevice, CDC_ITF_NUMBER_1 + index, NULL, 0);
+    UsbCdcRxActive[index] = 0;
+    USBD_CDC_SetRxBuffer(pUsbDevice, CDC_ITF_NUMBER_1 + index, UsbCdcRxBuffer[index][0]);
+    USBD_CDC_ReceivePacket(pUsbDevice, CDC_ITF_NUMBER_1 + index);
+  }
+
   return (USBD_OK);
   /* USER CODE END 8 */
 }
@@ -241,66 +220,8 @@ static int8_t CDC_DeInit(void)
 static int8_t CDC_Control(uint8_t cmd, uint8_t* pbuf, uint16_t length, uint8_t interfaceNumber)
 {
   /* USER CODE BEGIN 10 */
-  switch(cmd)
-  {
-  case CDC_SEND_ENCAPSULATED_COMMAND:
-
-    break;
-
-  case CDC_GET_ENCAPSULATED_RESPONSE:
-
-    break;
-
-  case CDC_SET_COMM_FEATURE:
-
-    break;
-
-  case CDC_GET_COMM_FEATURE:
-
-    break;
-
-  case CDC_CLEAR_COMM_FEATURE:
-
-    break;
-
-  /*******************************************************************************/
-  /* Line Coding Structure                                                       */
-  /*-----------------------------------------------------------------------------*/
-  /* Offset | Field       | Size | Value  | Description                          */
-  /* 0      | dwDTERate   |   4  | Number |Data terminal rate, in bits per second*/
-  /* 4      | bCharFormat |   1  | Number | Stop bits                            */
-  /*                                        0 - 1 Stop bit                       */
-  /*                                        1 - 1.5 Stop bits                    */
-  /*                                        2 - 2 Stop bits                      */
-  /* 5      | bParityType |  1   | Number | Parity                               */
-  /*                                        0 - None                             */
-  /*                                        1 - Odd                              */
-  /*                                        2 - Even                             */
-  /*                                        3 - Mark                             */
-  /*                                        4 - Space                            */
-  /* 6      | bDataBits  |   1   | Number Data bits (5, 6, 7, 8 or 16).          */
-  /*******************************************************************************/
-  case CDC_SET_LINE_CODING:
-
-    break;
-
-  case CDC_GET_LINE_CODING:
-
-    break;
-
-  case CDC_SET_CONTROL_LINE_STATE:
-
-    break;
-
-  case CDC_SEND_BREAK:
-
-    break;
-
-  default:
-    break;
-  }
-
-  return (USBD_OK);
+  //Line coding and control line state are kept per channel by VCP engine
+  return USB_VCP_ConfigCallback(cmd, pbuf, length, interfaceNumber);
   /* USER CODE END 10 */
 }
 
@@ -322,72 +243,53 @@ static int8_t CDC_Control(uint8_t cmd, uint8_t* pbuf, uint16_t length, uint8_t i
 static int8_t CDC_Receive(uint8_t* Buf, uint32_t *Len, uint8_t interfaceNumber)
 {
   /* USER CODE BEGIN 11 */
-  uint8_t result = 1;
-  
-  switch (interfaceNumber)
-	{
-#if (NUM_OF_CDC_UARTS > 0)
-		case CDC_ITF_NUMBER_1:
-		{
-			USB_VCP_DataReceivedCallback(UsbCdcRxBuffer_1, *Len, CDC_ITF_NUMBER_1);
-			
-			USBD_CDC_SetRxBuffer(pUsbDevice, CDC_ITF_NUMBER_1, UsbCdcRxBuffer_1);
-			USBD_CDC_ReceivePacket(pUsbDevice, CDC_ITF_NUMBER_1);
-		}
-		break;
-#endif
-		
-#if (NUM_OF_CDC_UARTS > 1)
-		case CDC_ITF_NUMBER_2:
-		{
-			USB_VCP_DataReceivedCallback(UsbCdcRxBuffer_2, *Len, CDC_ITF_NUMBER_2);
-			
-			USBD_CDC_SetRxBuffer(pUsbDevice, CDC_ITF_NUMBER_2, UsbCdcRxBuffer_2);
-			USBD_CDC_ReceivePacket(pUsbDevice, CDC_ITF_NUMBER_2);
-		}
-		break;
-#endif
+  uint8_t index = interfaceNumber - CDC_ITF_NUMBER_1;
+  uint8_t *packet;
 
-#if (NUM_OF_CDC_UARTS > 2)
-		case CDC_ITF_NUMBER_3:
-		{
-			USB_VCP_DataReceivedCallback(UsbCdcRxBuffer_3, *Len, CDC_ITF_NUMBER_3);
-			
-			USBD_CDC_SetRxBuffer(pUsbDevice, CDC_ITF_NUMBER_3, UsbCdcRxBuffer_3);
-			USBD_CDC_ReceivePacket(pUsbDevice, CDC_ITF_NUMBER_3);
-		}
-		break;
-#endif
+  if (index >= NUM_OF_CDC_UARTS)
+  {
+    return (USBD_FAIL);
+  }
+
+  packet = UsbCdcRxBuffer[index][UsbCdcRxActive[index]];
 
-#if (NUM_OF_CDC_UARTS > 3)
-		case CDC_ITF_NUMBER_4:
-		{
-			USB_VCP_DataReceivedCallback(UsbCdcRxBuffer_4, *Len, CDC_ITF_NUMBER_4);
-			
-			USBD_CDC_SetRxBuffer(pUsbDevice, CDC_ITF_NUMBER_4, UsbCdcRxBuffer_4);
-			USBD_CDC_ReceivePacket(pUsbDevice, CDC_ITF_NUMBER_4);
-		}
-		break;
+#if (USBD_DMA_ENABLE == 1)
+  if ((!CDC_IS_DMA_ALIGNED(packet)) || (Buf != packet))
+  {
+    return (USBD_FAIL);
+  }
 #endif
-		
-		default:
-		{
-			result = 0;
-		}
-		break;
-	}
-	
-	if(result)
-	{
-		return (USBD_OK);
-	}
-	else
-	{
-		return (USBD_FAIL);
-	}
+
+  /* Arm the other half before processing this one, so the host is ACKed
+     during the copy. Endpoint stays NAKed until VCP has room for the next packet */
+  if (USB_VCP_ReceiveCredit(interfaceNumber, *Len))
+  {
+    UsbCdcRxActive[index] ^= 1U;
+    CDC_ReceiveResume(interfaceNumber);
+  }
+
+  USB_VCP_DataReceivedCallback(packet, *Len, interfaceNumber);
+
+  return (USBD_OK);
   /* USER CODE END 11 */
 }
 
+/**
+  * @brief  Arm OUT endpoint for the next packet
+  * @param  interfaceNumber: CDC interface number
+  * @retval None
+  */
+void CDC_ReceiveResume(uint8_t interfaceNumber)
+{
+  uint8_t index = interfaceNumber - CDC_ITF_NUMBER_1;
+
+  if (index < NUM_OF_CDC_UARTS)
+  {
+    USBD_CDC_SetRxBuffer(pUsbDevice, interfaceNumber, UsbCdcRxBuffer[index][UsbCdcRxActive[index]]);
+    USBD_CDC_ReceivePacket(pUsbDevice, interfaceNumber);
+  }
+}
+
 bool CDC_CheckTransmitAvailable(uint8_t interfaceNumber)
 {
   if(USBD_CDC_CheckSendingAvailable(pUsbDevice, interfaceNumber) == USBD_OK)
@@ -412,6 +314,28 @@ uint8_t CDC_Transmit(uint8_t* Buf, uint16_t Len, uint8_t interfaceNumber)
   /* USER CODE BEGIN 12 */
   if(USBD_CDC_CheckSendingAvailable(pUsbDevice, interfaceNumber) == USBD_OK)
   {
+#if (USBD_DMA_ENABLE == 1)
+    /* DMA can not read from unaligned address: send an aligned copy, cut so
+       that the rest of data starts aligned. TransmitCplt reports sent length */
+    if (!CDC_IS_DMA_ALIGNED(Buf))
+    {
+      uint8_t index = interfaceNumber - CDC_ITF_NUMBER_1;
+
+      if (index >= NUM_OF_CDC_UARTS)
+      {
+        return (USBD_FAIL);
+      }
+
+      if (Len > APP_TX_BOUNCE_SIZE)
+      {
+        Len = APP_TX_BOUNCE_SIZE - (((uint32_t)Buf + APP_TX_BOUNCE_SIZE) & 3U);
+      }
+
+      memcpy(UsbCdcTxBounce[index], Buf, Len);
+      Buf = UsbCdcTxBounce[index];
+    }
+#endif
+
     USBD_CDC_SetTxBuffer(pUsbDevice, interfaceNumber, Buf, Len);
     result = USBD_CDC_TransmitPacket(pUsbDevice, interfaceNumber);
   }
@@ -419,6 +343,17 @@ uint8_t CDC_Transmit(uint8_t* Buf, uint16_t Len, uint8_t interfaceNumber)
   return result;
 }
 
+/**
+  * @brief  Notify the host of line state and events over the command endpoint
+  * @param  SerialState: CDC_SERIAL_STATE_xxx bitmap
+  * @param  interfaceNumber: CDC interface number
+  * @retval USBD_OK, USBD_BUSY while previous notification is not sent or USBD_FAIL
+  */
+uint8_t CDC_SendSerialState(uint16_t SerialState, uint8_t interfaceNumber)
+{
+  return USBD_CDC_SendSerialState(pUsbDevice, interfaceNumber, SerialState);
+}
+
 /**
   * @brief  CDC_TransmitCplt_HS
   *         Data transmited callback
@@ -435,13 +370,25 @@ static int8_t CDC_TransmitCplt(uint8_t *Buf, uint32_t *Len, uint8_t interfaceNum
 {
   uint8_t result = USBD_OK;
   /* USER CODE BEGIN 14 */
-  UNUSED(Buf);
-  UNUSED(Len);
-  UNUSED(interfaceNumber);
+  USB_VCP_TransmitCompleteCallback(Buf, *Len, interfaceNumber);
   /* USER CODE END 14 */
   return result;
 }
 
+/**
+  * @brief  CDC_SOF
+  *         Start of frame callback, used for timed flush of transmit data
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_SOF(void)
+{
+  uint8_t result = USBD_OK;
+  /* USER CODE BEGIN 15 */
+  USB_VCP_SOFCallback();
+  /* USER CODE END 15 */
+  return result;
+}
+
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
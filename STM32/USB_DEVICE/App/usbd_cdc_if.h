@@ -52,18 +52,11 @@
 /* Define size for the receive and transmit buffer over CDC */
 /* It's up to user to redefine and/or remove those define */
 
-//Minimum values warning!
-#define APP_RX_DATA_1_SIZE	CDC_DATA_HS_IN_PACKET_SIZE   //minumum CDC_DATA_HS_IN_PACKET_SIZE
-#define APP_TX_DATA_1_SIZE	CDC_DATA_HS_OUT_PACKET_SIZE  //minimum CDC_DATA_HS_OUT_PACKET_SIZE
+//Minimum value warning! One OUT packet per channel
+#define APP_RX_DATA_SIZE	CDC_DATA_HS_OUT_PACKET_SIZE  //minimum CDC_DATA_HS_OUT_PACKET_SIZE, multiple of 4
 
-#define APP_RX_DATA_2_SIZE	CDC_DATA_HS_IN_PACKET_SIZE
-#define APP_TX_DATA_2_SIZE	CDC_DATA_HS_OUT_PACKET_SIZE
-
-#define APP_RX_DATA_3_SIZE	CDC_DATA_HS_IN_PACKET_SIZE
-#define APP_TX_DATA_3_SIZE	CDC_DATA_HS_OUT_PACKET_SIZE
-
-#define APP_RX_DATA_4_SIZE	CDC_DATA_HS_IN_PACKET_SIZE
-#define APP_TX_DATA_4_SIZE	CDC_DATA_HS_OUT_PACKET_SIZE
+//DMA mode only: copy of unaligned transmit data, per channel
+#define APP_TX_BOUNCE_SIZE	CDC_DATA_HS_IN_PACKET_SIZE
 
 /* USER CODE END EXPORTED_DEFINES */
 
@@ -117,8 +110,10 @@ extern USBD_CDC_ItfTypeDef USBD_Interface_fops;
   * @brief Public functions declaration.
   * @{
   */
+void CDC_ReceiveResume(uint8_t interfaceNumber);
 bool CDC_CheckTransmitAvailable(uint8_t interfaceNumber);
 uint8_t CDC_Transmit(uint8_t* Buf, uint16_t Len, uint8_t interfaceNumber);
+uint8_t CDC_SendSerialState(uint16_t SerialState, uint8_t interfaceNumber);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
 
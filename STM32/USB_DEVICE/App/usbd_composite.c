@@ -22,9 +22,15 @@
     DEALINGS IN THE SOFTWARE.
 */
 
+#include <string.h>
 #include "usbd_composite.h"
 #include "usbd_desc.h"
-#include "usbd_cdc.h" /* for USBD_CfgHSDesc and USBD_CfgFSDesc */
+#include "usbd_cdc.h"
+#include "usbd_vendor.h"
+#include "usbd_gsusb.h"
+#include "usbhelper.h"
+#include "cdchelper.h"
+#include "vendorhelper.h"
 
 /* USB handle declared in main.c */
 extern USBD_HandleTypeDef USBD_Device;
@@ -74,9 +80,249 @@ one of ST Micro's legacy code's single class drivers, but then invokes all compo
 
 static struct composite_list_struct composite_list[] =
 {
-  { &USBD_CDC }, /* in this particular code, there is only CDC */
+#if (USBD_GSUSB_ENABLE == 1)
+  { &USBD_GsUsb },
+#endif
+  { &USBD_CDC },
+#if (USBD_VENDOR_ENABLE == 1)
+  { &USBD_Vendor },
+#endif
 };
 
+/*
+The configuration descriptor covers every member class, so it lives here rather than in a class driver.
+Member order must follow interface numbers.
+*/
+
+/* bespoke struct for this device; struct members are added and removed as needed */
+struct configuration_1
+{
+  struct configuration_descriptor config;
+#if (USBD_GSUSB_ENABLE == 1)
+  struct vendor_interface gsusb;
+#endif
+  struct cdc_interface cdc[NUM_OF_CDC_UARTS];
+#if (USBD_VENDOR_ENABLE == 1)
+  struct vendor_interface vendor;
+#endif
+};
+
+/* configuration descriptor header, same for every speed but the type */
+#define COMPOSITE_CONFIG_HEADER(desc, type)                                     \
+  {                                                                             \
+    /*Configuration Descriptor*/                                                \
+    sizeof(struct configuration_descriptor),         /* bLength */              \
+    (type),                                          /* bDescriptorType */      \
+    USB_UINT16(sizeof(desc)),                        /* wTotalLength */         \
+    USBD_MAX_NUM_INTERFACES,                         /* bNumInterfaces */       \
+    0x01,                                            /* bConfigurationValue */  \
+    0x00,                                            /* iConfiguration */       \
+    0x80,                                            /* bmAttributes */         \
+    50,                                              /* MaxPower */             \
+  }
+
+/* fully initialize the bespoke struct as a const */
+__ALIGN_BEGIN static const struct configuration_1 USBD_Composite_CfgHSDesc __ALIGN_END =
+{
+  COMPOSITE_CONFIG_HEADER(USBD_Composite_CfgHSDesc, USB_DESC_TYPE_CONFIGURATION),
+
+#if (USBD_GSUSB_ENABLE == 1)
+  VENDOR_DESCRIPTOR(GSUSB_ITF, 0xFF, 0xFF, GSUSB_EP_DATA_OUT, GSUSB_EP_DATA_IN, GSUSB_DATA_HS_MAX_PACKET_SIZE),
+#endif
+
+  {
+#if (NUM_OF_CDC_UARTS > 0)
+    /* CDC1 */
+    CDC_HS_DESCRIPTOR(CDC_ITF_CMD_1, CDC_ITF_DATA_1, CDC_EP_CMD_1, CDC_EP_DATA_OUT_1, CDC_EP_DATA_IN_1)
+#endif
+#if (NUM_OF_CDC_UARTS > 1)
+    /* CDC2 */
+    CDC_HS_DESCRIPTOR(CDC_ITF_CMD_2, CDC_ITF_DATA_2, CDC_EP_CMD_2, CDC_EP_DATA_OUT_2, CDC_EP_DATA_IN_2)
+#endif
+#if (NUM_OF_CDC_UARTS > 2)
+    /* CDC3 */
+    CDC_HS_DESCRIPTOR(CDC_ITF_CMD_3, CDC_ITF_DATA_3, CDC_EP_CMD_3, CDC_EP_DATA_OUT_3, CDC_EP_DATA_IN_3)
+#endif
+#if (NUM_OF_CDC_UARTS > 3)
+    /* CDC4 */
+    CDC_HS_DESCRIPTOR(CDC_ITF_CMD_4, CDC_ITF_DATA_4, CDC_EP_CMD_4, CDC_EP_DATA_OUT_4, CDC_EP_DATA_IN_4)
+#endif
+  },
+
+#if (USBD_VENDOR_ENABLE == 1)
+  VENDOR_DESCRIPTOR(VENDOR_ITF, 0x00, 0x00, VENDOR_EP_DATA_OUT, VENDOR_EP_DATA_IN, VENDOR_DATA_HS_MAX_PACKET_SIZE),
+#endif
+};
+
+/* fully initialize the bespoke struct as a const */
+__ALIGN_BEGIN static const struct configuration_1 USBD_Composite_CfgFSDesc __ALIGN_END =
+{
+  COMPOSITE_CONFIG_HEADER(USBD_Composite_CfgFSDesc, USB_DESC_TYPE_CONFIGURATION),
+
+#if (USBD_GSUSB_ENABLE == 1)
+  VENDOR_DESCRIPTOR(GSUSB_ITF, 0xFF, 0xFF, GSUSB_EP_DATA_OUT, GSUSB_EP_DATA_IN, GSUSB_DATA_FS_MAX_PACKET_SIZE),
+#endif
+
+  {
+#if (NUM_OF_CDC_UARTS > 0)
+    /* CDC1 */
+    CDC_FS_DESCRIPTOR(CDC_ITF_CMD_1, CDC_ITF_DATA_1, CDC_EP_CMD_1, CDC_EP_DATA_OUT_1, CDC_EP_DATA_IN_1)
+#endif
+#if (NUM_OF_CDC_UARTS > 1)
+    /* CDC2 */
+    CDC_FS_DESCRIPTOR(CDC_ITF_CMD_2, CDC_ITF_DATA_2, CDC_EP_CMD_2, CDC_EP_DATA_OUT_2, CDC_EP_DATA_IN_2)
+#endif
+#if (NUM_OF_CDC_UARTS > 2)
+    /* CDC3 */
+    CDC_FS_DESCRIPTOR(CDC_ITF_CMD_3, CDC_ITF_DATA_3, CDC_EP_CMD_3, CDC_EP_DATA_OUT_3, CDC_EP_DATA_IN_3)
+#endif
+#if (NUM_OF_CDC_UARTS > 3)
+    /* CDC4 */
+    CDC_FS_DESCRIPTOR(CDC_ITF_CMD_4, CDC_ITF_DATA_4, CDC_EP_CMD_4, CDC_EP_DATA_OUT_4, CDC_EP_DATA_IN_4)
+#endif
+  },
+
+#if (USBD_VENDOR_ENABLE == 1)
+  VENDOR_DESCRIPTOR(VENDOR_ITF, 0x00, 0x00, VENDOR_EP_DATA_OUT, VENDOR_EP_DATA_IN, VENDOR_DATA_FS_MAX_PACKET_SIZE),
+#endif
+};
+
+/* fully initialize the bespoke struct as a const */
+__ALIGN_BEGIN static const struct configuration_1 USBD_Composite_CfgOtherDesc __ALIGN_END =
+{
+  COMPOSITE_CONFIG_HEADER(USBD_Composite_CfgOtherDesc, USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION),
+
+#if (USBD_GSUSB_ENABLE == 1)
+  VENDOR_DESCRIPTOR(GSUSB_ITF, 0xFF, 0xFF, GSUSB_EP_DATA_OUT, GSUSB_EP_DATA_IN, GSUSB_DATA_FS_MAX_PACKET_SIZE),
+#endif
+
+  {
+#if (NUM_OF_CDC_UARTS > 0)
+    /* CDC1 */
+    CDC_OTHER_SPEED_DESCRIPTOR(CDC_ITF_CMD_1, CDC_ITF_DATA_1, CDC_EP_CMD_1, CDC_EP_DATA_OUT_1, CDC_EP_DATA_IN_1)
+#endif
+#if (NUM_OF_CDC_UARTS > 1)
+    /* CDC2 */
+    CDC_OTHER_SPEED_DESCRIPTOR(CDC_ITF_CMD_2, CDC_ITF_DATA_2, CDC_EP_CMD_2, CDC_EP_DATA_OUT_2, CDC_EP_DATA_IN_2)
+#endif
+#if (NUM_OF_CDC_UARTS > 2)
+    /* CDC3 */
+    CDC_OTHER_SPEED_DESCRIPTOR(CDC_ITF_CMD_3, CDC_ITF_DATA_3, CDC_EP_CMD_3, CDC_EP_DATA_OUT_3, CDC_EP_DATA_IN_3)
+#endif
+#if (NUM_OF_CDC_UARTS > 3)
+    /* CDC4 */
+    CDC_OTHER_SPEED_DESCRIPTOR(CDC_ITF_CMD_4, CDC_ITF_DATA_4, CDC_EP_CMD_4, CDC_EP_DATA_OUT_4, CDC_EP_DATA_IN_4)
+#endif
+  },
+
+#if (USBD_VENDOR_ENABLE == 1)
+  VENDOR_DESCRIPTOR(VENDOR_ITF, 0x00, 0x00, VENDOR_EP_DATA_OUT, VENDOR_EP_DATA_IN, VENDOR_DATA_FS_MAX_PACKET_SIZE),
+#endif
+};
+
+#define COMPOSITE_NUM_CLASSES   (sizeof(composite_list) / sizeof(*composite_list))
+#define COMPOSITE_NO_CLASS      0xFFU
+
+/*
+Dispatch tables: interface / endpoint number -> index in composite_list.
+They are built once by USBD_Composite_Register, so every data and class request
+interrupt goes straight to its owner instead of being offered to every class.
+*/
+static uint8_t composite_itf_class[USBD_MAX_NUM_INTERFACES];
+static uint8_t composite_in_ep_class[16];
+static uint8_t composite_out_ep_class[16];
+
+/* classes which handle SOF, so the 1 ms / 125 us interrupt skips the others */
+static USBD_CompClassTypeDef *composite_sof_list[COMPOSITE_NUM_CLASSES];
+static unsigned composite_sof_count;
+
+/* owner of the control transfer in progress, for EP0 data stage callbacks */
+static uint8_t composite_ep0_class = COMPOSITE_NO_CLASS;
+
+/* owner of device vendor requests (MS OS descriptors) */
+static uint8_t composite_vendor_class = COMPOSITE_NO_CLASS;
+
+USBD_StatusTypeDef USBD_Composite_Register(USBD_HandleTypeDef *pdev)
+{
+  unsigned index, item;
+
+  memset(composite_itf_class, COMPOSITE_NO_CLASS, sizeof(composite_itf_class));
+  memset(composite_in_ep_class, COMPOSITE_NO_CLASS, sizeof(composite_in_ep_class));
+  memset(composite_out_ep_class, COMPOSITE_NO_CLASS, sizeof(composite_out_ep_class));
+  composite_sof_count = 0;
+  composite_vendor_class = COMPOSITE_NO_CLASS;
+
+  for (index = 0; index < COMPOSITE_NUM_CLASSES; index++)
+  {
+    USBD_CompClassTypeDef *pnt = composite_list[index].pnt;
+
+    for (item = 0; item < pnt->NumInterfaces; item++)
+    {
+      uint8_t itf = pnt->Interfaces[item];
+
+      /* interface out of range or claimed twice */
+      if ((itf >= USBD_MAX_NUM_INTERFACES) || (composite_itf_class[itf] != COMPOSITE_NO_CLASS))
+        return USBD_FAIL;
+
+      composite_itf_class[itf] = index;
+    }
+
+    for (item = 0; item < pnt->NumEndpoints; item++)
+    {
+      uint8_t ep = pnt->Endpoints[item];
+      uint8_t *map = (ep & 0x80U) ? composite_in_ep_class : composite_out_ep_class;
+
+      /* endpoint claimed twice */
+      if (map[ep & 0x0FU] != COMPOSITE_NO_CLASS)
+        return USBD_FAIL;
+
+      map[ep & 0x0FU] = index;
+    }
+
+    if (pnt->SOF)
+      composite_sof_list[composite_sof_count++] = pnt;
+
+    if (pnt->VendorCode != 0U)
+    {
+      /* only one class may answer device vendor requests */
+      if (composite_vendor_class != COMPOSITE_NO_CLASS)
+        return USBD_FAIL;
+
+      composite_vendor_class = index;
+    }
+  }
+
+  return USBD_RegisterClass(pdev, &USBD_Composite);
+}
+
+/* owner of the request recipient (interface or endpoint), COMPOSITE_NO_CLASS if none */
+static uint8_t USBD_Composite_RequestClass (USBD_SetupReqTypedef *req)
+{
+  uint8_t target = LOBYTE(req->wIndex);
+
+  switch (req->bmRequest & USB_REQ_RECIPIENT_MASK)
+  {
+    case USB_REQ_RECIPIENT_DEVICE:
+      if (((req->bmRequest & USB_REQ_TYPE_MASK) == USB_REQ_TYPE_VENDOR) && (composite_vendor_class != COMPOSITE_NO_CLASS) &&
+          (req->bRequest == composite_list[composite_vendor_class].pnt->VendorCode))
+        return composite_vendor_class;
+      break;
+
+    case USB_REQ_RECIPIENT_INTERFACE:
+      if (target < USBD_MAX_NUM_INTERFACES)
+        return composite_itf_class[target];
+      break;
+
+    case USB_REQ_RECIPIENT_ENDPOINT:
+      return (target & 0x80U) ? composite_in_ep_class[target & 0x0FU] : composite_out_ep_class[target & 0x0FU];
+
+    default:
+      break;
+  }
+
+  return COMPOSITE_NO_CLASS;
+}
+
 static uint8_t USBD_Composite_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 {
   unsigned index;
@@ -105,39 +351,35 @@ static uint8_t USBD_Composite_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 
 static uint8_t USBD_Composite_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
 {
-  unsigned index;
+  uint8_t index = USBD_Composite_RequestClass(req);
 
-  for (index = 0; index < (sizeof(composite_list) / sizeof(*composite_list)); index++)
+  composite_ep0_class = index;
+
+  if ((index == COMPOSITE_NO_CLASS) || (composite_list[index].pnt->Setup == NULL))
   {
-    if (composite_list[index].pnt->Setup)
-      composite_list[index].pnt->Setup(pdev, req);
+    USBD_CtlError(pdev, req);
+    return USBD_FAIL;
   }
 
-  return USBD_OK;
+  return composite_list[index].pnt->Setup(pdev, req);
 }
 
 static uint8_t USBD_Composite_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  unsigned index;
+  uint8_t index = composite_in_ep_class[epnum & 0x0FU];
 
-  for (index = 0; index < (sizeof(composite_list) / sizeof(*composite_list)); index++)
-  {
-    if (composite_list[index].pnt->DataIn)
-      composite_list[index].pnt->DataIn(pdev, epnum);
-  }
+  if ((index != COMPOSITE_NO_CLASS) && (composite_list[index].pnt->DataIn))
+    composite_list[index].pnt->DataIn(pdev, epnum);
 
   return USBD_OK;
 }
 
 static uint8_t USBD_Composite_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
 {      
-  unsigned index;
+  uint8_t index = composite_out_ep_class[epnum & 0x0FU];
 
-  for (index = 0; index < (sizeof(composite_list) / sizeof(*composite_list)); index++)
-  {
-    if (composite_list[index].pnt->DataOut)
-      composite_list[index].pnt->DataOut(pdev, epnum);
-  }
+  if ((index != COMPOSITE_NO_CLASS) && (composite_list[index].pnt->DataOut))
+    composite_list[index].pnt->DataOut(pdev, epnum);
 
   return USBD_OK;
 }
@@ -146,10 +388,9 @@ static uint8_t USBD_Composite_SOF (USBD_HandleTypeDef *pdev)
 {
   unsigned index;
 
-  for (index = 0; index < (sizeof(composite_list) / sizeof(*composite_list)); index++)
+  for (index = 0; index < composite_sof_count; index++)
   {
-    if (composite_list[index].pnt->SOF)
-      composite_list[index].pnt->SOF(pdev);
+    composite_sof_list[index]->SOF(pdev);
   }
 
   return USBD_OK;
@@ -157,43 +398,40 @@ static uint8_t USBD_Composite_SOF (USBD_HandleTypeDef *pdev)
 
 static uint8_t USBD_Composite_EP0_TxSent (USBD_HandleTypeDef *pdev)
 { 
-  unsigned index;
+  uint8_t index = composite_ep0_class;
 
-  for (index = 0; index < (sizeof(composite_list) / sizeof(*composite_list)); index++)
-  {
-    if (composite_list[index].pnt->EP0_TxSent)
-      composite_list[index].pnt->EP0_TxSent(pdev);
-  }
+  if ((index != COMPOSITE_NO_CLASS) && (composite_list[index].pnt->EP0_TxSent))
+    composite_list[index].pnt->EP0_TxSent(pdev);
 
   return USBD_OK;
 }
 
 static uint8_t USBD_Composite_EP0_RxReady (USBD_HandleTypeDef *pdev)
 { 
-  unsigned index;
+  uint8_t index = composite_ep0_class;
 
-  for (index = 0; index < (sizeof(composite_list) / sizeof(*composite_list)); index++)
-  {
-    if (composite_list[index].pnt->EP0_RxReady)
-      composite_list[index].pnt->EP0_RxReady(pdev);
-  }
+  if ((index != COMPOSITE_NO_CLASS) && (composite_list[index].pnt->EP0_RxReady))
+    composite_list[index].pnt->EP0_RxReady(pdev);
 
   return USBD_OK;
 }
 
 static uint8_t *USBD_Composite_GetHSCfgDesc (uint16_t *length)
 {
-  return USBD_CDC_GetHSCfgDesc(length);
+  *length = sizeof(USBD_Composite_CfgHSDesc);
+  return (uint8_t *)&USBD_Composite_CfgHSDesc;
 }
 
 static uint8_t *USBD_Composite_GetFSCfgDesc (uint16_t *length)
 {
-  return USBD_CDC_GetFSCfgDesc(length);
+  *length = sizeof(USBD_Composite_CfgFSDesc);
+  return (uint8_t *)&USBD_Composite_CfgFSDesc;
 }
 
 static uint8_t *USBD_Composite_GetOtherSpeedCfgDesc (uint16_t *length)
 {
-  return USBD_CDC_GetOtherSpeedCfgDesc(length);
+  *length = sizeof(USBD_Composite_CfgOtherDesc);
+  return (uint8_t *)&USBD_Composite_CfgOtherDesc;
 }
 
 /*
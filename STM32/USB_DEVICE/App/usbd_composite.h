@@ -16,11 +16,21 @@ typedef struct
   uint8_t  (*DataIn)           (struct _USBD_HandleTypeDef *pdev , uint8_t epnum);   
   uint8_t  (*DataOut)          (struct _USBD_HandleTypeDef *pdev , uint8_t epnum); 
   uint8_t  (*SOF)              (struct _USBD_HandleTypeDef *pdev);
+  /* Interfaces and endpoint addresses owned by the class, used to build dispatch tables */
+  const uint8_t *Interfaces;
+  uint8_t  NumInterfaces;
+  const uint8_t *Endpoints;
+  uint8_t  NumEndpoints;
+  /* bRequest of device vendor requests handled by the class, 0 - none */
+  uint8_t  VendorCode;
 } USBD_CompClassTypeDef;
 
 /* array of callback functions invoked by USBD_RegisterClass() in main.c */
 extern USBD_ClassTypeDef USBD_Composite;
 
+/* build dispatch tables and register USBD_Composite with the core */
+USBD_StatusTypeDef USBD_Composite_Register(USBD_HandleTypeDef *pdev);
+
 //void USBD_Composite_PMAConfig(PCD_HandleTypeDef *hpcd, uint32_t *pma_address);
 
 #endif  // __USB_CDC_H_
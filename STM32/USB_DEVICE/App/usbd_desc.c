@@ -27,6 +27,8 @@
 #include "usbhelper.h"
 
 /* USER CODE BEGIN INCLUDE */
+#include "usbd_vendor.h"
+#include "usbd_gsusb.h"
 
 /* USER CODE END INCLUDE */
 
@@ -65,8 +67,14 @@
   * @{
   */
 
+#if (USBD_GSUSB_ENABLE == 1)
+/* Linux gs_usb binds by VID/PID */
+#define USBD_VID                           GSUSB_VID
+#define USBD_PID                           GSUSB_PID
+#else
 #define USBD_VID                           1172
 #define USBD_PID                           4097
+#endif
 
 //#define USBD_VID                           1155
 //#define USBD_PID                           22336
@@ -77,7 +85,11 @@
 #define USBD_CONFIGURATION_STRING          "CDC Config"
 #define USBD_INTERFACE_STRING              "CDC Interface"
 
+#if (USBD_CLASS_BOS_ENABLED == 1)
+#define USB_SIZ_BOS_DESC                   (5 + 28)
+#else
 #define USB_SIZ_BOS_DESC                   0x0C
+#endif
 
 /* USER CODE BEGIN PRIVATE_DEFINES */
 #define USBD_PRODUCT_STRING_IF1           "CanSniffer Interface 1"
@@ -132,9 +144,9 @@ uint8_t * USBD_Dev_SerialStrDescriptor(USBD_SpeedTypeDef speed, uint16_t *length
 uint8_t * USBD_Dev_ConfigStrDescriptor(USBD_SpeedTypeDef speed, uint16_t *length);
 uint8_t * USBD_Dev_InterfaceStrDescriptor(USBD_SpeedTypeDef speed, uint16_t *length);
 
-#if (USBD_LPM_ENABLED == 1)
-uint8_t * USBD_HS_USR_BOSDescriptor(USBD_SpeedTypeDef speed, uint16_t *length);
-#endif /* (USBD_LPM_ENABLED == 1) */
+#if ((USBD_LPM_ENABLED == 1) || (USBD_CLASS_BOS_ENABLED == 1))
+uint8_t * USBD_Dev_USR_BOSDescriptor(USBD_SpeedTypeDef speed, uint16_t *length);
+#endif /* ((USBD_LPM_ENABLED == 1) || (USBD_CLASS_BOS_ENABLED == 1)) */
 
 /**
   * @}
@@ -154,9 +166,9 @@ USBD_DescriptorsTypeDef Dev_Desc =
 , USBD_Dev_SerialStrDescriptor
 , USBD_Dev_ConfigStrDescriptor
 , USBD_Dev_InterfaceStrDescriptor
-#if (USBD_LPM_ENABLED == 1)
-, USBD_HS_USR_BOSDescriptor
-#endif /* (USBD_LPM_ENABLED == 1) */
+#if ((USBD_LPM_ENABLED == 1) || (USBD_CLASS_BOS_ENABLED == 1))
+, USBD_Dev_USR_BOSDescriptor
+#endif /* ((USBD_LPM_ENABLED == 1) || (USBD_CLASS_BOS_ENABLED == 1)) */
 };
 
 #if defined ( __ICCARM__ ) /* IAR Compiler */
@@ -167,16 +179,15 @@ static const struct device_descriptor USBD_Dev_DeviceDesc =
 {
   sizeof(USBD_Dev_DeviceDesc),    /* bLength */
   USB_DESC_TYPE_DEVICE,       /* bDescriptorType */
-#if (USBD_LPM_ENABLED == 1)
-  0x01,                       /*bcdUSB */ /* changed to USB version 2.01
+#if ((USBD_LPM_ENABLED == 1) || (USBD_CLASS_BOS_ENABLED == 1))
+  USB_UINT16(0x0201),         /*bcdUSB */ /* changed to USB version 2.01
                                              in order to support LPM L1 suspend
-                                             resume test of USBCV3.0*/
+                                             resume test of USBCV3.0 and to have
+                                             the host read the BOS descriptor */
 #else
-  0x00,                       /*bcdUSB */
+  USB_UINT16(0x0200),         /*bcdUSB */
 #endif /* (USBD_LPM_ENABLED == 1) */
-  0x02,
-  //USB_UINT16(0x0200),         /* bcdUSB */
-  
+
   0x00,                       /* bDeviceClass */
   0x00,                       /* bDeviceSubClass */
   0x00,                       /* bDeviceProtocol */
@@ -185,16 +196,9 @@ static const struct device_descriptor USBD_Dev_DeviceDesc =
 //  0x01,                       /* bDeviceProtocol */
   USB_MAX_EP0_SIZE,           /* bMaxPacketSize */
 
-  LOBYTE(USBD_VID),           /*idVendor*/
-  HIBYTE(USBD_VID),           /*idVendor*/
-  LOBYTE(USBD_PID),           /*idProduct*/
-  HIBYTE(USBD_PID),           /*idProduct*/
-  //USB_UINT16(USBD_VID),       /* idVendor */
-  //USB_UINT16(USBD_PID),       /* idProduct */
-  
-  0x00,                       /*bcdDevice rel. 2.00*/
-  0x02,
-  //USB_UINT16(0x0200),         /* bcdDevice */
+  USB_UINT16(USBD_VID),       /* idVendor */
+  USB_UINT16(USBD_PID),       /* idProduct */
+  USB_UINT16(0x0200),         /* bcdDevice rel. 2.00 */
   USBD_IDX_MFC_STR,           /* Index of manufacturer string */
   USBD_IDX_PRODUCT_STR,       /* Index of product string */
   USBD_IDX_SERIAL_STR,        /* Index of serial number string */
@@ -202,7 +206,33 @@ static const struct device_descriptor USBD_Dev_DeviceDesc =
 };
 
 /** BOS descriptor. */
-#if (USBD_LPM_ENABLED == 1)
+#if (USBD_CLASS_BOS_ENABLED == 1)
+#if defined ( __ICCARM__ ) /* IAR Compiler */
+  #pragma data_alignment=4
+#endif /* defined ( __ICCARM__ ) */
+/* MS OS 2.0 platform capability: Windows 8.1+ reads the descriptor set with
+   vendor request VENDOR_MS_VENDOR_CODE and binds WinUSB to the vendor interface */
+__ALIGN_BEGIN uint8_t USBD_Dev_BOSDesc[USB_SIZ_BOS_DESC] __ALIGN_END =
+{
+  0x5,
+  USB_DESC_TYPE_BOS,
+  LOBYTE(USB_SIZ_BOS_DESC),
+  HIBYTE(USB_SIZ_BOS_DESC),
+  0x1,  /* 1 device capability */
+        /* platform capability */
+  0x1C,
+  USB_DEVICE_CAPABITY_TYPE,
+  0x05, /* PLATFORM */
+  0x00,
+  0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C,  /* MS OS 2.0 UUID */
+  0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F,  /* D8DD60DF-4589-4CC7-9CD2-659D9E648A9F */
+  0x00, 0x00, 0x03, 0x06,                          /* dwWindowsVersion: Windows 8.1 */
+  LOBYTE(VENDOR_MS_OS_20_DESC_SIZ),
+  HIBYTE(VENDOR_MS_OS_20_DESC_SIZ),
+  VENDOR_MS_VENDOR_CODE,
+  0x00  /* bAltEnumCode */
+};
+#elif (USBD_LPM_ENABLED == 1)
 #if defined ( __ICCARM__ ) /* IAR Compiler */
   #pragma data_alignment=4
 #endif /* defined ( __ICCARM__ ) */
@@ -222,7 +252,7 @@ __ALIGN_BEGIN uint8_t USBD_Dev_BOSDesc[USB_SIZ_BOS_DESC] __ALIGN_END =
   0x0,
   0x0
 };
-#endif /* (USBD_LPM_ENABLED == 1) */
+#endif /* (USBD_CLASS_BOS_ENABLED == 1) */
 
 /**
   * @}
@@ -506,7 +536,7 @@ uint8_t * USBD_Dev_InterfaceStrDescriptor(USBD_SpeedTypeDef speed, uint16_t *len
   return USBD_StrDesc;
 }
 
-#if (USBD_LPM_ENABLED == 1)
+#if ((USBD_LPM_ENABLED == 1) || (USBD_CLASS_BOS_ENABLED == 1))
 /**
   * @brief  Return the BOS descriptor
   * @param  speed : Current device speed
@@ -519,7 +549,7 @@ uint8_t * USBD_Dev_USR_BOSDescriptor(USBD_SpeedTypeDef speed, uint16_t *length)
   *length = sizeof(USBD_Dev_BOSDesc);
   return (uint8_t*)USBD_Dev_BOSDesc;
 }
-#endif /* (USBD_LPM_ENABLED == 1) */
+#endif /* ((USBD_LPM_ENABLED == 1) || (USBD_CLASS_BOS_ENABLED == 1)) */
 
 /**
   * @brief  Create the serial number string descriptor
@@ -0,0 +1,710 @@
+/*
+    gs_usb (candleLight) compatible class for the composite device
+
+    Host frames from the bulk OUT endpoint are queued per channel in the USB
+    ISR and handed to the CAN backend from the main loop by USBD_GS_Run, so a
+    channel waiting for a mailbox does not hold up the other one. A frame is
+    echoed back with its echo_id when its Tx mailbox completes
+    (USBD_GS_TxComplete), which is what the Linux driver uses to complete the
+    socket transmit; a frame the channel cannot send is echoed at once with
+    GSUSB_CAN_ERR_FLAG, so the host never runs out of echo slots. Frames for a
+    channel which is not started are dropped, the host has no echo slot open
+    for them. Frames received from the bus are queued by USBD_GS_ReceiveFrame
+    and sent one host frame per IN transfer, echoes go first.
+*/
+
+#include <string.h>
+#include "usbd_gsusb.h"
+#include "usbd_ctlreq.h"
+
+#if (USBD_GSUSB_ENABLE == 1)
+
+#if defined (USE_OTG_HS)
+extern USBD_HandleTypeDef hUsbDeviceHS;
+#define pUsbDevice &hUsbDeviceHS
+#endif
+
+#if defined (USE_OTG_FS)
+extern USBD_HandleTypeDef hUsbDeviceFS;
+#define pUsbDevice &hUsbDeviceFS
+#endif
+
+/* BT_CONST limits of bxCAN, BTR register fields */
+#define GSUSB_BT_TSEG1_MIN          1U
+#define GSUSB_BT_TSEG1_MAX          16U
+#define GSUSB_BT_TSEG2_MIN          1U
+#define GSUSB_BT_TSEG2_MAX          8U
+#define GSUSB_BT_SJW_MAX            4U
+#define GSUSB_BT_BRP_MIN            1U
+#define GSUSB_BT_BRP_MAX            1024U
+#define GSUSB_BT_BRP_INC            1U
+
+#define GSUSB_FEATURES              (GSUSB_FEATURE_LISTEN_ONLY | GSUSB_FEATURE_LOOP_BACK | GSUSB_FEATURE_ONE_SHOT | GSUSB_FEATURE_HW_TIMESTAMP)
+
+#define GSUSB_SW_VERSION            2U
+#define GSUSB_HW_VERSION            1U
+
+/* largest OUT control request payload: bit timing */
+#define GSUSB_CTL_BUFFER_SIZE       sizeof(USBD_GS_BitTimingTypeDef)
+
+/* local function prototyping */
+
+static uint8_t USBD_GS_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_GS_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_GS_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t USBD_GS_EP0_RxReady (USBD_HandleTypeDef *pdev);
+static uint8_t USBD_GS_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_GS_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum);
+
+/* interfaces and endpoints owned by the class, for composite dispatch tables */
+static const uint8_t gsInterfaces[] = { GSUSB_ITF };
+static const uint8_t gsEndpoints[] = { GSUSB_EP_DATA_IN, GSUSB_EP_DATA_OUT };
+
+USBD_CompClassTypeDef USBD_GsUsb =
+{
+  USBD_GS_Init,
+  USBD_GS_DeInit,
+  USBD_GS_Setup,
+  NULL,                 /* EP0_TxSent, */
+  USBD_GS_EP0_RxReady,
+  USBD_GS_DataIn,
+  USBD_GS_DataOut,
+  NULL,                 /* SOF, */
+  gsInterfaces,
+  sizeof(gsInterfaces),
+  gsEndpoints,
+  sizeof(gsEndpoints),
+  0U,                   /* VendorCode, requests are addressed to the interface */
+};
+
+/* host frames from the host waiting for the backend, written by the USB ISR */
+__ALIGN_BEGIN static USBD_GS_HostFrameTypeDef gsTxQueue[GSUSB_NUM_CHANNELS][GSUSB_TX_QUEUE_SIZE] __ALIGN_END;
+static volatile uint32_t gsTxHead[GSUSB_NUM_CHANNELS];
+static volatile uint32_t gsTxTail[GSUSB_NUM_CHANNELS];
+
+/* host frames in Tx mailboxes, bit n of gsTxBusy - mailbox n holds one */
+static USBD_GS_HostFrameTypeDef gsTxPending[GSUSB_NUM_CHANNELS][GSUSB_TX_MAILBOXES];
+static volatile uint8_t gsTxBusy[GSUSB_NUM_CHANNELS];
+
+/* received frames waiting for the IN endpoint, written by the main loop */
+__ALIGN_BEGIN static USBD_GS_HostFrameTypeDef gsRxQueue[GSUSB_RX_QUEUE_SIZE] __ALIGN_END;
+static volatile uint32_t gsRxHead;
+static volatile uint32_t gsRxTail;
+
+/* echoes waiting for the IN endpoint, written by the Tx complete ISR and the
+   main loop with interrupts masked; a slot is reserved for every busy mailbox */
+__ALIGN_BEGIN static USBD_GS_HostFrameTypeDef gsEchoQueue[GSUSB_ECHO_QUEUE_SIZE] __ALIGN_END;
+static volatile uint32_t gsEchoHead;
+static volatile uint32_t gsEchoTail;
+
+__ALIGN_BEGIN static uint8_t gsOutBuffer[GSUSB_DATA_HS_MAX_PACKET_SIZE] __ALIGN_END;
+__ALIGN_BEGIN static uint32_t gsCtlBuffer[GSUSB_CTL_BUFFER_SIZE / 4U] __ALIGN_END;
+__ALIGN_BEGIN static uint32_t gsCtlReply[10] __ALIGN_END;
+
+static const USBD_GS_BackendTypeDef *gsBackend;
+
+static uint8_t gsCtlRequest;
+static uint8_t gsCtlChannel;
+static uint16_t gsFrameSize = GSUSB_HOST_FRAME_SIZE;
+static bool gsChannelStarted[GSUSB_NUM_CHANNELS];
+static volatile uint8_t gsInBusy;
+static volatile uint8_t gsInEcho;
+static volatile uint8_t gsOutPaused;
+static volatile uint8_t gsConfigured;
+
+static uint16_t USBD_GS_PacketSize (USBD_HandleTypeDef *pdev)
+{
+  return (pdev->dev_speed == USBD_SPEED_HIGH) ? GSUSB_DATA_HS_MAX_PACKET_SIZE : GSUSB_DATA_FS_MAX_PACKET_SIZE;
+}
+
+static uint32_t USBD_GS_Timestamp (void)
+{
+  return ((gsBackend != NULL) && (gsBackend->GetTimestamp != NULL)) ? gsBackend->GetTimestamp() : HAL_GetTick() * 1000U;
+}
+
+/* start IN transfer of the oldest echo or received frame, interrupts must be
+   masked or the caller must be an ISR */
+static void USBD_GS_StartIn (USBD_HandleTypeDef *pdev)
+{
+  USBD_GS_HostFrameTypeDef *hostFrame;
+
+  if ((gsConfigured == 0U) || (gsInBusy != 0U))
+  {
+    return;
+  }
+
+  if (gsEchoHead != gsEchoTail)
+  {
+    gsInEcho = 1U;
+    hostFrame = &gsEchoQueue[gsEchoTail & (GSUSB_ECHO_QUEUE_SIZE - 1U)];
+  }
+  else if (gsRxHead != gsRxTail)
+  {
+    gsInEcho = 0U;
+    hostFrame = &gsRxQueue[gsRxTail & (GSUSB_RX_QUEUE_SIZE - 1U)];
+  }
+  else
+  {
+    return;
+  }
+
+  gsInBusy = 1U;
+  (void)USBD_LL_Transmit(pdev, GSUSB_EP_DATA_IN, (uint8_t *)hostFrame, gsFrameSize);
+}
+
+/* any channel queue full, OUT endpoint must stay NAKed */
+static bool USBD_GS_TxQueueFull (void)
+{
+  uint8_t channel;
+
+  for (channel = 0; channel < GSUSB_NUM_CHANNELS; channel++)
+  {
+    if ((gsTxHead[channel] - gsTxTail[channel]) >= GSUSB_TX_QUEUE_SIZE)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* echo slots taken by queued echoes and reserved for busy mailboxes */
+static uint32_t USBD_GS_EchoLoad (void)
+{
+  uint32_t load = gsEchoHead - gsEchoTail;
+  uint8_t channel;
+  uint8_t busy;
+
+  for (channel = 0; channel < GSUSB_NUM_CHANNELS; channel++)
+  {
+    for (busy = gsTxBusy[channel]; busy != 0U; busy &= (uint8_t)(busy - 1U))
+    {
+      load++;
+    }
+  }
+
+  return load;
+}
+
+/* queue echo of a host frame, interrupts must be masked or the caller must be
+   an ISR; room is checked by the caller */
+static void USBD_GS_Echo (const USBD_GS_HostFrameTypeDef *hostFrame, uint32_t timestamp, uint32_t errorFlag)
+{
+  USBD_GS_HostFrameTypeDef *echo = &gsEchoQueue[gsEchoHead & (GSUSB_ECHO_QUEUE_SIZE - 1U)];
+
+  *echo = *hostFrame;
+  echo->can_id |= errorFlag;
+  echo->timestamp_us = timestamp;
+  gsEchoHead++;
+}
+
+static uint8_t USBD_GS_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  uint16_t packetSize = USBD_GS_PacketSize(pdev);
+
+  UNUSED(cfgidx);
+
+  USBD_LL_OpenEP(pdev, GSUSB_EP_DATA_IN, USBD_EP_TYPE_BULK, packetSize);
+  pdev->ep_in[GSUSB_EP_DATA_IN & 0xFU].is_used = 1U;
+
+  USBD_LL_OpenEP(pdev, GSUSB_EP_DATA_OUT, USBD_EP_TYPE_BULK, packetSize);
+  pdev->ep_out[GSUSB_EP_DATA_OUT & 0xFU].is_used = 1U;
+
+  memset((void *)gsTxHead, 0, sizeof(gsTxHead));
+  memset((void *)gsTxTail, 0, sizeof(gsTxTail));
+  memset((void *)gsTxBusy, 0, sizeof(gsTxBusy));
+  gsRxHead = gsRxTail = 0U;
+  gsEchoHead = gsEchoTail = 0U;
+  gsInBusy = 0U;
+  gsOutPaused = 0U;
+  gsFrameSize = GSUSB_HOST_FRAME_SIZE;
+  memset(gsChannelStarted, 0, sizeof(gsChannelStarted));
+  gsConfigured = 1U;
+
+  USBD_LL_PrepareReceive(pdev, GSUSB_EP_DATA_OUT, gsOutBuffer, packetSize);
+
+  return (uint8_t)USBD_OK;
+}
+
+static uint8_t USBD_GS_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  uint8_t channel;
+
+  UNUSED(cfgidx);
+
+  gsConfigured = 0U;
+
+  USBD_LL_CloseEP(pdev, GSUSB_EP_DATA_IN);
+  pdev->ep_in[GSUSB_EP_DATA_IN & 0xFU].is_used = 0U;
+
+  USBD_LL_CloseEP(pdev, GSUSB_EP_DATA_OUT);
+  pdev->ep_out[GSUSB_EP_DATA_OUT & 0xFU].is_used = 0U;
+
+  /* host is gone, take the channels off the bus */
+  for (channel = 0; channel < GSUSB_NUM_CHANNELS; channel++)
+  {
+    if (gsChannelStarted[channel] && (gsBackend != NULL) && (gsBackend->SetMode != NULL))
+    {
+      (void)gsBackend->SetMode(channel, GSUSB_MODE_RESET, 0U);
+    }
+    gsChannelStarted[channel] = false;
+    gsTxBusy[channel] = 0U;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/* device to host vendor requests, reply is built in gsCtlReply */
+static uint16_t USBD_GS_BuildReply (uint8_t request)
+{
+  switch (request)
+  {
+    case GSUSB_BREQ_BT_CONST:
+      gsCtlReply[0] = GSUSB_FEATURES;
+      gsCtlReply[1] = ((gsBackend != NULL) && (gsBackend->GetClock != NULL)) ? gsBackend->GetClock() : HAL_RCC_GetPCLK1Freq();
+      gsCtlReply[2] = GSUSB_BT_TSEG1_MIN;
+      gsCtlReply[3] = GSUSB_BT_TSEG1_MAX;
+      gsCtlReply[4] = GSUSB_BT_TSEG2_MIN;
+      gsCtlReply[5] = GSUSB_BT_TSEG2_MAX;
+      gsCtlReply[6] = GSUSB_BT_SJW_MAX;
+      gsCtlReply[7] = GSUSB_BT_BRP_MIN;
+      gsCtlReply[8] = GSUSB_BT_BRP_MAX;
+      gsCtlReply[9] = GSUSB_BT_BRP_INC;
+      return 40U;
+
+    case GSUSB_BREQ_DEVICE_CONFIG:
+      /* reserved1..3, icount (channels - 1), sw_version, hw_version */
+      gsCtlReply[0] = (uint32_t)(GSUSB_NUM_CHANNELS - 1U) << 24;
+      gsCtlReply[1] = GSUSB_SW_VERSION;
+      gsCtlReply[2] = GSUSB_HW_VERSION;
+      return 12U;
+
+    case GSUSB_BREQ_TIMESTAMP:
+      gsCtlReply[0] = USBD_GS_Timestamp();
+      return 4U;
+
+    default:
+      return 0U;
+  }
+}
+
+static uint8_t USBD_GS_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  uint8_t ifalt = 0U;
+  uint16_t status_info = 0U;
+  uint16_t length;
+  USBD_StatusTypeDef ret = USBD_OK;
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+    case USB_REQ_TYPE_VENDOR:
+    {
+      if (req->wValue >= GSUSB_NUM_CHANNELS)
+      {
+        USBD_CtlError(pdev, req);
+        ret = USBD_FAIL;
+      }
+      else if ((req->bmRequest & 0x80U) != 0U)
+      {
+        length = USBD_GS_BuildReply(req->bRequest);
+        if (length != 0U)
+        {
+          (void)USBD_CtlSendData(pdev, (uint8_t *)gsCtlReply, MIN(req->wLength, length));
+        }
+        else
+        {
+          USBD_CtlError(pdev, req);
+          ret = USBD_FAIL;
+        }
+      }
+      else if (req->wLength > sizeof(gsCtlBuffer))
+      {
+        USBD_CtlError(pdev, req);
+        ret = USBD_FAIL;
+      }
+      else if (req->wLength != 0U)
+      {
+        /* payload is handled in EP0_RxReady */
+        gsCtlRequest = req->bRequest;
+        gsCtlChannel = (uint8_t)req->wValue;
+        memset(gsCtlBuffer, 0, sizeof(gsCtlBuffer));
+        (void)USBD_CtlPrepareRx(pdev, (uint8_t *)gsCtlBuffer, req->wLength);
+      }
+    }
+    break;
+
+    case USB_REQ_TYPE_STANDARD:
+    {
+      switch (req->bRequest)
+      {
+        case USB_REQ_GET_STATUS:
+        {
+          if (pdev->dev_state == USBD_STATE_CONFIGURED)
+          {
+            (void)USBD_CtlSendData(pdev, (uint8_t *)&status_info, 2U);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+        }
+        break;
+
+        case USB_REQ_GET_INTERFACE:
+        {
+          if (pdev->dev_state == USBD_STATE_CONFIGURED)
+          {
+            (void)USBD_CtlSendData(pdev, &ifalt, 1U);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+        }
+        break;
+
+        case USB_REQ_SET_INTERFACE:
+        {
+          if (pdev->dev_state != USBD_STATE_CONFIGURED)
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+        }
+        break;
+
+        case USB_REQ_CLEAR_FEATURE:
+        {
+        }
+        break;
+
+        default:
+        {
+          USBD_CtlError(pdev, req);
+          ret = USBD_FAIL;
+        }
+        break;
+      }
+    }
+    break;
+
+    default:
+    {
+      USBD_CtlError(pdev, req);
+      ret = USBD_FAIL;
+    }
+    break;
+  }
+
+  return (uint8_t)ret;
+}
+
+/* host to device vendor requests, payload is in gsCtlBuffer */
+static uint8_t USBD_GS_EP0_RxReady (USBD_HandleTypeDef *pdev)
+{
+  uint8_t channel = gsCtlChannel;
+  uint32_t mode;
+  uint32_t flags;
+
+  UNUSED(pdev);
+
+  switch (gsCtlRequest)
+  {
+    case GSUSB_BREQ_BITTIMING:
+      if ((gsBackend != NULL) && (gsBackend->SetBitTiming != NULL))
+      {
+        (void)gsBackend->SetBitTiming(channel, (const USBD_GS_BitTimingTypeDef *)gsCtlBuffer);
+      }
+      break;
+
+    case GSUSB_BREQ_MODE:
+      mode = gsCtlBuffer[0];
+      flags = gsCtlBuffer[1];
+
+      /* the host dropped echo slots of the channel, its frames are forgotten */
+      gsTxTail[channel] = gsTxHead[channel];
+      gsTxBusy[channel] = 0U;
+
+      if (mode == GSUSB_MODE_START)
+      {
+        /* frame size is a device wide setting in gs_usb, last start wins */
+        gsFrameSize = ((flags & GSUSB_FEATURE_HW_TIMESTAMP) != 0U) ? GSUSB_HOST_FRAME_TS_SIZE : GSUSB_HOST_FRAME_SIZE;
+        gsChannelStarted[channel] = (gsBackend == NULL) || (gsBackend->SetMode == NULL) || gsBackend->SetMode(channel, mode, flags);
+      }
+      else
+      {
+        if ((gsBackend != NULL) && (gsBackend->SetMode != NULL))
+        {
+          (void)gsBackend->SetMode(channel, GSUSB_MODE_RESET, 0U);
+        }
+        gsChannelStarted[channel] = false;
+      }
+      break;
+
+    case GSUSB_BREQ_HOST_FORMAT:
+    case GSUSB_BREQ_BERR:
+    case GSUSB_BREQ_IDENTIFY:
+    default:
+      /* host format is always little endian on this device, nothing to do */
+      break;
+  }
+
+  gsCtlRequest = 0xFFU;
+
+  return (uint8_t)USBD_OK;
+}
+
+static uint8_t USBD_GS_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  UNUSED(epnum);
+
+  /* host frames are shorter than a packet, no ZLP is ever needed */
+  if (gsInEcho != 0U)
+  {
+    gsEchoTail++;
+  }
+  else
+  {
+    gsRxTail++;
+  }
+  gsInBusy = 0U;
+
+  USBD_GS_StartIn(pdev);
+
+  return (uint8_t)USBD_OK;
+}
+
+static uint8_t USBD_GS_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  uint32_t length = USBD_LL_GetRxDataSize(pdev, epnum);
+  uint8_t channel = ((const USBD_GS_HostFrameTypeDef *)gsOutBuffer)->channel;
+  USBD_GS_HostFrameTypeDef *slot;
+
+  /* the host has no interface for unknown channels, their frames are dropped */
+  if ((length >= GSUSB_HOST_FRAME_SIZE) && (channel < GSUSB_NUM_CHANNELS) &&
+      ((gsTxHead[channel] - gsTxTail[channel]) < GSUSB_TX_QUEUE_SIZE))
+  {
+    slot = &gsTxQueue[channel][gsTxHead[channel] & (GSUSB_TX_QUEUE_SIZE - 1U)];
+    memcpy(slot, gsOutBuffer, MIN(length, sizeof(*slot)));
+    gsTxHead[channel]++;
+  }
+
+  /* endpoint stays NAKed while a queue is full, USBD_GS_Run re-arms it */
+  if (!USBD_GS_TxQueueFull())
+  {
+    USBD_LL_PrepareReceive(pdev, GSUSB_EP_DATA_OUT, gsOutBuffer, USBD_GS_PacketSize(pdev));
+  }
+  else
+  {
+    gsOutPaused = 1U;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/* host frame to CAN frame */
+static void USBD_GS_ToCanFrame (const USBD_GS_HostFrameTypeDef *hostFrame, CanFrame_t *frame)
+{
+  frame->Flags = 0U;
+
+  if ((hostFrame->can_id & GSUSB_CAN_EFF_FLAG) != 0U)
+  {
+    frame->Id = hostFrame->can_id & 0x1FFFFFFFU;
+    frame->Flags |= CAN_FRAME_FLAG_EXT;
+  }
+  else
+  {
+    frame->Id = hostFrame->can_id & 0x7FFU;
+  }
+
+  if ((hostFrame->can_id & GSUSB_CAN_RTR_FLAG) != 0U)
+  {
+    frame->Flags |= CAN_FRAME_FLAG_RTR;
+  }
+
+  frame->Dlc = MIN(hostFrame->can_dlc, CAN_FRAME_MAX_DATA);
+  frame->Timestamp = 0U;
+  memcpy(frame->Data, hostFrame->data, CAN_FRAME_MAX_DATA);
+}
+
+/**
+  * @brief  Set CAN controller callbacks used by the class
+  * @param  backend: callbacks, NULL echoes every frame without a bus
+  * @retval None
+  */
+void USBD_GS_RegisterBackend(const USBD_GS_BackendTypeDef *backend)
+{
+  gsBackend = backend;
+}
+
+/**
+  * @brief  Queue a frame received from the bus for the host
+  * @param  channel: CAN channel of gs_usb, 0..GSUSB_NUM_CHANNELS-1
+  * @param  frame: received frame, Timestamp in microseconds
+  * @retval false if channel is not started or queue is full
+  * @note   main loop only, shares the queue producer side with USBD_GS_Run
+  */
+bool USBD_GS_ReceiveFrame(uint8_t channel, const CanFrame_t *frame)
+{
+  USBD_GS_HostFrameTypeDef *slot;
+
+  if ((channel >= GSUSB_NUM_CHANNELS) || !gsChannelStarted[channel] || ((gsRxHead - gsRxTail) >= GSUSB_RX_QUEUE_SIZE))
+  {
+    return false;
+  }
+
+  slot = &gsRxQueue[gsRxHead & (GSUSB_RX_QUEUE_SIZE - 1U)];
+
+  slot->echo_id = GSUSB_ECHO_ID_RX;
+  slot->can_id = frame->Id;
+  if ((frame->Flags & CAN_FRAME_FLAG_EXT) != 0U)
+  {
+    slot->can_id |= GSUSB_CAN_EFF_FLAG;
+  }
+  if ((frame->Flags & CAN_FRAME_FLAG_RTR) != 0U)
+  {
+    slot->can_id |= GSUSB_CAN_RTR_FLAG;
+  }
+  if ((frame->Flags & CAN_FRAME_FLAG_ERR) != 0U)
+  {
+    slot->can_id |= GSUSB_CAN_ERR_FLAG;
+  }
+  slot->can_dlc = frame->Dlc;
+  slot->channel = channel;
+  slot->flags = 0U;
+  slot->reserved = 0U;
+  memcpy(slot->data, frame->Data, CAN_FRAME_MAX_DATA);
+  /* protocol carries the low 32 bits, the host driver extends them */
+  slot->timestamp_us = (uint32_t)frame->Timestamp;
+
+  gsRxHead++;
+
+  return true;
+}
+
+/**
+  * @brief  Echo host frame of a completed Tx mailbox
+  * @param  channel: CAN channel of gs_usb, 0..GSUSB_NUM_CHANNELS-1
+  * @param  mailbox: Tx mailbox, 0..GSUSB_TX_MAILBOXES-1
+  * @param  sent: false if the frame was not sent, it is echoed with GSUSB_CAN_ERR_FLAG
+  * @param  timestamp: completion time, microseconds
+  * @retval None
+  * @note   Tx complete ISR, mailboxes holding other frames are ignored
+  */
+void USBD_GS_TxComplete(uint8_t channel, uint8_t mailbox, bool sent, uint32_t timestamp)
+{
+  uint8_t bit = (uint8_t)(1U << mailbox);
+
+  if ((channel >= GSUSB_NUM_CHANNELS) || (mailbox >= GSUSB_TX_MAILBOXES) || ((gsTxBusy[channel] & bit) == 0U))
+  {
+    return;
+  }
+
+  /* slot was reserved when the frame went to the mailbox */
+  USBD_GS_Echo(&gsTxPending[channel][mailbox], timestamp, sent ? 0U : GSUSB_CAN_ERR_FLAG);
+  gsTxBusy[channel] &= (uint8_t)~bit;
+}
+
+/* pass the oldest host frame of a channel on, false if the channel must wait */
+static bool USBD_GS_RunChannel (uint8_t channel)
+{
+  USBD_GS_HostFrameTypeDef *hostFrame;
+  CanFrame_t frame;
+  uint8_t mailbox;
+  bool next = true;
+  uint32_t primask = __get_PRIMASK();
+
+  /* Tx complete ISR must not see a mailbox before its host frame is stored,
+     mode requests must not flush the queue under the frame */
+  __disable_irq();
+
+  if (gsTxHead[channel] == gsTxTail[channel])
+  {
+    next = false;
+  }
+  else if (!gsChannelStarted[channel])
+  {
+    gsTxTail[channel]++;
+  }
+  else if (USBD_GS_EchoLoad() >= GSUSB_ECHO_QUEUE_SIZE)
+  {
+    next = false;
+  }
+  else
+  {
+    hostFrame = &gsTxQueue[channel][gsTxTail[channel] & (GSUSB_TX_QUEUE_SIZE - 1U)];
+
+    if ((gsBackend == NULL) || (gsBackend->Transmit == NULL))
+    {
+      USBD_GS_Echo(hostFrame, USBD_GS_Timestamp(), 0U);
+      gsTxTail[channel]++;
+    }
+    else
+    {
+      USBD_GS_ToCanFrame(hostFrame, &frame);
+      mailbox = gsBackend->Transmit(channel, &frame);
+
+      if (mailbox < GSUSB_TX_MAILBOXES)
+      {
+        gsTxPending[channel][mailbox] = *hostFrame;
+        gsTxBusy[channel] |= (uint8_t)(1U << mailbox);
+        gsTxTail[channel]++;
+      }
+      else if (mailbox == GSUSB_TX_BUSY)
+      {
+        next = false;
+      }
+      else
+      {
+        USBD_GS_Echo(hostFrame, USBD_GS_Timestamp(), GSUSB_CAN_ERR_FLAG);
+        gsTxTail[channel]++;
+      }
+    }
+  }
+
+  __set_PRIMASK(primask);
+
+  return next;
+}
+
+/**
+  * @brief  Pass queued host frames to the backend and start IN transfers
+  * @param  None
+  * @retval None
+  * @note   call from the main loop
+  */
+void USBD_GS_Run(void)
+{
+  USBD_HandleTypeDef *pdev = pUsbDevice;
+  uint8_t channel;
+  uint32_t primask;
+
+  if (gsConfigured == 0U)
+  {
+    return;
+  }
+
+  for (channel = 0; channel < GSUSB_NUM_CHANNELS; channel++)
+  {
+    while (USBD_GS_RunChannel(channel))
+    {
+    }
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if ((gsOutPaused != 0U) && !USBD_GS_TxQueueFull())
+  {
+    gsOutPaused = 0U;
+    USBD_LL_PrepareReceive(pdev, GSUSB_EP_DATA_OUT, gsOutBuffer, USBD_GS_PacketSize(pdev));
+  }
+
+  USBD_GS_StartIn(pdev);
+
+  __set_PRIMASK(primask);
+}
+
+#endif /* USBD_GSUSB_ENABLE */
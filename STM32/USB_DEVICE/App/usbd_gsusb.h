@@ -0,0 +1,130 @@
+/*
+    gs_usb (candleLight) compatible class for the composite device
+
+    Interface 0 speaks the protocol of the Linux gs_usb driver: bit timing and
+    mode are set by vendor control requests, CAN frames travel as host frame
+    structs on a bulk IN / bulk OUT pair and reach SocketCAN without a tty.
+    The CAN controller is reached through USBD_GS_BackendTypeDef callbacks,
+    its Tx complete interrupt reports sent frames with USBD_GS_TxComplete.
+*/
+
+#ifndef __USBD_GSUSB_H_
+#define __USBD_GSUSB_H_
+
+#include <stdbool.h>
+#include "usbd_composite.h"
+#include "usbd_cdc.h"
+#include "CanFrameBuffer.h"
+
+#if (USBD_GSUSB_ENABLE == 1)
+
+/* Linux gs_usb binds interface 0 of the candleLight VID/PID */
+#define GSUSB_VID                                   0x1D50U
+#define GSUSB_PID                                   0x606FU
+
+#define GSUSB_ITF                                   0x00U
+#define GSUSB_EP_DATA_IN                            0x81U
+#define GSUSB_EP_DATA_OUT                           0x02U
+
+#if (((2 * NUM_OF_CDC_UARTS) + 1 + USBD_VENDOR_ENABLE) >= USBD_MAX_EP_NUMBER)
+#error "gs_usb, CDC and vendor endpoints exceed core endpoints, reduce NUM_OF_CDC_UARTS"
+#endif
+
+#define GSUSB_DATA_HS_MAX_PACKET_SIZE               CDC_DATA_HS_MAX_PACKET_SIZE
+#define GSUSB_DATA_FS_MAX_PACKET_SIZE               CDC_DATA_FS_MAX_PACKET_SIZE
+
+/* CAN channels reported to the host: CAN1 and CAN2, one tagged stream */
+#ifndef GSUSB_NUM_CHANNELS
+#define GSUSB_NUM_CHANNELS                          2U
+#endif
+
+/* host frames waiting for the backend (per channel), received frames and
+   echoes waiting for the IN endpoint, power of two */
+#define GSUSB_TX_QUEUE_SIZE                         16U
+#define GSUSB_RX_QUEUE_SIZE                         64U
+#define GSUSB_ECHO_QUEUE_SIZE                       8U
+
+/* Tx mailboxes of a channel, results of USBD_GS_BackendTypeDef Transmit */
+#define GSUSB_TX_MAILBOXES                          3U
+#define GSUSB_TX_BUSY                               0xFEU   /* no free mailbox, retry later */
+#define GSUSB_TX_REJECTED                           0xFFU   /* channel cannot send, frame is echoed with GSUSB_CAN_ERR_FLAG */
+
+/* vendor requests, bRequest */
+#define GSUSB_BREQ_HOST_FORMAT                      0U
+#define GSUSB_BREQ_BITTIMING                        1U
+#define GSUSB_BREQ_MODE                             2U
+#define GSUSB_BREQ_BERR                             3U
+#define GSUSB_BREQ_BT_CONST                         4U
+#define GSUSB_BREQ_DEVICE_CONFIG                    5U
+#define GSUSB_BREQ_TIMESTAMP                        6U
+#define GSUSB_BREQ_IDENTIFY                         7U
+
+/* GSUSB_BREQ_MODE modes */
+#define GSUSB_MODE_RESET                            0U
+#define GSUSB_MODE_START                            1U
+
+/* feature bits of BT_CONST, same bits select them in GSUSB_BREQ_MODE flags */
+#define GSUSB_FEATURE_LISTEN_ONLY                   (1U << 0)
+#define GSUSB_FEATURE_LOOP_BACK                     (1U << 1)
+#define GSUSB_FEATURE_TRIPLE_SAMPLE                 (1U << 2)
+#define GSUSB_FEATURE_ONE_SHOT                      (1U << 3)
+#define GSUSB_FEATURE_HW_TIMESTAMP                  (1U << 4)
+#define GSUSB_FEATURE_IDENTIFY                      (1U << 5)
+
+/* host frame echo_id of frames received from the bus */
+#define GSUSB_ECHO_ID_RX                            0xFFFFFFFFU
+
+/* Linux can_id flags */
+#define GSUSB_CAN_EFF_FLAG                          0x80000000U
+#define GSUSB_CAN_RTR_FLAG                          0x40000000U
+#define GSUSB_CAN_ERR_FLAG                          0x20000000U
+
+/* host frame on the bulk endpoints, little endian; timestamp_us only in
+   GSUSB_FEATURE_HW_TIMESTAMP mode */
+typedef struct
+{
+  uint32_t echo_id;
+  uint32_t can_id;
+  uint8_t  can_dlc;
+  uint8_t  channel;
+  uint8_t  flags;
+  uint8_t  reserved;
+  uint8_t  data[8];
+  uint32_t timestamp_us;
+} USBD_GS_HostFrameTypeDef;
+
+#define GSUSB_HOST_FRAME_SIZE                       20U
+#define GSUSB_HOST_FRAME_TS_SIZE                    24U
+
+/* GSUSB_BREQ_BITTIMING payload */
+typedef struct
+{
+  uint32_t prop_seg;
+  uint32_t phase_seg1;
+  uint32_t phase_seg2;
+  uint32_t sjw;
+  uint32_t brp;
+} USBD_GS_BitTimingTypeDef;
+
+/* CAN controller side. Calls are made from the main loop (USBD_GS_Run, with
+   interrupts masked for Transmit) or from the USB ISR for control requests.
+   NULL members are skipped, without Transmit frames are echoed at once. */
+typedef struct
+{
+  bool     (*SetBitTiming)(uint8_t channel, const USBD_GS_BitTimingTypeDef *timing);
+  bool     (*SetMode)(uint8_t channel, uint32_t mode, uint32_t flags);
+  uint8_t  (*Transmit)(uint8_t channel, const CanFrame_t *frame);  /* mailbox, GSUSB_TX_BUSY or GSUSB_TX_REJECTED */
+  uint32_t (*GetTimestamp)(void);                                  /* microseconds */
+  uint32_t (*GetClock)(void);                                      /* CAN kernel clock, Hz */
+} USBD_GS_BackendTypeDef;
+
+extern USBD_CompClassTypeDef USBD_GsUsb;
+
+void USBD_GS_RegisterBackend(const USBD_GS_BackendTypeDef *backend);
+bool USBD_GS_ReceiveFrame(uint8_t channel, const CanFrame_t *frame);
+void USBD_GS_TxComplete(uint8_t channel, uint8_t mailbox, bool sent, uint32_t timestamp);
+void USBD_GS_Run(void);
+
+#endif /* USBD_GSUSB_ENABLE */
+
+#endif  // __USBD_GSUSB_H_
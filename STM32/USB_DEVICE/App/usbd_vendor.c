@@ -0,0 +1,370 @@
+/*
+    Vendor specific bulk class for the composite device
+
+    Bulk IN / bulk OUT pair without CDC line discipline: the host drives it with
+    libusb and large asynchronous transfers. Received packets and transmit
+    completions are passed to usbd_vcp as channel VENDOR_ITF_NUMBER, so the
+    interface shares Rx credits, Tx rings and transfer chaining with CDC.
+*/
+
+#include <string.h>
+#include "usbd_vendor.h"
+#include "usbd_ctlreq.h"
+#include "usbd_vcp.h"
+
+#if (USBD_VENDOR_ENABLE == 1)
+
+#if defined (USE_OTG_HS)
+extern USBD_HandleTypeDef hUsbDeviceHS;
+#define pUsbDevice &hUsbDeviceHS
+#endif
+
+#if defined (USE_OTG_FS)
+extern USBD_HandleTypeDef hUsbDeviceFS;
+#define pUsbDevice &hUsbDeviceFS
+#endif
+
+#define VENDOR_IS_DMA_ALIGNED(p)    ((((uint32_t)(p)) & 3U) == 0U)
+
+/* local function prototyping */
+
+static uint8_t USBD_Vendor_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_Vendor_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_Vendor_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t USBD_Vendor_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_Vendor_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum);
+
+/* MS OS 2.0 descriptor set: WinUSB for the vendor interface only, CDC
+   interfaces keep the inbox usbser driver */
+__ALIGN_BEGIN static const uint8_t USBD_Vendor_MSOS20Desc[VENDOR_MS_OS_20_DESC_SIZ] __ALIGN_END =
+{
+  /* Descriptor set header */
+  0x0A, 0x00,                                      /* wLength */
+  0x00, 0x00,                                      /* wDescriptorType: MS_OS_20_SET_HEADER_DESCRIPTOR */
+  0x00, 0x00, 0x03, 0x06,                          /* dwWindowsVersion: Windows 8.1 */
+  LOBYTE(VENDOR_MS_OS_20_DESC_SIZ),                /* wTotalLength */
+  HIBYTE(VENDOR_MS_OS_20_DESC_SIZ),
+
+  /* Configuration subset header */
+  0x08, 0x00,                                      /* wLength */
+  0x01, 0x00,                                      /* wDescriptorType: MS_OS_20_SUBSET_HEADER_CONFIGURATION */
+  0x00,                                            /* bConfigurationValue: first configuration */
+  0x00,                                            /* bReserved */
+  LOBYTE(VENDOR_MS_OS_20_DESC_SIZ - 10U),          /* wTotalLength: configuration subset */
+  HIBYTE(VENDOR_MS_OS_20_DESC_SIZ - 10U),
+
+  /* Function subset header */
+  0x08, 0x00,                                      /* wLength */
+  0x02, 0x00,                                      /* wDescriptorType: MS_OS_20_SUBSET_HEADER_FUNCTION */
+  VENDOR_ITF,                                      /* bFirstInterface */
+  0x00,                                            /* bReserved */
+  LOBYTE(VENDOR_MS_OS_20_DESC_SIZ - 18U),          /* wSubsetLength: function subset */
+  HIBYTE(VENDOR_MS_OS_20_DESC_SIZ - 18U),
+
+  /* Compatible ID */
+  0x14, 0x00,                                      /* wLength */
+  0x03, 0x00,                                      /* wDescriptorType: MS_OS_20_FEATURE_COMPATBLE_ID */
+  'W', 'I', 'N', 'U', 'S', 'B', 0, 0,              /* CompatibleID */
+  0, 0, 0, 0, 0, 0, 0, 0,                          /* SubCompatibleID */
+
+  /* Registry property: DeviceInterfaceGUIDs, libusb finds the device by it */
+  0x84, 0x00,                                      /* wLength */
+  0x04, 0x00,                                      /* wDescriptorType: MS_OS_20_FEATURE_REG_PROPERTY */
+  0x07, 0x00,                                      /* wPropertyDataType: REG_MULTI_SZ */
+  0x2A, 0x00,                                      /* wPropertyNameLength */
+  'D', 0, 'e', 0, 'v', 0, 'i', 0, 'c', 0, 'e', 0, 'I', 0, 'n', 0,
+  't', 0, 'e', 0, 'r', 0, 'f', 0, 'a', 0, 'c', 0, 'e', 0, 'G', 0,
+  'U', 0, 'I', 0, 'D', 0, 's', 0, 0, 0,
+  0x50, 0x00,                                      /* wPropertyDataLength */
+  '{', 0, '8', 0, 'F', 0, '3', 0, 'B', 0, '2', 0, 'C', 0, '4', 0,
+  '1', 0, '-', 0, '6', 0, 'D', 0, '2', 0, 'E', 0, '-', 0, '4', 0,
+  'A', 0, '7', 0, 'B', 0, '-', 0, '9', 0, 'C', 0, '1', 0, '5', 0,
+  '-', 0, '3', 0, 'E', 0, '0', 0, 'A', 0, '7', 0, 'D', 0, '6', 0,
+  'B', 0, '5', 0, 'F', 0, '2', 0, '1', 0, '}', 0, 0, 0, 0, 0,
+};
+
+/* interfaces and endpoints owned by the class, for composite dispatch tables */
+static const uint8_t vendorInterfaces[] = { VENDOR_ITF };
+static const uint8_t vendorEndpoints[] = { VENDOR_EP_DATA_IN, VENDOR_EP_DATA_OUT };
+
+USBD_CompClassTypeDef USBD_Vendor =
+{
+  USBD_Vendor_Init,
+  USBD_Vendor_DeInit,
+  USBD_Vendor_Setup,
+  NULL,                 /* EP0_TxSent, */
+  NULL,                 /* EP0_RxReady, */
+  USBD_Vendor_DataIn,
+  USBD_Vendor_DataOut,
+  NULL,                 /* SOF, coalescing flush runs from CDC SOF for all channels */
+  vendorInterfaces,
+  sizeof(vendorInterfaces),
+  vendorEndpoints,
+  sizeof(vendorEndpoints),
+  VENDOR_MS_VENDOR_CODE,
+};
+
+/* received packets, two halves: next packet is received to one while the other is processed */
+__ALIGN_BEGIN static uint8_t vendorRxBuffer[2][VENDOR_DATA_HS_MAX_PACKET_SIZE] __ALIGN_END;
+
+#if (USBD_DMA_ENABLE == 1)
+/* aligned copy of transmit data which DMA can not read in place */
+__ALIGN_BEGIN static uint8_t vendorTxBounce[VENDOR_DATA_HS_MAX_PACKET_SIZE] __ALIGN_END;
+#endif
+
+static uint8_t vendorRxActive;
+static uint8_t *vendorTxBuffer;
+static uint32_t vendorTxLength;
+static volatile uint8_t vendorTxState;
+static volatile uint8_t vendorConfigured;
+
+static uint16_t USBD_Vendor_PacketSize (USBD_HandleTypeDef *pdev)
+{
+  return (pdev->dev_speed == USBD_SPEED_HIGH) ? VENDOR_DATA_HS_MAX_PACKET_SIZE : VENDOR_DATA_FS_MAX_PACKET_SIZE;
+}
+
+static uint8_t USBD_Vendor_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  uint16_t packetSize = USBD_Vendor_PacketSize(pdev);
+
+  UNUSED(cfgidx);
+
+  USBD_LL_OpenEP(pdev, VENDOR_EP_DATA_IN, USBD_EP_TYPE_BULK, packetSize);
+  pdev->ep_in[VENDOR_EP_DATA_IN & 0xFU].is_used = 1U;
+
+  USBD_LL_OpenEP(pdev, VENDOR_EP_DATA_OUT, USBD_EP_TYPE_BULK, packetSize);
+  pdev->ep_out[VENDOR_EP_DATA_OUT & 0xFU].is_used = 1U;
+
+  vendorTxState = 0U;
+  vendorRxActive = 0U;
+  vendorConfigured = 1U;
+
+  USBD_LL_PrepareReceive(pdev, VENDOR_EP_DATA_OUT, vendorRxBuffer[vendorRxActive], packetSize);
+
+  return (uint8_t)USBD_OK;
+}
+
+static uint8_t USBD_Vendor_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  UNUSED(cfgidx);
+
+  vendorConfigured = 0U;
+
+  USBD_LL_CloseEP(pdev, VENDOR_EP_DATA_IN);
+  pdev->ep_in[VENDOR_EP_DATA_IN & 0xFU].is_used = 0U;
+
+  USBD_LL_CloseEP(pdev, VENDOR_EP_DATA_OUT);
+  pdev->ep_out[VENDOR_EP_DATA_OUT & 0xFU].is_used = 0U;
+
+  return (uint8_t)USBD_OK;
+}
+
+static uint8_t USBD_Vendor_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  uint8_t ifalt = 0U;
+  uint16_t status_info = 0U;
+  USBD_StatusTypeDef ret = USBD_OK;
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+    case USB_REQ_TYPE_VENDOR:
+    {
+      /* MS OS 2.0 descriptor set, announced by the BOS platform capability */
+      if ((req->bRequest == VENDOR_MS_VENDOR_CODE) && (req->wIndex == VENDOR_MS_OS_20_DESCRIPTOR_INDEX) && ((req->bmRequest & 0x80U) != 0U))
+      {
+        (void)USBD_CtlSendData(pdev, (uint8_t *)USBD_Vendor_MSOS20Desc, MIN(req->wLength, sizeof(USBD_Vendor_MSOS20Desc)));
+      }
+      else
+      {
+        USBD_CtlError(pdev, req);
+        ret = USBD_FAIL;
+      }
+    }
+    break;
+
+    case USB_REQ_TYPE_STANDARD:
+    {
+      switch (req->bRequest)
+      {
+        case USB_REQ_GET_STATUS:
+        {
+          if (pdev->dev_state == USBD_STATE_CONFIGURED)
+          {
+            (void)USBD_CtlSendData(pdev, (uint8_t *)&status_info, 2U);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+        }
+        break;
+
+        case USB_REQ_GET_INTERFACE:
+        {
+          if (pdev->dev_state == USBD_STATE_CONFIGURED)
+          {
+            (void)USBD_CtlSendData(pdev, &ifalt, 1U);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+        }
+        break;
+
+        case USB_REQ_SET_INTERFACE:
+        {
+          if (pdev->dev_state != USBD_STATE_CONFIGURED)
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+        }
+        break;
+
+        case USB_REQ_CLEAR_FEATURE:
+        {
+        }
+        break;
+
+        default:
+        {
+          USBD_CtlError(pdev, req);
+          ret = USBD_FAIL;
+        }
+        break;
+      }
+    }
+    break;
+
+    default:
+    {
+      USBD_CtlError(pdev, req);
+      ret = USBD_FAIL;
+    }
+    break;
+  }
+
+  return (uint8_t)ret;
+}
+
+static uint8_t USBD_Vendor_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  PCD_HandleTypeDef *hpcd = pdev->pData;
+
+  epnum &= 0x0FU;
+
+  if ((pdev->ep_in[epnum].total_length > 0U) && ((pdev->ep_in[epnum].total_length % hpcd->IN_ep[epnum].maxpacket) == 0U))
+  {
+    /* Transfer ended on a packet boundary: send ZLP so the host URB completes */
+    pdev->ep_in[epnum].total_length = 0U;
+
+    (void)USBD_LL_Transmit(pdev, epnum, NULL, 0U);
+  }
+  else
+  {
+    vendorTxState = 0U;
+    USB_VCP_TransmitCompleteCallback(vendorTxBuffer, vendorTxLength, VENDOR_ITF_NUMBER);
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+static uint8_t USBD_Vendor_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  uint8_t *packet = vendorRxBuffer[vendorRxActive];
+  uint32_t length = USBD_LL_GetRxDataSize(pdev, epnum);
+
+  /* Arm the other half before the copy, endpoint stays NAKed until VCP has
+     room for the next packet */
+  if (USB_VCP_ReceiveCredit(VENDOR_ITF_NUMBER, length))
+  {
+    vendorRxActive ^= 1U;
+    VENDOR_ReceiveResume(VENDOR_ITF_NUMBER);
+  }
+
+  USB_VCP_DataReceivedCallback(packet, length, VENDOR_ITF_NUMBER);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  Start IN transfer on the vendor bulk endpoint
+  * @param  Buf: Buffer of data to be sent
+  * @param  Len: Number of data to be sent (in bytes)
+  * @param  interfaceNumber: VENDOR_ITF_NUMBER
+  * @retval USBD_OK, USBD_BUSY while previous transfer runs or USBD_FAIL
+  */
+uint8_t VENDOR_Transmit(uint8_t *Buf, uint16_t Len, uint8_t interfaceNumber)
+{
+  USBD_HandleTypeDef *pdev = pUsbDevice;
+
+  UNUSED(interfaceNumber);
+
+  if (vendorConfigured == 0U)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if (vendorTxState != 0U)
+  {
+    return (uint8_t)USBD_BUSY;
+  }
+
+#if (USBD_DMA_ENABLE == 1)
+  /* DMA can not read from unaligned address: send an aligned copy, cut so
+     that the rest of data starts aligned. DataIn reports sent length */
+  if (!VENDOR_IS_DMA_ALIGNED(Buf))
+  {
+    if (Len > sizeof(vendorTxBounce))
+    {
+      Len = sizeof(vendorTxBounce) - (((uint32_t)Buf + sizeof(vendorTxBounce)) & 3U);
+    }
+
+    memcpy(vendorTxBounce, Buf, Len);
+    Buf = vendorTxBounce;
+  }
+#endif
+
+  vendorTxState = 1U;
+  vendorTxBuffer = Buf;
+  vendorTxLength = Len;
+
+  pdev->ep_in[VENDOR_EP_DATA_IN & 0xFU].total_length = Len;
+  USBD_LL_Transmit(pdev, VENDOR_EP_DATA_IN, Buf, Len);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  Check if vendor IN endpoint is idle
+  * @param  interfaceNumber: VENDOR_ITF_NUMBER
+  * @retval true if VENDOR_Transmit may start a transfer
+  */
+bool VENDOR_CheckTransmitAvailable(uint8_t interfaceNumber)
+{
+  UNUSED(interfaceNumber);
+
+  return ((vendorConfigured != 0U) && (vendorTxState == 0U));
+}
+
+/**
+  * @brief  Arm vendor OUT endpoint for the next packet
+  * @param  interfaceNumber: VENDOR_ITF_NUMBER
+  * @retval None
+  */
+void VENDOR_ReceiveResume(uint8_t interfaceNumber)
+{
+  USBD_HandleTypeDef *pdev = pUsbDevice;
+
+  UNUSED(interfaceNumber);
+
+  if (vendorConfigured != 0U)
+  {
+    USBD_LL_PrepareReceive(pdev, VENDOR_EP_DATA_OUT, vendorRxBuffer[vendorRxActive], USBD_Vendor_PacketSize(pdev));
+  }
+}
+
+#endif /* USBD_VENDOR_ENABLE */
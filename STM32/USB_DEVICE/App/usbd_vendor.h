@@ -0,0 +1,50 @@
+/*
+    Vendor specific bulk class for the composite device
+
+    One interface with a bulk IN / bulk OUT pair, bound to WinUSB on Windows
+    by MS OS 2.0 descriptors, so the host reads the capture stream with libusb
+    instead of a tty. Data goes through the same usbd_vcp channel rings as CDC.
+*/
+
+#ifndef __USBD_VENDOR_H_
+#define __USBD_VENDOR_H_
+
+#include <stdbool.h>
+#include "usbd_composite.h"
+#include "usbd_cdc.h"
+
+#if (USBD_VENDOR_ENABLE == 1)
+
+/* interface and endpoints follow the gs_usb and CDC ones */
+#define VENDOR_ITF                                  ((2U * NUM_OF_CDC_UARTS) + USBD_GSUSB_ENABLE)
+#define VENDOR_EP_DATA_OUT                          ((2U * NUM_OF_CDC_UARTS) + 1U + USBD_GSUSB_ENABLE)
+#define VENDOR_EP_DATA_IN                           (0x80U | VENDOR_EP_DATA_OUT)
+
+/* channel number in usbd_vcp, after CDC_ITF_NUMBER_n */
+#define VENDOR_ITF_NUMBER                           (NUM_OF_CDC_UARTS + 1)
+
+#if (VENDOR_EP_DATA_OUT >= USBD_MAX_EP_NUMBER)
+#error "Vendor interface endpoints exceed core endpoints, reduce NUM_OF_CDC_UARTS"
+#endif
+
+/* same packet sizes as CDC data endpoints, usbd_vcp sizes transfers by them */
+#define VENDOR_DATA_HS_MAX_PACKET_SIZE              CDC_DATA_HS_MAX_PACKET_SIZE
+#define VENDOR_DATA_FS_MAX_PACKET_SIZE              CDC_DATA_FS_MAX_PACKET_SIZE
+
+/* bRequest of the device vendor request which returns MS OS 2.0 descriptors */
+#define VENDOR_MS_VENDOR_CODE                       0x20U
+#define VENDOR_MS_OS_20_DESCRIPTOR_INDEX            0x07U
+
+/* MS OS 2.0 descriptor set: header, configuration subset, function subset,
+   compatible ID, registry property with DeviceInterfaceGUIDs */
+#define VENDOR_MS_OS_20_DESC_SIZ                    (10U + 8U + 8U + 20U + 132U)
+
+extern USBD_CompClassTypeDef USBD_Vendor;
+
+uint8_t VENDOR_Transmit(uint8_t *Buf, uint16_t Len, uint8_t interfaceNumber);
+bool VENDOR_CheckTransmitAvailable(uint8_t interfaceNumber);
+void VENDOR_ReceiveResume(uint8_t interfaceNumber);
+
+#endif /* USBD_VENDOR_ENABLE */
+
+#endif  // __USBD_VENDOR_H_
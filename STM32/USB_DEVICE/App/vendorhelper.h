@@ -0,0 +1,55 @@
+/*
+    USB descriptor macros for the vendor specific bulk interface
+*/
+
+#ifndef __VENDOR_HELPER_H
+#define __VENDOR_HELPER_H
+
+#include <stdint.h>
+#include "usbhelper.h"
+
+struct vendor_interface
+{
+  struct interface_descriptor             dat_interface;
+  struct endpoint_descriptor              ep_out;
+  struct endpoint_descriptor              ep_in;
+};
+
+/* macro to help generate vendor bulk interface descriptors, any speed */
+#define VENDOR_DESCRIPTOR(DATA_ITF, SUBCLASS, PROTOCOL, DATAOUT_EP, DATAIN_EP, PACKET_SIZE) \
+    { \
+      { \
+        /*Interface Descriptor */ \
+        sizeof(struct interface_descriptor),             /* bLength: Interface Descriptor size */ \
+        USB_DESC_TYPE_INTERFACE,                         /* bDescriptorType: Interface */ \
+        DATA_ITF,                                        /* bInterfaceNumber: Number of Interface */ \
+        0x00,                                            /* bAlternateSetting: Alternate setting */ \
+        0x02,                                            /* bNumEndpoints: Two endpoints used */ \
+        0xFF,                                            /* bInterfaceClass: Vendor specific */ \
+        SUBCLASS,                                        /* bInterfaceSubClass: */ \
+        PROTOCOL,                                        /* bInterfaceProtocol: */ \
+        0x00,                                            /* iInterface: */ \
+      }, \
+ \
+      { \
+        /* Data Endpoint OUT Descriptor */ \
+        sizeof(struct endpoint_descriptor),              /* bLength: Endpoint Descriptor size */ \
+        USB_DESC_TYPE_ENDPOINT,                          /* bDescriptorType: Endpoint */ \
+        DATAOUT_EP,                                      /* bEndpointAddress */ \
+        0x02,                                            /* bmAttributes: Bulk */ \
+        USB_UINT16(PACKET_SIZE),                         /* wMaxPacketSize: */ \
+        0x00,                                            /* bInterval: ignore for Bulk transfer */ \
+      }, \
+ \
+      { \
+        /* Data Endpoint IN Descriptor*/ \
+        sizeof(struct endpoint_descriptor),              /* bLength: Endpoint Descriptor size */ \
+        USB_DESC_TYPE_ENDPOINT,                          /* bDescriptorType: Endpoint */ \
+        DATAIN_EP,                                       /* bEndpointAddress */ \
+        0x02,                                            /* bmAttributes: Bulk */ \
+        USB_UINT16(PACKET_SIZE),                         /* wMaxPacketSize: */ \
+        0x00                                             /* bInterval: ignore for Bulk transfer */ \
+      } \
+    }
+
+#endif /* __VENDOR_HELPER_H */
@@ -24,6 +24,8 @@
 #include "stm32f4xx_hal.h"
 #include "usbd_def.h"
 #include "usbd_cdc.h"
+#include "usbd_vendor.h"
+#include "usbd_gsusb.h"
 #include "usbd_core.h"
 
 /* USER CODE BEGIN Includes */
@@ -54,6 +56,76 @@ void Error_Handler(void);
 void SystemClock_Config(void);
 
 /* USER CODE BEGIN 0 */
+/* FIFO planner, all sizes in 32-bit words.
+   Rx FIFO is shared by all OUT endpoints: setup packets, two max packets
+   (OUT endpoints are double buffered), status and global NAK words (RM0390).
+   Tx FIFOs belong to IN endpoints and are indexed by IN endpoint number.
+   EP0 and CDC command endpoints get the minimum depth, the rest of FIFO RAM
+   is split evenly between bulk IN data endpoints (gs_usb, CDC, vendor) so several
+   packets per frame can be queued. Build fails if the plan does not fit. */
+#if defined (USE_OTG_HS)
+#define USBD_FIFO_TOTAL_WORDS       0x3F4U   /* 4 KB FIFO RAM less core reserved words */
+#define USBD_FIFO_MAX_PACKET        CDC_DATA_HS_MAX_PACKET_SIZE
+#endif
+#if defined (USE_OTG_FS)
+#define USBD_FIFO_TOTAL_WORDS       0x140U   /* 1.25 KB FIFO RAM */
+#define USBD_FIFO_MAX_PACKET        CDC_DATA_FS_MAX_PACKET_SIZE
+#endif
+
+#define USBD_FIFO_WORDS(bytes)      (((bytes) + 3U) / 4U)
+#define USBD_FIFO_MIN_WORDS         16U      /* smallest Tx FIFO depth */
+#define USBD_FIFO_MAX(a, b)         (((a) > (b)) ? (a) : (b))
+#define USBD_FIFO_DATA_EP_COUNT     (NUM_OF_CDC_UARTS + USBD_VENDOR_ENABLE + USBD_GSUSB_ENABLE)
+
+#define USBD_FIFO_RX_WORDS          ((5U + 8U) + (2U * (USBD_FIFO_WORDS(USBD_FIFO_MAX_PACKET) + 1U)) + (2U * (USBD_FIFO_DATA_EP_COUNT + 1U)) + 1U)
+#define USBD_FIFO_EP0_WORDS         USBD_FIFO_MAX(USBD_FIFO_WORDS(USB_MAX_EP0_SIZE), USBD_FIFO_MIN_WORDS)
+#define USBD_FIFO_CMD_WORDS         USBD_FIFO_MAX(USBD_FIFO_WORDS(CDC_CMD_PACKET_SIZE), USBD_FIFO_MIN_WORDS)
+#define USBD_FIFO_FIXED_WORDS       (USBD_FIFO_RX_WORDS + USBD_FIFO_EP0_WORDS + (NUM_OF_CDC_UARTS * USBD_FIFO_CMD_WORDS))
+#define USBD_FIFO_DATA_IN_WORDS     ((USBD_FIFO_TOTAL_WORDS - USBD_FIFO_FIXED_WORDS) / USBD_FIFO_DATA_EP_COUNT)
+
+#if (USBD_FIFO_FIXED_WORDS >= USBD_FIFO_TOTAL_WORDS) || (USBD_FIFO_DATA_IN_WORDS < USBD_FIFO_WORDS(USBD_FIFO_MAX_PACKET))
+#error "USB FIFO plan does not fit FIFO RAM"
+#endif
+
+/* Program Rx FIFO and Tx FIFOs of every IN endpoint. HAL places each Tx FIFO
+   after the lower numbered ones, so depths are collected by endpoint number
+   first and set in ascending order whatever the interface layout is. */
+static void USBD_FIFO_Setup(PCD_HandleTypeDef *hpcd)
+{
+  uint16_t txWords[USBD_MAX_EP_NUMBER] = { USBD_FIFO_EP0_WORDS };
+  uint8_t ep;
+
+#if (USBD_GSUSB_ENABLE == 1)
+  txWords[GSUSB_EP_DATA_IN & 0x0FU] = USBD_FIFO_DATA_IN_WORDS;
+#endif
+#if (NUM_OF_CDC_UARTS > 0)
+  txWords[CDC_EP_DATA_IN_1 & 0x0FU] = USBD_FIFO_DATA_IN_WORDS;
+  txWords[CDC_EP_CMD_1 & 0x0FU] = USBD_FIFO_CMD_WORDS;
+#endif
+#if (NUM_OF_CDC_UARTS > 1)
+  txWords[CDC_EP_DATA_IN_2 & 0x0FU] = USBD_FIFO_DATA_IN_WORDS;
+  txWords[CDC_EP_CMD_2 & 0x0FU] = USBD_FIFO_CMD_WORDS;
+#endif
+#if (NUM_OF_CDC_UARTS > 2)
+  txWords[CDC_EP_DATA_IN_3 & 0x0FU] = USBD_FIFO_DATA_IN_WORDS;
+  txWords[CDC_EP_CMD_3 & 0x0FU] = USBD_FIFO_CMD_WORDS;
+#endif
+#if (NUM_OF_CDC_UARTS > 3)
+  txWords[CDC_EP_DATA_IN_4 & 0x0FU] = USBD_FIFO_DATA_IN_WORDS;
+  txWords[CDC_EP_CMD_4 & 0x0FU] = USBD_FIFO_CMD_WORDS;
+#endif
+#if (USBD_VENDOR_ENABLE == 1)
+  txWords[VENDOR_EP_DATA_IN & 0x0FU] = USBD_FIFO_DATA_IN_WORDS;
+#endif
+
+  HAL_PCDEx_SetRxFiFo(hpcd, USBD_FIFO_RX_WORDS);
+
+  for (ep = 0; ep < USBD_MAX_EP_NUMBER; ep++)
+  {
+    if (txWords[ep] != 0U)
+      HAL_PCDEx_SetTxFiFo(hpcd, ep, txWords[ep]);
+  }
+}
 
 /* USER CODE END 0 */
 
@@ -404,9 +476,9 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   hpcd_USB_OTG_HS.Instance = USB_OTG_HS;
   hpcd_USB_OTG_HS.Init.dev_endpoints = 8;
   hpcd_USB_OTG_HS.Init.speed = PCD_SPEED_FULL;
-  hpcd_USB_OTG_HS.Init.dma_enable = DISABLE;
+  hpcd_USB_OTG_HS.Init.dma_enable = (USBD_DMA_ENABLE == 1) ? ENABLE : DISABLE;
   hpcd_USB_OTG_HS.Init.phy_itface = USB_OTG_EMBEDDED_PHY;
-  hpcd_USB_OTG_HS.Init.Sof_enable = DISABLE;
+  hpcd_USB_OTG_HS.Init.Sof_enable = ENABLE;
   hpcd_USB_OTG_HS.Init.low_power_enable = DISABLE;
   hpcd_USB_OTG_HS.Init.lpm_enable = DISABLE;
   hpcd_USB_OTG_HS.Init.vbus_sensing_enable = DISABLE;
@@ -434,21 +506,9 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
   //For HS:
   //Maximum size of FIFO = 0x03F4 * 4-byte word = 4048 bytes
+  //Tx FIFOs are set in ascending IN endpoint order by USBD_FIFO_Setup
 
-  HAL_PCDEx_SetRxFiFo(&hpcd_USB_OTG_HS, 0x100);    //Rx Fifo
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_HS, 0, 0x40);  //EP 0 Fifo
-  
-#if (NUM_OF_CDC_UARTS > 0)
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_HS, CDC_EP_DATA_OUT_1, 0x80);
-#endif
-
-#if (NUM_OF_CDC_UARTS > 1)
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_HS, CDC_EP_DATA_OUT_2, 0x80);
-#endif
-
-#if (NUM_OF_CDC_UARTS > 2)
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_HS, CDC_EP_DATA_OUT_3, 0x80);
-#endif
+  USBD_FIFO_Setup(&hpcd_USB_OTG_HS);
 
   }
 #endif
@@ -465,7 +525,7 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   hpcd_USB_OTG_FS.Init.speed = PCD_SPEED_FULL;
   hpcd_USB_OTG_FS.Init.dma_enable = DISABLE;
   hpcd_USB_OTG_FS.Init.phy_itface = PCD_PHY_EMBEDDED;
-  hpcd_USB_OTG_FS.Init.Sof_enable = DISABLE;
+  hpcd_USB_OTG_FS.Init.Sof_enable = ENABLE;
   hpcd_USB_OTG_FS.Init.low_power_enable = DISABLE;
   hpcd_USB_OTG_FS.Init.lpm_enable = DISABLE;
   hpcd_USB_OTG_FS.Init.vbus_sensing_enable = DISABLE;
@@ -492,25 +552,9 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */  
   //For FS:
   //Maximum size of FIFO = 0x0140 * 4-byte word = 1280 bytes
+  //Tx FIFOs are set in ascending IN endpoint order by USBD_FIFO_Setup
 
-  HAL_PCDEx_SetRxFiFo(&hpcd_USB_OTG_FS, 0x80);     //Rx Fifo
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_FS, 0, 0x40);  //EP 0 Fifo
-  
-#if (NUM_OF_CDC_UARTS > 0)
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_FS, CDC_EP_DATA_OUT_1, 0x20);
-#endif
-
-#if (NUM_OF_CDC_UARTS > 1)
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_FS, CDC_EP_DATA_OUT_2, 0x20);
-#endif
-
-#if (NUM_OF_CDC_UARTS > 2)
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_FS, CDC_EP_DATA_OUT_3, 0x20);
-#endif
-
-#if (NUM_OF_CDC_UARTS > 3)
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_FS, CDC_EP_DATA_OUT_4, 0x20);
-#endif
+  USBD_FIFO_Setup(&hpcd_USB_OTG_FS);
 
   }
 #endif
@@ -63,6 +63,8 @@
   * @{
   */
 
+//CDC channels, may be given on the command line (fewer to fit gs_usb)
+#ifndef NUM_OF_CDC_UARTS
 //USB Full Speed
 #if defined (USE_OTG_FS)
 #define NUM_OF_CDC_UARTS                    2 //1-2
@@ -72,10 +74,42 @@
 #if defined (USE_OTG_HS)
 #define NUM_OF_CDC_UARTS                    3 //1-3
 #endif
+#endif
+
+//OTG internal DMA moves FIFO data instead of CPU: 1 - enabled, 0 - disabled.
+//Only OTG_HS core has DMA. Data buffers must be word aligned.
+#ifndef USBD_DMA_ENABLE
+#define USBD_DMA_ENABLE                     0
+#endif
+
+#if defined (USE_OTG_FS) && (USBD_DMA_ENABLE == 1)
+#error "OTG_FS core has no DMA"
+#endif
+
+//Vendor specific bulk interface (WinUSB, libusb) after CDC interfaces:
+//1 - enabled, 0 - disabled. Uses one more IN and OUT endpoint.
+#ifndef USBD_VENDOR_ENABLE
+#define USBD_VENDOR_ENABLE                  1
+#endif
+
+//gs_usb (candleLight) interface for the Linux SocketCAN driver: 1 - enabled,
+//0 - disabled. Device takes the candleLight VID/PID, gs_usb becomes interface 0
+//with EP1 IN / EP2 OUT and needs fewer CDC channels to fit core endpoints.
+#ifndef USBD_GSUSB_ENABLE
+#define USBD_GSUSB_ENABLE                   0
+#endif
+
+//Device endpoints of the core, EP0 included
+#if defined (USE_OTG_FS)
+#define USBD_MAX_EP_NUMBER                  6
+#endif
+#if defined (USE_OTG_HS)
+#define USBD_MAX_EP_NUMBER                  8
+#endif
 
 /*---------- -----------*/
 //#define USBD_MAX_NUM_INTERFACES     1U
-#define USBD_MAX_NUM_INTERFACES     ( (2 * NUM_OF_CDC_UARTS) + 0 )
+#define USBD_MAX_NUM_INTERFACES     ( (2 * NUM_OF_CDC_UARTS) + USBD_VENDOR_ENABLE + USBD_GSUSB_ENABLE )
 /*---------- -----------*/
 #define USBD_MAX_NUM_CONFIGURATION     1U
 /*---------- -----------*/
@@ -85,6 +119,9 @@
 /*---------- -----------*/
 #define USBD_LPM_ENABLED     0U
 /*---------- -----------*/
+//BOS descriptor carries MS OS 2.0 platform capability for the vendor interface
+#define USBD_CLASS_BOS_ENABLED     USBD_VENDOR_ENABLE
+/*---------- -----------*/
 #define USBD_SELF_POWERED     1U
 
 /****************************************/